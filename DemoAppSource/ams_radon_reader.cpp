@@ -1,8 +1,9 @@
 #include <string>
+#include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <iostream>
-#include <QTime>
+#include <time.h>
 #include "ams_radon_reader.h"
 #include "uart.h"
 
@@ -26,8 +27,10 @@
 #define ERR_NOMSG	-6
 #define ERR_PARAM	-7
 #define ERR_PROTO	-8
+#define ERR_CANCELLED	-9		// status of a ReaderOperation cancelled before it ran
 #define CRC_ERROR       -33
 #define TIMEOUT_ERROR	-34
+#define FRAME_SIZE_ERROR	-35	// reply longer than the receive buffer, dropped
 #define CRC16_PRELOAD 0xFFFF
 
 unsigned short crc16OffsetTable[256] = {
@@ -71,6 +74,9 @@ unsigned short crc16OffsetTable[256] = {
 #define COM_CTRL_CMD_ENTER_BOOTLOADER 	0x6B
 #define COM_WRITE_REG				 	0x68
 #define COM_READ_REG				 	0x69
+#define COM_SET_BAUD_RATE				0x6A
+#define COM_WRITE_REGS					0x6C
+#define COM_READ_TRACE					0x6D
 #define CMD_READER_CONFIG               0
 #define CMD_ANTENNA_POWER               1
 #define CMD_CHANGE_FREQ                 2
@@ -119,1962 +125,1256 @@ unsigned short crc16OffsetTable[256] = {
 #define COM_CTRL_CMD_ENTER_BOOTLOADER_RESP 	46
 #define COM_WRITE_REG_RESP				 	47
 #define COM_READ_REG_RESP				 	48
+#define COM_SET_BAUD_RATE_RESP				49
+#define COM_WRITE_REGS_RESP					50
+#define COM_READ_TRACE_RESP					51
+#define FIRMWARE_UNHANDLED_PROTOCOL		0x01	// reply status of a request the firmware does not implement
+#define FIRMWARE_CRC_ERROR				0x04	// reply status of a request the reader received corrupted
 #define WAIT_FOR_RESPONSE_TIME 				25
 #define WAIT_FOR_INVENTORY_RESPONSE_TIME 	300
 #define WAIT_FOR_TAG_DATA_RESPONSE_TIME 	300
 #define WAIT_FOR_AUTOTUNE_2_RESPONSE_TIME 	6000
 #define WAIT_FOR_AUTOTUNE_1_RESPONSE_TIME 	300
 #define WRITE_TO_TAG_WAIT_FOR_RESPONSE_TIME 400
+#define WAIT_FOR_FLASH_WRITE_RESPONSE_TIME	200		// erase and program one flash page of the PIC
+#define WAIT_FOR_BAND_TUNING_CHANNEL_TIME	(WAIT_FOR_AUTOTUNE_1_RESPONSE_TIME + WAIT_FOR_AUTOTUNE_2_RESPONSE_TIME)
+
+#define SEQUENCE_FLAG 0x80
+#define SEQUENCE_SIZE 1
+
+#define GEN2_LINK_FREQUENCY	0
+#define GEN2_CODING			1
+#define GEN2_SESSION		2
+#define GEN2_TREXT			3
+#define GEN2_TARI			4
+#define GEN2_QBEGIN			5
+#define GEN2_SEL			6
+#define GEN2_TARGET			7
+#define TXRX_SENSITIVITY	0
+#define TXRX_ANTENNA_ID		1
+#define TUNER_CIN			0
+#define TUNER_CLEN			1
+#define TUNER_COUT			2
+#define TUNER_TABLE_TUNE_BAND	0x03
+#define TUNER_TABLE_PROGRESS	0x04
+#define TUNER_TABLE_DUMP		0x05
+#define TUNER_TABLE_COMMIT		0x06
+#define TUNER_TABLE_INVALIDATE	0x07
+#define TUNE_BAND_HEADER_SIZE	8	// subcommand, autotune, profile, base frequency, reserved
+#define TUNING_TABLE_DUMP_HEADER_SIZE	3
+
+static const int timeoutTable[NUM_TIMEOUT_CLASSES] = {
+	WAIT_FOR_RESPONSE_TIME,					// TIMEOUT_COMMAND
+	WAIT_FOR_INVENTORY_RESPONSE_TIME,		// TIMEOUT_INVENTORY
+	WAIT_FOR_TAG_DATA_RESPONSE_TIME,		// TIMEOUT_TAG_DATA
+	WRITE_TO_TAG_WAIT_FOR_RESPONSE_TIME,	// TIMEOUT_TAG_WRITE
+	WAIT_FOR_AUTOTUNE_1_RESPONSE_TIME,		// TIMEOUT_AUTOTUNE
+	WAIT_FOR_AUTOTUNE_2_RESPONSE_TIME,		// TIMEOUT_AUTOTUNE_DEEP
+	WAIT_FOR_FLASH_WRITE_RESPONSE_TIME		// TIMEOUT_FLASH_WRITE
+};
+
+// Indexed by CommandId: opcode, reply opcode, subcommand, payload length, timeout class
+static const CommandDescriptor commandTable[] = {
+	{COM_CTRL_CMD_RESET,			COM_CTRL_CMD_RESET_RESP,			1,				1,					TIMEOUT_COMMAND},		// CMDID_RESET_PIC
+	{COM_CTRL_CMD_RESET,			COM_CTRL_CMD_RESET_RESP,			2,				1,					TIMEOUT_COMMAND},		// CMDID_RESET_AS3993
+	{COM_CTRL_CMD_ENTER_BOOTLOADER,	COM_CTRL_CMD_ENTER_BOOTLOADER_RESP,	NO_SUBCOMMAND,	0,					TIMEOUT_COMMAND},		// CMDID_ENTER_BOOTLOADER
+	{COM_CTRL_CMD_FW_NUMBER,		COM_CTRL_CMD_FW_NUMBER_RESP,		NO_SUBCOMMAND,	0,					TIMEOUT_COMMAND},		// CMDID_FW_NUMBER
+	{COM_CTRL_CMD_FW_INFORMATION,	COM_CTRL_CMD_FW_INFORMATION_RESP,	NO_SUBCOMMAND,	0,					TIMEOUT_COMMAND},		// CMDID_FW_INFORMATION
+	{COM_WRITE_REG,					COM_WRITE_REG_RESP,					NO_SUBCOMMAND,	2,					TIMEOUT_COMMAND},		// CMDID_WRITE_REG
+	{COM_READ_REG,					COM_READ_REG_RESP,					0x01,			2,					TIMEOUT_COMMAND},		// CMDID_READ_REG
+	{COM_READ_REG,					COM_READ_REG_RESP,					0x00,			2,					TIMEOUT_COMMAND},		// CMDID_READ_ALL_REGS
+	{COM_SET_BAUD_RATE,				COM_SET_BAUD_RATE_RESP,				NO_SUBCOMMAND,	4,					TIMEOUT_COMMAND},		// CMDID_SET_BAUD_RATE
+	{COM_WRITE_REGS,				COM_WRITE_REGS_RESP,				NO_SUBCOMMAND,	VARIABLE_PAYLOAD,	TIMEOUT_COMMAND},		// CMDID_WRITE_REGS
+	{COM_READ_TRACE,				COM_READ_TRACE_RESP,				NO_SUBCOMMAND,	0,					TIMEOUT_COMMAND},		// CMDID_READ_TRACE
+	{CMD_READER_CONFIG,				CMD_READER_CONFIG_RESP,				0x01,			2,					TIMEOUT_COMMAND},		// CMDID_SET_READER_CONFIG
+	{CMD_READER_CONFIG,				CMD_READER_CONFIG_RESP,				0x00,			2,					TIMEOUT_COMMAND},		// CMDID_GET_READER_CONFIG
+	{CMD_ANTENNA_POWER,				CMD_ANTENNA_POWER_RESP,				NO_SUBCOMMAND,	2,					TIMEOUT_COMMAND},		// CMDID_ANTENNA_POWER
+	{CMD_CHANGE_FREQ,				CMD_CHANGE_FREQ_RESP,				0x02,			5,					TIMEOUT_COMMAND},		// CMDID_REFLECTED_POWER
+	{CMD_CHANGE_FREQ,				CMD_CHANGE_FREQ_RESP,				0x04,			6,					TIMEOUT_COMMAND},		// CMDID_ADD_HOPPING_FREQ
+	{CMD_CHANGE_FREQ,				CMD_CHANGE_FREQ_RESP,				0x05,			1,					TIMEOUT_COMMAND},		// CMDID_GET_FREQ_LIST_PARAMS
+	{CMD_CHANGE_FREQ,				CMD_CHANGE_FREQ_RESP,				0x08,			8,					TIMEOUT_COMMAND},		// CMDID_SET_HOPPING_PARAMS
+	{CMD_CHANGE_FREQ,				CMD_CHANGE_FREQ_RESP,				0x09,			1,					TIMEOUT_COMMAND},		// CMDID_GET_HOPPING_PARAMS
+	{CMD_CHANGE_FREQ,				CMD_CHANGE_FREQ_RESP,				0x10,			17,					TIMEOUT_COMMAND},		// CMDID_CONTINUOUS_MODULATION
+	{CMD_GEN2_SETTINGS,				CMD_GEN2_SETTINGS_RESP,				NO_SUBCOMMAND,	16,					TIMEOUT_COMMAND},		// CMDID_GEN2_SETTINGS
+	{CMD_CONFIG_TX_RX,				CMD_CONFIG_TX_RX_RESP,				NO_SUBCOMMAND,	4,					TIMEOUT_COMMAND},		// CMDID_CONFIG_TX_RX
+	{CMD_INVENTORY_GEN2,			CMD_INVENTORY_GEN2_RESP,			NO_SUBCOMMAND,	3,					TIMEOUT_INVENTORY},		// CMDID_INVENTORY_GEN2
+	{CMD_GET_TAG_DATA,				CMD_GET_TAG_DATA_RESP,				NO_SUBCOMMAND,	0,					TIMEOUT_TAG_DATA},		// CMDID_GET_TAG_DATA
+	{CMD_SELECT_TAG,				CMD_SELECT_TAG_RESP,				NO_SUBCOMMAND,	VARIABLE_PAYLOAD,	TIMEOUT_COMMAND},		// CMDID_SELECT_TAG
+	{CMD_WRITE_TO_TAG,				CMD_WRITE_TO_TAG_RESP,				NO_SUBCOMMAND,	VARIABLE_PAYLOAD,	TIMEOUT_TAG_WRITE},		// CMDID_WRITE_TO_TAG
+	{CMD_READ_FROM_TAG,				CMD_READ_FROM_TAG_RESP,				NO_SUBCOMMAND,	10,					TIMEOUT_COMMAND},		// CMDID_READ_FROM_TAG
+	{CMD_LOCK_UNLOCK_TAG,			CMD_LOCK_UNLOCK_TAG_RESP,			NO_SUBCOMMAND,	6,					TIMEOUT_COMMAND},		// CMDID_LOCK_UNLOCK_TAG
+	{CMD_KILL_TAG,					CMD_KILL_TAG_RESP,					NO_SUBCOMMAND,	5,					TIMEOUT_COMMAND},		// CMDID_KILL_TAG
+	{CMD_START_STOP,				CMD_START_STOP_RESP,				NO_SUBCOMMAND,	5,					TIMEOUT_INVENTORY},		// CMDID_START_STOP
+	{CMD_TUNER_TABLE,				CMD_TUNER_TABLE_RESP,				0x00,			1,					TIMEOUT_COMMAND},		// CMDID_TUNER_TABLE_SIZE
+	{CMD_TUNER_TABLE,				CMD_TUNER_TABLE_RESP,				0x01,			1,					TIMEOUT_COMMAND},		// CMDID_TUNER_TABLE_DELETE
+	{CMD_TUNER_TABLE,				CMD_TUNER_TABLE_RESP,				0x02,			16,					TIMEOUT_COMMAND},		// CMDID_TUNER_TABLE_ADD
+	{CMD_TUNER_TABLE,				CMD_TUNER_TABLE_RESP,				TUNER_TABLE_TUNE_BAND,	VARIABLE_PAYLOAD,	TIMEOUT_COMMAND},	// CMDID_TUNER_TABLE_TUNE_BAND
+	{CMD_TUNER_TABLE,				CMD_TUNER_TABLE_RESP,				TUNER_TABLE_DUMP,	1,				TIMEOUT_COMMAND},		// CMDID_TUNER_TABLE_DUMP
+	{CMD_TUNER_TABLE,				CMD_TUNER_TABLE_RESP,				TUNER_TABLE_COMMIT,	1,				TIMEOUT_FLASH_WRITE},	// CMDID_TUNER_TABLE_COMMIT
+	{CMD_TUNER_TABLE,				CMD_TUNER_TABLE_RESP,				TUNER_TABLE_INVALIDATE,	1,			TIMEOUT_FLASH_WRITE},	// CMDID_TUNER_TABLE_INVALIDATE
+	{CMD_AUTO_TUNER,				CMD_AUTO_TUNER_RESP,				NO_SUBCOMMAND,	1,					TIMEOUT_AUTOTUNE},		// CMDID_AUTO_TUNE
+	{CMD_AUTO_TUNER,				CMD_AUTO_TUNER_RESP,				NO_SUBCOMMAND,	1,					TIMEOUT_AUTOTUNE_DEEP},	// CMDID_AUTO_TUNE_DEEP
+	{CMD_ANTENNA_TUNER,				CMD_ANTENNA_TUNER_RESP,				NO_SUBCOMMAND,	6,					TIMEOUT_COMMAND},		// CMDID_ANTENNA_TUNER
+	{CMD_GENERIC_CMD_ID,			CMD_GENERIC_CMD_ID_RESP,			NO_SUBCOMMAND,	VARIABLE_PAYLOAD,	TIMEOUT_COMMAND}		// CMDID_GENERIC
+};
+// fails to compile if an entry is missing
+typedef char commandTableComplete[sizeof(commandTable) / sizeof(commandTable[0]) == NUM_COMMAND_IDS ? 1 : -1];
+
+// Registers the firmware only writes while it initializes the chip (power
+// and modulator settings, regulators, ICD). Their shadow copies stay valid
+// until the next reset; everything else (status control, Gen2 timing,
+// sensitivity, PLL, measurement, IRQ and FIFO) is rewritten by inventories,
+// hopping and configuration commands and is always read from the chip.
+static bool isStableRegister(unsigned char regAddr)
+{
+	switch(regAddr)
+	{
+		case 0x0B: case 0x0C: case 0x0D:
+		case 0x13: case 0x15: case 0x16:
+		case 0x1D:
+			return true;
+		default:
+			return false;
+	}
+}
+// Registers in the reply of a read-all request, in order; the gaps of the
+// register map are left out.
+static bool isReadAllRegister(unsigned char regAddr)
+{
+	return regAddr < 0x3F && regAddr != 0x0F && !(regAddr > 0x1D && regAddr < 0x22) &&
+			!(regAddr > 0x22 && regAddr < 0x29) && !(regAddr > 0x2E && regAddr < 0x33) && regAddr != 0x34;
+}
 
 AMSRadonReader::AMSRadonReader(string uartFileName)
 {
 	uart = new UART(uartFileName);	
+	pipelineDepth = 1;
+	nextSequence = 0;
+	bytesInFlight = 0;
+	pipelineStatus = 0;
+	txLength = 0;
+	txCommand = CMDID_FW_NUMBER;
+	streamQueue = new TagStreamQueue();
+	streamRunning = false;
+	streamRounds = 0;
+	streamFramesDropped = 0;
+	invalidateAS3993Shadow();
+	memset(regPendingMask, 0, sizeof(regPendingMask));
+	memset(regPendingValue, 0, sizeof(regPendingValue));
 }
 short AMSRadonReader::initialize()
 {
+	invalidateAS3993Shadow();
 	return uart->initialize();
 }
-short AMSRadonReader::resetPIC()
+// Captures the UART session to recordFileName so it can be replayed later
+// without a reader module (see tools/uart_replay.cpp).
+short AMSRadonReader::startRecording(string recordFileName)
 {
-	char cmdMsgBuffer[7];
-	char respMsgBuffer[25];
-	SET_MESSAGE_TYPE(cmdMsgBuffer, COM_CTRL_CMD_RESET);
-	SET_MESSAGE_LENGTH(cmdMsgBuffer, 7);
-	SET_MESSAGE_CRC(cmdMsgBuffer, 0);
-	SET_MESSAGE_STATUS(cmdMsgBuffer, 0);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 6, 1);  //reset pic  = 1, reset as3993 = 2;
-	unsigned short crc = calculateCRC(cmdMsgBuffer, 7);
-	SET_MESSAGE_CRC(cmdMsgBuffer, crc);
-	uart->flush();
-	uart->sendMessage(&cmdMsgBuffer[0], 7);
-	short count = 0;
-	QTime timer;
-	unsigned short msgLength = 3;
-	timer.start();
-	do
+	return uart->startRecording(recordFileName) == 0 ? ERR_NONE : ERR_IO;
+}
+void AMSRadonReader::stopRecording()
+{
+	uart->stopRecording();
+}
+// Moves the link to the fastest rate up to maxBaudRate that both ends
+// support. The reader answers a rate request at the current rate and then
+// switches; the new rate is only kept if LINK_VERIFY_PINGS requests get
+// through, otherwise both ends go back to UART_DEFAULT_BAUD_RATE and the next
+// lower rate is tried. Returns ERR_REQUEST if the link stays at the default.
+short AMSRadonReader::negotiateBaudRate(int maxBaudRate)
+{
+	static const int linkBaudRates[] = {1000000, 460800, 230400};
+	if(pipelineDepth > 1 || streamRunning)
+		return ERR_BUSY;
+	// a reader left at a negotiated rate by an earlier session falls back on
+	// the framing errors our requests cause
+	short status = restoreDefaultBaudRate();
+	if(status != ERR_NONE)
+		return status;
+	for(unsigned int i = 0; i < sizeof(linkBaudRates) / sizeof(linkBaudRates[0]); i++)
 	{
-		if(uart->receiveMessage(&respMsgBuffer[count], 1) > 0)
+		int baudRate = linkBaudRates[i];
+		if(baudRate > maxBaudRate)
+			continue;
+		char *payload = beginRequest(CMDID_SET_BAUD_RATE);
+		payload[0] = baudRate & 0xFF;
+		payload[1] = (baudRate >> 8) & 0xFF;
+		payload[2] = (baudRate >> 16) & 0xFF;
+		payload[3] = (baudRate >> 24) & 0xFF;
+		ReplyView reply;
+		short msgLength = transact(reply);
+		if(msgLength == ERR_PROTO)
+			return ERR_REQUEST;		// firmware without rate negotiation
+		if(msgLength <= 0)
+			return msgLength;
+		if(reply.status() != 0)
+			continue;				// rate not supported by the reader
+		if(uart->setBaudRate(baudRate) != 0)
 		{
-			count++;
-			if(count == 3)
-			{
-				msgLength = GET_MESSAGE_LENGTH(respMsgBuffer);		
-			}
-			timer.restart();
+			restoreDefaultBaudRate();
+			continue;
 		}
-	}while ((count < msgLength) && (timer.elapsed() < WAIT_FOR_RESPONSE_TIME));
-	if(count != msgLength)
-		return TIMEOUT_ERROR;
-	unsigned short msgCRC  = GET_MESSAGE_CRC(respMsgBuffer);
-	SET_MESSAGE_CRC(respMsgBuffer, 0);
-	unsigned short calculatedCRC = calculateCRC(respMsgBuffer, msgLength);
-	if(msgCRC != calculatedCRC)
-		return CRC_ERROR;
-	char msgStatus  = GET_MESSAGE_STATUS(respMsgBuffer);
-	return msgStatus;
+		int verified = 0;
+		int firmwareVersion;
+		while(verified < LINK_VERIFY_PINGS && getFirmwareVersion(firmwareVersion) == 0)
+			verified++;
+		if(verified == LINK_VERIFY_PINGS)
+			return ERR_NONE;
+		if(uart->getBaudRate() != UART_DEFAULT_BAUD_RATE)
+			restoreDefaultBaudRate();
+	}
+	return ERR_REQUEST;
 }
-short AMSRadonReader::resetAS3993()
+int AMSRadonReader::getBaudRate()
 {
-	char cmdMsgBuffer[7];
-	char respMsgBuffer[25];
-	SET_MESSAGE_TYPE(cmdMsgBuffer, COM_CTRL_CMD_RESET);
-	SET_MESSAGE_LENGTH(cmdMsgBuffer, 7);
-	SET_MESSAGE_CRC(cmdMsgBuffer, 0);
-	SET_MESSAGE_STATUS(cmdMsgBuffer, 0);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 6, 2);  //reset pic  = 1, reset as3993 = 2;
-	unsigned short crc = calculateCRC(cmdMsgBuffer, 7);
-	SET_MESSAGE_CRC(cmdMsgBuffer, crc);
+	return uart->getBaudRate();
+}
+// Called with the result of a failed exchange. A corrupted or missing reply
+// at a negotiated rate means the line does not carry it, so the link goes
+// back to the default rate; the reader does the same on the CRC and framing
+// errors it sees. The error is passed on either way.
+short AMSRadonReader::linkFailed(short error)
+{
+	if((error == CRC_ERROR || error == TIMEOUT_ERROR) && uart->getBaudRate() != UART_DEFAULT_BAUD_RATE)
+		restoreDefaultBaudRate();
+	return error;
+}
+// Switches the port to UART_DEFAULT_BAUD_RATE and waits for the reader to
+// answer there. The first requests may be lost while the reader detects the
+// rate change.
+short AMSRadonReader::restoreDefaultBaudRate()
+{
+	if(uart->setBaudRate(UART_DEFAULT_BAUD_RATE) != 0)
+		return ERR_IO;
+	int firmwareVersion;
+	short status = ERR_NONE;
+	for(int i = 0; i < LINK_VERIFY_PINGS; i++)
+	{
+		status = getFirmwareVersion(firmwareVersion);
+		if(status == 0)
+			return ERR_NONE;
+	}
+	return status;
+}
+// Switches the reader into pipelined mode. Up to depth commands (and no more
+// request bytes than the firmware UART buffer holds) are sent ahead of their
+// replies. In this mode the command methods return 0 as soon as the request is
+// queued and do not fill in their output parameters, so only commands whose
+// reply carries nothing but a status should be issued. endPipeline() waits for
+// the outstanding replies and returns the first error seen.
+short AMSRadonReader::beginPipeline(int depth)
+{
+	if(depth < 1 || depth > MAX_PIPELINE_DEPTH)
+		return ERR_PARAM;
+	if(pipelineDepth > 1)
+		return ERR_BUSY;
 	uart->flush();
-	uart->sendMessage(&cmdMsgBuffer[0], 7);
-	short count = 0;
-	QTime timer;
-	unsigned short msgLength = 3;
-	timer.start();
-	do
+	pipelineDepth = depth;
+	pipelineStatus = 0;
+	bytesInFlight = 0;
+	inFlight.clear();
+	return ERR_NONE;
+}
+short AMSRadonReader::endPipeline()
+{
+	while(!inFlight.empty())
+		collectPipelinedReply();
+	pipelineDepth = 1;
+	short status = pipelineStatus;
+	pipelineStatus = 0;
+	return status;
+}
+// Starts cyclic inventory on the reader. The firmware then runs inventory
+// rounds back to back and pushes the result of every round as an unsolicited
+// CMD_GET_TAG_DATA reply. With INVENTORY_STREAM_TAGS in tidAndFast it pushes
+// every tag on its own as soon as it is singulated, and the round has no limit
+// on its tags. A thread decodes these frames and queues the tags for
+// readStreamedTag(). While the stream runs all other commands fail with
+// ERR_BUSY; stopTagStream() ends it.
+short AMSRadonReader::startTagStream(char autoAck, char tidAndFast, char rssi)
+{
+	if(streamRunning || pipelineDepth > 1)
+		return ERR_BUSY;
+	char currStartValue;
+	short status = startStop(1, 1, autoAck, tidAndFast, rssi, currStartValue);
+	if(status != 0)
+		return status;
+	streamQueue->reset();
+	streamRounds = 0;
+	streamFramesDropped = 0;
+	streamRunning = true;
+	if(pthread_create(&streamThread, NULL, &tagStreamThread, this) != 0)
 	{
-		if(uart->receiveMessage(&respMsgBuffer[count], 1) > 0)
-		{
-			count++;
-			if(count == 3)
-			{
-				msgLength = GET_MESSAGE_LENGTH(respMsgBuffer);		
-			}
-			timer.restart();
-		}
-	}while ((count < msgLength) && (timer.elapsed() < WAIT_FOR_RESPONSE_TIME));
-	if(count != msgLength)
-		return TIMEOUT_ERROR;
-	unsigned short msgCRC  = GET_MESSAGE_CRC(respMsgBuffer);
-	SET_MESSAGE_CRC(respMsgBuffer, 0);
-	unsigned short calculatedCRC = calculateCRC(respMsgBuffer, msgLength);
-	if(msgCRC != calculatedCRC)
-		return CRC_ERROR;
-	char msgStatus  = GET_MESSAGE_STATUS(respMsgBuffer);
-	return msgStatus;
+		streamRunning = false;
+		startStop(1, 0, 0, 0, 0, currStartValue);
+		return ERR_NOMEM;
+	}
+	return ERR_NONE;
 }
-short AMSRadonReader::enterBootloader()
+short AMSRadonReader::stopTagStream()
 {
-	char cmdMsgBuffer[6];
-	char respMsgBuffer[25];
-	SET_MESSAGE_TYPE(cmdMsgBuffer, COM_CTRL_CMD_ENTER_BOOTLOADER);
-	SET_MESSAGE_LENGTH(cmdMsgBuffer, 6);
-	SET_MESSAGE_CRC(cmdMsgBuffer, 0);
-	SET_MESSAGE_STATUS(cmdMsgBuffer, 0);
-	unsigned short crc = calculateCRC(cmdMsgBuffer, 6);
-	SET_MESSAGE_CRC(cmdMsgBuffer, crc);
-	uart->flush();
-	uart->sendMessage(&cmdMsgBuffer[0], 6);
-	short count = 0;
-	QTime timer;
-	unsigned short msgLength = 3;
-	timer.start();
-	do
+	if(!streamRunning)
+		return ERR_NONE;
+	streamRunning = false;
+	pthread_join(streamThread, NULL);
+	char currStartValue;
+	return startStop(1, 0, 0, 0, 0, currStartValue);
+}
+// Returns false if no streamed tag is waiting. Tags decoded before
+// stopTagStream() stay readable until the next startTagStream().
+bool AMSRadonReader::readStreamedTag(TagData &tag)
+{
+	return streamQueue->pop(tag);
+}
+// rounds: inventory rounds received, their tags are queued before the count
+// is raised. tagsDropped: tags lost because the queue was full.
+// framesDropped: frames lost to CRC errors or truncation.
+void AMSRadonReader::getTagStreamCounters(unsigned int &rounds, unsigned int &tagsDropped, unsigned int &framesDropped)
+{
+	rounds = streamRounds;
+	tagsDropped = streamQueue->getOverflowCount();
+	framesDropped = streamFramesDropped;
+}
+void *AMSRadonReader::tagStreamThread(void *reader)
+{
+	((AMSRadonReader *)reader)->runTagStream();
+	return NULL;
+}
+void AMSRadonReader::runTagStream()
+{
+	ReplyView reply;
+	TagData tag;
+	while(streamRunning)
 	{
-		if(uart->receiveMessage(&respMsgBuffer[count], 1) > 0)
+		short msgLength = receiveResponse(streamFrame, sizeof(streamFrame), TAG_STREAM_POLL_TIME);
+		if(msgLength == TIMEOUT_ERROR)
+			continue;
+		if(msgLength < 0)
 		{
-			count++;
-			if(count == 3)
+			streamFramesDropped++;
+			continue;
+		}
+		if((unsigned char)GET_MESSAGE_TYPE(streamFrame) != CMD_GET_TAG_DATA_RESP)
+			continue;
+		reply.attach(streamFrame, msgLength);
+		char inventoryType = reply.byte(1);
+		if(reply.status() == 0 && reply.byte(0) == 0)
+		{
+			unsigned short index = 3;
+			for(char tagNumber = reply.byte(2); tagNumber > 0; tagNumber--)
 			{
-				msgLength = GET_MESSAGE_LENGTH(respMsgBuffer);		
+				tag.clear();
+				index = decodeTag(reply, index, inventoryType, tag);
+				if(index == 0)
+				{	// record count or layout does not match the frame
+					streamFramesDropped++;
+					break;
+				}
+				streamQueue->push(tag);
 			}
-			timer.restart();
 		}
-	}while ((count < msgLength) && (timer.elapsed() < WAIT_FOR_RESPONSE_TIME));
-	if(count != msgLength)
-		return TIMEOUT_ERROR;
-	unsigned short msgCRC  = GET_MESSAGE_CRC(respMsgBuffer);
-	SET_MESSAGE_CRC(respMsgBuffer, 0);
-	unsigned short calculatedCRC = calculateCRC(respMsgBuffer, msgLength);
-	if(msgCRC != calculatedCRC)
-		return CRC_ERROR;
-	char msgStatus  = GET_MESSAGE_STATUS(respMsgBuffer);
-	return msgStatus;
+		if(inventoryType & TAG_DATA_ROUND_CONTINUES)
+			continue;
+		__sync_synchronize();
+		streamRounds++;
+	}
 }
-short AMSRadonReader::getFirmwareVersion(int &firmwareVersion)
+// Waits for the next reply of the pipeline and retires the request it belongs
+// to. Requests older than the one answered lost their reply and are retired
+// with TIMEOUT_ERROR, as is the oldest request if nothing arrives in time.
+short AMSRadonReader::collectPipelinedReply()
+{
+	unsigned char sequence = 0;
+	short msgLength = receiveResponse(rxFrame, sizeof(rxFrame), inFlight.front().timeout, &sequence);
+	short status = ERR_NONE;
+	if(msgLength < 0 || sequence == 0)
+	{	// nothing usable arrived or reply of an older firmware: replies come in order
+		sequence = inFlight.front().sequence;
+		status = msgLength < 0 ? msgLength : GET_MESSAGE_STATUS(rxFrame);
+	}
+	else
+	{
+		deque<PendingRequest>::iterator it = inFlight.begin();
+		while(it != inFlight.end() && it->sequence != sequence)
+			++it;
+		if(it == inFlight.end())
+			return ERR_NOMSG;	// stale reply, nothing retired
+		status = GET_MESSAGE_STATUS(rxFrame);
+	}
+	while(!inFlight.empty())
+	{
+		PendingRequest request = inFlight.front();
+		inFlight.pop_front();
+		bytesInFlight -= request.length;
+		if(request.sequence == sequence)
+			break;
+		if(pipelineStatus == ERR_NONE)
+			pipelineStatus = TIMEOUT_ERROR;
+	}
+	if(status != ERR_NONE && pipelineStatus == ERR_NONE)
+		pipelineStatus = status;
+	return status;
+}
+// Sends a request and, unless the reader is pipelining, waits for its reply.
+// Returns the reply length, 0 if the request was queued in the pipeline or a
+// negative error code.
+short AMSRadonReader::exchange(char *cmdMsgBuffer, unsigned short cmdLength, char *respMsgBuffer, unsigned short bufferSize, int timeout)
 {
-	char cmdMsgBuffer[6];
-	char respMsgBuffer[25];
-	SET_MESSAGE_TYPE(cmdMsgBuffer, COM_CTRL_CMD_FW_NUMBER);
-	SET_MESSAGE_LENGTH(cmdMsgBuffer, 6);
+	if(pipelineDepth <= 1)
+	{
+		uart->flush();
+		uart->sendMessage(cmdMsgBuffer, cmdLength);
+		return receiveResponse(respMsgBuffer, bufferSize, timeout);
+	}
+	if(cmdLength > FIRMWARE_RX_BUFFER_SIZE)
+		return ERR_PARAM;
+	while(!inFlight.empty() && ((int)inFlight.size() >= pipelineDepth || bytesInFlight + cmdLength > FIRMWARE_RX_BUFFER_SIZE))
+		collectPipelinedReply();
+	if(++nextSequence == 0)
+		nextSequence = 1;
 	SET_MESSAGE_CRC(cmdMsgBuffer, 0);
-	SET_MESSAGE_STATUS(cmdMsgBuffer, 0);
-	unsigned short crc = calculateCRC(cmdMsgBuffer, 6);
+	SET_MESSAGE_STATUS(cmdMsgBuffer, nextSequence);
+	unsigned short crc = calculateCRC(cmdMsgBuffer, cmdLength);
 	SET_MESSAGE_CRC(cmdMsgBuffer, crc);
-	uart->flush();
-	uart->sendMessage(&cmdMsgBuffer[0], 6);
-	short count = 0;
-	QTime timer;
-	unsigned short msgLength = 3;
-	timer.start();
-	do
-	{
-		if(uart->receiveMessage(&respMsgBuffer[count], 1) > 0)
-		{
-			count++;
-			if(count == 3)
-			{
-				msgLength = GET_MESSAGE_LENGTH(respMsgBuffer);		
-			}
-			timer.restart();
-		}
-	}while ((count < msgLength) && (timer.elapsed() < WAIT_FOR_RESPONSE_TIME));
-	if(count != msgLength)
-		return TIMEOUT_ERROR;
-	unsigned short msgCRC  = GET_MESSAGE_CRC(respMsgBuffer);
-	SET_MESSAGE_CRC(respMsgBuffer, 0);
-	unsigned short calculatedCRC = calculateCRC(respMsgBuffer, msgLength);
-	if(msgCRC != calculatedCRC)
-		return CRC_ERROR;
-	firmwareVersion = respMsgBuffer[6] << 16 | respMsgBuffer[7] << 8 | respMsgBuffer[8];
-	char msgStatus  = GET_MESSAGE_STATUS(respMsgBuffer);
-	return msgStatus;
+	PendingRequest request;
+	request.sequence = nextSequence;
+	request.length = cmdLength;
+	request.timeout = timeout;
+	inFlight.push_back(request);
+	bytesInFlight += cmdLength;
+	if(uart->sendMessage(cmdMsgBuffer, cmdLength) != 0)
+		return ERR_IO;
+	return 0;
+}
+// Starts a request in the transmit frame and returns its zeroed payload with
+// the subcommand already in place. payloadLength is only used by commands
+// without a fixed layout. Returns 0 if the frame would not fit the firmware
+// receive buffer.
+char *AMSRadonReader::beginRequest(CommandId command, unsigned short payloadLength)
+{
+	const CommandDescriptor &descriptor = commandTable[command];
+	if(descriptor.payloadLength != VARIABLE_PAYLOAD)
+		payloadLength = descriptor.payloadLength;
+	if(payloadLength > TX_FRAME_BUFFER_SIZE - UART_FRAME_HEADER_SIZE)
+		return 0;
+	txCommand = command;
+	txLength = UART_FRAME_HEADER_SIZE + payloadLength;
+	memset(txFrame, 0, txLength);
+	SET_MESSAGE_TYPE(txFrame, descriptor.opcode);
+	SET_MESSAGE_LENGTH(txFrame, txLength);
+	char *payload = &txFrame[UART_FRAME_HEADER_SIZE];
+	if(descriptor.subCommand != NO_SUBCOMMAND)
+		payload[0] = descriptor.subCommand;
+	return payload;
+}
+// Sends the request prepared by beginRequest() and points reply at the
+// answer. Returns the reply length, 0 if the request was queued in the
+// pipeline or a negative error code.
+short AMSRadonReader::transact(ReplyView &reply)
+{
+	const CommandDescriptor &descriptor = commandTable[txCommand];
+	if(streamRunning)
+		return ERR_BUSY;	// the stream thread owns the UART
+	unsigned short crc = calculateCRC(txFrame, txLength);
+	SET_MESSAGE_CRC(txFrame, crc);
+	short msgLength = exchange(txFrame, txLength, rxFrame, sizeof(rxFrame), timeoutTable[descriptor.timeoutClass]);
+	if(msgLength <= 0)
+		return linkFailed(msgLength);
+	while((unsigned char)GET_MESSAGE_TYPE(rxFrame) == CMD_GET_TAG_DATA_RESP && descriptor.replyOpcode != CMD_GET_TAG_DATA_RESP)
+	{	// tag data the reader pushed in cyclic mode before it saw the request
+		msgLength = receiveResponse(rxFrame, sizeof(rxFrame), timeoutTable[descriptor.timeoutClass]);
+		if(msgLength <= 0)
+			return linkFailed(msgLength);
+	}
+	if((unsigned char)GET_MESSAGE_TYPE(rxFrame) != descriptor.replyOpcode)
+		return ERR_PROTO;
+	if(GET_MESSAGE_STATUS(rxFrame) == FIRMWARE_CRC_ERROR)
+		return linkFailed(CRC_ERROR);
+	reply.attach(rxFrame, msgLength);
+	return msgLength;
+}
+// Same for requests whose reply carries nothing but the status.
+short AMSRadonReader::transact()
+{
+	ReplyView reply;
+	short msgLength = transact(reply);
+	if(msgLength <= 0)
+		return msgLength;
+	return reply.status();
+}
+// Gen2 settings, TX/RX configuration and antenna tuner share a layout of
+// (enable, value) byte pairs. Writes the pair field and reports the value the
+// reader stored.
+short AMSRadonReader::setPairedSetting(CommandId command, unsigned char field, char value, char &storedValue)
+{
+	char *payload = beginRequest(command);
+	payload[2 * field] = 0x01;
+	payload[2 * field + 1] = value;
+	ReplyView reply;
+	short msgLength = transact(reply);
+	if(msgLength <= 0)
+		return msgLength;
+	storedValue = reply.byte(2 * field + 1);
+	return reply.status();
+}
+short AMSRadonReader::resetPIC()
+{
+	invalidateAS3993Shadow();
+	beginRequest(CMDID_RESET_PIC);
+	return transact();
+}
+short AMSRadonReader::resetAS3993()
+{
+	invalidateAS3993Shadow();
+	beginRequest(CMDID_RESET_AS3993);
+	return transact();
+}
+short AMSRadonReader::enterBootloader()
+{
+	beginRequest(CMDID_ENTER_BOOTLOADER);
+	return transact();
+}
+short AMSRadonReader::getFirmwareVersion(int &firmwareVersion)
+{
+	beginRequest(CMDID_FW_NUMBER);
+	ReplyView reply;
+	short msgLength = transact(reply);
+	if(msgLength <= 0)
+		return msgLength;
+	firmwareVersion = reply.u8(0) << 16 | reply.u8(1) << 8 | reply.u8(2);
+	return reply.status();
 }
 short AMSRadonReader::getFirmwareInformation(string &firmwareInfo)
 {
-	char cmdMsgBuffer[6];
-	char respMsgBuffer[100];
-	SET_MESSAGE_TYPE(cmdMsgBuffer, COM_CTRL_CMD_FW_INFORMATION);
-	SET_MESSAGE_LENGTH(cmdMsgBuffer, 6);
-	SET_MESSAGE_CRC(cmdMsgBuffer, 0);
-	SET_MESSAGE_STATUS(cmdMsgBuffer, 0);
-	unsigned short crc = calculateCRC(cmdMsgBuffer, 6);
-	SET_MESSAGE_CRC(cmdMsgBuffer, crc);
-	uart->flush();
-	uart->sendMessage(&cmdMsgBuffer[0], 6);
-	short count = 0;
-	QTime timer;
-	unsigned short msgLength = 3;
-	timer.start();
-	do
-	{
-		if(uart->receiveMessage(&respMsgBuffer[count], 1) > 0)
-		{
-			count++;
-			if(count == 3)
-			{
-				msgLength = GET_MESSAGE_LENGTH(respMsgBuffer);		
-			}
-			timer.restart();
-		}
-	}while ((count < msgLength) && (timer.elapsed() < WAIT_FOR_RESPONSE_TIME));
-	if(count != msgLength)
-		return TIMEOUT_ERROR;
-	unsigned short msgCRC  = GET_MESSAGE_CRC(respMsgBuffer);
-	SET_MESSAGE_CRC(respMsgBuffer, 0);
-	unsigned short calculatedCRC = calculateCRC(respMsgBuffer, msgLength);
-	if(msgCRC != calculatedCRC)
-		return CRC_ERROR;
-	firmwareInfo = &respMsgBuffer[6];
-	char msgStatus  = GET_MESSAGE_STATUS(respMsgBuffer);
-	return msgStatus;
+	beginRequest(CMDID_FW_INFORMATION);
+	ReplyView reply;
+	short msgLength = transact(reply);
+	if(msgLength <= 0)
+		return msgLength;
+	firmwareInfo.assign(reply.payload(0), reply.payloadLength());
+	firmwareInfo.resize(strlen(firmwareInfo.c_str()));
+	return reply.status();
 }
 short AMSRadonReader::writeToAS3993Reg(char regAddr, char regValue, char &status)
 {
-	char cmdMsgBuffer[8];
-	char respMsgBuffer[25];
-	SET_MESSAGE_TYPE(cmdMsgBuffer, COM_WRITE_REG);
-	SET_MESSAGE_LENGTH(cmdMsgBuffer, 8);
-	SET_MESSAGE_CRC(cmdMsgBuffer, 0);
-	SET_MESSAGE_STATUS(cmdMsgBuffer, 0);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 6, regAddr);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 7, regValue);
-	unsigned short crc = calculateCRC(cmdMsgBuffer, 8);
-	SET_MESSAGE_CRC(cmdMsgBuffer, crc);
-	uart->flush();
-	uart->sendMessage(&cmdMsgBuffer[0], 8);
-	short count = 0;
-	QTime timer;
-	unsigned short msgLength = 3;
-	timer.start();
-	do
+	char *payload = beginRequest(CMDID_WRITE_REG);
+	payload[0] = regAddr;
+	payload[1] = regValue;
+	ReplyView reply;
+	short msgLength = transact(reply);
+	if(msgLength <= 0)
+		return msgLength;
+	status = reply.byte(0);
+	unsigned char address = regAddr;
+	if(address >= AS3993_REGISTER_COUNT)
+		invalidateAS3993Shadow();	// direct command, may reset the chip
+	else if(pipelineDepth <= 1)
 	{
-		if(uart->receiveMessage(&respMsgBuffer[count], 1) > 0)
-		{
-			count++;
-			if(count == 3)
-			{
-				msgLength = GET_MESSAGE_LENGTH(respMsgBuffer);		
-			}
-			timer.restart();
-		}
-	}while ((count < msgLength) && (timer.elapsed() < WAIT_FOR_RESPONSE_TIME));
-	if(count != msgLength)
-		return TIMEOUT_ERROR;
-	unsigned short msgCRC  = GET_MESSAGE_CRC(respMsgBuffer);
-	SET_MESSAGE_CRC(respMsgBuffer, 0);
-	unsigned short calculatedCRC = calculateCRC(respMsgBuffer, msgLength);
-	if(msgCRC != calculatedCRC)
-		return CRC_ERROR;
-	status = respMsgBuffer[6];
-	char msgStatus  = GET_MESSAGE_STATUS(respMsgBuffer);
-	return msgStatus;
+		regShadow[address] = regValue;
+		regShadowValid[address] = true;
+	}
+	return reply.status();
 }
 short AMSRadonReader::readAS3993Reg(char regAddr, char *regValue)
 {
-	char cmdMsgBuffer[8];
-	char respMsgBuffer[75];
-	SET_MESSAGE_TYPE(cmdMsgBuffer, COM_READ_REG);
-	SET_MESSAGE_LENGTH(cmdMsgBuffer, 8);
-	SET_MESSAGE_CRC(cmdMsgBuffer, 0);
-	SET_MESSAGE_STATUS(cmdMsgBuffer, 0);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 6, 0x01);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 7, regAddr);
-	unsigned short crc = calculateCRC(cmdMsgBuffer, 8);
-	SET_MESSAGE_CRC(cmdMsgBuffer, crc);
-	uart->flush();
-	uart->sendMessage(&cmdMsgBuffer[0], 8);
-	short count = 0;
-	QTime timer;
-	unsigned short msgLength = 3;
-	timer.start();
-	do
+	char *payload = beginRequest(CMDID_READ_REG);
+	payload[1] = regAddr;
+	ReplyView reply;
+	short msgLength = transact(reply);
+	if(msgLength <= 0)
+		return msgLength;
+	*regValue = reply.byte(0);
+	unsigned char address = regAddr;
+	if(address < AS3993_REGISTER_COUNT && reply.status() == 0)
 	{
-		if(uart->receiveMessage(&respMsgBuffer[count], 1) > 0)
-		{
-			count++;
-			if(count == 3)
-			{
-				msgLength = GET_MESSAGE_LENGTH(respMsgBuffer);		
-			}
-			timer.restart();
-		}
-	}while ((count < msgLength) && (timer.elapsed() < WAIT_FOR_RESPONSE_TIME));
-	if(count != msgLength)
-		return TIMEOUT_ERROR;
-	unsigned short msgCRC  = GET_MESSAGE_CRC(respMsgBuffer);
-	SET_MESSAGE_CRC(respMsgBuffer, 0);
-	unsigned short calculatedCRC = calculateCRC(respMsgBuffer, msgLength);
-	if(msgCRC != calculatedCRC)
-		return CRC_ERROR;
-	*regValue = respMsgBuffer[6];
-	char msgStatus  = GET_MESSAGE_STATUS(respMsgBuffer);
-	return msgStatus;
+		regShadow[address] = *regValue;
+		regShadowValid[address] = true;
+	}
+	return reply.status();
 }
 short AMSRadonReader::readAllAS3993Regs(char *regValues)
 {
-	char cmdMsgBuffer[8];
-	char respMsgBuffer[75];
-	SET_MESSAGE_TYPE(cmdMsgBuffer, COM_READ_REG);
-	SET_MESSAGE_LENGTH(cmdMsgBuffer, 8);
-	SET_MESSAGE_CRC(cmdMsgBuffer, 0);
-	SET_MESSAGE_STATUS(cmdMsgBuffer, 0);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 6, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 7, 0x00);
-	unsigned short crc = calculateCRC(cmdMsgBuffer, 8);
-	SET_MESSAGE_CRC(cmdMsgBuffer, crc);
-	uart->flush();
-	uart->sendMessage(&cmdMsgBuffer[0], 8);
-	short count = 0;
-	QTime timer;
-	unsigned short msgLength = 3;
-	timer.start();
-	do
-	{
-		if(uart->receiveMessage(&respMsgBuffer[count], 1) > 0)
-		{
-			count++;
-			if(count == 3)
-			{
-				msgLength = GET_MESSAGE_LENGTH(respMsgBuffer);		
-			}
-			timer.restart();
-		}
-	}while ((count < msgLength) && (timer.elapsed() < WAIT_FOR_RESPONSE_TIME));
-	if(count != msgLength)
-		return TIMEOUT_ERROR;
-	unsigned short msgCRC  = GET_MESSAGE_CRC(respMsgBuffer);
-	SET_MESSAGE_CRC(respMsgBuffer, 0);
-	unsigned short calculatedCRC = calculateCRC(respMsgBuffer, msgLength);
-	if(msgCRC != calculatedCRC)
-		return CRC_ERROR;
-	for(short i = 0; i < count - 6; i++)
+	beginRequest(CMDID_READ_ALL_REGS);
+	ReplyView reply;
+	short msgLength = transact(reply);
+	if(msgLength <= 0)
+		return msgLength;
+	memcpy(regValues, reply.payload(0), reply.payloadLength());
+	return reply.status();
+}
+// Fills the register shadow with one read-all request.
+short AMSRadonReader::loadAS3993Shadow()
+{
+	char regValues[AS3993_REGISTER_COUNT + 1];
+	memset(regValues, 0, sizeof(regValues));
+	short status = readAllAS3993Regs(regValues);
+	if(status != 0)
+		return status;
+	int index = 0;
+	for(unsigned char address = 0; address < AS3993_REGISTER_COUNT; address++)
 	{
-		regValues[i] = respMsgBuffer[6 + i];
+		if(!isReadAllRegister(address))
+			continue;
+		regShadow[address] = regValues[index++];
+		regShadowValid[address] = true;
 	}
-	char msgStatus  = GET_MESSAGE_STATUS(respMsgBuffer);
-	return msgStatus;
+	return ERR_NONE;
 }
-short AMSRadonReader::setReaderConfiguration(char powerMode, char *readerConfig)
+// Reads a register from the shadow, including changes staged but not yet
+// flushed. Registers the firmware changes on its own and registers not yet
+// shadowed are read from the chip.
+short AMSRadonReader::readCachedAS3993Reg(char regAddr, char &regValue)
 {
-	char cmdMsgBuffer[8];
-	char respMsgBuffer[25];
-	SET_MESSAGE_TYPE(cmdMsgBuffer, CMD_READER_CONFIG);
-	SET_MESSAGE_LENGTH(cmdMsgBuffer, 8);
-	SET_MESSAGE_CRC(cmdMsgBuffer, 0);
-	SET_MESSAGE_STATUS(cmdMsgBuffer, 0);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 6, 0x01);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 7, powerMode);
-	unsigned short crc = calculateCRC(cmdMsgBuffer, 8);
-	SET_MESSAGE_CRC(cmdMsgBuffer, crc);
-	uart->flush();
-	uart->sendMessage(&cmdMsgBuffer[0], 8);
-	short count = 0;
-	QTime timer;
-	unsigned short msgLength = 3;
-	timer.start();
-	do
+	unsigned char address = regAddr;
+	if(address >= AS3993_REGISTER_COUNT)
+		return ERR_PARAM;
+	if(!isStableRegister(address) || !regShadowValid[address])
 	{
-		if(uart->receiveMessage(&respMsgBuffer[count], 1) > 0)
-		{
-			count++;
-			if(count == 3)
-			{
-				msgLength = GET_MESSAGE_LENGTH(respMsgBuffer);		
-			}
-			timer.restart();
-		}
-	}while ((count < msgLength) && (timer.elapsed() < WAIT_FOR_RESPONSE_TIME));
-	if(count != msgLength)
-		return TIMEOUT_ERROR;
-	unsigned short msgCRC  = GET_MESSAGE_CRC(respMsgBuffer);
-	SET_MESSAGE_CRC(respMsgBuffer, 0);
-	unsigned short calculatedCRC = calculateCRC(respMsgBuffer, msgLength);
-	if(msgCRC != calculatedCRC)
-		return CRC_ERROR;
-	for(short i = 0; i < count - 6; i++)
+		short status = readAS3993Reg(regAddr, &regValue);
+		if(status != 0)
+			return status;
+	}
+	else
+		regValue = regShadow[address];
+	regValue = (regValue & ~regPendingMask[address]) | regPendingValue[address];
+	return ERR_NONE;
+}
+// Stages a change of the bits in mask. Nothing is sent until
+// flushAS3993Regs(); a change that leaves a shadowed register as it is is
+// dropped.
+void AMSRadonReader::stageAS3993Reg(char regAddr, char mask, char value)
+{
+	unsigned char address = regAddr;
+	unsigned char bits = mask;
+	if(address >= AS3993_REGISTER_COUNT || bits == 0)
+		return;
+	regPendingValue[address] = (regPendingValue[address] & ~bits) | (value & bits);
+	regPendingMask[address] |= bits;
+	if(isStableRegister(address) && regShadowValid[address] &&
+			((regShadow[address] ^ regPendingValue[address]) & regPendingMask[address]) == 0)
 	{
-		readerConfig[i] = respMsgBuffer[6 + i];
+		regPendingMask[address] = 0;
+		regPendingValue[address] = 0;
 	}
-	char msgStatus  = GET_MESSAGE_STATUS(respMsgBuffer);
-	return msgStatus;
 }
-short AMSRadonReader::getReaderConfiguration(char *readerConfig)
-{
-	char cmdMsgBuffer[8];
-	char respMsgBuffer[25];
-	SET_MESSAGE_TYPE(cmdMsgBuffer, CMD_READER_CONFIG);
-	SET_MESSAGE_LENGTH(cmdMsgBuffer, 8);
-	SET_MESSAGE_CRC(cmdMsgBuffer, 0);
-	SET_MESSAGE_STATUS(cmdMsgBuffer, 0);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 6, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 7, 0x00);
-	unsigned short crc = calculateCRC(cmdMsgBuffer, 8);
-	SET_MESSAGE_CRC(cmdMsgBuffer, crc);
-	uart->flush();
-	uart->sendMessage(&cmdMsgBuffer[0], 8);
-	short count = 0;
-	QTime timer;
-	unsigned short msgLength = 3;
-	timer.start();
-	do
+// Writes all staged changes in one request. The reader merges the masked
+// bits into the current register values, so registers the firmware changes
+// on its own need no read first, and replies the values read back, which
+// update the shadow. Returns ERR_NONE without a request if nothing is staged.
+short AMSRadonReader::flushAS3993Regs()
+{
+	if(pipelineDepth > 1)
+		return ERR_BUSY;
+	unsigned char addresses[AS3993_REGISTER_COUNT];
+	int count = 0;
+	for(unsigned char address = 0; address < AS3993_REGISTER_COUNT; address++)
+		if(regPendingMask[address] != 0)
+			addresses[count++] = address;
+	const int maxEntries = (TX_FRAME_BUFFER_SIZE - UART_FRAME_HEADER_SIZE) / WRITE_REGS_ENTRY_SIZE;
+	for(int first = 0; first < count; first += maxEntries)
 	{
-		if(uart->receiveMessage(&respMsgBuffer[count], 1) > 0)
+		int entries = count - first < maxEntries ? count - first : maxEntries;
+		char *payload = beginRequest(CMDID_WRITE_REGS, entries * WRITE_REGS_ENTRY_SIZE);
+		for(int i = 0; i < entries; i++)
 		{
-			count++;
-			if(count == 3)
-			{
-				msgLength = GET_MESSAGE_LENGTH(respMsgBuffer);		
-			}
-			timer.restart();
+			unsigned char address = addresses[first + i];
+			payload[WRITE_REGS_ENTRY_SIZE * i] = address;
+			payload[WRITE_REGS_ENTRY_SIZE * i + 1] = regPendingMask[address];
+			payload[WRITE_REGS_ENTRY_SIZE * i + 2] = regPendingValue[address];
 		}
-	}while ((count < msgLength) && (timer.elapsed() < WAIT_FOR_RESPONSE_TIME));
-	if(count != msgLength)
-		return TIMEOUT_ERROR;
-	unsigned short msgCRC  = GET_MESSAGE_CRC(respMsgBuffer);
-	SET_MESSAGE_CRC(respMsgBuffer, 0);
-	unsigned short calculatedCRC = calculateCRC(respMsgBuffer, msgLength);
-	if(msgCRC != calculatedCRC)
-		return CRC_ERROR;
-	for(short i = 0; i < count - 6; i++)
+		ReplyView reply;
+		short msgLength = transact(reply);
+		if(msgLength == ERR_PROTO || (msgLength > 0 && reply.status() == FIRMWARE_UNHANDLED_PROTOCOL))
+			return flushAS3993RegsSingly();	// firmware without batched writes
+		if(msgLength <= 0)
+			return msgLength;
+		if(reply.status() != 0)
+			return reply.status();
+		for(int i = 0; i < entries; i++)
+		{
+			unsigned char address = addresses[first + i];
+			regShadow[address] = reply.u8(i);
+			regShadowValid[address] = true;
+			regPendingMask[address] = 0;
+			regPendingValue[address] = 0;
+		}
+	}
+	return ERR_NONE;
+}
+// Drains the event trace of the firmware and appends the raw reply payloads
+// to trace. Each one starts with TRACE_HEADER_SIZE bytes (clock, wrap, lost
+// as little endian u32, u32, u16 and the event count) followed by the
+// events, see cmdReadTrace() of the firmware; tools/trace_decode turns them
+// into a timeline. Returns FIRMWARE_UNHANDLED_PROTOCOL if the firmware is
+// built without trace.
+short AMSRadonReader::readTrace(string &trace)
+{
+	for(int i = 0; i < TRACE_MAX_READS; i++)
 	{
-		readerConfig[i] = respMsgBuffer[6 + i];
+		beginRequest(CMDID_READ_TRACE);
+		ReplyView reply;
+		short msgLength = transact(reply);
+		if(msgLength <= 0)
+			return msgLength;
+		if(reply.status() != 0)
+			return reply.status();
+		unsigned char count = reply.u8(TRACE_HEADER_SIZE - 1);
+		if(count == 0)
+			break;
+		unsigned short length = TRACE_HEADER_SIZE + count * TRACE_EVENT_SIZE;
+		if(length > reply.payloadLength())
+			return ERR_PROTO;
+		trace.append(reply.payload(0), length);
 	}
-	char msgStatus  = GET_MESSAGE_STATUS(respMsgBuffer);
-	return msgStatus;
+	return ERR_NONE;
 }
-short AMSRadonReader::antennaPower(char state, char &status)
+// Read-modify-write of every staged register for firmware that lacks the
+// batched write.
+short AMSRadonReader::flushAS3993RegsSingly()
 {
-	char cmdMsgBuffer[8];
-	char respMsgBuffer[25];
-	SET_MESSAGE_TYPE(cmdMsgBuffer, CMD_ANTENNA_POWER);
-	SET_MESSAGE_LENGTH(cmdMsgBuffer, 8);
-	SET_MESSAGE_CRC(cmdMsgBuffer, 0);
-	SET_MESSAGE_STATUS(cmdMsgBuffer, 0);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 6, state);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 7, 0x00);
-	unsigned short crc = calculateCRC(cmdMsgBuffer, 8);
-	SET_MESSAGE_CRC(cmdMsgBuffer, crc);
-	uart->flush();
-	uart->sendMessage(&cmdMsgBuffer[0], 8);
-	short count = 0;
-	QTime timer;
-	unsigned short msgLength = 3;
-	timer.start();
-	do
+	for(unsigned char address = 0; address < AS3993_REGISTER_COUNT; address++)
 	{
-		if(uart->receiveMessage(&respMsgBuffer[count], 1) > 0)
+		if(regPendingMask[address] == 0)
+			continue;
+		char value = 0;
+		short status;
+		if(regPendingMask[address] != 0xFF)
 		{
-			count++;
-			if(count == 3)
-			{
-				msgLength = GET_MESSAGE_LENGTH(respMsgBuffer);		
-			}
-			timer.restart();
+			status = readAS3993Reg(address, &value);
+			if(status != 0)
+				return status;
 		}
-	}while ((count < msgLength) && (timer.elapsed() < WAIT_FOR_RESPONSE_TIME));
-	if(count != msgLength)
-		return TIMEOUT_ERROR;
-	unsigned short msgCRC  = GET_MESSAGE_CRC(respMsgBuffer);
-	SET_MESSAGE_CRC(respMsgBuffer, 0);
-	unsigned short calculatedCRC = calculateCRC(respMsgBuffer, msgLength);
-	if(msgCRC != calculatedCRC)
-		return CRC_ERROR;
-	status = respMsgBuffer[6];
-	char msgStatus  = GET_MESSAGE_STATUS(respMsgBuffer);
-	return msgStatus;
+		value = (value & ~regPendingMask[address]) | regPendingValue[address];
+		char operationStatus;
+		status = writeToAS3993Reg(address, value, operationStatus);
+		if(status != 0)
+			return status;
+		regPendingMask[address] = 0;
+		regPendingValue[address] = 0;
+	}
+	return ERR_NONE;
+}
+void AMSRadonReader::invalidateAS3993Shadow()
+{
+	for(int i = 0; i < AS3993_REGISTER_COUNT; i++)
+		regShadowValid[i] = false;
+}
+short AMSRadonReader::setReaderConfiguration(char powerMode, char *readerConfig)
+{
+	invalidateAS3993Shadow();	// the power mode may reinitialize the chip
+	char *payload = beginRequest(CMDID_SET_READER_CONFIG);
+	payload[1] = powerMode;
+	ReplyView reply;
+	short msgLength = transact(reply);
+	if(msgLength <= 0)
+		return msgLength;
+	memcpy(readerConfig, reply.payload(0), reply.payloadLength());
+	return reply.status();
+}
+short AMSRadonReader::getReaderConfiguration(char *readerConfig)
+{
+	beginRequest(CMDID_GET_READER_CONFIG);
+	ReplyView reply;
+	short msgLength = transact(reply);
+	if(msgLength <= 0)
+		return msgLength;
+	memcpy(readerConfig, reply.payload(0), reply.payloadLength());
+	return reply.status();
+}
+short AMSRadonReader::antennaPower(char state, char &status)
+{
+	char *payload = beginRequest(CMDID_ANTENNA_POWER);
+	payload[0] = state;
+	ReplyView reply;
+	short msgLength = transact(reply);
+	if(msgLength <= 0)
+		return msgLength;
+	status = reply.byte(0);
+	return reply.status();
 }
 short AMSRadonReader::getReflectedPowerLevel(int freq, char tunerSettings, char &IChannel, char &QChannel)
 {
 	// tunerSettings = 1: apply tuning settings from table
 	// tunerSettings = 0: don't
-	char cmdMsgBuffer[11];
-	char respMsgBuffer[25];
-	SET_MESSAGE_TYPE(cmdMsgBuffer, CMD_CHANGE_FREQ);
-	SET_MESSAGE_LENGTH(cmdMsgBuffer, 11);
-	SET_MESSAGE_CRC(cmdMsgBuffer, 0);
-	SET_MESSAGE_STATUS(cmdMsgBuffer, 0);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 6, 0x02);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 7, freq & 0xFF);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 8, freq >> 8 & 0xFF);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 9, freq >> 16 & 0xFF);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 10, tunerSettings);
-	unsigned short crc = calculateCRC(cmdMsgBuffer, 11);
-	SET_MESSAGE_CRC(cmdMsgBuffer, crc);
-	uart->flush();
-	uart->sendMessage(&cmdMsgBuffer[0], 11);
-	short count = 0;
-	QTime timer;
-	unsigned short msgLength = 3;
-	timer.start();
-	do
-	{
-		if(uart->receiveMessage(&respMsgBuffer[count], 1) > 0)
-		{
-			count++;
-			if(count == 3)
-			{
-				msgLength = GET_MESSAGE_LENGTH(respMsgBuffer);		
-			}
-			timer.restart();
-		}
-	}while ((count < msgLength) && (timer.elapsed() < WAIT_FOR_RESPONSE_TIME));
-	if(count != msgLength)
-		return TIMEOUT_ERROR;
-	unsigned short msgCRC  = GET_MESSAGE_CRC(respMsgBuffer);
-	SET_MESSAGE_CRC(respMsgBuffer, 0);
-	unsigned short calculatedCRC = calculateCRC(respMsgBuffer, msgLength);
-	if(msgCRC != calculatedCRC)
-		return CRC_ERROR;
-	IChannel = respMsgBuffer[6];
-	QChannel = respMsgBuffer[7];
-	char msgStatus  = GET_MESSAGE_STATUS(respMsgBuffer);
-	return msgStatus;
+	char *payload = beginRequest(CMDID_REFLECTED_POWER);
+	payload[1] = freq & 0xFF;
+	payload[2] = freq >> 8 & 0xFF;
+	payload[3] = freq >> 16 & 0xFF;
+	payload[4] = tunerSettings;
+	ReplyView reply;
+	short msgLength = transact(reply);
+	if(msgLength <= 0)
+		return msgLength;
+	IChannel = reply.byte(0);
+	QChannel = reply.byte(1);
+	return reply.status();
 }
 short AMSRadonReader::addHoppingFreq(int freq, char clearList, char profileID, char &status)
 {
-	char cmdMsgBuffer[12];
-	char respMsgBuffer[25];
-	SET_MESSAGE_TYPE(cmdMsgBuffer, CMD_CHANGE_FREQ);
-	SET_MESSAGE_LENGTH(cmdMsgBuffer, 12);
-	SET_MESSAGE_CRC(cmdMsgBuffer, 0);
-	SET_MESSAGE_STATUS(cmdMsgBuffer, 0);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 6, 0x04);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 7, freq & 0xFF);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 8, freq >> 8 & 0xFF);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 9, freq >> 16 & 0xFF);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 10, clearList);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 11, profileID);
-	unsigned short crc = calculateCRC(cmdMsgBuffer, 12);
-	SET_MESSAGE_CRC(cmdMsgBuffer, crc);
-	uart->flush();
-	uart->sendMessage(&cmdMsgBuffer[0], 12);
-	short count = 0;
-	QTime timer;
-	unsigned short msgLength = 3;
-	timer.start();
-	do
-	{
-		if(uart->receiveMessage(&respMsgBuffer[count], 1) > 0)
-		{
-			count++;
-			if(count == 3)
-			{
-				msgLength = GET_MESSAGE_LENGTH(respMsgBuffer);		
-			}
-			timer.restart();
-		}
-	}while ((count < msgLength) && (timer.elapsed() < WAIT_FOR_RESPONSE_TIME));
-	if(count != msgLength)
-		return TIMEOUT_ERROR;
-	unsigned short msgCRC  = GET_MESSAGE_CRC(respMsgBuffer);
-	SET_MESSAGE_CRC(respMsgBuffer, 0);
-	unsigned short calculatedCRC = calculateCRC(respMsgBuffer, msgLength);
-	if(msgCRC != calculatedCRC)
-		return CRC_ERROR;
-	status = respMsgBuffer[6];
-	char msgStatus  = GET_MESSAGE_STATUS(respMsgBuffer);
-	return msgStatus;
+	char *payload = beginRequest(CMDID_ADD_HOPPING_FREQ);
+	payload[1] = freq & 0xFF;
+	payload[2] = freq >> 8 & 0xFF;
+	payload[3] = freq >> 16 & 0xFF;
+	payload[4] = clearList;
+	payload[5] = profileID;
+	ReplyView reply;
+	short msgLength = transact(reply);
+	if(msgLength <= 0)
+		return msgLength;
+	status = reply.byte(0);
+	return reply.status();
 }
 short AMSRadonReader::getFreqListParams(char &profileID, int &minFreq, int &maxFreq, char &currNumFreqs, char &hostNumFreqs)
 {
-	char cmdMsgBuffer[7];
-	char respMsgBuffer[25];
-	SET_MESSAGE_TYPE(cmdMsgBuffer, CMD_CHANGE_FREQ);
-	SET_MESSAGE_LENGTH(cmdMsgBuffer, 7);
-	SET_MESSAGE_CRC(cmdMsgBuffer, 0);
-	SET_MESSAGE_STATUS(cmdMsgBuffer, 0);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 6, 0x05);
-	unsigned short crc = calculateCRC(cmdMsgBuffer, 7);
-	SET_MESSAGE_CRC(cmdMsgBuffer, crc);
-	uart->flush();
-	uart->sendMessage(&cmdMsgBuffer[0], 7);
-	short count = 0;
-	QTime timer;
-	unsigned short msgLength = 3;
-	timer.start();
-	do
-	{
-		if(uart->receiveMessage(&respMsgBuffer[count], 1) > 0)
-		{
-			count++;
-			if(count == 3)
-			{
-				msgLength = GET_MESSAGE_LENGTH(respMsgBuffer);		
-			}
-			timer.restart();
-		}
-	}while ((count < msgLength) && (timer.elapsed() < WAIT_FOR_RESPONSE_TIME));
-	if(count != msgLength)
-		return TIMEOUT_ERROR;
-	unsigned short msgCRC  = GET_MESSAGE_CRC(respMsgBuffer);
-	SET_MESSAGE_CRC(respMsgBuffer, 0);
-	unsigned short calculatedCRC = calculateCRC(respMsgBuffer, msgLength);
-	if(msgCRC != calculatedCRC)
-		return CRC_ERROR;
-	profileID = respMsgBuffer[6];
-	minFreq = 0;
-	minFreq += (int)respMsgBuffer[7];
-	minFreq += (int)respMsgBuffer[8] << 8;
-	minFreq += (int)respMsgBuffer[9] << 16;
-	maxFreq = 0;
-	maxFreq += (int)respMsgBuffer[10];
-	maxFreq += (int)respMsgBuffer[11] << 8;
-	maxFreq += (int)respMsgBuffer[12] << 16;
-	currNumFreqs = respMsgBuffer[13];
-	hostNumFreqs = respMsgBuffer[14];
-	char msgStatus  = GET_MESSAGE_STATUS(respMsgBuffer);
-	return msgStatus;
+	beginRequest(CMDID_GET_FREQ_LIST_PARAMS);
+	ReplyView reply;
+	short msgLength = transact(reply);
+	if(msgLength <= 0)
+		return msgLength;
+	profileID = reply.byte(0);
+	minFreq = reply.u24(1);
+	maxFreq = reply.u24(4);
+	currNumFreqs = reply.byte(7);
+	hostNumFreqs = reply.byte(8);
+	return reply.status();
 }
 short AMSRadonReader::setFreqHoppingParams(short listeningTime, short maxSendingTime, short idleTime, signed char  rssi, char &status)
 {
-	char cmdMsgBuffer[14];
-	char respMsgBuffer[25];
-	SET_MESSAGE_TYPE(cmdMsgBuffer, CMD_CHANGE_FREQ);
-	SET_MESSAGE_LENGTH(cmdMsgBuffer, 14);
-	SET_MESSAGE_CRC(cmdMsgBuffer, 0);
-	SET_MESSAGE_STATUS(cmdMsgBuffer, 0);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 6, 0x08);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 7, listeningTime & 0xFF);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 8, listeningTime >> 8 & 0xFF);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 9, maxSendingTime & 0xFF);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 10, maxSendingTime >> 8 & 0xFF);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 11, idleTime & 0xFF);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 12, idleTime >> 8 & 0xFF);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 13, rssi);
-	unsigned short crc = calculateCRC(cmdMsgBuffer, 14);
-	SET_MESSAGE_CRC(cmdMsgBuffer, crc);
-	uart->flush();
-	uart->sendMessage(&cmdMsgBuffer[0], 14);
-	short count = 0;
-	QTime timer;
-	unsigned short msgLength = 3;
-	timer.start();
-	do
-	{
-		if(uart->receiveMessage(&respMsgBuffer[count], 1) > 0)
-		{
-			count++;
-			if(count == 3)
-			{
-				msgLength = GET_MESSAGE_LENGTH(respMsgBuffer);		
-			}
-			timer.restart();
-		}
-	}while ((count < msgLength) && (timer.elapsed() < WAIT_FOR_RESPONSE_TIME));
-	if(count != msgLength)
-		return TIMEOUT_ERROR;
-	unsigned short msgCRC  = GET_MESSAGE_CRC(respMsgBuffer);
-	SET_MESSAGE_CRC(respMsgBuffer, 0);
-	unsigned short calculatedCRC = calculateCRC(respMsgBuffer, msgLength);
-	if(msgCRC != calculatedCRC)
-		return CRC_ERROR;
-	status = respMsgBuffer[6];
-	char msgStatus  = GET_MESSAGE_STATUS(respMsgBuffer);
-	return msgStatus;
+	char *payload = beginRequest(CMDID_SET_HOPPING_PARAMS);
+	payload[1] = listeningTime & 0xFF;
+	payload[2] = listeningTime >> 8 & 0xFF;
+	payload[3] = maxSendingTime & 0xFF;
+	payload[4] = maxSendingTime >> 8 & 0xFF;
+	payload[5] = idleTime & 0xFF;
+	payload[6] = idleTime >> 8 & 0xFF;
+	payload[7] = rssi;
+	ReplyView reply;
+	short msgLength = transact(reply);
+	if(msgLength <= 0)
+		return msgLength;
+	status = reply.byte(0);
+	return reply.status();
 }
 short AMSRadonReader::getFreqHoppingParams(short &listeningTime, short &maxSendingTime, short &idleTime)
 {
-	char cmdMsgBuffer[7];
-	char respMsgBuffer[25];
-	SET_MESSAGE_TYPE(cmdMsgBuffer, CMD_CHANGE_FREQ);
-	SET_MESSAGE_LENGTH(cmdMsgBuffer, 7);
-	SET_MESSAGE_CRC(cmdMsgBuffer, 0);
-	SET_MESSAGE_STATUS(cmdMsgBuffer, 0);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 6, 0x09);
-	unsigned short crc = calculateCRC(cmdMsgBuffer, 7);
-	SET_MESSAGE_CRC(cmdMsgBuffer, crc);
-	uart->flush();
-	uart->sendMessage(&cmdMsgBuffer[0], 7);
-	short count = 0;
-	QTime timer;
-	unsigned short msgLength = 3;
-	timer.start();
-	do
-	{
-		if(uart->receiveMessage(&respMsgBuffer[count], 1) > 0)
-		{
-			count++;
-			if(count == 3)
-			{
-				msgLength = GET_MESSAGE_LENGTH(respMsgBuffer);		
-			}
-			timer.restart();
-		}
-	}while ((count < msgLength) && (timer.elapsed() < WAIT_FOR_RESPONSE_TIME));
-	if(count != msgLength)
-		return TIMEOUT_ERROR;
-	unsigned short msgCRC  = GET_MESSAGE_CRC(respMsgBuffer);
-	SET_MESSAGE_CRC(respMsgBuffer, 0);
-	unsigned short calculatedCRC = calculateCRC(respMsgBuffer, msgLength);
-	if(msgCRC != calculatedCRC)
-		return CRC_ERROR;
-	listeningTime = 0;
-	listeningTime += (int)respMsgBuffer[6];
-	listeningTime += (int)respMsgBuffer[7] << 8;
-	maxSendingTime = 0;
-	maxSendingTime += (int)respMsgBuffer[8];
-	maxSendingTime += (int)respMsgBuffer[9] << 8;
-	idleTime = 0;
-	idleTime += (int)respMsgBuffer[10];
-	idleTime += (int)respMsgBuffer[11] << 8;
-	char msgStatus  = GET_MESSAGE_STATUS(respMsgBuffer);
-	return msgStatus;
+	beginRequest(CMDID_GET_HOPPING_PARAMS);
+	ReplyView reply;
+	short msgLength = transact(reply);
+	if(msgLength <= 0)
+		return msgLength;
+	listeningTime = reply.u16(0);
+	maxSendingTime = reply.u16(2);
+	idleTime = reply.u16(4);
+	return reply.status();
 }
 short AMSRadonReader::performContinuousModulationTest(int freq, short duration, char random, char *randomData)
 {
-	char cmdMsgBuffer[23];
-	char respMsgBuffer[25];
-	SET_MESSAGE_TYPE(cmdMsgBuffer, CMD_CHANGE_FREQ);
-	SET_MESSAGE_LENGTH(cmdMsgBuffer, 23);
-	SET_MESSAGE_CRC(cmdMsgBuffer, 0);
-	SET_MESSAGE_STATUS(cmdMsgBuffer, 0);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 6, 0x10);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 7, freq & 0xFF);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 8, freq >> 8 & 0xFF);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 9, freq >> 16 & 0xFF);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 10, duration & 0xFF);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 11, duration >> 8 & 0xFF);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 12, random);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 13, randomData[0]);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 14, randomData[1]);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 15, randomData[2]);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 16, randomData[3]);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 17, randomData[4]);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 18, randomData[5]);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 19, randomData[6]);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 20, randomData[7]);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 21, randomData[8]);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 22, randomData[9]);
-	unsigned short crc = calculateCRC(cmdMsgBuffer, 23);
-	SET_MESSAGE_CRC(cmdMsgBuffer, crc);
-	uart->flush();
-	uart->sendMessage(&cmdMsgBuffer[0], 23);
-	short count = 0;
-	QTime timer;
-	unsigned short msgLength = 3;
-	timer.start();
-	do
-	{
-		if(uart->receiveMessage(&respMsgBuffer[count], 1) > 0)
-		{
-			count++;
-			if(count == 3)
-			{
-				msgLength = GET_MESSAGE_LENGTH(respMsgBuffer);		
-			}
-			timer.restart();
-		}
-	}while ((count < msgLength) && (timer.elapsed() < WAIT_FOR_RESPONSE_TIME));
-	if(count != msgLength)
-		return TIMEOUT_ERROR;
-	unsigned short msgCRC  = GET_MESSAGE_CRC(respMsgBuffer);
-	SET_MESSAGE_CRC(respMsgBuffer, 0);
-	unsigned short calculatedCRC = calculateCRC(respMsgBuffer, msgLength);
-	if(msgCRC != calculatedCRC)
-		return CRC_ERROR;
-	char msgStatus  = GET_MESSAGE_STATUS(respMsgBuffer);
-	return msgStatus;
+	char *payload = beginRequest(CMDID_CONTINUOUS_MODULATION);
+	payload[1] = freq & 0xFF;
+	payload[2] = freq >> 8 & 0xFF;
+	payload[3] = freq >> 16 & 0xFF;
+	payload[4] = duration & 0xFF;
+	payload[5] = duration >> 8 & 0xFF;
+	payload[6] = random;
+	memcpy(&payload[7], randomData, 10);
+	return transact();
 }
 short AMSRadonReader::setLinkFrequency(char linkFreq, char &storedLinkFreq)
 {
-	char cmdMsgBuffer[22];
-	char respMsgBuffer[25];
-	SET_MESSAGE_TYPE(cmdMsgBuffer, CMD_GEN2_SETTINGS);
-	SET_MESSAGE_LENGTH(cmdMsgBuffer, 22);
-	SET_MESSAGE_CRC(cmdMsgBuffer, 0);
-	SET_MESSAGE_STATUS(cmdMsgBuffer, 0);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 6, 0x01);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 7, linkFreq);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 8, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 9, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 10, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 11, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 12, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 13, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 14, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 15, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 16, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 17, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 18, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 19, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 20, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 21, 0x00);
-	unsigned short crc = calculateCRC(cmdMsgBuffer, 22);
-	SET_MESSAGE_CRC(cmdMsgBuffer, crc);
-	uart->flush();
-	uart->sendMessage(&cmdMsgBuffer[0], 22);
-	short count = 0;
-	QTime timer;
-	unsigned short msgLength = 3;
-	timer.start();
-	do
-	{
-		if(uart->receiveMessage(&respMsgBuffer[count], 1) > 0)
-		{
-			count++;
-			if(count == 3)
-			{
-				msgLength = GET_MESSAGE_LENGTH(respMsgBuffer);		
-			}
-			timer.restart();
-		}
-	}while ((count < msgLength) && (timer.elapsed() < WAIT_FOR_RESPONSE_TIME));
-	if(count != msgLength)
-		return TIMEOUT_ERROR;
-	unsigned short msgCRC  = GET_MESSAGE_CRC(respMsgBuffer);
-	SET_MESSAGE_CRC(respMsgBuffer, 0);
-	unsigned short calculatedCRC = calculateCRC(respMsgBuffer, msgLength);
-	if(msgCRC != calculatedCRC)
-		return CRC_ERROR;
-	storedLinkFreq = respMsgBuffer[7];
-	char msgStatus  = GET_MESSAGE_STATUS(respMsgBuffer);
-	return msgStatus;
+	return setPairedSetting(CMDID_GEN2_SETTINGS, GEN2_LINK_FREQUENCY, linkFreq, storedLinkFreq);
 }
 short AMSRadonReader::setCoding(char coding, char &storedCoding)
 {
-	char cmdMsgBuffer[22];
-	char respMsgBuffer[25];
-	SET_MESSAGE_TYPE(cmdMsgBuffer, CMD_GEN2_SETTINGS);
-	SET_MESSAGE_LENGTH(cmdMsgBuffer, 22);
-	SET_MESSAGE_CRC(cmdMsgBuffer, 0);
-	SET_MESSAGE_STATUS(cmdMsgBuffer, 0);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 6, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 7, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 8, 0x01);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 9, coding);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 10, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 11, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 12, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 13, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 14, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 15, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 16, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 17, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 18, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 19, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 20, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 21, 0x00);
-	unsigned short crc = calculateCRC(cmdMsgBuffer, 22);
-	SET_MESSAGE_CRC(cmdMsgBuffer, crc);
-	uart->flush();
-	uart->sendMessage(&cmdMsgBuffer[0], 22);
-	short count = 0;
-	QTime timer;
-	unsigned short msgLength = 3;
-	timer.start();
-	do
-	{
-		if(uart->receiveMessage(&respMsgBuffer[count], 1) > 0)
-		{
-			count++;
-			if(count == 3)
-			{
-				msgLength = GET_MESSAGE_LENGTH(respMsgBuffer);		
-			}
-			timer.restart();
-		}
-	}while ((count < msgLength) && (timer.elapsed() < WAIT_FOR_RESPONSE_TIME));
-	if(count != msgLength)
-		return TIMEOUT_ERROR;
-	unsigned short msgCRC  = GET_MESSAGE_CRC(respMsgBuffer);
-	SET_MESSAGE_CRC(respMsgBuffer, 0);
-	unsigned short calculatedCRC = calculateCRC(respMsgBuffer, msgLength);
-	if(msgCRC != calculatedCRC)
-		return CRC_ERROR;
-	storedCoding = respMsgBuffer[9];
-	char msgStatus  = GET_MESSAGE_STATUS(respMsgBuffer);
-	return msgStatus;
+	return setPairedSetting(CMDID_GEN2_SETTINGS, GEN2_CODING, coding, storedCoding);
 }
 short AMSRadonReader::setSession(char session, char &storedSession)
 {
-	char cmdMsgBuffer[22];
-	char respMsgBuffer[25];
-	SET_MESSAGE_TYPE(cmdMsgBuffer, CMD_GEN2_SETTINGS);
-	SET_MESSAGE_LENGTH(cmdMsgBuffer, 22);
-	SET_MESSAGE_CRC(cmdMsgBuffer, 0);
-	SET_MESSAGE_STATUS(cmdMsgBuffer, 0);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 6, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 7, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 8, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 9, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 10, 0x01);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 11, session);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 12, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 13, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 14, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 15, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 16, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 17, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 18, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 19, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 20, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 21, 0x00);
-	unsigned short crc = calculateCRC(cmdMsgBuffer, 22);
-	SET_MESSAGE_CRC(cmdMsgBuffer, crc);
-	uart->flush();
-	uart->sendMessage(&cmdMsgBuffer[0], 22);
-	short count = 0;
-	QTime timer;
-	unsigned short msgLength = 3;
-	timer.start();
-	do
-	{
-		if(uart->receiveMessage(&respMsgBuffer[count], 1) > 0)
-		{
-			count++;
-			if(count == 3)
-			{
-				msgLength = GET_MESSAGE_LENGTH(respMsgBuffer);		
-			}
-			timer.restart();
-		}
-	}while ((count < msgLength) && (timer.elapsed() < WAIT_FOR_RESPONSE_TIME));
-	if(count != msgLength)
-		return TIMEOUT_ERROR;
-	unsigned short msgCRC  = GET_MESSAGE_CRC(respMsgBuffer);
-	SET_MESSAGE_CRC(respMsgBuffer, 0);
-	unsigned short calculatedCRC = calculateCRC(respMsgBuffer, msgLength);
-	if(msgCRC != calculatedCRC)
-		return CRC_ERROR;
-	storedSession = respMsgBuffer[11];
-	char msgStatus  = GET_MESSAGE_STATUS(respMsgBuffer);
-	return msgStatus;
+	return setPairedSetting(CMDID_GEN2_SETTINGS, GEN2_SESSION, session, storedSession);
 }
 short AMSRadonReader::setTrext(char trext,char &storedTrext)
 {
-	char cmdMsgBuffer[22];
-	char respMsgBuffer[25];
-	SET_MESSAGE_TYPE(cmdMsgBuffer, CMD_GEN2_SETTINGS);
-	SET_MESSAGE_LENGTH(cmdMsgBuffer, 22);
-	SET_MESSAGE_CRC(cmdMsgBuffer, 0);
-	SET_MESSAGE_STATUS(cmdMsgBuffer, 0);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 6, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 7, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 8, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 9, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 10, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 11, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 12, 0x01);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 13, trext);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 14, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 15, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 16, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 17, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 18, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 19, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 20, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 21, 0x00);
-	unsigned short crc = calculateCRC(cmdMsgBuffer, 22);
-	SET_MESSAGE_CRC(cmdMsgBuffer, crc);
-	uart->flush();
-	uart->sendMessage(&cmdMsgBuffer[0], 22);
-	short count = 0;
-	QTime timer;
-	unsigned short msgLength = 3;
-	timer.start();
-	do
-	{
-		if(uart->receiveMessage(&respMsgBuffer[count], 1) > 0)
-		{
-			count++;
-			if(count == 3)
-			{
-				msgLength = GET_MESSAGE_LENGTH(respMsgBuffer);		
-			}
-			timer.restart();
-		}
-	}while ((count < msgLength) && (timer.elapsed() < WAIT_FOR_RESPONSE_TIME));
-	if(count != msgLength)
-		return TIMEOUT_ERROR;
-	unsigned short msgCRC  = GET_MESSAGE_CRC(respMsgBuffer);
-	SET_MESSAGE_CRC(respMsgBuffer, 0);
-	unsigned short calculatedCRC = calculateCRC(respMsgBuffer, msgLength);
-	if(msgCRC != calculatedCRC)
-		return CRC_ERROR;
-	storedTrext = respMsgBuffer[13];
-	char msgStatus  = GET_MESSAGE_STATUS(respMsgBuffer);
-	return msgStatus;
+	return setPairedSetting(CMDID_GEN2_SETTINGS, GEN2_TREXT, trext, storedTrext);
 }
 short AMSRadonReader::setTari(char tari, char &storedTari)
 {
-	char cmdMsgBuffer[22];
-	char respMsgBuffer[25];
-	SET_MESSAGE_TYPE(cmdMsgBuffer, CMD_GEN2_SETTINGS);
-	SET_MESSAGE_LENGTH(cmdMsgBuffer, 22);
-	SET_MESSAGE_CRC(cmdMsgBuffer, 0);
-	SET_MESSAGE_STATUS(cmdMsgBuffer, 0);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 6, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 7, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 8, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 9, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 10, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 11, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 12, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 13, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 14, 0x01);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 15, tari);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 16, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 17, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 18, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 19, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 20, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 21, 0x00);
-	unsigned short crc = calculateCRC(cmdMsgBuffer, 22);
-	SET_MESSAGE_CRC(cmdMsgBuffer, crc);
-	uart->flush();
-	uart->sendMessage(&cmdMsgBuffer[0], 22);
-	short count = 0;
-	QTime timer;
-	unsigned short msgLength = 3;
-	timer.start();
-	do
-	{
-		if(uart->receiveMessage(&respMsgBuffer[count], 1) > 0)
-		{
-			count++;
-			if(count == 3)
-			{
-				msgLength = GET_MESSAGE_LENGTH(respMsgBuffer);		
-			}
-			timer.restart();
-		}
-	}while ((count < msgLength) && (timer.elapsed() < WAIT_FOR_RESPONSE_TIME));
-	if(count != msgLength)
-		return TIMEOUT_ERROR;
-	unsigned short msgCRC  = GET_MESSAGE_CRC(respMsgBuffer);
-	SET_MESSAGE_CRC(respMsgBuffer, 0);
-	unsigned short calculatedCRC = calculateCRC(respMsgBuffer, msgLength);
-	if(msgCRC != calculatedCRC)
-		return CRC_ERROR;
-	storedTari = respMsgBuffer[15];
-	char msgStatus  = GET_MESSAGE_STATUS(respMsgBuffer);
-	return msgStatus;
+	return setPairedSetting(CMDID_GEN2_SETTINGS, GEN2_TARI, tari, storedTari);
 }
 short AMSRadonReader::setQBegin(char qBegin, char &storedQBegin)
 {
-	char cmdMsgBuffer[22];
-	char respMsgBuffer[25];
-	SET_MESSAGE_TYPE(cmdMsgBuffer, CMD_GEN2_SETTINGS);
-	SET_MESSAGE_LENGTH(cmdMsgBuffer, 22);
-	SET_MESSAGE_CRC(cmdMsgBuffer, 0);
-	SET_MESSAGE_STATUS(cmdMsgBuffer, 0);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 6, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 7, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 8, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 9, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 10, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 11, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 12, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 13, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 14, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 15, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 16, 0x01);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 17, qBegin);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 18, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 19, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 20, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 21, 0x00);
-	unsigned short crc = calculateCRC(cmdMsgBuffer, 22);
-	SET_MESSAGE_CRC(cmdMsgBuffer, crc);
-	uart->flush();
-	uart->sendMessage(&cmdMsgBuffer[0], 22);
-	short count = 0;
-	QTime timer;
-	unsigned short msgLength = 3;
-	timer.start();
-	do
-	{
-		if(uart->receiveMessage(&respMsgBuffer[count], 1) > 0)
-		{
-			count++;
-			if(count == 3)
-			{
-				msgLength = GET_MESSAGE_LENGTH(respMsgBuffer);		
-			}
-			timer.restart();
-		}
-	}while ((count < msgLength) && (timer.elapsed() < WAIT_FOR_RESPONSE_TIME));
-	if(count != msgLength)
-		return TIMEOUT_ERROR;
-	unsigned short msgCRC  = GET_MESSAGE_CRC(respMsgBuffer);
-	SET_MESSAGE_CRC(respMsgBuffer, 0);
-	unsigned short calculatedCRC = calculateCRC(respMsgBuffer, msgLength);
-	if(msgCRC != calculatedCRC)
-		return CRC_ERROR;
-	storedQBegin = respMsgBuffer[17];
-	char msgStatus  = GET_MESSAGE_STATUS(respMsgBuffer);
-	return msgStatus;
+	return setPairedSetting(CMDID_GEN2_SETTINGS, GEN2_QBEGIN, qBegin, storedQBegin);
 }
 short AMSRadonReader::setSel(char set, char &storedSet)
 {
-	char cmdMsgBuffer[22];
-	char respMsgBuffer[25];
-	SET_MESSAGE_TYPE(cmdMsgBuffer, CMD_GEN2_SETTINGS);
-	SET_MESSAGE_LENGTH(cmdMsgBuffer, 22);
-	SET_MESSAGE_CRC(cmdMsgBuffer, 0);
-	SET_MESSAGE_STATUS(cmdMsgBuffer, 0);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 6, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 7, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 8, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 9, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 10, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 11, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 12, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 13, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 14, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 15, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 16, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 17, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 18, 0x01);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 19, set);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 20, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 21, 0x00);
-	unsigned short crc = calculateCRC(cmdMsgBuffer, 22);
-	SET_MESSAGE_CRC(cmdMsgBuffer, crc);
-	uart->flush();
-	uart->sendMessage(&cmdMsgBuffer[0], 22);
-	short count = 0;
-	QTime timer;
-	unsigned short msgLength = 3;
-	timer.start();
-	do
-	{
-		if(uart->receiveMessage(&respMsgBuffer[count], 1) > 0)
-		{
-			count++;
-			if(count == 3)
-			{
-				msgLength = GET_MESSAGE_LENGTH(respMsgBuffer);		
-			}
-			timer.restart();
-		}
-	}while ((count < msgLength) && (timer.elapsed() < WAIT_FOR_RESPONSE_TIME));
-	if(count != msgLength)
-		return TIMEOUT_ERROR;
-	unsigned short msgCRC  = GET_MESSAGE_CRC(respMsgBuffer);
-	SET_MESSAGE_CRC(respMsgBuffer, 0);
-	unsigned short calculatedCRC = calculateCRC(respMsgBuffer, msgLength);
-	if(msgCRC != calculatedCRC)
-		return CRC_ERROR;
-	storedSet = respMsgBuffer[19];
-	char msgStatus  = GET_MESSAGE_STATUS(respMsgBuffer);
-	return msgStatus;
+	return setPairedSetting(CMDID_GEN2_SETTINGS, GEN2_SEL, set, storedSet);
 }
 short AMSRadonReader::setTarget(char target, char &storedTarget)
 {
-	char cmdMsgBuffer[22];
-	char respMsgBuffer[25];
-	SET_MESSAGE_TYPE(cmdMsgBuffer, CMD_GEN2_SETTINGS);
-	SET_MESSAGE_LENGTH(cmdMsgBuffer, 22);
-	SET_MESSAGE_CRC(cmdMsgBuffer, 0);
-	SET_MESSAGE_STATUS(cmdMsgBuffer, 0);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 6, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 7, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 8, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 9, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 10, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 11, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 12, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 13, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 14, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 15, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 16, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 17, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 18, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 19, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 20, 0x01);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 21, target);
-	unsigned short crc = calculateCRC(cmdMsgBuffer, 22);
-	SET_MESSAGE_CRC(cmdMsgBuffer, crc);
-	uart->flush();
-	uart->sendMessage(&cmdMsgBuffer[0], 22);
-	short count = 0;
-	QTime timer;
-	unsigned short msgLength = 3;
-	timer.start();
-	do
-	{
-		if(uart->receiveMessage(&respMsgBuffer[count], 1) > 0)
-		{
-			count++;
-			if(count == 3)
-			{
-				msgLength = GET_MESSAGE_LENGTH(respMsgBuffer);		
-			}
-			timer.restart();
-		}
-	}while ((count < msgLength) && (timer.elapsed() < WAIT_FOR_RESPONSE_TIME));
-	if(count != msgLength)
-		return TIMEOUT_ERROR;
-	unsigned short msgCRC  = GET_MESSAGE_CRC(respMsgBuffer);
-	SET_MESSAGE_CRC(respMsgBuffer, 0);
-	unsigned short calculatedCRC = calculateCRC(respMsgBuffer, msgLength);
-	if(msgCRC != calculatedCRC)
-		return CRC_ERROR;
-	storedTarget = respMsgBuffer[21];
-	char msgStatus  = GET_MESSAGE_STATUS(respMsgBuffer);
-	return msgStatus;
+	return setPairedSetting(CMDID_GEN2_SETTINGS, GEN2_TARGET, target, storedTarget);
 }
 short AMSRadonReader::getGen2Settings(char &linkFreq, char &coding, char &session, char &trext, char &tari, char &qBegin, char &set, char &target)
 {
-	char cmdMsgBuffer[22];
-	char respMsgBuffer[25];
-	SET_MESSAGE_TYPE(cmdMsgBuffer, CMD_GEN2_SETTINGS);
-	SET_MESSAGE_LENGTH(cmdMsgBuffer, 22);
-	SET_MESSAGE_CRC(cmdMsgBuffer, 0);
-	SET_MESSAGE_STATUS(cmdMsgBuffer, 0);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 6, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 7, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 8, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 9, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 10, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 11, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 12, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 13, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 14, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 15, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 16, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 17, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 18, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 19, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 20, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 21, 0x00);
-	unsigned short crc = calculateCRC(cmdMsgBuffer, 22);
-	SET_MESSAGE_CRC(cmdMsgBuffer, crc);
-	uart->flush();
-	uart->sendMessage(&cmdMsgBuffer[0], 22);
-	short count = 0;
-	QTime timer;
-	unsigned short msgLength = 3;
-	timer.start();
-	do
-	{
-		if(uart->receiveMessage(&respMsgBuffer[count], 1) > 0)
-		{
-			count++;
-			if(count == 3)
-			{
-				msgLength = GET_MESSAGE_LENGTH(respMsgBuffer);		
-			}
-			timer.restart();
-		}
-	}while ((count < msgLength) && (timer.elapsed() < WAIT_FOR_RESPONSE_TIME));
-	if(count != msgLength)
-		return TIMEOUT_ERROR;
-	unsigned short msgCRC  = GET_MESSAGE_CRC(respMsgBuffer);
-	SET_MESSAGE_CRC(respMsgBuffer, 0);
-	unsigned short calculatedCRC = calculateCRC(respMsgBuffer, msgLength);
-	if(msgCRC != calculatedCRC)
-		return CRC_ERROR;
-	linkFreq = respMsgBuffer[7];
-	coding = respMsgBuffer[9]; 
-	session = respMsgBuffer[11]; 
-	trext = respMsgBuffer[13]; 
-	tari = respMsgBuffer[15]; 
-	qBegin = respMsgBuffer[17]; 
-	set = respMsgBuffer[19]; 
-	target = respMsgBuffer[21]; 
-	char msgStatus  = GET_MESSAGE_STATUS(respMsgBuffer);
-	return msgStatus;
+	beginRequest(CMDID_GEN2_SETTINGS);
+	ReplyView reply;
+	short msgLength = transact(reply);
+	if(msgLength <= 0)
+		return msgLength;
+	linkFreq = reply.byte(2 * GEN2_LINK_FREQUENCY + 1);
+	coding = reply.byte(2 * GEN2_CODING + 1);
+	session = reply.byte(2 * GEN2_SESSION + 1);
+	trext = reply.byte(2 * GEN2_TREXT + 1);
+	tari = reply.byte(2 * GEN2_TARI + 1);
+	qBegin = reply.byte(2 * GEN2_QBEGIN + 1);
+	set = reply.byte(2 * GEN2_SEL + 1);
+	target = reply.byte(2 * GEN2_TARGET + 1);
+	return reply.status();
 }
 short AMSRadonReader::setAntennaSensitivity(signed char sensitivity, signed char &storedSensitivity)
 {
-	char cmdMsgBuffer[10];
-	char respMsgBuffer[25];
-	SET_MESSAGE_TYPE(cmdMsgBuffer, CMD_CONFIG_TX_RX);
-	SET_MESSAGE_LENGTH(cmdMsgBuffer, 10);
-	SET_MESSAGE_CRC(cmdMsgBuffer, 0);
-	SET_MESSAGE_STATUS(cmdMsgBuffer, 0);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 6, 0x01);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 7, sensitivity);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 8, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 9, 0x00);
-	unsigned short crc = calculateCRC(cmdMsgBuffer, 10);
-	SET_MESSAGE_CRC(cmdMsgBuffer, crc);
-	uart->flush();
-	uart->sendMessage(&cmdMsgBuffer[0], 10);
-	short count = 0;
-	QTime timer;
-	unsigned short msgLength = 3;
-	timer.start();
-	do
-	{
-		if(uart->receiveMessage(&respMsgBuffer[count], 1) > 0)
-		{
-			count++;
-			if(count == 3)
-			{
-				msgLength = GET_MESSAGE_LENGTH(respMsgBuffer);		
-			}
-			timer.restart();
-		}
-	}while ((count < msgLength) && (timer.elapsed() < WAIT_FOR_RESPONSE_TIME));
-	if(count != msgLength)
-		return TIMEOUT_ERROR;
-	unsigned short msgCRC  = GET_MESSAGE_CRC(respMsgBuffer);
-	SET_MESSAGE_CRC(respMsgBuffer, 0);
-	unsigned short calculatedCRC = calculateCRC(respMsgBuffer, msgLength);
-	if(msgCRC != calculatedCRC)
-		return CRC_ERROR;
-	storedSensitivity = respMsgBuffer[7];
-	char msgStatus  = GET_MESSAGE_STATUS(respMsgBuffer);
-	return msgStatus;
+	char stored = storedSensitivity;
+	short status = setPairedSetting(CMDID_CONFIG_TX_RX, TXRX_SENSITIVITY, sensitivity, stored);
+	storedSensitivity = stored;
+	return status;
 }
 short AMSRadonReader::getAntennaSensitivity(char &sensitivity)
 {
-	char cmdMsgBuffer[10];
-	char respMsgBuffer[25];
-	SET_MESSAGE_TYPE(cmdMsgBuffer, CMD_CONFIG_TX_RX);
-	SET_MESSAGE_LENGTH(cmdMsgBuffer, 10);
-	SET_MESSAGE_CRC(cmdMsgBuffer, 0);
-	SET_MESSAGE_STATUS(cmdMsgBuffer, 0);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 6, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 7, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 8, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 9, 0x00);
-	unsigned short crc = calculateCRC(cmdMsgBuffer, 10);
-	SET_MESSAGE_CRC(cmdMsgBuffer, crc);
-	uart->flush();
-	uart->sendMessage(&cmdMsgBuffer[0], 10);
-	short count = 0;
-	QTime timer;
-	unsigned short msgLength = 3;
-	timer.start();
-	do
-	{
-		if(uart->receiveMessage(&respMsgBuffer[count], 1) > 0)
-		{
-			count++;
-			if(count == 3)
-			{
-				msgLength = GET_MESSAGE_LENGTH(respMsgBuffer);		
-			}
-			timer.restart();
-		}
-	}while ((count < msgLength) && (timer.elapsed() < WAIT_FOR_RESPONSE_TIME));
-	if(count != msgLength)
-		return TIMEOUT_ERROR;
-	unsigned short msgCRC  = GET_MESSAGE_CRC(respMsgBuffer);
-	SET_MESSAGE_CRC(respMsgBuffer, 0);
-	unsigned short calculatedCRC = calculateCRC(respMsgBuffer, msgLength);
-	if(msgCRC != calculatedCRC)
-		return CRC_ERROR;
-	sensitivity = respMsgBuffer[7];
-	char msgStatus  = GET_MESSAGE_STATUS(respMsgBuffer);
-	return msgStatus;
+	beginRequest(CMDID_CONFIG_TX_RX);
+	ReplyView reply;
+	short msgLength = transact(reply);
+	if(msgLength <= 0)
+		return msgLength;
+	sensitivity = reply.byte(2 * TXRX_SENSITIVITY + 1);
+	return reply.status();
 }
 short AMSRadonReader::setAntennaID(char antennaID, char &storedAntennaID)
 {
-	char cmdMsgBuffer[10];
-	char respMsgBuffer[25];
-	SET_MESSAGE_TYPE(cmdMsgBuffer, CMD_CONFIG_TX_RX);
-	SET_MESSAGE_LENGTH(cmdMsgBuffer, 10);
-	SET_MESSAGE_CRC(cmdMsgBuffer, 0);
-	SET_MESSAGE_STATUS(cmdMsgBuffer, 0);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 6, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 7, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 8, 0x01);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 9, antennaID);
-	unsigned short crc = calculateCRC(cmdMsgBuffer, 10);
-	SET_MESSAGE_CRC(cmdMsgBuffer, crc);
-	uart->flush();
-	uart->sendMessage(&cmdMsgBuffer[0], 10);
-	short count = 0;
-	QTime timer;
-	unsigned short msgLength = 3;
-	timer.start();
-	do
-	{
-		if(uart->receiveMessage(&respMsgBuffer[count], 1) > 0)
-		{
-			count++;
-			if(count == 3)
-			{
-				msgLength = GET_MESSAGE_LENGTH(respMsgBuffer);		
-			}
-			timer.restart();
-		}
-	}while ((count < msgLength) && (timer.elapsed() < WAIT_FOR_RESPONSE_TIME));
-	if(count != msgLength)
-		return TIMEOUT_ERROR;
-	unsigned short msgCRC  = GET_MESSAGE_CRC(respMsgBuffer);
-	SET_MESSAGE_CRC(respMsgBuffer, 0);
-	unsigned short calculatedCRC = calculateCRC(respMsgBuffer, msgLength);
-	if(msgCRC != calculatedCRC)
-		return CRC_ERROR;
-	storedAntennaID = respMsgBuffer[9];
-	char msgStatus  = GET_MESSAGE_STATUS(respMsgBuffer);
-	return msgStatus;
+	return setPairedSetting(CMDID_CONFIG_TX_RX, TXRX_ANTENNA_ID, antennaID, storedAntennaID);
 }
 short AMSRadonReader::getAntennaID(char &antennaID)
 {
-	char cmdMsgBuffer[10];
-	char respMsgBuffer[25];
-	SET_MESSAGE_TYPE(cmdMsgBuffer, CMD_CONFIG_TX_RX);
-	SET_MESSAGE_LENGTH(cmdMsgBuffer, 10);
-	SET_MESSAGE_CRC(cmdMsgBuffer, 0);
-	SET_MESSAGE_STATUS(cmdMsgBuffer, 0);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 6, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 7, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 8, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 9, 0x00);
-	unsigned short crc = calculateCRC(cmdMsgBuffer, 10);
-	SET_MESSAGE_CRC(cmdMsgBuffer, crc);
-	uart->flush();
-	uart->sendMessage(&cmdMsgBuffer[0], 10);
-	short count = 0;
-	QTime timer;
-	unsigned short msgLength = 3;
-	timer.start();
-	do
+	beginRequest(CMDID_CONFIG_TX_RX);
+	ReplyView reply;
+	short msgLength = transact(reply);
+	if(msgLength <= 0)
+		return msgLength;
+	antennaID = reply.byte(2 * TXRX_ANTENNA_ID + 1);
+	return reply.status();
+}
+// Sends one request of a paired-setting command that sets only the fields in
+// which desired differs from current. Fields with their bit set in
+// verifiedFields must read back as requested. Returns ERR_NONE without a
+// request if nothing differs.
+short AMSRadonReader::writeChangedSettings(CommandId command, const char *current, const char *desired, int fieldCount, int verifiedFields)
+{
+	int changedFields = 0;
+	for(int field = 0; field < fieldCount; field++)
+		if(current[field] != desired[field])
+			changedFields |= 1 << field;
+	if(changedFields == 0)
+		return ERR_NONE;
+	char *payload = beginRequest(command);
+	for(int field = 0; field < fieldCount; field++)
 	{
-		if(uart->receiveMessage(&respMsgBuffer[count], 1) > 0)
-		{
-			count++;
-			if(count == 3)
-			{
-				msgLength = GET_MESSAGE_LENGTH(respMsgBuffer);		
-			}
-			timer.restart();
-		}
-	}while ((count < msgLength) && (timer.elapsed() < WAIT_FOR_RESPONSE_TIME));
-	if(count != msgLength)
-		return TIMEOUT_ERROR;
-	unsigned short msgCRC  = GET_MESSAGE_CRC(respMsgBuffer);
-	SET_MESSAGE_CRC(respMsgBuffer, 0);
-	unsigned short calculatedCRC = calculateCRC(respMsgBuffer, msgLength);
-	if(msgCRC != calculatedCRC)
-		return CRC_ERROR;
-	antennaID = respMsgBuffer[9];
-	char msgStatus  = GET_MESSAGE_STATUS(respMsgBuffer);
-	return msgStatus;
+		if(!(changedFields & (1 << field)))
+			continue;
+		payload[2 * field] = 0x01;
+		payload[2 * field + 1] = desired[field];
+	}
+	ReplyView reply;
+	short msgLength = transact(reply);
+	if(msgLength <= 0)
+		return msgLength;
+	if(reply.status() != 0)
+		return reply.status();
+	for(int field = 0; field < fieldCount; field++)
+		if((changedFields & verifiedFields & (1 << field)) && reply.byte(2 * field + 1) != desired[field])
+			return ERR_REQUEST;
+	return ERR_NONE;
+}
+// Brings the reader to profile with as few requests as possible: the TX/RX,
+// Gen2 and register settings are read once and only the differences are
+// written, so a reader that kept its configuration over a host restart costs
+// the reads only. reconfigured tells whether the antenna or a Gen2 setting
+// had to change, which is also when the antenna is tuned again. The
+// sensitivity does not count, the reader reports the sensitivity it reached
+// rather than the one requested.
+short AMSRadonReader::applyReaderProfile(const ReaderProfile &profile, bool &reconfigured)
+{
+	reconfigured = false;
+	if(pipelineDepth > 1 || streamRunning)
+		return ERR_BUSY;
+	beginRequest(CMDID_CONFIG_TX_RX);
+	ReplyView reply;
+	short msgLength = transact(reply);
+	if(msgLength <= 0)
+		return msgLength;
+	if(reply.status() != 0)
+		return reply.status();
+	char currentTxRx[TXRX_ANTENNA_ID + 1];
+	currentTxRx[TXRX_SENSITIVITY] = reply.byte(2 * TXRX_SENSITIVITY + 1);
+	currentTxRx[TXRX_ANTENNA_ID] = reply.byte(2 * TXRX_ANTENNA_ID + 1);
+	char desiredTxRx[TXRX_ANTENNA_ID + 1];
+	desiredTxRx[TXRX_SENSITIVITY] = profile.sensitivity;
+	desiredTxRx[TXRX_ANTENNA_ID] = profile.antennaID;
+	char currentGen2[GEN2_TARGET + 1];
+	short status = getGen2Settings(currentGen2[GEN2_LINK_FREQUENCY], currentGen2[GEN2_CODING], currentGen2[GEN2_SESSION],
+			currentGen2[GEN2_TREXT], currentGen2[GEN2_TARI], currentGen2[GEN2_QBEGIN], currentGen2[GEN2_SEL], currentGen2[GEN2_TARGET]);
+	if(status != 0)
+		return status;
+	char desiredGen2[GEN2_TARGET + 1];
+	desiredGen2[GEN2_LINK_FREQUENCY] = profile.linkFreq;
+	desiredGen2[GEN2_CODING] = profile.coding;
+	desiredGen2[GEN2_SESSION] = profile.session;
+	desiredGen2[GEN2_TREXT] = profile.trext;
+	desiredGen2[GEN2_TARI] = profile.tari;
+	desiredGen2[GEN2_QBEGIN] = profile.qBegin;
+	desiredGen2[GEN2_SEL] = profile.sel;
+	desiredGen2[GEN2_TARGET] = profile.target;
+	reconfigured = currentTxRx[TXRX_ANTENNA_ID] != desiredTxRx[TXRX_ANTENNA_ID] ||
+			memcmp(currentGen2, desiredGen2, sizeof(desiredGen2)) != 0;
+	status = writeChangedSettings(CMDID_CONFIG_TX_RX, currentTxRx, desiredTxRx, TXRX_ANTENNA_ID + 1, 1 << TXRX_ANTENNA_ID);
+	if(status != 0)
+		return status;
+	status = writeChangedSettings(CMDID_GEN2_SETTINGS, currentGen2, desiredGen2, GEN2_TARGET + 1, 0xFF);
+	if(status != 0)
+		return status;
+	// after the TX/RX settings, setting the sensitivity changes registers
+	status = loadAS3993Shadow();
+	if(status != 0)
+		return status;
+	for(int i = 0; i < profile.registerCount && i < PROFILE_MAX_REGISTERS; i++)
+	{
+		const ProfileRegister &reg = profile.registers[i];
+		unsigned char address = reg.address;
+		if(address < AS3993_REGISTER_COUNT && regShadowValid[address] && ((regShadow[address] ^ reg.value) & reg.mask) == 0)
+			continue;
+		stageAS3993Reg(reg.address, reg.mask, reg.value);
+	}
+	status = flushAS3993Regs();
+	if(status != 0)
+		return status;
+	if(reconfigured && profile.autoTune != 0)
+		return performAutoTuning(profile.autoTune);
+	return ERR_NONE;
 }
 short AMSRadonReader::performGen2Inventory(char autoAck, char tidAndFast, char rssi)
 {
-	char cmdMsgBuffer[9];
-	char respMsgBuffer[100];
-	SET_MESSAGE_TYPE(cmdMsgBuffer, CMD_INVENTORY_GEN2);
-	SET_MESSAGE_LENGTH(cmdMsgBuffer, 9);
-	SET_MESSAGE_CRC(cmdMsgBuffer, 0);
-	SET_MESSAGE_STATUS(cmdMsgBuffer, 0);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 6, autoAck); 
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 7, tidAndFast); 
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 8, rssi); 
-	unsigned short crc = calculateCRC(cmdMsgBuffer, 9);
-	SET_MESSAGE_CRC(cmdMsgBuffer, crc);
-	uart->flush();
-	uart->sendMessage(&cmdMsgBuffer[0], 9);
-	short count = 0;
-	QTime timer;
-	unsigned short msgLength = 3;
-	timer.start();
-	do
+	char *payload = beginRequest(CMDID_INVENTORY_GEN2);
+	payload[0] = autoAck;
+	payload[1] = tidAndFast;
+	payload[2] = rssi;
+	return transact();
+}
+// Decodes the tag record starting at payload index of a CMD_GET_TAG_DATA reply
+// and returns the index of the next record, or 0 if the record runs past the
+// payload or has an EPC or TID length the record can not hold. inventoryType
+// tells which of the optional TID/calibration and MMS/VFC/TEMP blocks are
+// present.
+unsigned short AMSRadonReader::decodeTag(ReplyView &reply, unsigned short index, char inventoryType, TagData &tag)
+{
+	unsigned int length = reply.payloadLength();
+	// AGC, RSSI, frequency (3), PC + EPC length, PC (2)
+	if(index + 8u > length)
+		return 0;
+	int EPCLen = reply.u8(index + 5) - 2;
+	if(EPCLen < 0 || EPCLen > TAG_EPC_MAX_SIZE || index + 8u + EPCLen > length)
+		return 0;
+	tag.setReaderAGC(reply.byte(index));
+	tag.setReaderRSSI(reply.byte(++index));
+	tag.setCommFrequency(reply.payload(++index));
+	index += 3;
+	tag.setPC(reply.payload(++index));
+	tag.setEPCAndEPCLength(reply.payload(index += 2), EPCLen);
+	index += EPCLen;
+	if(inventoryType & 0x02)
 	{
-		if(uart->receiveMessage(&respMsgBuffer[count], 1) > 0)
-		{
-			count++;
-			if(count == 3)
-			{
-				msgLength = GET_MESSAGE_LENGTH(respMsgBuffer);		
-			}
-			timer.restart();
-		}
-	}while ((count < msgLength) && (timer.elapsed() < WAIT_FOR_INVENTORY_RESPONSE_TIME));
-	if(count != msgLength)
-		return TIMEOUT_ERROR;
-	unsigned short msgCRC  = GET_MESSAGE_CRC(respMsgBuffer);
-	SET_MESSAGE_CRC(respMsgBuffer, 0);
-	unsigned short calculatedCRC = calculateCRC(respMsgBuffer, msgLength);
-	if(msgCRC != calculatedCRC)
-		return CRC_ERROR;
-	char msgStatus  = GET_MESSAGE_STATUS(respMsgBuffer);
-	return msgStatus;
+		// TID length, TID, calibration (8)
+		if(index + 1u > length)
+			return 0;
+		int TIDLen = reply.u8(index);
+		if(TIDLen > TAG_TID_MAX_SIZE || index + 1u + TIDLen + 8 > length)
+			return 0;
+		tag.setTIDAndTIDLength(reply.payload(++index), TIDLen);
+		index += TIDLen;
+		tag.setTempCalibrationParams(reply.payload(index));
+		index += 8;
+	}
+	if(inventoryType & 0x04)
+	{
+		// MMS, VFC, TEMP (2 each)
+		if(index + 6u > length)
+			return 0;
+		tag.setMMS(reply.payload(index));
+		tag.setVFC(reply.payload(index += 2));
+		tag.setTEMP(reply.payload(index += 2));
+		index += 2;
+	}
+	return index;
 }
+// Appends the tags of the last inventory round to tags, decoding them in place.
+// A vector the caller clears and reuses keeps its capacity, so steady state
+// reads do not allocate.
 short AMSRadonReader::getTagData(vector<TagData> &tags, char &inventoryType, char &inventoryResult, char &numberOfTagsFound)
 {
-	char cmdMsgBuffer[6];
-	char respMsgBuffer[1000];
-	TagData tag;
-	char tagNumber;
-	SET_MESSAGE_TYPE(cmdMsgBuffer, CMD_GET_TAG_DATA);
-	SET_MESSAGE_LENGTH(cmdMsgBuffer, 6);
-	SET_MESSAGE_CRC(cmdMsgBuffer, 0);
-	SET_MESSAGE_STATUS(cmdMsgBuffer, 0);
-	unsigned short crc = calculateCRC(cmdMsgBuffer, 6);
-	SET_MESSAGE_CRC(cmdMsgBuffer, crc);
-	uart->flush();
-	uart->sendMessage(&cmdMsgBuffer[0], 6);
-	short count = 0;
-	QTime timer;
-	unsigned short msgLength = 3;
-	timer.start();
-	do
-	{
-		if(uart->receiveMessage(&respMsgBuffer[count], 1) > 0)
-		{
-			count++;
-			if(count == 3)
-			{
-				msgLength = GET_MESSAGE_LENGTH(respMsgBuffer);		
-			}
-			timer.restart();
-		}
-	}while ((count < msgLength) && (timer.elapsed() < WAIT_FOR_TAG_DATA_RESPONSE_TIME));
-	if(count != msgLength)
-		return TIMEOUT_ERROR;
-	unsigned short msgCRC  = GET_MESSAGE_CRC(respMsgBuffer);
-	SET_MESSAGE_CRC(respMsgBuffer, 0);
-	unsigned short calculatedCRC = calculateCRC(respMsgBuffer, msgLength);
-	if(msgCRC != calculatedCRC)
-		return CRC_ERROR;
-	char msgStatus  = GET_MESSAGE_STATUS(respMsgBuffer);
+	beginRequest(CMDID_GET_TAG_DATA);
+	ReplyView reply;
+	short msgLength = transact(reply);
+	if(msgLength <= 0)
+		return msgLength;
+	char msgStatus  = reply.status();
 	if(msgStatus != 0)
 		return msgStatus;
-	inventoryResult = respMsgBuffer[6];
-	inventoryType = respMsgBuffer[7];
+	inventoryResult = reply.byte(0);
+	inventoryType = reply.byte(1);
 	if(inventoryResult == 0)
 	{
-		numberOfTagsFound = respMsgBuffer[8];
-		tagNumber = numberOfTagsFound;
-		unsigned short index = 9;
-		while(tagNumber > 0)
+		numberOfTagsFound = reply.byte(2);
+		unsigned int first = tags.size();
+		tags.resize(first + (unsigned char)numberOfTagsFound);
+		unsigned short index = 3;
+		for(unsigned int t = first; t < tags.size(); t++)
 		{
-			tag.setReaderAGC(respMsgBuffer[index]);
-			tag.setReaderRSSI(respMsgBuffer[++index]);
-			tag.setCommFrequency(&respMsgBuffer[++index]);
-			char EPCLen = respMsgBuffer[index += 3] - 2;
-			tag.setPC(&respMsgBuffer[++index]);
-			tag.setEPCAndEPCLength(&respMsgBuffer[index += 2], EPCLen);
-			index += EPCLen;
-			if(inventoryType & 0x02)
-			{
-				char TIDLen = respMsgBuffer[(int)index];
-				tag.setTIDAndTIDLength(&respMsgBuffer[++index], TIDLen);
-				index += TIDLen;
-				tag.setTempCalibrationParams(&respMsgBuffer[(int)index]);
-				index += 8;
+			index = decodeTag(reply, index, inventoryType, tags[t]);
+			if(index == 0)
+			{	// record count or layout does not match the frame
+				tags.resize(t);
+				return ERR_PROTO;
 			}
-			if(inventoryType & 0x04)
-			{
-				tag.setMMS(&respMsgBuffer[(int)index]);
-				tag.setVFC(&respMsgBuffer[index += 2]);
-				tag.setTEMP(&respMsgBuffer[index += 2]);
-				index += 2;
-			}
-			tags.push_back(tag);
-			tag.clear();
-			tagNumber--;
 		}
 	}
 	return msgStatus;
 }
 short AMSRadonReader::clearListOfSelectCommands()
 {
-	char cmdMsgBuffer[8];
-	char respMsgBuffer[25];
-	SET_MESSAGE_TYPE(cmdMsgBuffer, CMD_SELECT_TAG);
-	SET_MESSAGE_LENGTH(cmdMsgBuffer, 8);
-	SET_MESSAGE_CRC(cmdMsgBuffer, 0);
-	SET_MESSAGE_STATUS(cmdMsgBuffer, 0);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 6, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 7, 0x00);
-	unsigned short crc = calculateCRC(cmdMsgBuffer, 8);
-	SET_MESSAGE_CRC(cmdMsgBuffer, crc);
-	uart->flush();
-	uart->sendMessage(&cmdMsgBuffer[0], 8);
-	short count = 0;
-	QTime timer;
-	unsigned short msgLength = 3;
-	timer.start();
-	do
-	{
-		if(uart->receiveMessage(&respMsgBuffer[count], 1) > 0)
-		{
-			count++;
-			if(count == 3)
-			{
-				msgLength = GET_MESSAGE_LENGTH(respMsgBuffer);		
-			}
-			timer.restart();
-		}
-	}while ((count < msgLength) && (timer.elapsed() < WAIT_FOR_RESPONSE_TIME));
-	if(count != msgLength)
-		return TIMEOUT_ERROR;
-	unsigned short msgCRC  = GET_MESSAGE_CRC(respMsgBuffer);
-	SET_MESSAGE_CRC(respMsgBuffer, 0);
-	unsigned short calculatedCRC = calculateCRC(respMsgBuffer, msgLength);
-	if(msgCRC != calculatedCRC)
-		return CRC_ERROR;
-	char msgStatus  = GET_MESSAGE_STATUS(respMsgBuffer);
-	return msgStatus;
+	beginRequest(CMDID_SELECT_TAG, 2);
+	return transact();
 }
 short AMSRadonReader::singulateATag(char clear, char target, char action, char memBank, short address, char maskLen, char truncate, char *mask, short maskSize)
 {
-	short bufferLen = 6 + 8 + maskSize;
-	char *cmdMsgBuffer = new char[bufferLen];
-	char respMsgBuffer[25];
-	SET_MESSAGE_TYPE(cmdMsgBuffer, CMD_SELECT_TAG);
-	SET_MESSAGE_LENGTH(cmdMsgBuffer, bufferLen);
-	SET_MESSAGE_CRC(cmdMsgBuffer, 0);
-	SET_MESSAGE_STATUS(cmdMsgBuffer, 0);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 6, clear);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 7, target);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 8, action);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 9, memBank);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 10, address & 0xFF);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 11, (address >>8) & 0xFF);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 12, maskLen);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 13, truncate);
-	for(short i = 0; i < maskSize; i++)
-		cmdMsgBuffer[14 + i] = mask[i];
-	unsigned short crc = calculateCRC(cmdMsgBuffer, bufferLen);
-	SET_MESSAGE_CRC(cmdMsgBuffer, crc);
-	uart->flush();
-	uart->sendMessage(&cmdMsgBuffer[0], bufferLen);
-	short count = 0;
-	QTime timer;
-	unsigned short msgLength = 3;
-	timer.start();
-	do
-	{
-		if(uart->receiveMessage(&respMsgBuffer[count], 1) > 0)
-		{
-			count++;
-			if(count == 3)
-			{
-				msgLength = GET_MESSAGE_LENGTH(respMsgBuffer);		
-			}
-			timer.restart();
-		}
-	}while ((count < msgLength) && (timer.elapsed() < WAIT_FOR_RESPONSE_TIME));
-	if(count != msgLength)
-		return TIMEOUT_ERROR;
-	unsigned short msgCRC  = GET_MESSAGE_CRC(respMsgBuffer);
-	SET_MESSAGE_CRC(respMsgBuffer, 0);
-	unsigned short calculatedCRC = calculateCRC(respMsgBuffer, msgLength);
-	if(msgCRC != calculatedCRC)
-		return CRC_ERROR;
-	char msgStatus  = GET_MESSAGE_STATUS(respMsgBuffer);
-	return msgStatus;
+	char *payload = beginRequest(CMDID_SELECT_TAG, 8 + maskSize);
+	if(!payload)
+		return ERR_PARAM;
+	payload[0] = clear;
+	payload[1] = target;
+	payload[2] = action;
+	payload[3] = memBank;
+	payload[4] = address & 0xFF;
+	payload[5] = (address >> 8) & 0xFF;
+	payload[6] = maskLen;
+	payload[7] = truncate;
+	memcpy(&payload[8], mask, maskSize);
+	return transact();
 }
 short AMSRadonReader::writeToTag(char memBank, int address, int accessPW, char *data, short dataLen, short &numOfWordsWritten, char &tagErrorCode)
 {
-	short bufferLen = 6 + 9 + dataLen;
-	char *cmdMsgBuffer = new char[bufferLen];
-	char respMsgBuffer[25];
-	SET_MESSAGE_TYPE(cmdMsgBuffer, CMD_WRITE_TO_TAG);
-	SET_MESSAGE_LENGTH(cmdMsgBuffer, bufferLen);
-	SET_MESSAGE_CRC(cmdMsgBuffer, 0);
-	SET_MESSAGE_STATUS(cmdMsgBuffer, 0);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 6, memBank);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 7, address & 0xFF);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 8, (address >> 8) & 0xFF);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 9, (address >> 16) & 0xFF);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 10, (address >> 24) & 0xFF);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 11, accessPW & 0xFF);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 12, (accessPW >> 8) & 0xFF);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 13, (accessPW >> 16) & 0xFF);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 14, (accessPW >> 24) & 0xFF);
-	for(short i = 0; i < dataLen; i++)
-		cmdMsgBuffer[15 + i] = data[i];
-	unsigned short crc = calculateCRC(cmdMsgBuffer, bufferLen);
-	SET_MESSAGE_CRC(cmdMsgBuffer, crc);
-	uart->flush();
-	uart->sendMessage(&cmdMsgBuffer[0], bufferLen);
-	short count = 0;
-	QTime timer;
-	unsigned short msgLength = 3;
-	timer.start();
-	do
-	{
-		if(uart->receiveMessage(&respMsgBuffer[count], 1) > 0)
-		{
-			count++;
-			if(count == 3)
-			{
-				msgLength = GET_MESSAGE_LENGTH(respMsgBuffer);		
-			}
-			timer.restart();
-		}
-	}while ((count < msgLength) && (timer.elapsed() < WRITE_TO_TAG_WAIT_FOR_RESPONSE_TIME));
-	if(count != msgLength)
-		return TIMEOUT_ERROR;
-	unsigned short msgCRC  = GET_MESSAGE_CRC(respMsgBuffer);
-	SET_MESSAGE_CRC(respMsgBuffer, 0);
-	unsigned short calculatedCRC = calculateCRC(respMsgBuffer, msgLength);
-	if(msgCRC != calculatedCRC)
-		return CRC_ERROR;
-	numOfWordsWritten = respMsgBuffer[6];
-	tagErrorCode = respMsgBuffer[7];
-	char msgStatus  = GET_MESSAGE_STATUS(respMsgBuffer);
-	return msgStatus;
+	char *payload = beginRequest(CMDID_WRITE_TO_TAG, 9 + dataLen);
+	if(!payload)
+		return ERR_PARAM;
+	payload[0] = memBank;
+	payload[1] = address & 0xFF;
+	payload[2] = (address >> 8) & 0xFF;
+	payload[3] = (address >> 16) & 0xFF;
+	payload[4] = (address >> 24) & 0xFF;
+	payload[5] = accessPW & 0xFF;
+	payload[6] = (accessPW >> 8) & 0xFF;
+	payload[7] = (accessPW >> 16) & 0xFF;
+	payload[8] = (accessPW >> 24) & 0xFF;
+	memcpy(&payload[9], data, dataLen);
+	ReplyView reply;
+	short msgLength = transact(reply);
+	if(msgLength <= 0)
+		return msgLength;
+	numOfWordsWritten = reply.byte(0);
+	tagErrorCode = reply.byte(1);
+	return reply.status();
 }
 short AMSRadonReader::readFromTag(char memBank, int address, int password, char *data, char &dataLen)
 {
-	char cmdMsgBuffer[16];
-	char respMsgBuffer[100];
-	SET_MESSAGE_TYPE(cmdMsgBuffer, CMD_READ_FROM_TAG);
-	SET_MESSAGE_LENGTH(cmdMsgBuffer, 16);
-	SET_MESSAGE_CRC(cmdMsgBuffer, 0);
-	SET_MESSAGE_STATUS(cmdMsgBuffer, 0);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 6, memBank);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 7, address & 0xFF);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 8, (address >> 8) & 0xFF);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 9, (address >> 16) & 0xFF);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 10, (address >> 24) & 0xFF);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 11, password & 0xFF);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 12, (password >> 8) & 0xFF);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 13, (password >> 16) & 0xFF);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 14, (password >> 24) & 0xFF);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 15, dataLen);
-	unsigned short crc = calculateCRC(cmdMsgBuffer, 16);
-	SET_MESSAGE_CRC(cmdMsgBuffer, crc);
-	uart->flush();
-	uart->sendMessage(&cmdMsgBuffer[0], 16);
-	short count = 0;
-	QTime timer;
-	unsigned short msgLength = 3;
-	timer.start();
-	do
-	{
-		if(uart->receiveMessage(&respMsgBuffer[count], 1) > 0)
-		{
-			count++;
-			if(count == 3)
-			{
-				msgLength = GET_MESSAGE_LENGTH(respMsgBuffer);		
-			}
-			timer.restart();
-		}
-	}while ((count < msgLength) && (timer.elapsed() < WAIT_FOR_RESPONSE_TIME));
-	if(count != msgLength)
-		return TIMEOUT_ERROR;
-	unsigned short msgCRC  = GET_MESSAGE_CRC(respMsgBuffer);
-	SET_MESSAGE_CRC(respMsgBuffer, 0);
-	unsigned short calculatedCRC = calculateCRC(respMsgBuffer, msgLength);
-	if(msgCRC != calculatedCRC)
-		return CRC_ERROR;
-	dataLen = msgLength - 6;
-	for(short i = 0; i < dataLen; i++)
-	{
-		data[i] = respMsgBuffer[6 + i];
-	}
-	char msgStatus  = GET_MESSAGE_STATUS(respMsgBuffer);
-	return msgStatus;
+	char *payload = beginRequest(CMDID_READ_FROM_TAG);
+	payload[0] = memBank;
+	payload[1] = address & 0xFF;
+	payload[2] = (address >> 8) & 0xFF;
+	payload[3] = (address >> 16) & 0xFF;
+	payload[4] = (address >> 24) & 0xFF;
+	payload[5] = password & 0xFF;
+	payload[6] = (password >> 8) & 0xFF;
+	payload[7] = (password >> 16) & 0xFF;
+	payload[8] = (password >> 24) & 0xFF;
+	payload[9] = dataLen;
+	ReplyView reply;
+	short msgLength = transact(reply);
+	if(msgLength <= 0)
+		return msgLength;
+	dataLen = reply.payloadLength();
+	memcpy(data, reply.payload(0), reply.payloadLength());
+	return reply.status();
 }
 short AMSRadonReader::lockUnlockTag(int maskAndAction, int accessPassword, char &tagCode)
 {
-	char cmdMsgBuffer[12];
-	char respMsgBuffer[25];
-	SET_MESSAGE_TYPE(cmdMsgBuffer, CMD_LOCK_UNLOCK_TAG);
-	SET_MESSAGE_LENGTH(cmdMsgBuffer, 12);
-	SET_MESSAGE_CRC(cmdMsgBuffer, 0);
-	SET_MESSAGE_STATUS(cmdMsgBuffer, 0);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 6, maskAndAction & 0xFF); 
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 7, (maskAndAction >> 8) & 0xFF); 
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 8, (maskAndAction >> 16) & 0xFF); 
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 9, accessPassword & 0xFF); 
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 10, (accessPassword >> 8) & 0xFF); 
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 11, (accessPassword >> 16) & 0xFF); 
-	unsigned short crc = calculateCRC(cmdMsgBuffer, 12);
-	SET_MESSAGE_CRC(cmdMsgBuffer, crc);
-	uart->flush();
-	uart->sendMessage(&cmdMsgBuffer[0], 12);
-	short count = 0;
-	QTime timer;
-	unsigned short msgLength = 3;
-	timer.start();
-	do
-	{
-		if(uart->receiveMessage(&respMsgBuffer[count], 1) > 0)
-		{
-			count++;
-			if(count == 3)
-			{
-				msgLength = GET_MESSAGE_LENGTH(respMsgBuffer);		
-			}
-			timer.restart();
-		}
-	}while ((count < msgLength) && (timer.elapsed() < WAIT_FOR_RESPONSE_TIME));
-	if(count != msgLength)
-		return TIMEOUT_ERROR;
-	unsigned short msgCRC  = GET_MESSAGE_CRC(respMsgBuffer);
-	SET_MESSAGE_CRC(respMsgBuffer, 0);
-	unsigned short calculatedCRC = calculateCRC(respMsgBuffer, msgLength);
-	if(msgCRC != calculatedCRC)
-		return CRC_ERROR;
-	tagCode = respMsgBuffer[6];
-	char msgStatus  = GET_MESSAGE_STATUS(respMsgBuffer);
-	return msgStatus;
+	char *payload = beginRequest(CMDID_LOCK_UNLOCK_TAG);
+	payload[0] = maskAndAction & 0xFF;
+	payload[1] = (maskAndAction >> 8) & 0xFF;
+	payload[2] = (maskAndAction >> 16) & 0xFF;
+	payload[3] = accessPassword & 0xFF;
+	payload[4] = (accessPassword >> 8) & 0xFF;
+	payload[5] = (accessPassword >> 16) & 0xFF;
+	ReplyView reply;
+	short msgLength = transact(reply);
+	if(msgLength <= 0)
+		return msgLength;
+	tagCode = reply.byte(0);
+	return reply.status();
 }
 short AMSRadonReader::killTag(int killPassword, char recom, char &status)
 {
-	char cmdMsgBuffer[11];
-	char respMsgBuffer[25];
-	SET_MESSAGE_TYPE(cmdMsgBuffer, CMD_KILL_TAG);
-	SET_MESSAGE_LENGTH(cmdMsgBuffer, 11);
-	SET_MESSAGE_CRC(cmdMsgBuffer, 0);
-	SET_MESSAGE_STATUS(cmdMsgBuffer, 0);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 6, killPassword & 0xFF);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 7, (killPassword >> 8) & 0xFF);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 8, (killPassword >> 16) & 0xFF);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 9, (killPassword >> 24) & 0xFF);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 10, recom);
-	unsigned short crc = calculateCRC(cmdMsgBuffer, 11);
-	SET_MESSAGE_CRC(cmdMsgBuffer, crc);
-	uart->flush();
-	uart->sendMessage(&cmdMsgBuffer[0], 11);
-	short count = 0;
-	QTime timer;
-	unsigned short msgLength = 3;
-	timer.start();
-	do
-	{
-		if(uart->receiveMessage(&respMsgBuffer[count], 1) > 0)
-		{
-			count++;
-			if(count == 3)
-			{
-				msgLength = GET_MESSAGE_LENGTH(respMsgBuffer);		
-			}
-			timer.restart();
-		}
-	}while ((count < msgLength) && (timer.elapsed() < WAIT_FOR_RESPONSE_TIME));
-	if(count != msgLength)
-		return TIMEOUT_ERROR;
-	unsigned short msgCRC  = GET_MESSAGE_CRC(respMsgBuffer);
-	SET_MESSAGE_CRC(respMsgBuffer, 0);
-	unsigned short calculatedCRC = calculateCRC(respMsgBuffer, msgLength);
-	if(msgCRC != calculatedCRC)
-		return CRC_ERROR;
-	status = respMsgBuffer[6];
-	char msgStatus  = GET_MESSAGE_STATUS(respMsgBuffer);
-	return msgStatus;
+	char *payload = beginRequest(CMDID_KILL_TAG);
+	payload[0] = killPassword & 0xFF;
+	payload[1] = (killPassword >> 8) & 0xFF;
+	payload[2] = (killPassword >> 16) & 0xFF;
+	payload[3] = (killPassword >> 24) & 0xFF;
+	payload[4] = recom;
+	ReplyView reply;
+	short msgLength = transact(reply);
+	if(msgLength <= 0)
+		return msgLength;
+	status = reply.byte(0);
+	return reply.status();
 }
 short AMSRadonReader::startStop(char update, char start, char autoAck, char tidAndFast, char rssi, char &currStartValue)
 {
-	char cmdMsgBuffer[11];
-	char respMsgBuffer[25];
-	SET_MESSAGE_TYPE(cmdMsgBuffer, CMD_START_STOP);
-	SET_MESSAGE_LENGTH(cmdMsgBuffer, 11);
-	SET_MESSAGE_CRC(cmdMsgBuffer, 0);
-	SET_MESSAGE_STATUS(cmdMsgBuffer, 0);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 6, update);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 7, start);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 8, autoAck);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 9, tidAndFast);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 10, rssi);
-	unsigned short crc = calculateCRC(cmdMsgBuffer, 11);
-	SET_MESSAGE_CRC(cmdMsgBuffer, crc);
-	uart->flush();
-	uart->sendMessage(&cmdMsgBuffer[0], 11);
-	short count = 0;
-	QTime timer;
-	unsigned short msgLength = 3;
-	timer.start();
-	do
-	{
-		if(uart->receiveMessage(&respMsgBuffer[count], 1) > 0)
-		{
-			count++;
-			if(count == 3)
-			{
-				msgLength = GET_MESSAGE_LENGTH(respMsgBuffer);		
-			}
-			timer.restart();
-		}
-	}while ((count < msgLength) && (timer.elapsed() < WAIT_FOR_RESPONSE_TIME));
-	if(count != msgLength)
-		return TIMEOUT_ERROR;
-	unsigned short msgCRC  = GET_MESSAGE_CRC(respMsgBuffer);
-	SET_MESSAGE_CRC(respMsgBuffer, 0);
-	unsigned short calculatedCRC = calculateCRC(respMsgBuffer, msgLength);
-	if(msgCRC != calculatedCRC)
-		return CRC_ERROR;
-	currStartValue = respMsgBuffer[6];
-	char msgStatus  = GET_MESSAGE_STATUS(respMsgBuffer);
-	return msgStatus;
+	char *payload = beginRequest(CMDID_START_STOP);
+	payload[0] = update;
+	payload[1] = start;
+	payload[2] = autoAck;
+	payload[3] = tidAndFast;
+	payload[4] = rssi;
+	ReplyView reply;
+	short msgLength = transact(reply);
+	if(msgLength <= 0)
+		return msgLength;
+	currStartValue = reply.byte(0);
+	return reply.status();
 }
 short AMSRadonReader::getCurrentTuningTableSize(char &maxTuningTableSizeSupported, char &currTuningTableSize)
 {
-	char cmdMsgBuffer[7];
-	char respMsgBuffer[25];
-	SET_MESSAGE_TYPE(cmdMsgBuffer, CMD_TUNER_TABLE);
-	SET_MESSAGE_LENGTH(cmdMsgBuffer, 7);
-	SET_MESSAGE_CRC(cmdMsgBuffer, 0);
-	SET_MESSAGE_STATUS(cmdMsgBuffer, 0);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 6, 0x00); 
-	unsigned short crc = calculateCRC(cmdMsgBuffer, 7);
-	SET_MESSAGE_CRC(cmdMsgBuffer, crc);
-	uart->flush();
-	uart->sendMessage(&cmdMsgBuffer[0], 7);
-	short count = 0;
-	QTime timer;
-	unsigned short msgLength = 3;
-	timer.start();
-	do
-	{
-		if(uart->receiveMessage(&respMsgBuffer[count], 1) > 0)
-		{
-			count++;
-			if(count == 3)
-			{
-				msgLength = GET_MESSAGE_LENGTH(respMsgBuffer);		
-			}
-			timer.restart();
-		}
-	}while ((count < msgLength) && (timer.elapsed() < WAIT_FOR_RESPONSE_TIME));
-	if(count != msgLength)
-		return TIMEOUT_ERROR;
-	unsigned short msgCRC  = GET_MESSAGE_CRC(respMsgBuffer);
-	SET_MESSAGE_CRC(respMsgBuffer, 0);
-	unsigned short calculatedCRC = calculateCRC(respMsgBuffer, msgLength);
-	if(msgCRC != calculatedCRC)
-		return CRC_ERROR;
-	maxTuningTableSizeSupported = respMsgBuffer[7];
-	currTuningTableSize = respMsgBuffer[8];
-	char msgStatus  = GET_MESSAGE_STATUS(respMsgBuffer);
-	return msgStatus;
+	beginRequest(CMDID_TUNER_TABLE_SIZE);
+	ReplyView reply;
+	short msgLength = transact(reply);
+	if(msgLength <= 0)
+		return msgLength;
+	maxTuningTableSizeSupported = reply.byte(1);
+	currTuningTableSize = reply.byte(2);
+	return reply.status();
 }
 short AMSRadonReader::deleteCurrentTuningTable(char &maxTuningTableSizeSupported)
 {
-	char cmdMsgBuffer[7];
-	char respMsgBuffer[25];
-	SET_MESSAGE_TYPE(cmdMsgBuffer, CMD_TUNER_TABLE);
-	SET_MESSAGE_LENGTH(cmdMsgBuffer, 7);
-	SET_MESSAGE_CRC(cmdMsgBuffer, 0);
-	SET_MESSAGE_STATUS(cmdMsgBuffer, 0);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 6, 0x01); 
-	unsigned short crc = calculateCRC(cmdMsgBuffer, 7);
-	SET_MESSAGE_CRC(cmdMsgBuffer, crc);
-	uart->flush();
-	uart->sendMessage(&cmdMsgBuffer[0], 7);
-	short count = 0;
-	QTime timer;
-	unsigned short msgLength = 3;
-	timer.start();
-	do
-	{
-		if(uart->receiveMessage(&respMsgBuffer[count], 1) > 0)
-		{
-			count++;
-			if(count == 3)
-			{
-				msgLength = GET_MESSAGE_LENGTH(respMsgBuffer);		
-			}
-			timer.restart();
-		}
-	}while ((count < msgLength) && (timer.elapsed() < WAIT_FOR_RESPONSE_TIME));
-	if(count != msgLength)
-		return TIMEOUT_ERROR;
-	unsigned short msgCRC  = GET_MESSAGE_CRC(respMsgBuffer);
-	SET_MESSAGE_CRC(respMsgBuffer, 0);
-	unsigned short calculatedCRC = calculateCRC(respMsgBuffer, msgLength);
-	if(msgCRC != calculatedCRC)
-		return CRC_ERROR;
-	maxTuningTableSizeSupported = respMsgBuffer[7];
-	char msgStatus  = GET_MESSAGE_STATUS(respMsgBuffer);
-	return msgStatus;
+	beginRequest(CMDID_TUNER_TABLE_DELETE);
+	ReplyView reply;
+	short msgLength = transact(reply);
+	if(msgLength <= 0)
+		return msgLength;
+	maxTuningTableSizeSupported = reply.byte(1);
+	return reply.status();
 }
 short AMSRadonReader::addToTuningTable(int freq, 
 		char ant1TuneEnable, 
@@ -2085,288 +1385,213 @@ short AMSRadonReader::addToTuningTable(int freq,
 		char ant2TuneEnable,
 		char ant2Cin,
 		char ant2Clen,
-		char ant2Cout,
-		short ant2I_Q,
-		char &remainingSizeInTuningTable)
-{
-	char cmdMsgBuffer[22];
-	char respMsgBuffer[25];
-	SET_MESSAGE_TYPE(cmdMsgBuffer, CMD_TUNER_TABLE);
-	SET_MESSAGE_LENGTH(cmdMsgBuffer, 22);
-	SET_MESSAGE_CRC(cmdMsgBuffer, 0);
-	SET_MESSAGE_STATUS(cmdMsgBuffer, 0);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 6, 0x02); 
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 7, freq & 0xFF); 
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 8, (freq >> 8) & 0xFF);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 9, (freq >> 16) & 0xFF); 
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 10, ant1TuneEnable); 
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 11, ant1Cin);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 12, ant1Clen); 
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 13, ant1Cout); 
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 14, ant1I_Q & 0xFF);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 15, (ant1I_Q >> 8) & 0xFF); 
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 16, ant2TuneEnable); 
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 17, ant2Cin);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 18, ant2Clen); 
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 19, ant2Cout); 
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 20, ant2I_Q & 0xFF);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 21, (ant2I_Q >> 8) & 0xFF);
-	unsigned short crc = calculateCRC(cmdMsgBuffer, 22);
-	SET_MESSAGE_CRC(cmdMsgBuffer, crc);
-	uart->flush();
-	uart->sendMessage(&cmdMsgBuffer[0], 22);
-	short count = 0;
-	QTime timer;
-	unsigned short msgLength = 3;
-	timer.start();
-	do
-	{
-		if(uart->receiveMessage(&respMsgBuffer[count], 1) > 0)
-		{
-			count++;
-			if(count == 3)
-			{
-				msgLength = GET_MESSAGE_LENGTH(respMsgBuffer);		
-			}
-			timer.restart();
-		}
-	}while ((count < msgLength) && (timer.elapsed() < WAIT_FOR_RESPONSE_TIME));
-	if(count != msgLength)
-		return TIMEOUT_ERROR;
-	unsigned short msgCRC  = GET_MESSAGE_CRC(respMsgBuffer);
-	SET_MESSAGE_CRC(respMsgBuffer, 0);
-	unsigned short calculatedCRC = calculateCRC(respMsgBuffer, msgLength);
-	if(msgCRC != calculatedCRC)
-		return CRC_ERROR;
-	remainingSizeInTuningTable = respMsgBuffer[7];
-	char msgStatus  = GET_MESSAGE_STATUS(respMsgBuffer);
-	return msgStatus;
+		char ant2Cout,
+		short ant2I_Q,
+		char &remainingSizeInTuningTable)
+{
+	char *payload = beginRequest(CMDID_TUNER_TABLE_ADD);
+	payload[1] = freq & 0xFF;
+	payload[2] = (freq >> 8) & 0xFF;
+	payload[3] = (freq >> 16) & 0xFF;
+	payload[4] = ant1TuneEnable;
+	payload[5] = ant1Cin;
+	payload[6] = ant1Clen;
+	payload[7] = ant1Cout;
+	payload[8] = ant1I_Q & 0xFF;
+	payload[9] = (ant1I_Q >> 8) & 0xFF;
+	payload[10] = ant2TuneEnable;
+	payload[11] = ant2Cin;
+	payload[12] = ant2Clen;
+	payload[13] = ant2Cout;
+	payload[14] = ant2I_Q & 0xFF;
+	payload[15] = (ant2I_Q >> 8) & 0xFF;
+	ReplyView reply;
+	short msgLength = transact(reply);
+	if(msgLength <= 0)
+		return msgLength;
+	remainingSizeInTuningTable = reply.byte(1);
+	return reply.status();
 }
 short AMSRadonReader::performAutoTuning(char autoTune)
 {
-	char cmdMsgBuffer[7];
-	char respMsgBuffer[25];
-	SET_MESSAGE_TYPE(cmdMsgBuffer, CMD_AUTO_TUNER);
-	SET_MESSAGE_LENGTH(cmdMsgBuffer, 7);
-	SET_MESSAGE_CRC(cmdMsgBuffer, 0);
-	SET_MESSAGE_STATUS(cmdMsgBuffer, 0);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 6, autoTune);
-	unsigned short crc = calculateCRC(cmdMsgBuffer, 7);
-	SET_MESSAGE_CRC(cmdMsgBuffer, crc);
-	uart->flush();
-	uart->sendMessage(&cmdMsgBuffer[0], 7);
-	short waitTimeForResponse;
-	if(autoTune == 0x02)
-		waitTimeForResponse = WAIT_FOR_AUTOTUNE_2_RESPONSE_TIME;  //wait more than 3 seconds for tuning to finish
-	else
-		waitTimeForResponse = WAIT_FOR_AUTOTUNE_1_RESPONSE_TIME;
-	short count = 0;
-	QTime timer;
-	unsigned short msgLength = 3;
-	timer.start();
-	do
+	//autoTune = 0x02 takes more than 3 seconds to finish
+	char *payload = beginRequest(autoTune == 0x02 ? CMDID_AUTO_TUNE_DEEP : CMDID_AUTO_TUNE);
+	payload[0] = autoTune;
+	return transact();
+}
+// Replaces the hop list with freqs and lets the reader tune the antenna for
+// every channel of it, which takes one request instead of several per
+// channel. The reader pushes a frame after each tuned channel, reported to
+// progress, and finally the whole tuning table. autoTune selects the
+// algorithm as for performAutoTuning(); 0x01 goes on with the deep search
+// where the reflected power stays high. Returns ERR_REQUEST if the firmware
+// can not set up a band, the caller then tunes channel by channel.
+short AMSRadonReader::tuneBand(const int *freqs, int numFreqs, char autoTune, char profileID, vector<TuningTableEntry> &tuningTable,
+		TuningProgressCallback progress, void *context)
+{
+	tuningTable.clear();
+	if(pipelineDepth > 1 || streamRunning)
+		return ERR_BUSY;
+	if(numFreqs <= 0 || TUNE_BAND_HEADER_SIZE + 2 * numFreqs > TX_FRAME_BUFFER_SIZE - UART_FRAME_HEADER_SIZE)
+		return ERR_PARAM;
+	int baseFreq = freqs[0];
+	for(int i = 1; i < numFreqs; i++)
+		if(freqs[i] < baseFreq)
+			baseFreq = freqs[i];
+	char *payload = beginRequest(CMDID_TUNER_TABLE_TUNE_BAND, TUNE_BAND_HEADER_SIZE + 2 * numFreqs);
+	payload[1] = autoTune;
+	payload[2] = profileID;
+	payload[3] = baseFreq & 0xFF;
+	payload[4] = baseFreq >> 8 & 0xFF;
+	payload[5] = baseFreq >> 16 & 0xFF;
+	for(int i = 0; i < numFreqs; i++)
 	{
-		if(uart->receiveMessage(&respMsgBuffer[count], 1) > 0)
-		{
-			count++;
-			if(count == 3)
-			{
-				msgLength = GET_MESSAGE_LENGTH(respMsgBuffer);		
-			}
-			timer.restart();
-		}
-	}while ((count < msgLength) && (timer.elapsed() < waitTimeForResponse));
-	if(count != msgLength)
-		return TIMEOUT_ERROR;
-	unsigned short msgCRC  = GET_MESSAGE_CRC(respMsgBuffer);
-	SET_MESSAGE_CRC(respMsgBuffer, 0);
-	unsigned short calculatedCRC = calculateCRC(respMsgBuffer, msgLength);
-	if(msgCRC != calculatedCRC)
-		return CRC_ERROR;
-	char msgStatus  = GET_MESSAGE_STATUS(respMsgBuffer);
-	return msgStatus;
+		int offset = freqs[i] - baseFreq;
+		if(offset > 0xFFFF)
+			return ERR_PARAM;
+		payload[TUNE_BAND_HEADER_SIZE + 2 * i] = offset & 0xFF;
+		payload[TUNE_BAND_HEADER_SIZE + 2 * i + 1] = offset >> 8 & 0xFF;
+	}
+	ReplyView reply;
+	short msgLength = transact(reply);
+	if(msgLength <= 0)
+		return msgLength;
+	if(reply.byte(0) != TUNER_TABLE_TUNE_BAND)
+		return ERR_REQUEST;		// firmware without band setup
+	if(reply.status() != 0)
+		return reply.status();
+	int totalChannels = reply.u8(2);
+	if(autoTune == 0 || totalChannels == 0)
+		return reply.status();		// only the frequency list was replaced
+	while(true)
+	{
+		msgLength = receiveResponse(rxFrame, sizeof(rxFrame), WAIT_FOR_BAND_TUNING_CHANNEL_TIME);
+		if(msgLength <= 0)
+			return msgLength;
+		if((unsigned char)GET_MESSAGE_TYPE(rxFrame) != CMD_TUNER_TABLE_RESP)
+			return ERR_PROTO;
+		reply.attach(rxFrame, msgLength);
+		if(reply.byte(0) == TUNER_TABLE_DUMP)
+			break;
+		if(reply.byte(0) != TUNER_TABLE_PROGRESS)
+			return ERR_PROTO;
+		if(progress)
+			progress(context, reply.u8(1), reply.u8(2));
+	}
+	decodeTuningTable(reply, tuningTable);
+	if(progress)
+		progress(context, totalChannels, totalChannels);
+	return reply.status();
+}
+// Reads the tuning table entries of the antenna in use.
+short AMSRadonReader::getTuningTable(vector<TuningTableEntry> &tuningTable)
+{
+	tuningTable.clear();
+	beginRequest(CMDID_TUNER_TABLE_DUMP);
+	ReplyView reply;
+	short msgLength = transact(reply);
+	if(msgLength <= 0)
+		return msgLength;
+	if(reply.byte(0) != TUNER_TABLE_DUMP)
+		return ERR_REQUEST;		// firmware without table dump
+	decodeTuningTable(reply, tuningTable);
+	return reply.status();
+}
+// Keeps the tuning table, hop frequencies, Gen2 settings and antenna of the
+// reader in its flash. After a reset or power cycle the reader starts with
+// them instead of its defaults, so the band does not have to be sent and
+// tuned again.
+short AMSRadonReader::storeSettings(char &storedTuningTableSize)
+{
+	beginRequest(CMDID_TUNER_TABLE_COMMIT);
+	ReplyView reply;
+	short msgLength = transact(reply);
+	if(msgLength <= 0)
+		return msgLength;
+	if(reply.byte(0) != TUNER_TABLE_COMMIT)
+		return ERR_REQUEST;		// firmware without settings store
+	storedTuningTableSize = reply.byte(2);
+	return reply.status();
+}
+// Makes the reader start with its defaults again after the next reset.
+short AMSRadonReader::forgetStoredSettings()
+{
+	beginRequest(CMDID_TUNER_TABLE_INVALIDATE);
+	ReplyView reply;
+	short msgLength = transact(reply);
+	if(msgLength <= 0)
+		return msgLength;
+	if(reply.byte(0) != TUNER_TABLE_INVALIDATE)
+		return ERR_REQUEST;
+	return reply.status();
+}
+// Replaces the tuning table with entries of one antenna saved earlier, e.g.
+// from getTuningTable(). The entries are added pipelined.
+short AMSRadonReader::restoreTuningTable(char antennaID, const vector<TuningTableEntry> &tuningTable)
+{
+	if(pipelineDepth > 1 || streamRunning)
+		return ERR_BUSY;
+	if(antennaID != 1 && antennaID != 2)
+		return ERR_PARAM;
+	char maxTuningTableSize;
+	short status = deleteCurrentTuningTable(maxTuningTableSize);
+	if(status != 0)
+		return status;
+	if(tuningTable.size() > (unsigned char)maxTuningTableSize)
+		return ERR_NOMEM;
+	status = beginPipeline(MAX_PIPELINE_DEPTH);
+	if(status != 0)
+		return status;
+	char remainingSize;
+	for(unsigned int i = 0; i < tuningTable.size(); i++)
+	{
+		const TuningTableEntry &entry = tuningTable[i];
+		if(antennaID == 1)
+			addToTuningTable(entry.freq, 1, entry.cin, entry.clen, entry.cout, entry.IQ, 0, 0, 0, 0, 0, remainingSize);
+		else
+			addToTuningTable(entry.freq, 0, 0, 0, 0, 0, 1, entry.cin, entry.clen, entry.cout, entry.IQ, remainingSize);
+	}
+	return endPipeline();
 }
-short AMSRadonReader::setAntennaCin(char cin, char &storedCin)
+void AMSRadonReader::decodeTuningTable(ReplyView &reply, vector<TuningTableEntry> &tuningTable)
 {
-	char cmdMsgBuffer[12];
-	char respMsgBuffer[25];
-	SET_MESSAGE_TYPE(cmdMsgBuffer, CMD_ANTENNA_TUNER);
-	SET_MESSAGE_LENGTH(cmdMsgBuffer, 12);
-	SET_MESSAGE_CRC(cmdMsgBuffer, 0);
-	SET_MESSAGE_STATUS(cmdMsgBuffer, 0);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 6, 0x01);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 7, cin);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 8, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 9, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 10, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 11, 0x00);
-	unsigned short crc = calculateCRC(cmdMsgBuffer, 12);
-	SET_MESSAGE_CRC(cmdMsgBuffer, crc);
-	uart->flush();
-	uart->sendMessage(&cmdMsgBuffer[0], 12);
-	short count = 0;
-	QTime timer;
-	unsigned short msgLength = 3;
-	timer.start();
-	do
+	TuningTableEntry entry;
+	for(int i = 0; i < reply.u8(2); i++)
 	{
-		if(uart->receiveMessage(&respMsgBuffer[count], 1) > 0)
-		{
-			count++;
-			if(count == 3)
-			{
-				msgLength = GET_MESSAGE_LENGTH(respMsgBuffer);		
-			}
-			timer.restart();
-		}
-	}while ((count < msgLength) && (timer.elapsed() < WAIT_FOR_RESPONSE_TIME));
-	if(count != msgLength)
-		return TIMEOUT_ERROR;
-	unsigned short msgCRC = GET_MESSAGE_CRC(respMsgBuffer);
-	SET_MESSAGE_CRC(respMsgBuffer, 0);
-	unsigned short calculatedCRC = calculateCRC(respMsgBuffer, msgLength);
-	if(msgCRC != calculatedCRC)
-		return CRC_ERROR;
-	storedCin = respMsgBuffer[7];
-	char msgStatus  = GET_MESSAGE_STATUS(respMsgBuffer);
-	return msgStatus;
+		unsigned short index = TUNING_TABLE_DUMP_HEADER_SIZE + i * TUNING_TABLE_ENTRY_SIZE;
+		if(index + TUNING_TABLE_ENTRY_SIZE > reply.payloadLength())
+			break;
+		entry.freq = reply.u24(index);
+		entry.cin = reply.byte(index + 3);
+		entry.clen = reply.byte(index + 4);
+		entry.cout = reply.byte(index + 5);
+		entry.IQ = reply.u16(index + 6);
+		tuningTable.push_back(entry);
+	}
+}
+short AMSRadonReader::setAntennaCin(char cin, char &storedCin)
+{
+	return setPairedSetting(CMDID_ANTENNA_TUNER, TUNER_CIN, cin, storedCin);
 }
 short AMSRadonReader::setAntennaClen(char clen, char &storedClen)
 {
-	char cmdMsgBuffer[12];
-	char respMsgBuffer[25];
-	SET_MESSAGE_TYPE(cmdMsgBuffer, CMD_ANTENNA_TUNER);
-	SET_MESSAGE_LENGTH(cmdMsgBuffer, 12);
-	SET_MESSAGE_CRC(cmdMsgBuffer, 0);
-	SET_MESSAGE_STATUS(cmdMsgBuffer, 0);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 6, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 7, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 8, 0x01);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 9, clen);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 10, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 11, 0x00);
-	unsigned short crc = calculateCRC(cmdMsgBuffer, 12);
-	SET_MESSAGE_CRC(cmdMsgBuffer, crc);
-	uart->flush();
-	uart->sendMessage(&cmdMsgBuffer[0], 12);
-	short count = 0;
-	QTime timer;
-	unsigned short msgLength = 3;
-	timer.start();
-	do
-	{
-		if(uart->receiveMessage(&respMsgBuffer[count], 1) > 0)
-		{
-			count++;
-			if(count == 3)
-			{
-				msgLength = GET_MESSAGE_LENGTH(respMsgBuffer);		
-			}
-			timer.restart();
-		}
-	}while ((count < msgLength) && (timer.elapsed() < WAIT_FOR_RESPONSE_TIME));
-	if(count != msgLength)
-		return TIMEOUT_ERROR;
-	unsigned short msgCRC = GET_MESSAGE_CRC(respMsgBuffer);
-	SET_MESSAGE_CRC(respMsgBuffer, 0);
-	unsigned short calculatedCRC = calculateCRC(respMsgBuffer, msgLength);
-	if(msgCRC != calculatedCRC)
-		return CRC_ERROR;
-	storedClen = respMsgBuffer[9];
-	char msgStatus  = GET_MESSAGE_STATUS(respMsgBuffer);
-	return msgStatus;
+	return setPairedSetting(CMDID_ANTENNA_TUNER, TUNER_CLEN, clen, storedClen);
 }
 short AMSRadonReader::setAntennaCout(char cout, char &storedCout)
 {
-	char cmdMsgBuffer[12];
-	char respMsgBuffer[25];
-	SET_MESSAGE_TYPE(cmdMsgBuffer, CMD_ANTENNA_TUNER);
-	SET_MESSAGE_LENGTH(cmdMsgBuffer, 12);
-	SET_MESSAGE_CRC(cmdMsgBuffer, 0);
-	SET_MESSAGE_STATUS(cmdMsgBuffer, 0);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 6, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 7, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 8, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 9, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 10, 0x01);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 11, cout);
-	unsigned short crc = calculateCRC(cmdMsgBuffer, 12);
-	SET_MESSAGE_CRC(cmdMsgBuffer, crc);
-	uart->flush();
-	uart->sendMessage(&cmdMsgBuffer[0], 12);
-	short count = 0;
-	QTime timer;
-	unsigned short msgLength = 3;
-	timer.start();
-	do
-	{
-		if(uart->receiveMessage(&respMsgBuffer[count], 1) > 0)
-		{
-			count++;
-			if(count == 3)
-			{
-				msgLength = GET_MESSAGE_LENGTH(respMsgBuffer);		
-			}
-			timer.restart();
-		}
-	}while ((count < msgLength) && (timer.elapsed() < WAIT_FOR_RESPONSE_TIME));
-	if(count != msgLength)
-		return TIMEOUT_ERROR;
-	unsigned short msgCRC = GET_MESSAGE_CRC(respMsgBuffer);
-	SET_MESSAGE_CRC(respMsgBuffer, 0);
-	unsigned short calculatedCRC = calculateCRC(respMsgBuffer, msgLength);
-	if(msgCRC != calculatedCRC)
-		return CRC_ERROR;
-	storedCout = respMsgBuffer[11];
-	char msgStatus  = GET_MESSAGE_STATUS(respMsgBuffer);
-	return msgStatus;
+	return setPairedSetting(CMDID_ANTENNA_TUNER, TUNER_COUT, cout, storedCout);
 }
 short AMSRadonReader::getAntennaTunerParams(char &cin, char &clen, char &cout)
 {
-	char cmdMsgBuffer[12];
-	char respMsgBuffer[25];
-	SET_MESSAGE_TYPE(cmdMsgBuffer, CMD_ANTENNA_TUNER);
-	SET_MESSAGE_LENGTH(cmdMsgBuffer, 12);
-	SET_MESSAGE_CRC(cmdMsgBuffer, 0);
-	SET_MESSAGE_STATUS(cmdMsgBuffer, 0);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 6, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 7, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 8, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 9, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 10, 0x00);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 11, 0x00);
-	unsigned short crc = calculateCRC(cmdMsgBuffer, 12);
-	SET_MESSAGE_CRC(cmdMsgBuffer, crc);
-	uart->flush();
-	uart->sendMessage(&cmdMsgBuffer[0], 12);
-	short count = 0;
-	QTime timer;
-	unsigned short msgLength = 3;
-	timer.start();
-	do
-	{
-		if(uart->receiveMessage(&respMsgBuffer[count], 1) > 0)
-		{
-			count++;
-			if(count == 3)
-			{
-				msgLength = GET_MESSAGE_LENGTH(respMsgBuffer);		
-			}
-			timer.restart();
-		}
-	}while ((count < msgLength) && (timer.elapsed() < WAIT_FOR_RESPONSE_TIME));
-	if(count != msgLength)
-		return TIMEOUT_ERROR;
-	unsigned short msgCRC  = GET_MESSAGE_CRC(respMsgBuffer);
-	SET_MESSAGE_CRC(respMsgBuffer, 0);
-	unsigned short calculatedCRC = calculateCRC(respMsgBuffer, msgLength);
-	if(msgCRC != calculatedCRC)
-		return CRC_ERROR;
-	cin = respMsgBuffer[7];
-	clen = respMsgBuffer[9];
-	cout = respMsgBuffer[11];
-	char msgStatus  = GET_MESSAGE_STATUS(respMsgBuffer);
-	return msgStatus;
+	beginRequest(CMDID_ANTENNA_TUNER);
+	ReplyView reply;
+	short msgLength = transact(reply);
+	if(msgLength <= 0)
+		return msgLength;
+	cin = reply.byte(2 * TUNER_CIN + 1);
+	clen = reply.byte(2 * TUNER_CLEN + 1);
+	cout = reply.byte(2 * TUNER_COUT + 1);
+	return reply.status();
 }
 short AMSRadonReader::sendCommand(int password, 
 		short lengthTransmitData, 
@@ -2378,59 +1603,50 @@ short AMSRadonReader::sendCommand(int password,
 		char &dataLength,
 		char *receivedData)
 {
-	short bufferLen = 6 + 9 + lengthTransmitData;
-	char *cmdMsgBuffer = new char[bufferLen];
-	char respMsgBuffer[100];
-	SET_MESSAGE_TYPE(cmdMsgBuffer, CMD_GENERIC_CMD_ID);
-	SET_MESSAGE_LENGTH(cmdMsgBuffer, bufferLen);
-	SET_MESSAGE_CRC(cmdMsgBuffer, 0);
-	SET_MESSAGE_STATUS(cmdMsgBuffer, 0);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 6, password & 0xFF);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 7, (password >> 8) & 0xFF);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 8, (password >> 16) & 0xFF);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 9, lengthTransmitData & 0xFF);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 10, (lengthTransmitData >> 8) & 0xFF);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 11, lengthRecieveData & 0xFF);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 12, (lengthRecieveData >> 8) & 0xFF);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 13, directCommand);
-	SET_MESSAGE_PAYLOAD(cmdMsgBuffer, 14, noResponseTime);
-	unsigned short crc = calculateCRC(cmdMsgBuffer, bufferLen);
-	SET_MESSAGE_CRC(cmdMsgBuffer, crc);
-	for(short i = 0; i < lengthTransmitData; i++)
-		cmdMsgBuffer[15 + i] = transmitData[i];
-	uart->flush();
-	uart->sendMessage(&cmdMsgBuffer[0], bufferLen);
-	short count = 0;
-	QTime timer;
-	unsigned short msgLength = 3;
-	timer.start();
-	do
-	{
-		if(uart->receiveMessage(&respMsgBuffer[count], 1) > 0)
-		{
-			count++;
-			if(count == 3)
-			{
-				msgLength = GET_MESSAGE_LENGTH(respMsgBuffer);		
-			}
-			timer.restart();
-		}
-	}while ((count < msgLength) && (timer.elapsed() < WAIT_FOR_RESPONSE_TIME));
-	if(count != msgLength)
+	char *payload = beginRequest(CMDID_GENERIC, 9 + lengthTransmitData);
+	if(!payload)
+		return ERR_PARAM;
+	payload[0] = password & 0xFF;
+	payload[1] = (password >> 8) & 0xFF;
+	payload[2] = (password >> 16) & 0xFF;
+	payload[3] = lengthTransmitData & 0xFF;
+	payload[4] = (lengthTransmitData >> 8) & 0xFF;
+	payload[5] = lengthRecieveData & 0xFF;
+	payload[6] = (lengthRecieveData >> 8) & 0xFF;
+	payload[7] = directCommand;
+	payload[8] = noResponseTime;
+	memcpy(&payload[9], transmitData, lengthTransmitData);
+	ReplyView reply;
+	short msgLength = transact(reply);
+	if(msgLength <= 0)
+		return msgLength;
+	status = reply.byte(0);
+	dataLength = reply.byte(1);
+	memcpy(receivedData, reply.payload(2), (unsigned char)dataLength);
+	return reply.status();
+}
+short AMSRadonReader::receiveResponse(char *respMsgBuffer, unsigned short bufferSize, int timeout, unsigned char *sequence)
+{
+	int msgLength = uart->receiveFrame(respMsgBuffer, bufferSize, timeout);
+	if(msgLength == 0)
 		return TIMEOUT_ERROR;
+	if(msgLength == UART_FRAME_TOO_LONG)
+		return FRAME_SIZE_ERROR;
+	if(msgLength < 0)
+		return ERR_IO;	// the port failed, a slower rate would not help
 	unsigned short msgCRC  = GET_MESSAGE_CRC(respMsgBuffer);
 	SET_MESSAGE_CRC(respMsgBuffer, 0);
 	unsigned short calculatedCRC = calculateCRC(respMsgBuffer, msgLength);
 	if(msgCRC != calculatedCRC)
 		return CRC_ERROR;
-	status = respMsgBuffer[6];
-	dataLength = respMsgBuffer[7];
-	for(short i = 0; i < dataLength; i++)
-	{
-		receivedData[i] = respMsgBuffer[8 + i];
+	if((unsigned char)GET_MESSAGE_TYPE(respMsgBuffer) & SEQUENCE_FLAG)
+	{	// tagged reply: drop the sequence trailer, callers see the plain frame
+		msgLength -= SEQUENCE_SIZE;
+		if(sequence)
+			*sequence = respMsgBuffer[msgLength];
+		SET_MESSAGE_TYPE(respMsgBuffer, GET_MESSAGE_TYPE(respMsgBuffer) & ~SEQUENCE_FLAG);
 	}
-	char msgStatus  = GET_MESSAGE_STATUS(respMsgBuffer);
-	return msgStatus;
+	return msgLength;
 }
 unsigned short AMSRadonReader::calculateCRC(const void *buf, unsigned short len)
 {
@@ -2441,101 +1657,118 @@ unsigned short AMSRadonReader::calculateCRC(const void *buf, unsigned short len)
 		crc = (crc << 8) ^ crc16OffsetTable[((crc >> 8) ^ *sbuf++) & 0x00FF];
 	return crc;
 }
+ReplyView::ReplyView()
+{
+	frame = 0;
+	length = 0;
+}
+void ReplyView::attach(char *frame, unsigned short length)
+{
+	this->frame = frame;
+	this->length = length;
+}
+char ReplyView::status()
+{
+	return GET_MESSAGE_STATUS(frame);
+}
+unsigned short ReplyView::payloadLength()
+{
+	return length > UART_FRAME_HEADER_SIZE ? length - UART_FRAME_HEADER_SIZE : 0;
+}
+char *ReplyView::payload(unsigned short index)
+{
+	return &frame[UART_FRAME_HEADER_SIZE + index];
+}
+char ReplyView::byte(unsigned short index)
+{
+	return index < payloadLength() ? frame[UART_FRAME_HEADER_SIZE + index] : 0;
+}
+unsigned char ReplyView::u8(unsigned short index)
+{
+	return byte(index);
+}
+unsigned short ReplyView::u16(unsigned short index)
+{
+	return u8(index) | u8(index + 1) << 8;
+}
+unsigned int ReplyView::u24(unsigned short index)
+{
+	return u8(index) | u8(index + 1) << 8 | u8(index + 2) << 16;
+}
+// Writes length bytes as lower case hex digits followed by a terminating 0.
+static void toHex(const unsigned char *bytes, unsigned short length, char *hex)
+{
+	static const char digits[] = "0123456789abcdef";
+	for(unsigned short c = 0; c < length; c++)
+	{
+		*hex++ = digits[bytes[c] >> 4];
+		*hex++ = digits[bytes[c] & 0x0F];
+	}
+	*hex = 0;
+}
 TagData::TagData()
 {
 	clear();	
 }
 void TagData::clear()
 {
-	readerAGC = 0;
-	readerRSSI = 0;
-	commFrequency = 0;
-	EPCLength = 0;
-	EPC = "";
-	PC = 0;
-	TIDLength = 0;
-	TID = "";
-	tempCalibrationParams = "";
-	MMS = 0;
-	VFC = 0;
-	TEMP = 0;
+	memset(this, 0, sizeof(*this));
 }
 void TagData::setReaderAGC(char readerAGC)
 {
-	this->readerAGC = readerAGC;
+	this->readerAGC = (unsigned char)readerAGC;
 }
 void TagData::setReaderRSSI(char readerRSSI)
 {
-	this->readerRSSI = readerRSSI;	
+	this->readerRSSI = (unsigned char)readerRSSI;	
 }
-void TagData::setCommFrequency(char *commFrequency)
+void TagData::setCommFrequency(const char *commFrequency)
 {
-	this->commFrequency = 0;
-	this->commFrequency += commFrequency[0];
-	this->commFrequency += commFrequency[1] << 8;
-	this->commFrequency += commFrequency[2] << 16;
+	const unsigned char *bytes = (const unsigned char *)commFrequency;
+	this->commFrequency = bytes[0] | bytes[1] << 8 | bytes[2] << 16;
 }
-void TagData::setEPCAndEPCLength(char *EPC, char EPCLength)
+// EPCs longer than TAG_EPC_MAX_SIZE are truncated.
+void TagData::setEPCAndEPCLength(const char *EPC, char EPCLength)
 {
-	this->EPCLength = EPCLength;
-	if(EPCLength > 0)
-	{
-		this->EPC  = "0x";
-		char EPCChar[3];
-		for(int c = 0; c < EPCLength; c++)
-		{
-			sprintf(EPCChar, "%02x", EPC[c]);
-			this->EPC += EPCChar;
-		}
-	}
+	unsigned char length = EPCLength;
+	if(length > TAG_EPC_MAX_SIZE)
+		length = TAG_EPC_MAX_SIZE;
+	this->EPCLength = length;
+	memcpy(this->EPC, EPC, length);
 }
-void TagData::setPC(char *PC)
+void TagData::setPC(const char *PC)
 {
-	this->PC = 0;
-	this->PC += PC[0];
-	this->PC += PC[1] << 8;
+	const unsigned char *bytes = (const unsigned char *)PC;
+	this->PC = bytes[0] | bytes[1] << 8;
 }
-void TagData::setTIDAndTIDLength(char *TID, char TIDLength)
+// TIDs longer than TAG_TID_MAX_SIZE are truncated.
+void TagData::setTIDAndTIDLength(const char *TID, char TIDLength)
 {
-	this->TIDLength = TIDLength;
-	if(TIDLength > 0)
-	{
-		this->TID  = "0x";
-		char TIDChar[3];
-		for(int c = 0; c < TIDLength; c++)
-		{
-			sprintf(TIDChar, "%02x", TID[c]);
-			this->TID += TIDChar;
-		}
-	}
+	unsigned char length = TIDLength;
+	if(length > TAG_TID_MAX_SIZE)
+		length = TAG_TID_MAX_SIZE;
+	this->TIDLength = length;
+	memcpy(this->TID, TID, length);
 }
-void TagData::setTempCalibrationParams(char *tempCalibrationParams)
+void TagData::setTempCalibrationParams(const char *tempCalibrationParams)
 {
-	this->tempCalibrationParams  = "0x";
-	char CalChar[3];
-	for(int c = 0; c < 8; c++)
-	{
-		sprintf(CalChar, "%02x", tempCalibrationParams[c]);
-		this->tempCalibrationParams += CalChar;
-	}	
+	tempCalibrationLength = TAG_CALIBRATION_SIZE;
+	memcpy(this->tempCalibrationParams, tempCalibrationParams, TAG_CALIBRATION_SIZE);
 }
-void TagData::setMMS(char *MMS)
+void TagData::setMMS(const char *MMS)
 {
-	this->MMS = 0;
-	this->MMS += MMS[1];
-	this->MMS += MMS[0] << 8;
+	const unsigned char *bytes = (const unsigned char *)MMS;
+	this->MMS = bytes[0] << 8 | bytes[1];
 }
-void TagData::setVFC(char *VFC)
+void TagData::setVFC(const char *VFC)
 {
-	this->VFC = 0;
-	this->VFC += VFC[1];
-	this->VFC += VFC[0] << 8;
+	const unsigned char *bytes = (const unsigned char *)VFC;
+	this->VFC = bytes[0] << 8 | bytes[1];
 }
-void TagData::setTEMP(char *TEMP)
+void TagData::setTEMP(const char *TEMP)
 {
-	this->TEMP = 0;
-	this->TEMP += TEMP[1];
-	this->TEMP += TEMP[0] << 8;
+	const unsigned char *bytes = (const unsigned char *)TEMP;
+	this->TEMP = bytes[0] << 8 | bytes[1];
 }
 unsigned short TagData::getReaderAGC()
 {
@@ -2553,10 +1786,15 @@ unsigned short TagData::getEPCLength()
 {
 	return EPCLength;
 }
-string TagData::getEPC()
+const unsigned char *TagData::getEPC()
 {
 	return EPC;
 }
+// hex must hold TAG_EPC_HEX_SIZE characters.
+void TagData::getEPCHex(char *hex)
+{
+	toHex(EPC, EPCLength, hex);
+}
 unsigned short TagData::getPC()
 {
 	return PC;
@@ -2565,13 +1803,24 @@ unsigned short TagData::getTIDLength()
 {
 	return TIDLength;
 }
-string TagData::getTID()
+const unsigned char *TagData::getTID()
 {
 	return TID;
 }
-string TagData::getTempCalibrationParams()
+// hex must hold TAG_TID_HEX_SIZE characters.
+void TagData::getTIDHex(char *hex)
 {
-	return tempCalibrationParams;
+	toHex(TID, TIDLength, hex);
+}
+// 0 if the inventory round did not read the calibration words.
+unsigned short TagData::getTempCalibrationLength()
+{
+	return tempCalibrationLength;
+}
+// Calibration word 0..3, big endian as stored in user memory 8..11.
+unsigned short TagData::getTempCalibrationWord(int index)
+{
+	return tempCalibrationParams[2 * index] << 8 | tempCalibrationParams[2 * index + 1];
 }
 unsigned short TagData::getMMS()
 {
@@ -2585,3 +1834,539 @@ unsigned short TagData::getTEMP()
 {
 	return TEMP;
 }
+void TagData::setReaderIndex(unsigned char readerIndex)
+{
+	this->readerIndex = readerIndex;
+}
+unsigned char TagData::getReaderIndex()
+{
+	return readerIndex;
+}
+TagStreamQueue::TagStreamQueue()
+{
+	reset();
+}
+// Only call while no thread pushes or pops.
+void TagStreamQueue::reset()
+{
+	head = 0;
+	tail = 0;
+	overflows = 0;
+}
+bool TagStreamQueue::push(const TagData &tag)
+{
+	if(tail - head >= TAG_STREAM_QUEUE_SIZE)
+	{
+		overflows++;
+		return false;
+	}
+	slots[tail & (TAG_STREAM_QUEUE_SIZE - 1)] = tag;
+	__sync_synchronize();	// publish the slot before the new tail
+	tail++;
+	return true;
+}
+bool TagStreamQueue::pop(TagData &tag)
+{
+	if(head == tail)
+		return false;
+	__sync_synchronize();	// read the slot only after seeing the tail
+	tag = slots[head & (TAG_STREAM_QUEUE_SIZE - 1)];
+	__sync_synchronize();	// finish reading before the producer may reuse the slot
+	head++;
+	return true;
+}
+unsigned int TagStreamQueue::getOverflowCount()
+{
+	return overflows;
+}
+TuningCache::TuningCache(const string &path)
+	: path(path)
+{
+}
+// Line breaks in the firmware information would break the file format.
+static string tuningCacheReaderID(const string &firmwareInfo)
+{
+	string readerID = firmwareInfo;
+	for(unsigned int i = 0; i < readerID.size(); i++)
+		if(readerID[i] == '\n' || readerID[i] == '\r')
+			readerID[i] = ' ';
+	return readerID;
+}
+TuningCache::Record *TuningCache::find(int band, char antennaID, const string &firmwareInfo)
+{
+	string readerID = tuningCacheReaderID(firmwareInfo);
+	for(unsigned int i = 0; i < records.size(); i++)
+		if(records[i].band == band && records[i].antennaID == antennaID && records[i].readerID == readerID)
+			return &records[i];
+	return 0;
+}
+// Reads the cache file. A missing or damaged file leaves the cache empty.
+bool TuningCache::load()
+{
+	records.clear();
+	FILE *file = fopen(path.c_str(), "r");
+	if(!file)
+		return false;
+	char line[512];
+	bool valid = fgets(line, sizeof(line), file) && strcmp(line, TUNING_CACHE_MAGIC "\n") == 0;
+	while(valid && fgets(line, sizeof(line), file))
+	{
+		Record record;
+		int antennaID, count, idOffset;
+		if(sscanf(line, "%d %d %d %n", &record.band, &antennaID, &count, &idOffset) != 3 || count < 0)
+		{
+			valid = false;
+			break;
+		}
+		record.antennaID = antennaID;
+		record.readerID = line + idOffset;
+		if(!record.readerID.empty() && record.readerID[record.readerID.size() - 1] == '\n')
+			record.readerID.erase(record.readerID.size() - 1);
+		for(int i = 0; valid && i < count; i++)
+		{
+			TuningTableEntry entry;
+			int cin, clen, cout, IQ;
+			valid = fgets(line, sizeof(line), file)
+					&& sscanf(line, "%d %d %d %d %d", &entry.freq, &cin, &clen, &cout, &IQ) == 5;
+			entry.cin = cin;
+			entry.clen = clen;
+			entry.cout = cout;
+			entry.IQ = IQ;
+			record.tuningTable.push_back(entry);
+		}
+		records.push_back(record);
+	}
+	fclose(file);
+	if(!valid)
+		records.clear();
+	return valid;
+}
+// Writes the cache to a temporary file first so an interrupted save never
+// leaves a truncated cache behind.
+bool TuningCache::save()
+{
+	string tmpPath = path + ".tmp";
+	FILE *file = fopen(tmpPath.c_str(), "w");
+	if(!file)
+		return false;
+	fprintf(file, TUNING_CACHE_MAGIC "\n");
+	for(unsigned int i = 0; i < records.size(); i++)
+	{
+		const Record &record = records[i];
+		fprintf(file, "%d %d %u %s\n", record.band, record.antennaID, (unsigned int)record.tuningTable.size(), record.readerID.c_str());
+		for(unsigned int j = 0; j < record.tuningTable.size(); j++)
+		{
+			const TuningTableEntry &entry = record.tuningTable[j];
+			fprintf(file, "%d %d %d %d %d\n", entry.freq, (unsigned char)entry.cin, (unsigned char)entry.clen,
+					(unsigned char)entry.cout, entry.IQ);
+		}
+	}
+	bool written = !ferror(file);
+	if(fclose(file) != 0 || !written || rename(tmpPath.c_str(), path.c_str()) != 0)
+	{
+		remove(tmpPath.c_str());
+		return false;
+	}
+	return true;
+}
+bool TuningCache::lookup(int band, char antennaID, const string &readerID, vector<TuningTableEntry> &tuningTable)
+{
+	Record *record = find(band, antennaID, readerID);
+	if(!record || record->tuningTable.empty())
+		return false;
+	tuningTable = record->tuningTable;
+	return true;
+}
+// Replaces the table for band and antenna of this reader.
+void TuningCache::store(int band, char antennaID, const string &readerID, const vector<TuningTableEntry> &tuningTable)
+{
+	Record *record = find(band, antennaID, readerID);
+	if(!record)
+	{
+		records.push_back(Record());
+		record = &records.back();
+		record->band = band;
+		record->antennaID = antennaID;
+		record->readerID = tuningCacheReaderID(readerID);
+	}
+	record->tuningTable = tuningTable;
+}
+ReaderOperation::ReaderOperation()
+{
+	pthread_mutex_init(&lock, NULL);
+	pthread_cond_init(&finished, NULL);
+	state = OPERATION_IDLE;
+	cancelRequested = false;
+	status = ERR_NONE;
+	completion = 0;
+	completionContext = 0;
+}
+ReaderOperation::~ReaderOperation()
+{
+	pthread_cond_destroy(&finished);
+	pthread_mutex_destroy(&lock);
+}
+void ReaderOperation::setCompletion(ReaderCompletion completion, void *context)
+{
+	this->completion = completion;
+	completionContext = context;
+}
+// Waiters are released first and the completion runs last, nothing of the
+// operation is touched after it, so the completion may delete it.
+void ReaderOperation::finish(ReaderOperationState finalState, short result)
+{
+	ReaderCompletion done = completion;
+	void *context = completionContext;
+	pthread_mutex_lock(&lock);
+	status = result;
+	state = finalState;
+	pthread_cond_broadcast(&finished);
+	pthread_mutex_unlock(&lock);
+	if(done)
+		done(context, this);
+}
+// Set once AsyncReader::cancel() was called while the operation ran. Commands
+// already sent can not be taken back, but run() may skip the ones left.
+bool ReaderOperation::isCancelRequested()
+{
+	pthread_mutex_lock(&lock);
+	bool requested = cancelRequested;
+	pthread_mutex_unlock(&lock);
+	return requested;
+}
+// Called with the lock of the AsyncReader held, which keeps the operation
+// alive: it is still the current one, so finish() has not been called yet.
+void ReaderOperation::requestCancel()
+{
+	pthread_mutex_lock(&lock);
+	cancelRequested = true;
+	pthread_mutex_unlock(&lock);
+}
+ReaderOperationState ReaderOperation::getState()
+{
+	pthread_mutex_lock(&lock);
+	ReaderOperationState current = state;
+	pthread_mutex_unlock(&lock);
+	return current;
+}
+// Waits up to timeout ms, or without limit if timeout is negative. Returns
+// false if the operation is still queued or running.
+bool ReaderOperation::wait(int timeout)
+{
+	struct timespec deadline;
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec += timeout / 1000;
+	deadline.tv_nsec += (timeout % 1000) * 1000000L;
+	if(deadline.tv_nsec >= 1000000000L)
+	{
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000L;
+	}
+	pthread_mutex_lock(&lock);
+	while(state == OPERATION_QUEUED || state == OPERATION_RUNNING)
+	{
+		if(timeout < 0)
+			pthread_cond_wait(&finished, &lock);
+		else if(pthread_cond_timedwait(&finished, &lock, &deadline) != 0)
+			break;
+	}
+	bool done = state != OPERATION_QUEUED && state != OPERATION_RUNNING;
+	pthread_mutex_unlock(&lock);
+	return done;
+}
+short ReaderOperation::getStatus()
+{
+	pthread_mutex_lock(&lock);
+	short result = status;
+	pthread_mutex_unlock(&lock);
+	return result;
+}
+InventoryOperation::InventoryOperation(int rounds, char tidAndFast, char rssi)
+	: rounds(rounds), tidAndFast(tidAndFast), rssi(rssi)
+{
+}
+short InventoryOperation::run(AMSRadonReader *reader)
+{
+	tags.clear();
+	for(int i = 0; i < rounds && !isCancelRequested(); i++)
+	{
+		char numberOfTagsFound, inventoryResult, inventoryType;
+		short status = reader->performGen2Inventory(0, tidAndFast, rssi);
+		if(status != 0)
+			return status;
+		status = reader->getTagData(tags, inventoryType, inventoryResult, numberOfTagsFound);
+		if(status != 0)
+			return status;
+	}
+	return ERR_NONE;
+}
+const vector<TagData> &InventoryOperation::getTags()
+{
+	return tags;
+}
+AutoTuneOperation::AutoTuneOperation(char autoTune)
+	: autoTune(autoTune)
+{
+}
+short AutoTuneOperation::run(AMSRadonReader *reader)
+{
+	return reader->performAutoTuning(autoTune);
+}
+TuneBandOperation::TuneBandOperation(const int *freqs, int numFreqs, char autoTune, char profileID,
+		TuningProgressCallback progress, void *context)
+	: freqs(freqs, freqs + numFreqs), autoTune(autoTune), profileID(profileID), progress(progress), progressContext(context)
+{
+}
+short TuneBandOperation::run(AMSRadonReader *reader)
+{
+	if(freqs.empty())
+		return ERR_PARAM;
+	return reader->tuneBand(&freqs[0], freqs.size(), autoTune, profileID, tuningTable, progress, progressContext);
+}
+const vector<TuningTableEntry> &TuneBandOperation::getTuningTable()
+{
+	return tuningTable;
+}
+AsyncReader::AsyncReader(AMSRadonReader *reader)
+	: reader(reader), current(0), stopping(false)
+{
+	pthread_mutex_init(&lock, NULL);
+	pthread_cond_init(&wakeUp, NULL);
+	ioThreadRunning = pthread_create(&ioThread, NULL, &ioThreadEntry, this) == 0;
+}
+// Cancels what is still queued and waits for the running operation.
+AsyncReader::~AsyncReader()
+{
+	cancelAll();
+	pthread_mutex_lock(&lock);
+	stopping = true;
+	pthread_cond_signal(&wakeUp);
+	pthread_mutex_unlock(&lock);
+	if(ioThreadRunning)
+		pthread_join(ioThread, NULL);
+	pthread_cond_destroy(&wakeUp);
+	pthread_mutex_destroy(&lock);
+}
+short AsyncReader::submit(ReaderOperation *operation)
+{
+	if(!ioThreadRunning)
+		return ERR_NOMEM;
+	ReaderOperationState state = operation->getState();
+	if(state == OPERATION_QUEUED || state == OPERATION_RUNNING)
+		return ERR_BUSY;
+	pthread_mutex_lock(&operation->lock);
+	operation->state = OPERATION_QUEUED;
+	operation->cancelRequested = false;
+	operation->status = ERR_NONE;
+	pthread_mutex_unlock(&operation->lock);
+	pthread_mutex_lock(&lock);
+	queue.push_back(operation);
+	pthread_cond_signal(&wakeUp);
+	pthread_mutex_unlock(&lock);
+	return ERR_NONE;
+}
+// A queued operation is removed and finishes with ERR_CANCELLED, true is
+// returned. A running one is only asked to stop, see isCancelRequested().
+bool AsyncReader::cancel(ReaderOperation *operation)
+{
+	pthread_mutex_lock(&lock);
+	for(deque<ReaderOperation *>::iterator it = queue.begin(); it != queue.end(); ++it)
+	{
+		if(*it == operation)
+		{
+			queue.erase(it);
+			pthread_mutex_unlock(&lock);
+			operation->finish(OPERATION_CANCELLED, ERR_CANCELLED);
+			return true;
+		}
+	}
+	if(current == operation)
+		operation->requestCancel();
+	pthread_mutex_unlock(&lock);
+	return false;
+}
+void AsyncReader::cancelAll()
+{
+	pthread_mutex_lock(&lock);
+	deque<ReaderOperation *> cancelled;
+	cancelled.swap(queue);
+	if(current)
+		current->requestCancel();
+	pthread_mutex_unlock(&lock);
+	for(unsigned int i = 0; i < cancelled.size(); i++)
+		cancelled[i]->finish(OPERATION_CANCELLED, ERR_CANCELLED);
+}
+// True if nothing is queued or running, the reader may then be used directly.
+bool AsyncReader::isIdle()
+{
+	pthread_mutex_lock(&lock);
+	bool idle = queue.empty() && current == 0;
+	pthread_mutex_unlock(&lock);
+	return idle;
+}
+void *AsyncReader::ioThreadEntry(void *asyncReader)
+{
+	((AsyncReader *)asyncReader)->serve();
+	return NULL;
+}
+void AsyncReader::serve()
+{
+	pthread_mutex_lock(&lock);
+	while(true)
+	{
+		while(queue.empty() && !stopping)
+			pthread_cond_wait(&wakeUp, &lock);
+		if(queue.empty())
+			break;
+		current = queue.front();
+		queue.pop_front();
+		pthread_mutex_unlock(&lock);
+		pthread_mutex_lock(&current->lock);
+		current->state = OPERATION_RUNNING;
+		pthread_mutex_unlock(&current->lock);
+		short status = current->run(reader);
+		ReaderOperation *done = current;
+		pthread_mutex_lock(&lock);
+		current = 0;
+		pthread_mutex_unlock(&lock);
+		done->finish(OPERATION_DONE, status);
+		pthread_mutex_lock(&lock);
+	}
+	pthread_mutex_unlock(&lock);
+}
+ReaderPool::~ReaderPool()
+{
+	// the I/O threads go first, they may still be using their reader
+	for(unsigned int i = 0; i < members.size(); i++)
+		delete members[i].asyncReader;
+	for(unsigned int i = 0; i < members.size(); i++)
+		delete members[i].reader;
+}
+// Returns the index of the new reader. The reader still has to be
+// initialized, that can be done through getReader() or an operation.
+int ReaderPool::addReader(const string &uartFileName, int transmitSlot)
+{
+	Member member;
+	member.reader = new AMSRadonReader(uartFileName);
+	member.asyncReader = new AsyncReader(member.reader);
+	member.transmitSlot = transmitSlot;
+	member.uartFileName = uartFileName;
+	members.push_back(member);
+	return members.size() - 1;
+}
+int ReaderPool::size()
+{
+	return members.size();
+}
+AMSRadonReader *ReaderPool::getReader(int index)
+{
+	return members[index].reader;
+}
+AsyncReader *ReaderPool::getAsyncReader(int index)
+{
+	return members[index].asyncReader;
+}
+const string &ReaderPool::getUartFileName(int index)
+{
+	return members[index].uartFileName;
+}
+void ReaderPool::cancelAll()
+{
+	for(unsigned int i = 0; i < members.size(); i++)
+		members[i].asyncReader->cancelAll();
+}
+// Runs operations[i] on reader i, lowest transmit slot first. Readers without
+// an operation (0) are left out. The readers of one slot run in parallel and
+// the next slot starts once all of them are done.
+// Returns the first error, the other operations still run.
+short ReaderPool::runBySlot(vector<ReaderOperation *> &operations)
+{
+	short result = ERR_NONE;
+	bool slotRun = false;
+	int lastSlot = 0;
+	while(true)
+	{
+		bool found = false;
+		int slot = 0;
+		for(unsigned int i = 0; i < members.size(); i++)
+		{
+			if(operations[i] == 0)
+				continue;
+			int candidate = members[i].transmitSlot;
+			if((!slotRun || candidate > lastSlot) && (!found || candidate < slot))
+			{
+				slot = candidate;
+				found = true;
+			}
+		}
+		if(!found)
+			break;
+		vector<ReaderOperation *> submitted;
+		for(unsigned int i = 0; i < members.size(); i++)
+		{
+			if(operations[i] == 0 || members[i].transmitSlot != slot)
+				continue;
+			short status = members[i].asyncReader->submit(operations[i]);
+			if(status == ERR_NONE)
+				submitted.push_back(operations[i]);
+			else if(result == ERR_NONE)
+				result = status;
+		}
+		for(unsigned int i = 0; i < submitted.size(); i++)
+		{
+			submitted[i]->wait(-1);
+			if(result == ERR_NONE)
+				result = submitted[i]->getStatus();
+		}
+		slotRun = true;
+		lastSlot = slot;
+	}
+	return result;
+}
+// The tags of all readers are appended to tags, each marked with the index
+// of the reader that saw it. A tag within reach of several readers is
+// reported by each of them. Tags read before an error are kept.
+short ReaderPool::inventory(int rounds, char tidAndFast, char rssi, vector<TagData> &tags)
+{
+	vector<InventoryOperation *> inventories;
+	vector<ReaderOperation *> operations;
+	for(unsigned int i = 0; i < members.size(); i++)
+	{
+		inventories.push_back(new InventoryOperation(rounds, tidAndFast, rssi));
+		operations.push_back(inventories[i]);
+	}
+	short status = runBySlot(operations);
+	for(unsigned int i = 0; i < inventories.size(); i++)
+	{
+		const vector<TagData> &found = inventories[i]->getTags();
+		for(unsigned int j = 0; j < found.size(); j++)
+		{
+			tags.push_back(found[j]);
+			tags.back().setReaderIndex(i);
+		}
+		delete inventories[i];
+	}
+	return status;
+}
+// Tunes the band on the readers i with selected[i] set, see
+// AMSRadonReader::tuneBand(). tuningTables[i] gets the table of reader i,
+// it stays empty for the others. Tuning transmits too, so it keeps to the
+// slots.
+short ReaderPool::tuneBand(const int *freqs, int numFreqs, char autoTune, char profileID, const vector<bool> &selected,
+		vector< vector<TuningTableEntry> > &tuningTables)
+{
+	vector<TuneBandOperation *> tunings(members.size(), (TuneBandOperation *)0);
+	vector<ReaderOperation *> operations(members.size(), (ReaderOperation *)0);
+	for(unsigned int i = 0; i < members.size(); i++)
+		if(i < selected.size() && selected[i])
+			operations[i] = tunings[i] = new TuneBandOperation(freqs, numFreqs, autoTune, profileID);
+	short status = runBySlot(operations);
+	tuningTables.assign(members.size(), vector<TuningTableEntry>());
+	for(unsigned int i = 0; i < tunings.size(); i++)
+	{
+		if(tunings[i] != 0)
+			tuningTables[i] = tunings[i]->getTuningTable();
+		delete tunings[i];
+	}
+	return status;
+}
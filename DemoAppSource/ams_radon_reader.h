@@ -16,18 +16,225 @@
 #include "uart.h"
 #include <string>
 #include <vector>
+#include <deque>
+#include <pthread.h>
+
+#define MAX_PIPELINE_DEPTH		8
+#define FIRMWARE_RX_BUFFER_SIZE	128		// UART_RX_BUFFER_SIZE of the reader firmware
+#define TX_FRAME_BUFFER_SIZE	FIRMWARE_RX_BUFFER_SIZE
+#define RX_FRAME_BUFFER_SIZE	1100	// PAYLOAD_MAX_SIZE of the reader firmware plus header
+#define TAG_EPC_MAX_SIZE		16		// 128 bit EPC
+#define TAG_TID_MAX_SIZE		12		// 96 bit TID
+#define TAG_CALIBRATION_SIZE	8		// temperature calibration words of a Magnus 3
+#define TAG_EPC_HEX_SIZE		(2 * TAG_EPC_MAX_SIZE + 1)
+#define TAG_TID_HEX_SIZE		(2 * TAG_TID_MAX_SIZE + 1)
+#define TAG_STREAM_QUEUE_SIZE	512		// must be a power of two
+#define TAG_STREAM_POLL_TIME	50		// ms the stream thread waits for a frame before checking for stop
+#define INVENTORY_STREAM_TAGS	0x08	// tidAndFast flag of startTagStream(): the reader pushes every tag as it is singulated
+#define TAG_DATA_ROUND_CONTINUES	0x08	// inventory type flag of a pushed frame: more tags of the round follow
+#define VARIABLE_PAYLOAD		0xFF
+#define NO_SUBCOMMAND			-1
+#define LINK_VERIFY_PINGS		3		// frames that must get through before a negotiated baud rate is kept
+#define AS3993_REGISTER_COUNT	0x40
+#define WRITE_REGS_ENTRY_SIZE	3		// address, mask, value
+#define TRACE_HEADER_SIZE		11		// clock, wrap, lost, count of a trace reply
+#define TRACE_EVENT_SIZE		8		// id, arg8, arg16, time stamp of a traced event
+#define TRACE_MAX_READS			16		// requests readTrace() sends before it leaves a busy reader
+#define PROFILE_MAX_REGISTERS	8
+#define TUNING_TABLE_ENTRY_SIZE	8		// freq, cin, clen, cout, I*I+Q*Q of a dumped tuning table entry
+#define TUNING_CACHE_MAGIC		"HERMES TUNING CACHE 1"
 
 class TagData;
+class TagStreamQueue;
+
+// One entry per request the reader API can issue. Indexes the command
+// descriptor table in ams_radon_reader.cpp, keep both in the same order.
+enum CommandId
+{
+	CMDID_RESET_PIC,
+	CMDID_RESET_AS3993,
+	CMDID_ENTER_BOOTLOADER,
+	CMDID_FW_NUMBER,
+	CMDID_FW_INFORMATION,
+	CMDID_WRITE_REG,
+	CMDID_READ_REG,
+	CMDID_READ_ALL_REGS,
+	CMDID_SET_BAUD_RATE,
+	CMDID_WRITE_REGS,
+	CMDID_READ_TRACE,
+	CMDID_SET_READER_CONFIG,
+	CMDID_GET_READER_CONFIG,
+	CMDID_ANTENNA_POWER,
+	CMDID_REFLECTED_POWER,
+	CMDID_ADD_HOPPING_FREQ,
+	CMDID_GET_FREQ_LIST_PARAMS,
+	CMDID_SET_HOPPING_PARAMS,
+	CMDID_GET_HOPPING_PARAMS,
+	CMDID_CONTINUOUS_MODULATION,
+	CMDID_GEN2_SETTINGS,
+	CMDID_CONFIG_TX_RX,
+	CMDID_INVENTORY_GEN2,
+	CMDID_GET_TAG_DATA,
+	CMDID_SELECT_TAG,
+	CMDID_WRITE_TO_TAG,
+	CMDID_READ_FROM_TAG,
+	CMDID_LOCK_UNLOCK_TAG,
+	CMDID_KILL_TAG,
+	CMDID_START_STOP,
+	CMDID_TUNER_TABLE_SIZE,
+	CMDID_TUNER_TABLE_DELETE,
+	CMDID_TUNER_TABLE_ADD,
+	CMDID_TUNER_TABLE_TUNE_BAND,
+	CMDID_TUNER_TABLE_DUMP,
+	CMDID_TUNER_TABLE_COMMIT,
+	CMDID_TUNER_TABLE_INVALIDATE,
+	CMDID_AUTO_TUNE,
+	CMDID_AUTO_TUNE_DEEP,
+	CMDID_ANTENNA_TUNER,
+	CMDID_GENERIC,
+	NUM_COMMAND_IDS
+};
+
+enum TimeoutClass
+{
+	TIMEOUT_COMMAND,
+	TIMEOUT_INVENTORY,
+	TIMEOUT_TAG_DATA,
+	TIMEOUT_TAG_WRITE,
+	TIMEOUT_AUTOTUNE,
+	TIMEOUT_AUTOTUNE_DEEP,
+	TIMEOUT_FLASH_WRITE,
+	NUM_TIMEOUT_CLASSES
+};
+
+struct CommandDescriptor
+{
+	unsigned char opcode;
+	unsigned char replyOpcode;
+	short subCommand;				// first payload byte, NO_SUBCOMMAND if the opcode has none
+	unsigned char payloadLength;	// including the subcommand, VARIABLE_PAYLOAD if given per request
+	unsigned char timeoutClass;
+};
+
+// Read access to a reply frame in place. Indexes are relative to the start
+// of the payload; bytes past the end of the reply read as 0.
+class ReplyView
+{
+	private:
+		char *frame;
+		unsigned short length;
+	public:
+		ReplyView();
+		void attach(char *frame, unsigned short length);
+		char status();
+		unsigned short payloadLength();
+		char *payload(unsigned short index);
+		char byte(unsigned short index);
+		unsigned char u8(unsigned short index);
+		unsigned short u16(unsigned short index);
+		unsigned int u24(unsigned short index);
+};
+
+struct ProfileRegister
+{
+	char address;
+	char mask;
+	char value;
+};
+
+// Reader state applyReaderProfile() brings the reader to. Gen2 and TX/RX
+// fields take the values of the matching set...() calls; registers are
+// masked changes as for stageAS3993Reg().
+struct ReaderProfile
+{
+	char antennaID;
+	signed char sensitivity;
+	char linkFreq;
+	char coding;
+	char session;
+	char trext;
+	char tari;
+	char qBegin;
+	char sel;
+	char target;
+	ProfileRegister registers[PROFILE_MAX_REGISTERS];
+	int registerCount;
+	char autoTune;			// performAutoTuning() argument, 0 for none
+};
+
+struct TuningTableEntry
+{
+	int freq;
+	char cin;
+	char clen;
+	char cout;
+	unsigned short IQ;		// I*I+Q*Q of the reflected power after tuning
+};
+
+// Called by tuneBand() after each tuned channel.
+typedef void (*TuningProgressCallback)(void *context, int tunedChannels, int totalChannels);
+
+struct PendingRequest
+{
+	unsigned char sequence;
+	unsigned short length;
+	int timeout;
+};
 
 class AMSRadonReader 
 {
 	private:
 		UART *uart;
+		int pipelineDepth;
+		unsigned char nextSequence;
+		unsigned short bytesInFlight;
+		short pipelineStatus;
+		deque<PendingRequest> inFlight;
+		char txFrame[TX_FRAME_BUFFER_SIZE];
+		char rxFrame[RX_FRAME_BUFFER_SIZE];
+		unsigned short txLength;
+		CommandId txCommand;
+		TagStreamQueue *streamQueue;
+		pthread_t streamThread;
+		volatile bool streamRunning;
+		volatile unsigned int streamRounds;
+		volatile unsigned int streamFramesDropped;
+		char streamFrame[RX_FRAME_BUFFER_SIZE];
+		unsigned char regShadow[AS3993_REGISTER_COUNT];
+		bool regShadowValid[AS3993_REGISTER_COUNT];
+		unsigned char regPendingMask[AS3993_REGISTER_COUNT];
+		unsigned char regPendingValue[AS3993_REGISTER_COUNT];
+		short collectPipelinedReply();
+		static void *tagStreamThread(void *reader);
+		void runTagStream();
+		unsigned short decodeTag(ReplyView &reply, unsigned short index, char inventoryType, TagData &tag);
+		short linkFailed(short error);
+		void invalidateAS3993Shadow();
+		short flushAS3993RegsSingly();
+		short writeChangedSettings(CommandId command, const char *current, const char *desired, int fieldCount, int verifiedFields);
+		short restoreDefaultBaudRate();
+		void decodeTuningTable(ReplyView &reply, vector<TuningTableEntry> &tuningTable);
 	protected:
+		char *beginRequest(CommandId command, unsigned short payloadLength = VARIABLE_PAYLOAD);
+		short transact(ReplyView &reply);
+		short transact();
+		short setPairedSetting(CommandId command, unsigned char field, char value, char &storedValue);
+		short exchange(char *cmdMsgBuffer, unsigned short cmdLength, char *respMsgBuffer, unsigned short bufferSize, int timeout);
+		short receiveResponse(char *respMsgBuffer, unsigned short bufferSize, int timeout, unsigned char *sequence = 0);
 		unsigned short calculateCRC(const void *buf, unsigned short len);
 	public:
 		AMSRadonReader(string uartFileName);
 		short initialize();
+		short startRecording(string recordFileName);
+		void stopRecording();
+		short negotiateBaudRate(int maxBaudRate);
+		int getBaudRate();
+		short beginPipeline(int depth);
+		short endPipeline();
+		short startTagStream(char autoAck, char tidAndFast, char rssi);
+		short stopTagStream();
+		bool readStreamedTag(TagData &tag);
+		void getTagStreamCounters(unsigned int &rounds, unsigned int &tagsDropped, unsigned int &framesDropped);
 		short resetPIC();
 		short resetAS3993();
 		short enterBootloader();
@@ -36,6 +243,11 @@ class AMSRadonReader
 		short writeToAS3993Reg(char regAddr, char regValue, char &status);
 		short readAS3993Reg(char regAddr, char *regValue);
 		short readAllAS3993Regs(char *regValues);
+		short loadAS3993Shadow();
+		short readCachedAS3993Reg(char regAddr, char &regValue);
+		void stageAS3993Reg(char regAddr, char mask, char value);
+		short flushAS3993Regs();
+		short readTrace(string &trace);
 		short setReaderConfiguration(char powerMode, char *readerConfig);
 		short getReaderConfiguration(char *readerConfig);
 		short antennaPower(char state, char &status);
@@ -58,6 +270,7 @@ class AMSRadonReader
 		short getAntennaSensitivity(char &sensitivity);
 		short setAntennaID(char antennaID, char &storedAntennaID);
 		short getAntennaID(char &antennaID);
+		short applyReaderProfile(const ReaderProfile &profile, bool &reconfigured);
 		short performGen2Inventory(char autoAck, char tidAndFast, char rssi);
 		short getTagData(vector<TagData> &tags, char &inventoryType, char &inventoryResult, char &numberOfTagsFound);
 		short clearListOfSelectCommands();
@@ -82,6 +295,12 @@ class AMSRadonReader
 				short ant2I_Q,
 				char &remainingSizeInTuningTable);
 		short performAutoTuning(char autoTune);
+		short tuneBand(const int *freqs, int numFreqs, char autoTune, char profileID, vector<TuningTableEntry> &tuningTable,
+				TuningProgressCallback progress = 0, void *context = 0);
+		short getTuningTable(vector<TuningTableEntry> &tuningTable);
+		short restoreTuningTable(char antennaID, const vector<TuningTableEntry> &tuningTable);
+		short storeSettings(char &storedTuningTableSize);
+		short forgetStoredSettings();
 		short setAntennaCin(char cin, char &storedCin);
 		short setAntennaClen(char clen, char &storedClen);
 		short setAntennaCout(char cout, char &storedCout);
@@ -96,45 +315,230 @@ class AMSRadonReader
 				char &dataLength,
 				char *receivedData);
 };
+// One tag record of an inventory round. Plain data with the EPC, TID and
+// calibration bytes stored inline in binary, so records can be decoded into
+// and copied between reused buffers without allocating. Hex strings are
+// only produced on request for display and export.
 class TagData 
 {
 	private:
+		unsigned int commFrequency;
 		unsigned short readerAGC;
 		unsigned short readerRSSI;
-		unsigned int commFrequency;
-		unsigned short EPCLength;
-		string EPC;
 		unsigned short PC;
-		unsigned short TIDLength;
-		string TID;
-		string tempCalibrationParams;
 		unsigned short MMS;
 		unsigned short VFC;
 		unsigned short TEMP;
+		unsigned char readerIndex;	// which reader of a ReaderPool saw the tag
+		unsigned char EPCLength;
+		unsigned char TIDLength;
+		unsigned char tempCalibrationLength;
+		unsigned char EPC[TAG_EPC_MAX_SIZE];
+		unsigned char TID[TAG_TID_MAX_SIZE];
+		unsigned char tempCalibrationParams[TAG_CALIBRATION_SIZE];
 	public:
 		TagData();
 		void clear();
 		void setReaderAGC(char readerAGC);
 		void setReaderRSSI(char readerRSSI);
-		void setCommFrequency(char *commFrequency);
-		void setEPCAndEPCLength(char *EPC, char EPCLength);
-		void setPC(char *PC);
-		void setTIDAndTIDLength(char *TID, char TIDLength);
-		void setTempCalibrationParams(char *tempCalibrationParams);
-		void setMMS(char *MMS);
-		void setVFC(char *VFC);
-		void setTEMP(char *TEMP);
+		void setCommFrequency(const char *commFrequency);
+		void setEPCAndEPCLength(const char *EPC, char EPCLength);
+		void setPC(const char *PC);
+		void setTIDAndTIDLength(const char *TID, char TIDLength);
+		void setTempCalibrationParams(const char *tempCalibrationParams);
+		void setMMS(const char *MMS);
+		void setVFC(const char *VFC);
+		void setTEMP(const char *TEMP);
+		void setReaderIndex(unsigned char readerIndex);
 		unsigned short getReaderAGC();
 		unsigned short getReaderRSSI();
 		unsigned int getCommFrequency();
 		unsigned short getEPCLength();
-		string getEPC();
+		const unsigned char *getEPC();
+		void getEPCHex(char *hex);
 		unsigned short getPC();
 		unsigned short getTIDLength();
-		string getTID();
-		string getTempCalibrationParams();
+		const unsigned char *getTID();
+		void getTIDHex(char *hex);
+		unsigned short getTempCalibrationLength();
+		unsigned short getTempCalibrationWord(int index);
 		unsigned short getMMS();
 		unsigned short getVFC();
 		unsigned short getTEMP();
+		unsigned char getReaderIndex();
+};
+// Single producer, single consumer ring of tags. The stream thread pushes,
+// the application pops; neither side takes a lock. Tags pushed while the
+// ring is full are dropped and counted.
+class TagStreamQueue
+{
+	private:
+		TagData slots[TAG_STREAM_QUEUE_SIZE];
+		volatile unsigned int head;		// advanced by the consumer only
+		volatile unsigned int tail;		// advanced by the producer only
+		volatile unsigned int overflows;
+	public:
+		TagStreamQueue();
+		void reset();
+		bool push(const TagData &tag);
+		bool pop(TagData &tag);
+		unsigned int getOverflowCount();
+};
+// Tuning tables kept on disk across runs. A table is stored per band and
+// antenna together with the firmware information of the reader it was
+// measured on, so it is never restored onto different hardware.
+class TuningCache
+{
+	private:
+		struct Record
+		{
+			int band;
+			char antennaID;
+			string readerID;
+			vector<TuningTableEntry> tuningTable;
+		};
+		string path;
+		vector<Record> records;
+		Record *find(int band, char antennaID, const string &readerID);
+	public:
+		TuningCache(const string &path);
+		bool load();
+		bool save();
+		bool lookup(int band, char antennaID, const string &readerID, vector<TuningTableEntry> &tuningTable);
+		void store(int band, char antennaID, const string &readerID, const vector<TuningTableEntry> &tuningTable);
+};
+enum ReaderOperationState
+{
+	OPERATION_IDLE,
+	OPERATION_QUEUED,
+	OPERATION_RUNNING,
+	OPERATION_DONE,
+	OPERATION_CANCELLED
+};
+class ReaderOperation;
+// Called when an operation is done, on the I/O thread of the AsyncReader, or
+// on the thread that cancelled it before it started. It is the last use of the
+// operation by the AsyncReader, so it may delete it.
+typedef void (*ReaderCompletion)(void *context, ReaderOperation *operation);
+// A request that AsyncReader runs on its I/O thread, and the future of its
+// result: wait() blocks until it is done, getStatus() then returns what run()
+// returned. Subclasses implement run() with the blocking AMSRadonReader
+// calls and keep the results as members. An operation must stay alive until
+// it is done or cancelled, and until its completion returned if it has one.
+class ReaderOperation
+{
+	friend class AsyncReader;
+	private:
+		pthread_mutex_t lock;			// guards state, cancelRequested and status
+		pthread_cond_t finished;
+		ReaderOperationState state;
+		bool cancelRequested;
+		short status;
+		ReaderCompletion completion;
+		void *completionContext;
+		void finish(ReaderOperationState finalState, short result);
+		void requestCancel();
+	protected:
+		virtual short run(AMSRadonReader *reader) = 0;
+		bool isCancelRequested();
+	public:
+		ReaderOperation();
+		virtual ~ReaderOperation();
+		void setCompletion(ReaderCompletion completion, void *context);
+		ReaderOperationState getState();
+		bool wait(int timeout);
+		short getStatus();
+};
+// Inventory rounds polled one after the other, collecting the tags of all.
+class InventoryOperation : public ReaderOperation
+{
+	private:
+		int rounds;
+		char tidAndFast;
+		char rssi;
+		vector<TagData> tags;
+	protected:
+		short run(AMSRadonReader *reader);
+	public:
+		InventoryOperation(int rounds, char tidAndFast, char rssi);
+		const vector<TagData> &getTags();
+};
+class AutoTuneOperation : public ReaderOperation
+{
+	private:
+		char autoTune;
+	protected:
+		short run(AMSRadonReader *reader);
+	public:
+		AutoTuneOperation(char autoTune);
+};
+// AMSRadonReader::tuneBand(); the progress callback runs on the I/O thread.
+class TuneBandOperation : public ReaderOperation
+{
+	private:
+		vector<int> freqs;
+		char autoTune;
+		char profileID;
+		TuningProgressCallback progress;
+		void *progressContext;
+		vector<TuningTableEntry> tuningTable;
+	protected:
+		short run(AMSRadonReader *reader);
+	public:
+		TuneBandOperation(const int *freqs, int numFreqs, char autoTune, char profileID,
+				TuningProgressCallback progress = 0, void *context = 0);
+		const vector<TuningTableEntry> &getTuningTable();
+};
+// Runs ReaderOperations one after the other on a dedicated I/O thread, so
+// the submitting thread can go on with other work. While operations are
+// queued or running the reader must not be used directly.
+class AsyncReader
+{
+	private:
+		AMSRadonReader *reader;
+		pthread_t ioThread;
+		bool ioThreadRunning;
+		pthread_mutex_t lock;
+		pthread_cond_t wakeUp;
+		deque<ReaderOperation *> queue;
+		ReaderOperation *current;
+		bool stopping;
+		static void *ioThreadEntry(void *asyncReader);
+		void serve();
+	public:
+		AsyncReader(AMSRadonReader *reader);
+		~AsyncReader();
+		short submit(ReaderOperation *operation);
+		bool cancel(ReaderOperation *operation);
+		void cancelAll();
+		bool isIdle();
+};
+// Several readers, each on its own UART and I/O thread. Readers sharing a
+// transmit slot work at the same time; the slots take turns, so readers
+// whose antennas overlap must be given different slots or they jam each
+// other's tag replies.
+class ReaderPool
+{
+	private:
+		struct Member
+		{
+			AMSRadonReader *reader;
+			AsyncReader *asyncReader;
+			int transmitSlot;
+			string uartFileName;
+		};
+		vector<Member> members;
+		short runBySlot(vector<ReaderOperation *> &operations);
+	public:
+		~ReaderPool();
+		int addReader(const string &uartFileName, int transmitSlot);
+		int size();
+		AMSRadonReader *getReader(int index);
+		AsyncReader *getAsyncReader(int index);
+		const string &getUartFileName(int index);
+		void cancelAll();
+		short inventory(int rounds, char tidAndFast, char rssi, vector<TagData> &tags);
+		short tuneBand(const int *freqs, int numFreqs, char autoTune, char profileID, const vector<bool> &selected,
+				vector< vector<TuningTableEntry> > &tuningTables);
 };
 #endif
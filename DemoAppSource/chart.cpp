@@ -80,6 +80,7 @@ Chart::Chart(QString typeOfPlot, KitModel *model, KitController *controller):
 	this->controller = controller;
 	plotType=typeOfPlot;
 	MaxNumberOfPlotPoints=25;
+	measurementCount=0;
 	setAutoReplot( false );
 	if(plotType == "Moisture")
 	{
@@ -121,10 +122,23 @@ int Chart::curveInfoIndex(QString label)
 	}
 	return -1;
 }
-void Chart::setTempCurvesSlot(QList<SensorTag> TempTagList)
+void Chart::setTempCurvesSlot(TagListSnapshotPointer snapshot)
 {
 	qDebug("setTempCurvesSlot");
-	if (TempTagList.length()==0)
+	setCurves(snapshot);
+	qDebug("setTempCurvesSlot ending");
+}
+void Chart::setMoistCurvesSlot(TagListSnapshotPointer snapshot)
+{
+	qDebug("setMoistCurvesSlot");
+	setCurves(snapshot);
+	qDebug("setMoistCurvesSlot ending");
+}
+// Adds a curve for each tag of the snapshot that has none yet. An empty
+// snapshot clears the plot.
+void Chart::setCurves(TagListSnapshotPointer snapshot)
+{
+	if (snapshot->Tags.size()==0)
 	{
 		qDebug("clearing plot");
 		clearPlot();
@@ -132,13 +146,13 @@ void Chart::setTempCurvesSlot(QList<SensorTag> TempTagList)
 	}
 	QColor curveColors[] = {QColor(0,0,255), QColor(255,0,0), QColor(0,200,0), QColor(50,200,200), QColor(250,150,50)};
 	int numColors=5;
-	for (int i=0; i < TempTagList.length(); i++)
+	for (int i=0; i < snapshot->Tags.size(); i++)
 	{
-		if (curveInfoIndex(TempTagList[i].Label)>=0)
+		if (curveInfoIndex(snapshot->Tags[i].Label)>=0)
 			continue; // Tag is already in the curveInfo list
 		curveStruct c;
-		c.curveLabel = TempTagList[i].Label;
-		c.curvePointer = new QwtPlotCurve(TempTagList[i].Label);
+		c.curveLabel = snapshot->Tags[i].Label;
+		c.curvePointer = new QwtPlotCurve(snapshot->Tags[i].Label);
 		c.curvePointer->setPen(QPen(curveColors[i % numColors]));
 		c.curvePointer->setRenderHint( QwtPlotItem::RenderAntialiased );
 		c.symbolPointer=new QwtSymbol(QwtSymbol::Ellipse, QBrush(curveColors[i % numColors]), QPen(curveColors[i % numColors]), QSize(5,5));
@@ -146,106 +160,77 @@ void Chart::setTempCurvesSlot(QList<SensorTag> TempTagList)
 		c.curvePointer->attach(this);
 		curveInfo.append(c);
 		QwtPlotItemList plotItems = itemList();
-		for (int i=0;i<plotItems.size();i++)
+		for (int p=0;p<plotItems.size();p++)
 		{
-			const QVariant itemInfo = itemToInfo(plotItems[i]);
+			const QVariant itemInfo = itemToInfo(plotItems[p]);
 			QwtLegendLabel *legendLabel = qobject_cast<QwtLegendLabel *>(legend->legendWidget(itemInfo));
 			if (legendLabel)
 			{
-				if (legendLabel->text().text()==TempTagList[i].Label)
+				if (legendLabel->text().text()==c.curveLabel)
 					legendLabel->setChecked(true);
 			}
 		}	
 	}
 	replot();
-	qDebug("setTempCurvesSlot ending");
 }
-void Chart::setMoistCurvesSlot(QList<SensorTag> MoistTagList)
+// Takes the time of the measurement of the snapshot over. The snapshot only
+// has the latest measurement, so the chart keeps the times of the ones it
+// shows itself.
+bool Chart::addMeasurementTime(TagListSnapshotPointer snapshot, float &earliestSeconds, float &latestSeconds)
 {
-	qDebug("setMoistCurvesSlot");
-	if (MoistTagList.length()==0)
+	if (snapshot->MeasurementCount==0)
+		return false;
+	if (snapshot->MeasurementCount!=measurementCount)
 	{
-		qDebug("clearing plot");
-		clearPlot();
-		return;
+		measurementSeconds.append(0.001*snapshot->FirstMeasurementTime.msecsTo(snapshot->LastMeasurementTime));
+		measurementCount=snapshot->MeasurementCount;
+		while (measurementSeconds.length() > MaxNumberOfPlotPoints)
+			measurementSeconds.removeFirst();
 	}
-	QColor curveColors[] = {QColor(0,0,255), QColor(255,0,0), QColor(0,200,0), QColor(50,200,200), QColor(250,150,50)};
-	int numColors=5;
-	for (int i=0; i < MoistTagList.length(); i++)
+	earliestSeconds = measurementSeconds.first();
+	latestSeconds = measurementSeconds.last();
+	if (earliestSeconds==latestSeconds)
+		latestSeconds=earliestSeconds+10;
+	return true;
+}
+// Adds the tag's latest measurement to its curve if the tag was measured in
+// the measurement of the snapshot, and drops the points that scrolled out.
+void Chart::updateCurve(TagListSnapshotPointer snapshot, const TagSnapshot &tag)
+{
+	int c = curveInfoIndex(tag.Label);
+	if (c<0)
 	{
-		if (curveInfoIndex(MoistTagList[i].Label)>=0)
-			continue; // Tag is already in the curveInfo list
-		curveStruct c;
-		c.curveLabel = MoistTagList[i].Label;
-		c.curvePointer = new QwtPlotCurve(MoistTagList[i].Label);
-		c.curvePointer->setPen(QPen(curveColors[i % numColors]));
-		c.curvePointer->setRenderHint( QwtPlotItem::RenderAntialiased );
-		c.symbolPointer=new QwtSymbol(QwtSymbol::Ellipse, QBrush(curveColors[i % numColors]), QPen(curveColors[i % numColors]), QSize(5,5));
-		c.curvePointer->setSymbol(c.symbolPointer);
-		c.curvePointer->attach(this);
-		curveInfo.append(c);
-		QwtPlotItemList plotItems = itemList();
-		for (int i=0;i<plotItems.size();i++)
-		{
-			const QVariant itemInfo = itemToInfo(plotItems[i]);
-			QwtLegendLabel *legendLabel = qobject_cast<QwtLegendLabel *>(legend->legendWidget(itemInfo));
-			if (legendLabel)
-			{
-				if (legendLabel->text().text()==MoistTagList[i].Label)
-					legendLabel->setChecked(true);
-			}
-		}	
+		setCurves(snapshot); // There is a tag in the list for which there is no curve
+		c = curveInfoIndex(tag.Label);
+		if (c<0)
+			return;
 	}
-	replot();
-	qDebug("setMoistCurvesSlot ending");
+	curveStruct &curve = curveInfo[c];
+	int latestMeasNumber = snapshot->MeasurementCount-1;
+	float val = tag.Value.getValue();
+	bool newPoint = curve.pointNumbers.isEmpty() || curve.pointNumbers.last()!=latestMeasNumber;
+	if (tag.Measured && tag.Value.getNumber()==latestMeasNumber && val > -1000 && newPoint)
+	{
+		curve.points << QPointF(measurementSeconds.last(), val);
+		curve.pointNumbers.append(latestMeasNumber);
+	}
+	int earliestMeasNumber = snapshot->MeasurementCount - MaxNumberOfPlotPoints;
+	while (!curve.pointNumbers.isEmpty() && curve.pointNumbers.first() < earliestMeasNumber)
+	{
+		curve.points.remove(0);
+		curve.pointNumbers.removeFirst();
+	}
+	curve.curvePointer->setSamples(curve.points);
 }
-void Chart::updateTempCurvesSlot(QList<SensorTag> TempTagList, QList<QDateTime> TempMeasTimeList)
+void Chart::updateTempCurvesSlot(TagListSnapshotPointer snapshot)
 {
 	qDebug("updateTempCurvesSlot");
-	int MeasTimeListLength = TempMeasTimeList.length();
-	if (MeasTimeListLength==0)
+	float earliestSeconds, latestSeconds;
+	if (!addMeasurementTime(snapshot, earliestSeconds, latestSeconds))
 		return;
 	setAxisAutoScale(QwtPlot::yLeft);
-	QDateTime firstMeasTime = TempMeasTimeList[0];
-	int earliestMeasNumber = MeasTimeListLength - MaxNumberOfPlotPoints;
-	if (earliestMeasNumber < 0)
-		earliestMeasNumber=0;
-	QDateTime earliestPlottedTime = TempMeasTimeList[earliestMeasNumber];
-	QDateTime latestPlottedTime = TempMeasTimeList[MeasTimeListLength-1];
-	float earliestSeconds = 0.001*firstMeasTime.msecsTo(earliestPlottedTime);
-	float latestSeconds = 0.001*firstMeasTime.msecsTo(latestPlottedTime);
-	if (earliestSeconds==latestSeconds)
-		latestSeconds=earliestSeconds+10;
-	for (int t=0; t < TempTagList.length(); t++)
-	{
-		int c;
-		for (c=0; c < curveInfo.length(); c++)
-		{
-			if (TempTagList[t].Label==curveInfo[c].curveLabel)
-				break;
-		}
-		if (c==curveInfo.length())
-			setTempCurvesSlot(TempTagList); // There is a tag in the list for which there is no curve
-		QPolygonF points;
-		int historyLength = TempTagList[t].TemperatureMeasurementHistory.length();
-		if (historyLength > 0)
-		{
-			for (int m=historyLength-1;m>=0;m--)
-			{
-				int measNumber = TempTagList[t].TemperatureMeasurementHistory[m].getNumber();
-				if (measNumber < earliestMeasNumber)
-					break;
-				float val = TempTagList[t].TemperatureMeasurementHistory[m].getValue();
-				if (val > -1000)
-				{
-					QDateTime measTime=TempMeasTimeList[measNumber];
-					float seconds = 0.001*firstMeasTime.msecsTo(measTime);
-					points << QPointF(seconds, val);
-				}
-			}
-			curveInfo[c].curvePointer->setSamples(points);
-		}
-	}
+	for (int t=0; t < snapshot->Tags.size(); t++)
+		updateCurve(snapshot, snapshot->Tags[t]);
 	updateAxes();
 	QwtScaleDiv scaleDiv = axisScaleDiv(QwtPlot::yLeft);
 	double lowerBound = scaleDiv.lowerBound();
@@ -258,56 +243,21 @@ void Chart::updateTempCurvesSlot(QList<SensorTag> TempTagList, QList<QDateTime>
 	setAxisScale( QwtPlot::xBottom, earliestSeconds, latestSeconds);
 	replot();
 }
-void Chart::updateMoistCurvesSlot(QList<SensorTag> MoistTagList, QList<QDateTime> MoistMeasTimeList)
+void Chart::updateMoistCurvesSlot(TagListSnapshotPointer snapshot)
 {
 	qDebug("updateMoistCurvesSlot");
-	int MeasTimeListLength = MoistMeasTimeList.length();
-	if (MeasTimeListLength==0)
+	float earliestSeconds, latestSeconds;
+	if (!addMeasurementTime(snapshot, earliestSeconds, latestSeconds))
 		return;
-	QDateTime firstMeasTime = MoistMeasTimeList[0];
-	int earliestMeasNumber = MeasTimeListLength - MaxNumberOfPlotPoints;
-	if (earliestMeasNumber < 0)
-		earliestMeasNumber=0;
-	QDateTime earliestPlottedTime = MoistMeasTimeList[earliestMeasNumber];
-	QDateTime latestPlottedTime = MoistMeasTimeList[MeasTimeListLength-1];
-	float earliestSeconds = 0.001*firstMeasTime.msecsTo(earliestPlottedTime);
-	float latestSeconds = 0.001*firstMeasTime.msecsTo(latestPlottedTime);
-	if (earliestSeconds==latestSeconds)
-		latestSeconds=earliestSeconds+10;
 	bool SelectedM3TagsInList=false;
-	for (int t=0; t < MoistTagList.length(); t++)
+	for (int t=0; t < snapshot->Tags.size(); t++)
 	{
-		if (MoistTagList[t].getModel().left(2)=="03" && MoistTagList[t].SelectedForMeasurement)
+		const TagSnapshot &tag = snapshot->Tags[t];
+		if (tag.Model.left(2)=="03" && tag.SelectedForMeasurement)
 		{
 			SelectedM3TagsInList=true;
 		}
-		int c;
-		for (c=0; c < curveInfo.length(); c++)
-		{
-			if (MoistTagList[t].Label==curveInfo[c].curveLabel)
-				break;
-		}
-		if (c==curveInfo.length())
-			setMoistCurvesSlot(MoistTagList); // There is a tag in the list for which there is no curve
-		QPolygonF points;
-		int historyLength = MoistTagList[t].SensorMeasurementHistory.length();
-		if (historyLength > 0)
-		{
-			for (int m=historyLength-1;m>=0;m--)
-			{
-				int measNumber = MoistTagList[t].SensorMeasurementHistory[m].getNumber();
-				if (measNumber < earliestMeasNumber)
-					break;
-				float val = MoistTagList[t].SensorMeasurementHistory[m].getValue();
-				if (val > -1000)
-				{
-					QDateTime measTime=MoistMeasTimeList[measNumber];
-					float seconds = 0.001*firstMeasTime.msecsTo(measTime);
-					points << QPointF(seconds, val);
-				}
-			}
-			curveInfo[c].curvePointer->setSamples(points);
-		}
+		updateCurve(snapshot, tag);
 	}
 	setAxisScale( QwtPlot::xBottom, earliestSeconds, latestSeconds);
 	if (SelectedM3TagsInList)
@@ -328,6 +278,8 @@ void Chart::clearPlot()
 		delete curveInfo[i].curvePointer;
 	}
 	curveInfo.clear();
+	measurementSeconds.clear();
+	measurementCount=0;
 	replot();
 }
 void Chart::legendChecked( const QVariant &itemInfo, bool on )
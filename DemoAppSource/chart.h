@@ -19,6 +19,7 @@
 #include <qwt_legend.h>
 #include <qwt_scale_draw.h>
 #include <qwt_symbol.h>
+#include <QPolygonF>
 #include "sensorTag.h"
 #include "kit_controller.h"
 #include "kit_model.h"
@@ -49,10 +50,10 @@ class Chart : public QwtPlot
 		Chart(QString plotType, KitModel *model, KitController *controller);
 		int MaxNumberOfPlotPoints;
 	public Q_SLOTS:
-		void setTempCurvesSlot(QList<SensorTag> TempTagList);
-		void setMoistCurvesSlot(QList<SensorTag> MoistTagList);
-		void updateTempCurvesSlot(QList<SensorTag> TempTagList, QList<QDateTime> TempMeasTimeList);
-		void updateMoistCurvesSlot(QList<SensorTag> MoistTagList, QList<QDateTime> MoistMeasTimeList);
+		void setTempCurvesSlot(TagListSnapshotPointer snapshot);
+		void setMoistCurvesSlot(TagListSnapshotPointer snapshot);
+		void updateTempCurvesSlot(TagListSnapshotPointer snapshot);
+		void updateMoistCurvesSlot(TagListSnapshotPointer snapshot);
 		private Q_SLOTS:
 		void legendChecked( const QVariant &, bool on );
 	private:
@@ -61,8 +62,12 @@ class Chart : public QwtPlot
 			QwtPlotCurve* curvePointer;
 			QwtSymbol* symbolPointer;
 			QString curveLabel;
+			QPolygonF points;		// the plotted measurements of the tag
+			QList<int> pointNumbers;	// and their measurement numbers
 		};
 		QList<curveStruct> curveInfo;
+		QList<float> measurementSeconds;	// times of the plotted measurements
+		int measurementCount;
 		int dataCount;
 		QString plotType;
 		QwtLegend *legend;
@@ -71,5 +76,8 @@ class Chart : public QwtPlot
 		KitController *controller;
 		int curveInfoIndex(QString label);
 		void clearPlot();
+		void setCurves(TagListSnapshotPointer snapshot);
+		bool addMeasurementTime(TagListSnapshotPointer snapshot, float &earliestSeconds, float &latestSeconds);
+		void updateCurve(TagListSnapshotPointer snapshot, const TagSnapshot &tag);
 };
 #endif
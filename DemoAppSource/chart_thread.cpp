@@ -54,7 +54,7 @@ void ChartThread::run()
 	{
 		qDebug("calling searchForTempTags()");
 		controller->searchForTempTags();
-		emit tempTagsFoundSignal(model->TempTagList);
+		emit tempTagsFoundSignal(model->getTagSnapshot("Temperature"));
 		while(abort != true)
 		{
 			QDateTime measureStartTime = QDateTime::currentDateTime();
@@ -62,7 +62,7 @@ void ChartThread::run()
 			controller->measureTempTags();	
 			if (abort==true)
 				break;
-			emit tempTagsMeasuredSignal(model->TempTagList, model->TempMeasTimeList);
+			emit tempTagsMeasuredSignal(model->getTagSnapshot("Temperature"));
 			QThread::msleep(100);
 			QDateTime nextStartTime = measureStartTime.addSecs(measurementPeriod);
 			int msecondsToNextMeas = QDateTime::currentDateTime().msecsTo(nextStartTime);
@@ -79,7 +79,7 @@ void ChartThread::run()
 	{
 		qDebug("calling searchForMoistTags()");
 		controller->searchForMoistureTags();
-		emit moistTagsFoundSignal(model->MoistTagList);
+		emit moistTagsFoundSignal(model->getTagSnapshot("Moisture"));
 		while(abort != true)
 		{
 			QDateTime measureStartTime = QDateTime::currentDateTime();
@@ -87,7 +87,7 @@ void ChartThread::run()
 			controller->measureMoistureTags();	
 			if (abort==true)
 				break;
-			emit moistTagsMeasuredSignal(model->MoistTagList, model->MoistMeasTimeList);
+			emit moistTagsMeasuredSignal(model->getTagSnapshot("Moisture"));
 			QThread::msleep(100);
 			QDateTime nextStartTime = measureStartTime.addSecs(measurementPeriod);
 			int msecondsToNextMeas = QDateTime::currentDateTime().msecsTo(nextStartTime);
@@ -23,9 +23,6 @@
 
 enum CollectionType { TEMPERATURE = 1, MOISTURE, TEMPCAL };
 
-Q_DECLARE_METATYPE(QList<SensorTag>);
-Q_DECLARE_METATYPE(QList<QDateTime>);
-
 class ChartThread : public QThread
 {
 	Q_OBJECT
@@ -39,10 +36,10 @@ class ChartThread : public QThread
 	protected:
 		void run() Q_DECL_OVERRIDE;
 	signals:
-		void tempTagsFoundSignal(QList<SensorTag>);
-		void tempTagsMeasuredSignal(QList<SensorTag>, QList<QDateTime>);
-		void moistTagsFoundSignal(QList<SensorTag>);
-		void moistTagsMeasuredSignal(QList<SensorTag>, QList<QDateTime>);
+		void tempTagsFoundSignal(TagListSnapshotPointer);
+		void tempTagsMeasuredSignal(TagListSnapshotPointer);
+		void moistTagsFoundSignal(TagListSnapshotPointer);
+		void moistTagsMeasuredSignal(TagListSnapshotPointer);
 		void tempCodeMeasuredSignal(float code);
 	public:
 		ChartThread(QObject *parent = 0);
@@ -103,14 +103,13 @@ TempDemoPage::TempDemoPage(KitModel *model, KitController *controller, QWidget *
 	plot = new Chart("Temperature", model, controller);
 	thread = new ChartThread;
 	thread->initialize(controller, model);
-	qRegisterMetaType< QList<SensorTag> >( "QList<SensorTag>" );
-	qRegisterMetaType< QList<QDateTime> >( "QList<QDateTime>" );
-	connect(thread, SIGNAL(tempTagsFoundSignal(QList<SensorTag>)), plot, SLOT(setTempCurvesSlot(QList<SensorTag>)));
-	connect(thread, SIGNAL(tempTagsMeasuredSignal(QList<SensorTag>, QList<QDateTime>)), plot, SLOT(updateTempCurvesSlot(QList<SensorTag>, QList<QDateTime>)));
-	connect(thread, SIGNAL(tempTagsMeasuredSignal(QList<SensorTag>, QList<QDateTime>)), this, SLOT(updateTempOutputLabelsSlot(QList<SensorTag>)));
+	qRegisterMetaType<TagListSnapshotPointer>("TagListSnapshotPointer");
+	connect(thread, SIGNAL(tempTagsFoundSignal(TagListSnapshotPointer)), plot, SLOT(setTempCurvesSlot(TagListSnapshotPointer)));
+	connect(thread, SIGNAL(tempTagsMeasuredSignal(TagListSnapshotPointer)), plot, SLOT(updateTempCurvesSlot(TagListSnapshotPointer)));
+	connect(thread, SIGNAL(tempTagsMeasuredSignal(TagListSnapshotPointer)), this, SLOT(updateTempOutputLabelsSlot(TagListSnapshotPointer)));
 	connect(model, SIGNAL(updateTempTagSelectionsSignal()), this, SLOT(updateTagSelectionsSlot()));
-	connect(model, SIGNAL(updateTempTagsSignal(QList<SensorTag>)), this, SLOT(updateTempOutputLabelsSlot(QList<SensorTag>)));
-	connect(model, SIGNAL(updateTempTagsSignal(QList<SensorTag>)), plot, SLOT(setTempCurvesSlot(QList<SensorTag>)));
+	connect(model, SIGNAL(updateTempTagsSignal(TagListSnapshotPointer)), this, SLOT(updateTempOutputLabelsSlot(TagListSnapshotPointer)));
+	connect(model, SIGNAL(updateTempTagsSignal(TagListSnapshotPointer)), plot, SLOT(setTempCurvesSlot(TagListSnapshotPointer)));
 	const int margin = 5;
 	plot->setContentsMargins( margin, margin, margin, margin );
 	QHBoxLayout *outputLayout = new QHBoxLayout;
@@ -172,7 +171,7 @@ TempDemoPage::TempDemoPage(KitModel *model, KitController *controller, QWidget *
 	configTempDemoDialog->setWindowIcon(QIcon(APPLICATION_ICON));
 	measurementDetailsDialog = new MeasurementDetailsDialog(model, controller, "Temperature");
 	measurementDetailsDialog->setWindowIcon(QIcon(APPLICATION_ICON));
-	connect(thread, SIGNAL(tempTagsMeasuredSignal(QList<SensorTag>, QList<QDateTime>)), measurementDetailsDialog->tablePage, SLOT(loadTempTableSlot(QList<SensorTag>)));
+	connect(thread, SIGNAL(tempTagsMeasuredSignal(TagListSnapshotPointer)), measurementDetailsDialog->tablePage, SLOT(loadTempTableSlot(TagListSnapshotPointer)));
 	helpDialog = new HelpDialog(model, controller, "TempDemoPage");
 	helpDialog->setWindowIcon(QIcon(APPLICATION_ICON));
 	QVBoxLayout *chartControlLayout = new QVBoxLayout;
@@ -218,7 +217,7 @@ TempDemoPage::TempDemoPage(KitModel *model, KitController *controller, QWidget *
 void TempDemoPage::updateTagSelectionsSlot()
 {
 	qDebug("updateTagSelectionsSlot");
-	for (int t=0; t < model->TempTagList.length(); t++)
+	for (int t=0; t < model->TempTagList.length() && t < outputLabels.length(); t++)
 	{
 		if (model->TempTagList[t].SelectedForMeasurement==false)
 		{
@@ -226,18 +225,18 @@ void TempDemoPage::updateTagSelectionsSlot()
 		}
 	}
 }
-void TempDemoPage::updateTempOutputLabelsSlot(QList<SensorTag> TempTagList)
+void TempDemoPage::updateTempOutputLabelsSlot(TagListSnapshotPointer snapshot)
 {
 	for (int i=0; i<outputLabels.length(); i++)
 	{
 		outputLabels[i]->setText("");
 	}
-	for (int t=0; t < TempTagList.length(); t++)
+	for (int t=0; t < snapshot->Tags.size() && t < outputLabels.length(); t++)
 	{
-		int historyLength = TempTagList[t].TemperatureMeasurementHistory.length();
-		if (TempTagList[t].SelectedForMeasurement==true && historyLength>0)
+		const TagSnapshot &tag = snapshot->Tags[t];
+		if (tag.SelectedForMeasurement==true && tag.Measured)
 		{		
-			float temp = TempTagList[t].TemperatureMeasurementHistory[historyLength-1].getValue();
+			float temp = tag.Value.getValue();
 			if (temp > -1000)	
 				outputLabels[t]->setText(QString::number(temp, 'f', 1)+" C");
 			else
@@ -354,14 +353,13 @@ MoistureDemoPage::MoistureDemoPage(KitModel *model, KitController *controller, Q
 	plot = new Chart("Moisture", model, controller);
 	thread = new ChartThread;
 	thread->initialize(controller, model);
-	qRegisterMetaType< QList<SensorTag> >( "QList<SensorTag>" );
-	qRegisterMetaType< QList<QDateTime> >( "QList<QDateTime>" );
-	connect(thread, SIGNAL(moistTagsFoundSignal(QList<SensorTag>)), plot, SLOT(setMoistCurvesSlot(QList<SensorTag>)));
-	connect(thread, SIGNAL(moistTagsMeasuredSignal(QList<SensorTag>, QList<QDateTime>)), plot, SLOT(updateMoistCurvesSlot(QList<SensorTag>, QList<QDateTime>)));
-	connect(thread, SIGNAL(moistTagsMeasuredSignal(QList<SensorTag>, QList<QDateTime>)), this, SLOT(updateMoistOutputLabelsSlot(QList<SensorTag>)));
+	qRegisterMetaType<TagListSnapshotPointer>("TagListSnapshotPointer");
+	connect(thread, SIGNAL(moistTagsFoundSignal(TagListSnapshotPointer)), plot, SLOT(setMoistCurvesSlot(TagListSnapshotPointer)));
+	connect(thread, SIGNAL(moistTagsMeasuredSignal(TagListSnapshotPointer)), plot, SLOT(updateMoistCurvesSlot(TagListSnapshotPointer)));
+	connect(thread, SIGNAL(moistTagsMeasuredSignal(TagListSnapshotPointer)), this, SLOT(updateMoistOutputLabelsSlot(TagListSnapshotPointer)));
 	connect(model, SIGNAL(updateMoistTagSelectionsSignal()), this, SLOT(updateTagSelectionsSlot()));
-	connect(model, SIGNAL(updateMoistTagsSignal(QList<SensorTag>)), this, SLOT(updateMoistOutputLabelsSlot(QList<SensorTag>)));
-	connect(model, SIGNAL(updateMoistTagsSignal(QList<SensorTag>)), plot, SLOT(setMoistCurvesSlot(QList<SensorTag>)));
+	connect(model, SIGNAL(updateMoistTagsSignal(TagListSnapshotPointer)), this, SLOT(updateMoistOutputLabelsSlot(TagListSnapshotPointer)));
+	connect(model, SIGNAL(updateMoistTagsSignal(TagListSnapshotPointer)), plot, SLOT(setMoistCurvesSlot(TagListSnapshotPointer)));
 	const int margin = 5;
 	plot->setContentsMargins( margin, margin, margin, margin );
 	QHBoxLayout *outputLayout = new QHBoxLayout;
@@ -418,7 +416,7 @@ MoistureDemoPage::MoistureDemoPage(KitModel *model, KitController *controller, Q
 	configMoistureDemoDialog->setWindowIcon(QIcon(APPLICATION_ICON));
 	measurementDetailsDialog = new MeasurementDetailsDialog(model, controller, "Moisture");
 	measurementDetailsDialog->setWindowIcon(QIcon(APPLICATION_ICON));
-	connect(thread, SIGNAL(moistTagsMeasuredSignal(QList<SensorTag>, QList<QDateTime>)), measurementDetailsDialog->tablePage, SLOT(loadMoistTableSlot(QList<SensorTag>)));
+	connect(thread, SIGNAL(moistTagsMeasuredSignal(TagListSnapshotPointer)), measurementDetailsDialog->tablePage, SLOT(loadMoistTableSlot(TagListSnapshotPointer)));
 	helpDialog = new HelpDialog(model, controller, "MoistureDemoPage");
 	helpDialog->setWindowIcon(QIcon(APPLICATION_ICON));
 	QVBoxLayout *chartControlLayout = new QVBoxLayout;
@@ -463,7 +461,7 @@ MoistureDemoPage::MoistureDemoPage(KitModel *model, KitController *controller, Q
 void MoistureDemoPage::updateTagSelectionsSlot()
 {
 	qDebug("updateTagSelectionsSlot");
-	for (int t=0; t < model->MoistTagList.length(); t++)
+	for (int t=0; t < model->MoistTagList.length() && t < outputLabels.length(); t++)
 	{
 		if (model->MoistTagList[t].SelectedForMeasurement==false)
 		{
@@ -471,21 +469,21 @@ void MoistureDemoPage::updateTagSelectionsSlot()
 		}
 	}
 }
-void MoistureDemoPage::updateMoistOutputLabelsSlot(QList<SensorTag> MoistTagList)
+void MoistureDemoPage::updateMoistOutputLabelsSlot(TagListSnapshotPointer snapshot)
 {
 	for (int i=0; i<outputLabels.length(); i++)
 	{
 		outputLabels[i]->setText("");
 	}
-	for (int t=0; t < MoistTagList.length(); t++)
+	for (int t=0; t < snapshot->Tags.size() && t < outputLabels.length(); t++)
 	{
-		int historyLength = MoistTagList[t].SensorMeasurementHistory.length();
-		if (MoistTagList[t].SelectedForMeasurement==true && historyLength>0)
+		const TagSnapshot &tag = snapshot->Tags[t];
+		if (tag.SelectedForMeasurement==true && tag.Measured)
 		{		
-			float moist = MoistTagList[t].SensorMeasurementHistory[historyLength-1].getValue();
+			float moist = tag.Value.getValue();
 			if (moist> -1)	
 			{	
-				qDebug("Updating output labels: Tag %d %s %f", t, qPrintable(MoistTagList[t].getEpc()), moist);
+				qDebug("Updating output labels: Tag %d %s %f", t, qPrintable(tag.Epc), moist);
 				QString wetdry=" DRY";
 				if (model->wetAbove==true && moist>=model->moistThreshold)
 					wetdry=" WET";
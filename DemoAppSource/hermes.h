@@ -114,7 +114,7 @@ class TempDemoPage : public QWizardPage
 		QVBoxLayout *plotLayout;
 	public slots:
 		void updateTagSelectionsSlot();
-		void updateTempOutputLabelsSlot(QList<SensorTag>);
+		void updateTempOutputLabelsSlot(TagListSnapshotPointer);
 	private slots:
 		void measurementDetailsButtonClicked();
 		void mainScreenButtonClicked();
@@ -158,7 +158,7 @@ class MoistureDemoPage : public QWizardPage
 		QVBoxLayout *plotLayout;
 	public slots:
 		void updateTagSelectionsSlot();
-		void updateMoistOutputLabelsSlot(QList<SensorTag>);
+		void updateMoistOutputLabelsSlot(TagListSnapshotPointer);
 	private slots:
 		void measurementDetailsButtonClicked();
 		void mainScreenButtonClicked();
@@ -1,6 +1,10 @@
 #include <vector>
 #include <iostream>
+#include <stdlib.h>
 #include <QTime>
+#include <QThread>
+#include <QCoreApplication>
+#include <QStringList>
 #include "kit_model.h"
 #include "gui_view.h"
 #include "utilityFunctions.h"
@@ -10,7 +14,43 @@ using namespace std;
 
 KitModel::KitModel()
 {
-	reader = new AMSRadonReader("/dev/ttyO4");
+	// HERMES_READER_UART points the reader at another port, e.g. the pty of
+	// a uart_replay session
+	const char *readerUart = getenv("HERMES_READER_UART");
+	// HERMES_READER_UARTS drives several readers instead, e.g.
+	// "/dev/ttyO4,/dev/ttyO1:1" where ":1" is the transmit slot of a reader
+	// whose antenna overlaps the one of the first
+	pool = new ReaderPool();
+	const char *readerUarts = getenv("HERMES_READER_UARTS");
+	if(readerUarts != NULL)
+	{
+		QStringList entries = QString(readerUarts).split(',', QString::SkipEmptyParts);
+		for(int i = 0; i < entries.size(); i++)
+		{
+			QStringList fields = entries[i].split(':');
+			int transmitSlot = fields.size() > 1 ? fields[1].toInt() : 0;
+			pool->addReader(fields[0].trimmed().toStdString(), transmitSlot);
+		}
+	}
+	if(pool->size() == 0)
+		pool->addReader(readerUart != NULL ? readerUart : "/dev/ttyO4", 0);
+	reader = pool->getReader(0);
+	asyncReader = pool->getAsyncReader(0);
+	// antenna tuning of earlier runs, HERMES_TUNING_CACHE moves the file
+	const char *tuningCacheFile = getenv("HERMES_TUNING_CACHE");
+	tuningCache = new TuningCache(tuningCacheFile != NULL ? tuningCacheFile : "tuning_cache");
+	tuningCache->load();
+	// power response of the tags of earlier runs, HERMES_TAG_POWER_MODEL moves the file
+	const char *powerModelFile = getenv("HERMES_TAG_POWER_MODEL");
+	powerModel = new TagPowerModel(powerModelFile != NULL ? powerModelFile : "tag_power_model");
+	powerModel->load();
+	// HERMES_TRACE_FILE collects the event trace of the reader firmware after
+	// every inventory, decode it with tools/trace_decode
+	const char *readerTraceFile = getenv("HERMES_TRACE_FILE");
+	if(readerTraceFile != NULL)
+		traceFile = readerTraceFile;
+	tempSnapshot = TagListSnapshotPointer(new TagListSnapshot);
+	moistSnapshot = tempSnapshot;
 	gpio7 = new GPIO(7);
 }
 void KitModel::turnReaderOn()
@@ -65,6 +105,8 @@ void KitModel::registerMoistureObserver(GUIView *gui)
 void KitModel::setAbort(bool status)
 {
 	this->abort = status;
+	if(status)
+		pool->cancelAll();
 }
 void KitModel::selectForMeasurement(QString measurementType, QString tagLabel, bool select)
 {
@@ -98,283 +140,341 @@ void KitModel::clearTags(QString measurementType)
 	if (measurementType=="Temperature")
 	{
 		TempTagList.clear();
+		TempTagRegistry.clear();
 		TempMeasTimeList.clear();
-		emit updateTempTagsSignal(TempTagList);
+		publishTagSnapshot(measurementType);
+		emit updateTempTagsSignal(getTagSnapshot(measurementType));
 	}
 	if (measurementType=="Moisture")
 	{
 		MoistTagList.clear();
+		MoistTagRegistry.clear();
 		MoistMeasTimeList.clear();
-		emit updateMoistTagsSignal(MoistTagList);
+		publishTagSnapshot(measurementType);
+		emit updateMoistTagsSignal(getTagSnapshot(measurementType));
 	}	
 }
+static void addProfileRegister(ReaderProfile &profile, char address, char mask, char value)
+{
+	ProfileRegister &reg = profile.registers[profile.registerCount++];
+	reg.address = address;
+	reg.mask = mask;
+	reg.value = value;
+}
 int KitModel::initializeReader()
 {
+	readerIDs.assign(pool->size(), string());
+	for(int i = 0; i < pool->size(); i++)
+	{
+		int status = configureReader(i);
+		if(status != 0)
+		{
+			qDebug("Reader %d failed to initialize (%d)", i, status);
+			return status;
+		}
+	}
+	return 0;
+}
+int KitModel::configureReader(int index)
+{
+	AMSRadonReader *poolReader = pool->getReader(index);
 	char status;
-	int initStatus = reader->initialize();
+	int initStatus = poolReader->initialize();
 	if (initStatus != 0)
 		return initStatus;
-	status = reader->clearListOfSelectCommands();
-	if(status != 0)
-		return status;
-	char storedAntennaID;
-	status = reader->setAntennaID(2, storedAntennaID);
-	if(status != 0)
-		return status;
-	signed char storedAntennaSensitivity;
-	status = reader->setAntennaSensitivity((signed char)(-80), storedAntennaSensitivity);
-	if(status != 0)
-		return status;
-	char reg0x00Value;
-	status = reader->readAS3993Reg(0x00, &reg0x00Value);
-	if(status != 0)
-		return status;
-	reg0x00Value &= ~(0x04);
-	reg0x00Value |= 0x04;   // Enable AGC (?)
-	char operationStatus;
-	status = reader->writeToAS3993Reg(0x00, reg0x00Value, operationStatus);
-	if(status != 0)
-		return status;
-	reg0x00Value = 0;
-	status  = reader->readAS3993Reg(0x00, &reg0x00Value);
-	if(status != 0)
-		return status;
-	char reg0x15Value;
-	status = reader->readAS3993Reg(0x15, &reg0x15Value);
-	if(status != 0)
-		return status;
-	reg0x15Value &= 0xE0;
-	reg0x15Value |= 0x17;
-	status = reader->writeToAS3993Reg(0x15, reg0x15Value, operationStatus);
-	if(status != 0)
-		return status;
-	reg0x15Value = 0;
-	status = reader->readAS3993Reg(0x15, &reg0x15Value);
-	if(status != 0)
-		return status;
-	char storedLinkFreq;
-	status = reader->setLinkFrequency(6, storedLinkFreq);
-	if(status != 0)
-		return status;
-	char storedCoding;
-	status = reader->setCoding(2, storedCoding);
-	if(status != 0)
-		return status;
-	char storedSession;
-	status = reader->setSession(0, storedSession);
-	if(status != 0)
-		return status;
-	char storedTrext;
-	status = reader->setTrext(0, storedTrext);
-	if(status != 0)
-		return status;
-	char storedTari;
-	status = reader->setTari(2, storedTari);
-	if(status != 0)
-		return status;
-	char storedQBegin;
-	status = reader->setQBegin(6, storedQBegin);
-	if(status != 0)
-		return status;
-	char storedSel;
-	status = reader->setSel(0, storedSel);
-	if(status != 0)
-		return status;
-	char storedTarget;
-	status = reader->setTarget(0, storedTarget);
-	if(status != 0)
-		return status;
-	char reg0x17Value;
-	status = reader->readAS3993Reg(0x17, &reg0x17Value);
+	const char *recordFile = getenv("HERMES_UART_RECORD");
+	if(recordFile != NULL && poolReader == reader)
+		poolReader->startRecording(recordFile);
+	// stays at the default rate if the reader firmware can not go faster
+	poolReader->negotiateBaudRate(READER_MAX_BAUD_RATE);
+	status = poolReader->clearListOfSelectCommands();
 	if(status != 0)
 		return status;
+	string &readerID = readerIDs[index];
+	if(poolReader->getFirmwareInformation(readerID) != 0)
+		readerID.clear();	// no cached tuning without knowing the reader
+	else if(index > 0)
+		readerID += " on " + pool->getUartFileName(index);	// readers of a pool often run the same firmware
+	// Only the settings the reader does not have yet are sent, and the antenna
+	// is only tuned again if it or the Gen2 settings changed, so a restart with
+	// a reader that kept its configuration is quick.
+	ReaderProfile profile;
+	profile.antennaID = READER_ANTENNA;
+	profile.sensitivity = -80;
+	profile.linkFreq = 6;
+	profile.coding = 2;
+	profile.session = 0;
+	profile.trext = 0;
+	profile.tari = 2;
+	profile.qBegin = 6;
+	profile.sel = 0;
+	profile.target = 0;
+	profile.registerCount = 0;
+	addProfileRegister(profile, 0x00, 0x04, 0x04);	// Enable AGC (?)
+	addProfileRegister(profile, 0x15, 0x1F, 0x17);
 	char regRefDiv = 0x07 - 3;
-	reg0x17Value &= 0x8F;
-	reg0x17Value |= (regRefDiv << 4);
-	status = reader->writeToAS3993Reg(0x17, reg0x17Value, operationStatus);
-	if(status != 0)
-		return status;
-	reg0x17Value = 0;
-	status = reader->readAS3993Reg(0x17, &reg0x17Value);
-	if(status != 0)
-		return status;
-	status  = reader->performAutoTuning(0x01);
+	addProfileRegister(profile, 0x17, 0x70, regRefDiv << 4);
+	profile.autoTune = 0x01;
+	bool reconfigured;
+	status = poolReader->applyReaderProfile(profile, reconfigured);
 	if(status != 0)
 		return status;
+	qDebug(reconfigured ? "reader configured" : "reader kept its configuration");
 	return 0;
 }
 int KitModel::setPower(char value)
 {
 	// value: attenuation factor for ams chip, NOT actual power in dBm
-	char reg0x15Value;
 	char status;
-	char operationStatus;
 	qDebug("Setting power to attenuation factor %d", value);
 	if (value > 19)
 		return -1;
 	char registerEntry = value;
 	if (value > 11)
 		registerEntry = value + 4;
-	status = reader->readAS3993Reg(0x15, &reg0x15Value);
+	// served from the register shadow: one request at most, none if the
+	// level does not change
+	for(int i = 0; i < pool->size(); i++)
+	{
+		AMSRadonReader *poolReader = pool->getReader(i);
+		poolReader->stageAS3993Reg(0x15, 0x1F, registerEntry);
+		status = poolReader->flushAS3993Regs();
+		if (status!=0)
+			return status;
+	}
+	txPower = value;
+	return 0;
+}
+static void reportTuningProgress(void *model, int tunedChannels, int totalChannels)
+{
+	emit ((KitModel *)model)->antennaTuningSignal(tunedChannels, totalChannels);
+}
+// Restores the tuning table pool reader index had for the band in an earlier
+// run. A few channels are measured with the restored settings; if the
+// reflected power got clearly worse than it was after tuning, the antenna
+// surroundings changed and the band has to be tuned again.
+bool KitModel::restoreTuning(int index, FreqBandEnum band, const int *freqs, int numFreqs)
+{
+	AMSRadonReader *poolReader = pool->getReader(index);
+	vector<TuningTableEntry> tuningTable;
+	if(index >= (int)readerIDs.size() || readerIDs[index].empty() || !tuningCache->lookup(band, READER_ANTENNA, readerIDs[index], tuningTable))
+		return false;
+	vector<TuningTableEntry> noTuning;
+	if(poolReader->tuneBand(freqs, numFreqs, 0x00, 1, noTuning) != 0)
+		return false;
+	if(poolReader->restoreTuningTable(READER_ANTENNA, tuningTable) != 0)
+		return false;
+	int checks = (int)tuningTable.size() < TUNING_CACHE_SPOT_CHECKS ? (int)tuningTable.size() : TUNING_CACHE_SPOT_CHECKS;
+	for(int i = 0; i < checks; i++)
+	{
+		// first, last and evenly spread channels in between
+		const TuningTableEntry &entry = tuningTable[checks > 1 ? i * (tuningTable.size() - 1) / (checks - 1) : 0];
+		char IChannel, QChannel;
+		if(poolReader->getReflectedPowerLevel(entry.freq, 0x01, IChannel, QChannel) != 0)
+			return false;
+		int I = (signed char)IChannel;
+		int Q = (signed char)QChannel;
+		// same 30 % margin the firmware allows before it retunes, plus a
+		// little for the noise of a single measurement
+		if(I * I + Q * Q > entry.IQ + entry.IQ * 3 / 10 + 2)
+		{
+			qDebug("Cached tuning no longer fits at %d kHz, tuning again", entry.freq);
+			return false;
+		}
+	}
+	qDebug("Restored tuning of %d channels from the cache", (int)tuningTable.size());
+	return true;
+}
+// Keeps the tuning table pool reader index got for the band for later runs.
+void KitModel::cacheTuning(int index, FreqBandEnum band, const vector<TuningTableEntry> &tuningTable)
+{
+	if(index >= (int)readerIDs.size() || readerIDs[index].empty())
+		return;
+	tuningCache->store(band, READER_ANTENNA, readerIDs[index], tuningTable);
+	if(!tuningCache->save())
+		qDebug("Failed to save the tuning cache");
+}
+// Runs a reader operation on the I/O thread and waits for it. On the GUI
+// thread events are processed meanwhile, so the window keeps repainting and
+// the progress signals the operation emits get through.
+short KitModel::runReaderOperation(ReaderOperation *operation)
+{
+	short status = asyncReader->submit(operation);
 	if(status != 0)
 		return status;
-	reg0x15Value &= 0xE0;
-	reg0x15Value |= registerEntry;
-	status = reader->writeToAS3993Reg(0x15, reg0x15Value, operationStatus);
-	if (status!=0)
+	bool guiThread = QThread::currentThread() == QCoreApplication::instance()->thread();
+	while(!operation->wait(guiThread ? 50 : -1))
+		QCoreApplication::processEvents();
+	return operation->getStatus();
+}
+// Lets the reader keep band and tuning in its flash, so it hops and tunes
+// right after a reset. Older firmware does not support this.
+void KitModel::storeReaderSettings(int index)
+{
+	char storedTuningTableSize;
+	char status = pool->getReader(index)->storeSettings(storedTuningTableSize);
+	if(status != 0)
+		qDebug("Reader did not store its settings (%d)", status);
+}
+// Appends the events the reader firmware traced since the last call to
+// traceFile. Does nothing if HERMES_TRACE_FILE is not set.
+void KitModel::saveReaderTrace()
+{
+	if(traceFile.empty())
+		return;
+	string trace;
+	short status = reader->readTrace(trace);
+	if(status != 0)
+		qDebug("Could not read the reader trace: %d", status);
+	if(trace.empty())
+		return;
+	QFile file(QString::fromStdString(traceFile));
+	if(!file.open(QIODevice::WriteOnly | QIODevice::Append) || file.write(trace.data(), trace.size()) != (qint64)trace.size())
+		qDebug("Could not write the reader trace to %s", traceFile.c_str());
+}
+// Makes freqs the hop list and tunes the antenna for each of its channels.
+// A tuning table cached for this reader is used if it still fits. Otherwise
+// the reader tunes the band in one request; firmware that can not set up a
+// band is driven channel by channel.
+// The other readers of a pool get the same, without the channel by channel
+// fallback.
+int KitModel::setUpBand(FreqBandEnum band, const int *freqs, int numFreqs, bool reportProgress)
+{
+	if(pool->size() > 1)
+	{
+		// the other readers of the pool restore their cached tuning as well,
+		// only those it no longer fits are tuned, in their transmit slots
+		vector<bool> retune(pool->size(), false);
+		bool anyRetune = false;
+		for(int i = 1; i < pool->size(); i++)
+		{
+			retune[i] = !restoreTuning(i, band, freqs, numFreqs);
+			anyRetune = anyRetune || retune[i];
+		}
+		if(anyRetune)
+		{
+			vector< vector<TuningTableEntry> > tuningTables;
+			char poolStatus = pool->tuneBand(freqs, numFreqs, 0x01, 1, retune, tuningTables);
+			if(poolStatus != 0)
+			{
+				qDebug("Band setup on the other readers failed (%d)", poolStatus);
+				return poolStatus;
+			}
+			for(int i = 1; i < pool->size(); i++)
+			{
+				if(!retune[i])
+					continue;
+				cacheTuning(i, band, tuningTables[i]);
+				storeReaderSettings(i);
+			}
+		}
+	}
+	if(restoreTuning(0, band, freqs, numFreqs))
+	{
+		// the reader did not retune, its flash is not written again
+		if(reportProgress)
+			emit antennaTuningSignal(numFreqs, numFreqs);
+		return 0;
+	}
+	if(reportProgress)
+		emit antennaTuningSignal(0, numFreqs);
+	TuneBandOperation tuning(freqs, numFreqs, 0x01, 1, reportProgress ? &reportTuningProgress : 0, this);
+	char status = runReaderOperation(&tuning);
+	if(status == 0)
+	{
+		const vector<TuningTableEntry> &tuningTable = tuning.getTuningTable();
+		qDebug("Tuned %d channels on the reader", (int)tuningTable.size());
+		cacheTuning(0, band, tuningTable);
+		storeReaderSettings(0);
+		return 0;
+	}
+	qDebug("Band setup on the reader failed (%d), tuning channel by channel", status);
+	char operationStatus;
+	char maxTuningTableSizeSupported;
+	status = reader->deleteCurrentTuningTable(maxTuningTableSizeSupported);
+	if (status != 0)
 		return status;
-	txPower = value;
+	for (int i=0;i<numFreqs;i++)
+	{
+		status = reader->addHoppingFreq(freqs[i], i == 0 ? 0x01 : 0x00, 1, operationStatus);
+		if(status != 0)
+		{
+			qDebug("Failed to add channel to hop table");
+			return status;
+		}
+		status=autotune(freqs[i]);
+		if (status != 0)
+		{
+			qDebug("autotune failed");
+			return status;
+		}
+		if (reportProgress && i > 0)
+			emit antennaTuningSignal(i,numFreqs);
+	}
+	if (reportProgress)
+		emit antennaTuningSignal(numFreqs,numFreqs);
 	return 0;
 }
 int KitModel::setFrequencyBand(FreqBandEnum band)
 {
 	char status;
 	char operationStatus;
-	char maxTuningTableSizeSupported;
 	if (band==FCC)
 	{
 		qDebug("Changing band to FCC");
-		emit antennaTuningSignal(0,50);
-		status = reader->deleteCurrentTuningTable(maxTuningTableSizeSupported);
+		status = setUpBand(band, FCCBandFreqs, 50, true);
 		if (status != 0)
 			return status;
-		status = reader->addHoppingFreq(FCCBandFreqs[0], 0x01, 1, operationStatus);
-		if(status != 0)
-			return status;
-		status = autotune(FCCBandFreqs[0]);
-		if (status != 0)
-			return status;
-		for (int i=1;i<=49;i++)
-		{
-			status = reader->addHoppingFreq(FCCBandFreqs[i], 0x00, 1, operationStatus);
-			if(status != 0)
-			{
-				qDebug("Failed to add channel to hop table");
-				return status;
-			}
-			status=autotune(FCCBandFreqs[i]);
-			if (status != 0)
-				return status;
-			emit antennaTuningSignal(i,50);
-		}
 		centerFrequency=915000;
-		emit antennaTuningSignal(50,50);	
 	}
 	else if (band==ETSI)
 	{
 		qDebug("Changing band to ETSI");
-		status = reader->deleteCurrentTuningTable(maxTuningTableSizeSupported);
+		status = setUpBand(band, ETSIBandFreqs, 4, false);
 		if (status != 0)
 			return status;
-		status = reader->addHoppingFreq(ETSIBandFreqs[0], 0x01, 1, operationStatus);
-		if(status != 0)
-			return status;
-		status = autotune(ETSIBandFreqs[0]);
-		if (status != 0)
-			return status;
-		for (int i=1;i<=3;i++)
-		{
-			status = reader->addHoppingFreq(ETSIBandFreqs[i], 0x00, 1, operationStatus);
-			if(status != 0)
-				return status;
-			status = autotune(ETSIBandFreqs[i]);
-			if (status != 0)
-			{
-				qDebug("autotune failed");
-				return status;
-			}
-		}
 		qDebug("ETSI Tuning complete");
 		centerFrequency=866600;
 	}
 	else if (band==PRC)
 	{
-		emit antennaTuningSignal(0,16);
-		status = reader->deleteCurrentTuningTable(maxTuningTableSizeSupported);
-		if (status != 0)
-			return status;
-		status = reader->addHoppingFreq(PRCBandFreqs[0], 0x01, 1, operationStatus);
-		if(status != 0)
-			return status;
-		status = autotune(PRCBandFreqs[0]);
+		status = setUpBand(band, PRCBandFreqs, 16, true);
 		if (status != 0)
 			return status;
-		for (int i=1;i<=15;i++)
-		{
-			status = reader->addHoppingFreq(PRCBandFreqs[i], 0x00, 1, operationStatus);
-			if(status != 0)
-			{
-				qDebug("Failed to add channel to hop table");
-				return status;
-			}
-			status=autotune(PRCBandFreqs[i]);
-			if (status != 0)
-				return status;
-			emit antennaTuningSignal(i,16);
-		}
 		centerFrequency=922375;
-		emit antennaTuningSignal(16,16);	
 	}
 	else if (band==JAPAN)
 	{
-		emit antennaTuningSignal(0,6);
-		status = reader->deleteCurrentTuningTable(maxTuningTableSizeSupported);
+		status = setUpBand(band, JPNBandFreqs, 6, true);
 		if (status != 0)
 			return status;
-		status = reader->addHoppingFreq(JPNBandFreqs[0], 0x01, 1, operationStatus);
-		if(status != 0)
-			return status;
-		status = autotune(JPNBandFreqs[0]);
-		if (status != 0)
-			return status;
-		for (int i=1;i<=5;i++)
-		{
-			status = reader->addHoppingFreq(JPNBandFreqs[i], 0x00, 1, operationStatus);
-			if(status != 0)
-			{
-				qDebug("Failed to add channel to hop table");
-				return status;
-			}
-			status=autotune(JPNBandFreqs[i]);
-			if (status != 0)
-				return status;
-			emit antennaTuningSignal(i,6);
-		}
 		centerFrequency=919200;
-		emit antennaTuningSignal(6,6);	
 	}
 	else if (band==FCC_center)
 	{
 		qDebug("Changing band to 915 MHz only");
-		status = reader->deleteCurrentTuningTable(maxTuningTableSizeSupported);
-		if (status != 0)
-			return status;
-		status = reader->addHoppingFreq(915250, 0x01, 1, operationStatus);
-		if(status != 0)
-			return status;
-		status = autotune(915250);
+		const int freq = 915250;
+		status = setUpBand(band, &freq, 1, false);
 		if (status != 0)
 			return status;
 		centerFrequency=915250;
 	}
 	else if (band==ETSI_center)
 	{
-		status = reader->deleteCurrentTuningTable(maxTuningTableSizeSupported);
-		if (status != 0)
-			return status;
-		status = reader->addHoppingFreq(866900, 0x01, 1, operationStatus);
-		if(status != 0)
-			return status;
-		status = autotune(866900);
+		const int freq = 866900;
+		status = setUpBand(band, &freq, 1, false);
 		if (status != 0)
 			return status;
 		centerFrequency=866900;
 	}
-	status = reader->setFreqHoppingParams(1, 400, 0, -40, operationStatus);
-	if(status != 0)
+	for(int i = 0; i < pool->size(); i++)
 	{
-		qDebug("Error setting hopping parameters");
-		return status;
+		status = pool->getReader(i)->setFreqHoppingParams(1, 400, 0, -40, operationStatus);
+		if(status != 0)
+		{
+			qDebug("Error setting hopping parameters");
+			return status;
+		}
 	}
 	currentFreqBand=band;
 	emit bandChangedSignal(band);
@@ -415,255 +515,212 @@ void KitModel::debugPrintTagLists()
 		qDebug(" ");
 	}
 }
-void KitModel::addTagToList(TagData tag, QString measurementType)
+// Called by the thread that measures, after the tag list or its measurements
+// changed. Only the latest measurement of each tag is taken over, the views
+// keep the older ones they need.
+void KitModel::publishTagSnapshot(QString measurementType)
 {
-	int maxNumberOfTags=5;
-	QString tid = QString::fromStdString(tag.getTID());
-	if (tid.length() == 26)
-		tid = tid.right(24);
+	bool temperature = measurementType=="Temperature";
+	QList<SensorTag> &tagList = temperature ? TempTagList : MoistTagList;
+	QList<QDateTime> &measTimeList = temperature ? TempMeasTimeList : MoistMeasTimeList;
+	TagListSnapshot *snapshot = new TagListSnapshot;
+	snapshot->MeasurementCount = measTimeList.length();
+	if (!measTimeList.isEmpty())
+	{
+		snapshot->FirstMeasurementTime = measTimeList.first();
+		snapshot->LastMeasurementTime = measTimeList.last();
+	}
+	snapshot->Tags.resize(tagList.length());
+	for (int t=0; t<tagList.length(); t++)
+	{
+		SensorTag &sensorTag = tagList[t];
+		TagSnapshot &tag = snapshot->Tags[t];
+		tag.Epc = sensorTag.getEpc();
+		tag.Label = sensorTag.Label;
+		tag.Model = sensorTag.getModel();
+		tag.CrcValid = sensorTag.getCrcValid();
+		tag.SelectedForMeasurement = sensorTag.SelectedForMeasurement;
+		QList<SensorMeasurement> &values = temperature ? sensorTag.TemperatureMeasurementHistory : sensorTag.SensorMeasurementHistory;
+		tag.Measured = !values.isEmpty() && !sensorTag.OnChipRssiMeasurementHistory.isEmpty();
+		if (tag.Measured)
+		{
+			tag.Value = values.last();
+			tag.OnChipRssi = sensorTag.OnChipRssiMeasurementHistory.last();
+		}
+	}
+	QMutexLocker locker(&snapshotLock);
+	if (temperature)
+		tempSnapshot = TagListSnapshotPointer(snapshot);
 	else
+		moistSnapshot = TagListSnapshotPointer(snapshot);
+}
+// The latest published snapshot of the temperature or moisture tags
+TagListSnapshotPointer KitModel::getTagSnapshot(QString measurementType)
+{
+	QMutexLocker locker(&snapshotLock);
+	return measurementType=="Temperature" ? tempSnapshot : moistSnapshot;
+}
+// Tags are only listed once their temperature calibration has been read.
+void KitModel::addTagToList(TagData &tag, QString measurementType)
+{
+	bool temperature = measurementType=="Temperature";
+	if (!temperature && measurementType!="Moisture")
 		return;
-	if (tid.left(5) != "e2824")
+	if (tag.getTIDLength() != 12)
 		return;
-	if (measurementType=="Temperature" && tid.mid(5,2)!="03")
+	const unsigned char *tidBytes = tag.getTID();
+	if (tidBytes[0] != 0xe2 || tidBytes[1] != 0x82 || (tidBytes[2] >> 4) != 0x4)	// TID starts with e2824
 		return;
-	QString epc = QString::fromStdString(tag.getEPC());
-	if (epc.length() > 2)
-		epc = epc.right(epc.length()-2);
-	else
-		epc = "";
-	QString tempCal = QString::fromStdString(tag.getTempCalibrationParams());
-	if (tempCal.length() == 18)
-		tempCal = tempCal.right(16);
-	else
-		tempCal = "";
-	if (measurementType=="Temperature")
+	if (temperature && ((tidBytes[2] & 0x0f) << 4 | tidBytes[3] >> 4) != 0x03)
+		return;
+	QList<SensorTag> &tagList = temperature ? TempTagList : MoistTagList;
+	TagRegistry &registry = temperature ? TempTagRegistry : MoistTagRegistry;
+	bool tempCalRead = tag.getTempCalibrationLength() == TAG_CALIBRATION_SIZE;
+	int handle = registry.find(tag.getEPC(), tag.getEPCLength());
+	if (handle >= 0)
 	{
-		if (TempTagList.length()>=maxNumberOfTags)
-			return;
-		bool tagAlreadyInList=false;
-		for (int t=0; t<TempTagList.length(); t++)
-		{		
-			if (TempTagList[t].getEpc()==epc)
-			{
-				tagAlreadyInList=true;
-				if (tempCal.length() == 16)
-				{
-					for (int i=0;i<=3;i++)
-						TempTagList[t].setUserMemory(8+i, UtilityFunctions::HexWordToInt(tempCal.mid(4*i,4)));
-					TempTagList[t].decodeTemperatureCalWords();
-				}	
-				break;
-			}			
-		}
-		if (tagAlreadyInList == false)
+		if (tempCalRead)
 		{
-			SensorTag newTag;
-			newTag.setEpc(epc);
-			newTag.setTid(tid);
-			QString abbreviatedEpc=UtilityFunctions::AbbreviatedEpc(epc);
-			newTag.Label=abbreviatedEpc;
-			bool labelIsUnique;
-			do
-			{
-				labelIsUnique=true;
-				for (int t=0; t<TempTagList.length(); t++)
-				{
-					if (newTag.Label == TempTagList[t].Label)
-					{
-						labelIsUnique=false;
-						if (newTag.Label==abbreviatedEpc)
-							newTag.Label=abbreviatedEpc+"_0";
-						else
-						{
-							int underscoreIndex = newTag.Label.indexOf("_");
-							int len = newTag.Label.length();
-							int num = newTag.Label.right(len-underscoreIndex-1).toInt();
-							num++;
-							newTag.Label = abbreviatedEpc + "_" + QString::number(num);
-						}					
-					}
-				}		
-			} while (labelIsUnique==false);		
-			if (tempCal.length()==16)
-			{
-				for (int i=0;i<=3;i++)
-					newTag.setUserMemory(8+i, UtilityFunctions::HexWordToInt(tempCal.mid(4*i,4)));
-				newTag.decodeTemperatureCalWords();
-				TempTagList.append(newTag);
-			}		
-		}		
-	}
-	if (measurementType=="Moisture")
-	{
-		if (MoistTagList.length()>=maxNumberOfTags)
-			return;
-		bool tagAlreadyInList=false;
-		for (int t=0; t<MoistTagList.length(); t++)
-		{		
-			if (MoistTagList[t].getEpc()==epc)
-			{
-				tagAlreadyInList=true;
-				if (tempCal.length() == 16)
-				{
-					for (int i=0;i<=3;i++)
-						MoistTagList[t].setUserMemory(8+i, UtilityFunctions::HexWordToInt(tempCal.mid(4*i,4)));
-					MoistTagList[t].decodeTemperatureCalWords();
-				}	
-				break;
-			}			
+			for (int i=0;i<=3;i++)
+				tagList[handle].setUserMemory(8+i, tag.getTempCalibrationWord(i));
+			tagList[handle].decodeTemperatureCalWords();
 		}
-		if (tagAlreadyInList == false)
-		{
-			SensorTag newTag;
-			newTag.setEpc(epc);
-			newTag.setTid(tid);
-			QString abbreviatedEpc=UtilityFunctions::AbbreviatedEpc(epc);
-			newTag.Label=abbreviatedEpc;
-			bool labelIsUnique;
-			do
-			{
-				labelIsUnique=true;
-				for (int t=0; t<MoistTagList.length(); t++)
-				{
-					if (newTag.Label == MoistTagList[t].Label)
-					{
-						labelIsUnique=false;
-						if (newTag.Label==abbreviatedEpc)
-							newTag.Label=abbreviatedEpc+"_0";
-						else
-						{
-							int underscoreIndex = newTag.Label.indexOf("_");
-							int len = newTag.Label.length();
-							int num = newTag.Label.right(len-underscoreIndex-1).toInt();
-							num++;
-							newTag.Label = abbreviatedEpc + "_" + QString::number(num);
-						}					
-					}
-				}		
-			} while (labelIsUnique==false);		
-			if (tempCal.length()==16)
-			{
-				for (int i=0;i<=3;i++)
-					newTag.setUserMemory(8+i, UtilityFunctions::HexWordToInt(tempCal.mid(4*i,4)));
-				newTag.decodeTemperatureCalWords();
-				MoistTagList.append(newTag);
-			}		
-		}		
+		return;
 	}
+	if (!tempCalRead)
+		return;
+	char tid[TAG_TID_HEX_SIZE];
+	tag.getTIDHex(tid);
+	char epcHex[TAG_EPC_HEX_SIZE];
+	tag.getEPCHex(epcHex);
+	QLatin1String epc(epcHex);
+	SensorTag newTag;
+	newTag.setEpc(epc);
+	newTag.setTid(QLatin1String(tid));
+	newTag.Label=registry.uniqueLabel(UtilityFunctions::AbbreviatedEpc(epc));
+	for (int i=0;i<=3;i++)
+		newTag.setUserMemory(8+i, tag.getTempCalibrationWord(i));
+	newTag.decodeTemperatureCalWords();
+	registry.insert(tag.getEPC(), tag.getEPCLength(), tagList.length());
+	tagList.append(newTag);
 }
 int KitModel::findTags(int numInventories, QString measurementType)
 {
 	char status;
-	vector<TagData> tags;
-	char numberOfTagsFound;	
-	char inventoryResult;
-	char inventoryType;
-	status = reader->clearListOfSelectCommands();
-	if(status != 0)
-		return status;
-	for (int i=1; i<=numInventories; i++)
+	for(int i = 0; i < pool->size(); i++)
 	{
-		status = reader->performGen2Inventory(0, 0x03, 0x06);
+		status = pool->getReader(i)->clearListOfSelectCommands();
 		if(status != 0)
 			return status;
-		status = reader->getTagData(tags, inventoryType, inventoryResult, numberOfTagsFound);
-		if(status != 0)
-			break;	
-		if(inventoryResult != 0)
-			break;
-		for (unsigned j=0; j<tags.size(); j++)
-			addTagToList(tags.at(j), measurementType);		
 	}
-	return 0;
-}
-int KitModel::setSelectsForReading()
-{
-	// Select commands must be set before calling
-	char status;
-	status = reader->clearListOfSelectCommands();
-	if(status != 0)
-		return status;	
-	char mask = 0x1F;
-	status = reader->singulateATag(1, 0x03, 0x06, 3, 0xA0, 0x08, 0, &mask, 1); // Magnus 2 On-Chip RSSI Select
-	if(status != 0)
-		return status;
-	status = reader->singulateATag(1, 0x03, 0x06, 3, 0xD0, 0x08, 0, &mask, 1); // Magnus 3 On-Chip RSSI Select
-	if(status != 0)
-		return status;
-	mask = 0;
-	status = reader->singulateATag(1, 0x03, 0x06, 3, 0xE0, 0, 0, &mask, 0); // Magnus 3 Temperature Select
+	tagBuffer.clear();
+	status = inventoryRounds(numInventories, 0x03, tagBuffer);
 	if(status != 0)
 		return status;
+	for (unsigned j=0; j<tagBuffer.size(); j++)
+		addTagToList(tagBuffer[j], measurementType);		
+	publishTagSnapshot(measurementType);
 	return 0;
 }
-void KitModel::addSensorReading(TagData tag, QString measurementType)
+// Collects the tags of numInventories inventory rounds. A single round is
+// polled. Longer runs let the reader cycle through the rounds on its own and
+// push each result, which saves the two round trips and the idle gap that
+// polling costs per round. With several readers all of them take part, each
+// on its own I/O thread.
+int KitModel::inventoryRounds(int numInventories, char tidAndFast, vector<TagData> &tags)
 {
-	QString epc = QString::fromStdString(tag.getEPC());
-	if (epc.length() > 2)
-		epc = epc.right(epc.length()-2);
-	else
-		epc = "";
-	if (measurementType=="Temperature")
+	char status;
+	if(pool->size() > 1)
+		return pool->inventory(numInventories < 1 ? 1 : numInventories, tidAndFast, 0x06, tags);
+	if(numInventories <= 1)
 	{
-		for (int i=0; i<TempTagList.length(); i++)
-		{
-			if (TempTagList[i].getEpc() == epc && TempTagList[i].SelectedForMeasurement)
-			{
-				SensorRead sr;
-				sr.setFrequencyKHz(tag.getCommFrequency());
-				sr.setReadPower(txPower);
-				sr.setSensorCode(tag.getMMS());
-				sr.setOnChipRssiCode(tag.getVFC());
-				sr.setTemperatureCode(tag.getTEMP());
-				TempTagList[i].addSensorRead(sr);
-				break;
-			}
-		}
+		char numberOfTagsFound;	
+		char inventoryResult;
+		char inventoryType;
+		status = reader->performGen2Inventory(0, tidAndFast, 0x06);
+		if(status != 0)
+			return status;
+		reader->getTagData(tags, inventoryType, inventoryResult, numberOfTagsFound);
+		saveReaderTrace();
+		return 0;
 	}
-	else if (measurementType=="Moisture")
+	status = reader->startTagStream(0, tidAndFast | INVENTORY_STREAM_TAGS, 0x06);
+	if(status != 0)
+		return status;
+	TagData tag;
+	unsigned int rounds, tagsDropped, framesDropped;
+	QTime timer;
+	timer.start();
+	do
 	{
-		for (int i=0; i<MoistTagList.length(); i++)
-		{
-			if (MoistTagList[i].getEpc() == epc && MoistTagList[i].SelectedForMeasurement)
-			{
-				SensorRead sr;
-				sr.setFrequencyKHz(tag.getCommFrequency());
-				sr.setReadPower(txPower);
-				sr.setSensorCode(tag.getMMS());
-				sr.setOnChipRssiCode(tag.getVFC());
-				sr.setTemperatureCode(tag.getTEMP());
-				MoistTagList[i].addSensorRead(sr);
-				break;
-			}
-		}
-	}
+		while(reader->readStreamedTag(tag))
+			tags.push_back(tag);
+		reader->getTagStreamCounters(rounds, tagsDropped, framesDropped);
+		if(rounds >= (unsigned)numInventories)
+			break;
+		QThread::msleep(5);
+	} while(timer.elapsed() < numInventories * INVENTORY_ROUND_TIMEOUT);
+	status = reader->stopTagStream();
+	while(reader->readStreamedTag(tag))
+		tags.push_back(tag);
+	reader->getTagStreamCounters(rounds, tagsDropped, framesDropped);
+	if(tagsDropped != 0 || framesDropped != 0)
+		qDebug("Tag stream: %u rounds, %u tags and %u frames dropped", rounds, tagsDropped, framesDropped);
+	saveReaderTrace();
+	return status;
 }
-int KitModel::readTags(int numInventories, QString measurementType)
+int KitModel::setSelectsForReading()
 {
+	// Select commands must be set before calling
 	char status;
-	TagData tag;
-	vector<TagData> tags;
-	char numberOfTagsFound;	
-	char inventoryResult;
-	char inventoryType;
-	for(int i = 1; i <= numInventories; i++) 
+	for(int i = 0; i < pool->size(); i++)
 	{
-		status = reader->performGen2Inventory(0, 0x05, 0x06);
+		AMSRadonReader *poolReader = pool->getReader(i);
+		poolReader->beginPipeline(4);
+		poolReader->clearListOfSelectCommands();
+		char mask = 0x1F;
+		poolReader->singulateATag(1, 0x03, 0x06, 3, 0xA0, 0x08, 0, &mask, 1); // Magnus 2 On-Chip RSSI Select
+		poolReader->singulateATag(1, 0x03, 0x06, 3, 0xD0, 0x08, 0, &mask, 1); // Magnus 3 On-Chip RSSI Select
+		mask = 0;
+		poolReader->singulateATag(1, 0x03, 0x06, 3, 0xE0, 0, 0, &mask, 0); // Magnus 3 Temperature Select
+		status = poolReader->endPipeline();
 		if(status != 0)
 			return status;
-		status = reader->getTagData(tags, inventoryType, inventoryResult, numberOfTagsFound);
-		if(status != 0)
-			break;	
-		if(inventoryResult != 0)
-			break;
-		for (unsigned j=0; j<tags.size(); j++)
-		{	
-			addSensorReading(tags.at(j), measurementType);	
-		}	
 	}
 	return 0;
 }
+void KitModel::addSensorReading(TagData &tag, QString measurementType)
+{
+	bool temperature = measurementType=="Temperature";
+	if (!temperature && measurementType!="Moisture")
+		return;
+	QList<SensorTag> &tagList = temperature ? TempTagList : MoistTagList;
+	TagRegistry &registry = temperature ? TempTagRegistry : MoistTagRegistry;
+	int handle = registry.find(tag.getEPC(), tag.getEPCLength());
+	if (handle < 0 || !tagList[handle].SelectedForMeasurement)
+		return;
+	SensorRead sr;
+	sr.setFrequencyKHz(tag.getCommFrequency());
+	sr.setReadPower(txPower);
+	sr.setSensorCode(tag.getMMS());
+	sr.setOnChipRssiCode(tag.getVFC());
+	sr.setTemperatureCode(tag.getTEMP());
+	tagList[handle].addSensorRead(sr);
+	powerModel->addRead(tagList[handle].getEpc(), currentFreqBand, sr);
+}
+int KitModel::readTags(int numInventories, QString measurementType)
+{
+	char status;
+	tagBuffer.clear();
+	status = inventoryRounds(numInventories, 0x05, tagBuffer);
+	if(status != 0)
+		return status;
+	for (unsigned j=0; j<tagBuffer.size(); j++)
+	{	
+		addSensorReading(tagBuffer[j], measurementType);	
+	}	
+	return 0;
+}
 bool KitModel::validTempTagsInList()
 {
 	for (int i=0; i<TempTagList.length(); i++)
@@ -700,6 +757,9 @@ bool KitModel::findOptimumPower(int tagIndex, QString measurementType)
 		}
 		else
 			nextPowerCode = (19+tempMaxPower)/2;		
+		int predictedPowerCode = powerModel->predictPower(TempTagList[t].getEpc(), currentFreqBand, TempTargetOnChipRssiMin, TempTargetOnChipRssiMax, tempMaxPower);
+		if (predictedPowerCode >= 0)
+			nextPowerCode = predictedPowerCode;
 		int stepSize=7;
 		for (int i=1; i<=6; i++)  // Maximum of 6 iterations to look for power
 		{
@@ -812,6 +872,9 @@ bool KitModel::findOptimumPower(int tagIndex, QString measurementType)
 		}
 		else
 			nextPowerCode = (19+moistMaxPower)/2;		
+		int predictedPowerCode = powerModel->predictPower(MoistTagList[t].getEpc(), currentFreqBand, MoistTargetOnChipRssiMin, MoistTargetOnChipRssiMax, moistMaxPower);
+		if (predictedPowerCode >= 0)
+			nextPowerCode = predictedPowerCode;
 		int stepSize=7;
 		for (int i=1; i<=6; i++)  // Maximum of 6 iterations to look for power
 		{
@@ -1037,210 +1100,181 @@ int KitModel::writeDataToTag(QString epc, char bankCode, int address, QString da
 }
 int KitModel::measureTempTags()
 {
-	int validTempCount;
-	int validOcRssiCount;
-	for (int t=0; t<TempTagList.length(); t++)
-	{
-		TempTagList[t].clearSensorReads();
-	}
-	for (int t=0; t<TempTagList.length(); t++)
-	{
-		if (txPower!=tempMaxPower)
-			setPower(tempMaxPower);
-		findTags(2, "Temperature");
-		setSelectsForReading();		
-		if (TempTagList[t].getCrcValid()==true && TempTagList[t].SelectedForMeasurement)
-		{
-			if (this->abort)
-				return 0;
-			float temp;	
-			bool goodPower=true;
-			if (tempAutoPower==true)
-			{
-				goodPower = findOptimumPower(t, "Temperature");
-			}
-			for (int r=0; r<=4*tempMinSamplesPerMeas; r++)
-			{
-				if (this->abort)
-					return 0;
-				if (tempAutoPower == true)
-				{
-					temp = TempTagList[t].calculateTemperature(TempTargetOnChipRssiMin, TempTargetOnChipRssiMax, tempMinSamplesPerMeas, validTempCount);
-					qDebug("Tag %d read iteration %d temp: %f", t, r, temp);
-					if (goodPower==false)
-						break;
-				}
-				else
-				{
-					temp = TempTagList[t].calculateTemperature(0, 31, tempMinSamplesPerMeas, validTempCount);
-					qDebug("Tag %d read iteration %d temp: %f", t, r, temp);
-				}
-				if (r==2*tempMinSamplesPerMeas && validTempCount <= tempMinSamplesPerMeas/3)
-					break; // Give up on this round
-				if (temp > -100)
-				{
-					break;
-				}
-				if (tempAutoPower == true)
-				{
-					int ocRssi = TempTagList[t].getLastOnChipRssiReading();
-					// Check if On-Chip RSSI is outside limits and tweak power if necessary
-					if (ocRssi<TempTargetOnChipRssiMin && ocRssi>0 && txPower > tempMaxPower)
-						setPower(txPower-1);
-					if (ocRssi>TempTargetOnChipRssiMax && ocRssi>0 && txPower < 18)
-						setPower(txPower+1);
-					// If on-Chip RSSI target range is wide enough, try to get away from low rssi values for better read reliability
-					if (TempTargetOnChipRssiMin<12 && TempTargetOnChipRssiMax > (TempTargetOnChipRssiMin+6))
-					{
-						int targetMiddle=(TempTargetOnChipRssiMin+TempTargetOnChipRssiMax)/2;
-						if (ocRssi>0 && ocRssi<=targetMiddle && txPower > tempMaxPower)
-							setPower(txPower-1);
-					}
-				}
-				readTags(1, "Temperature");
-			}
-			int totalCount=TempTagList[t].SensorReadHistory.length();
-			float avgOcRssi;
-			if (tempAutoPower)
-			{
-				temp = TempTagList[t].calculateTemperature(TempTargetOnChipRssiMin, TempTargetOnChipRssiMax, tempMinSamplesPerMeas, validTempCount);
-				avgOcRssi = TempTagList[t].avgOnChipRssiCode(TempTargetOnChipRssiMin, TempTargetOnChipRssiMax, tempMinSamplesPerMeas, validOcRssiCount);
-			}
-			else
-			{
-				temp = TempTagList[t].calculateTemperature(0, 31, tempMinSamplesPerMeas, validTempCount);
-				avgOcRssi = TempTagList[t].avgOnChipRssiCode(0, 31, tempMinSamplesPerMeas, validOcRssiCount);
-			}
-			qDebug("Tag %d final temp: %f", t, temp);
-			SensorMeasurement tempMeas;
-			tempMeas.setValue(temp);
-			tempMeas.setTime();
-			tempMeas.setNumber(TempMeasTimeList.length());
-			tempMeas.setReadPowerCode(txPower);
-			tempMeas.setValidPowerReadCount(validTempCount);
-			tempMeas.setInvalidPowerReadCount(totalCount-validTempCount);
-			SensorMeasurement ocRssiMeas;
-			ocRssiMeas.setValue(avgOcRssi);
-			ocRssiMeas.setTime();
-			ocRssiMeas.setNumber(TempMeasTimeList.length());
-			ocRssiMeas.setReadPowerCode(txPower);
-			ocRssiMeas.setValidPowerReadCount(validOcRssiCount);
-			ocRssiMeas.setInvalidPowerReadCount(totalCount-validOcRssiCount);
-			TempTagList[t].addTemperatureMeasurement(tempMeas);
-			TempTagList[t].addOnChipRssiMeasurement(ocRssiMeas);
-		}		
-	}
-	TempMeasTimeList.append(QDateTime::currentDateTime());
-	return 0;	
+	return measureTagsInBatch("Temperature");
 }
 int KitModel::measureMoistTags()
 {
-	int validMoistCount;
-	int validOcRssiCount;
-	for (int t=0; t<MoistTagList.length(); t++)
+	return measureTagsInBatch("Moisture");
+}
+// Estimate from the reads of the tag so far: the temperature or the sensor
+// code, -1000 if there are not enough reads. With auto power only the reads
+// with an on-chip RSSI in the target window count.
+float KitModel::sensorEstimate(SensorTag &tag, bool temperature, int &validCount)
+{
+	if (temperature)
 	{
-		MoistTagList[t].clearSensorReads();
+		if (tempAutoPower)
+			return tag.calculateTemperature(TempTargetOnChipRssiMin, TempTargetOnChipRssiMax, tempMinSamplesPerMeas, validCount);
+		return tag.calculateTemperature(0, 31, tempMinSamplesPerMeas, validCount);
 	}
-	for (int t=0; t<MoistTagList.length(); t++)
+	int minOnChipRssi = moistAutoPower ? MoistTargetOnChipRssiMin : 0;
+	int maxOnChipRssi = moistAutoPower ? MoistTargetOnChipRssiMax : 31;
+	if (moistLinearRegression)
+		return tag.linearFitSensorCode(minOnChipRssi, maxOnChipRssi, moistMinSamplesPerMeas, centerFrequency, validCount);
+	return tag.avgSensorCode(minOnChipRssi, maxOnChipRssi, moistMinSamplesPerMeas, validCount);
+}
+struct BatchTag
+{
+	int handle;	// index in the tag list
+	int rounds;	// inventory rounds run at its power
+	int power;	// attenuation the tag is read best at
+	bool done;
+};
+// Measures all selected tags together. Every inventory round reads all tags in
+// the field, so the rounds are shared: each runs at the power of the unfinished
+// tag with the fewest rounds so far, and every tag keeps the reads it got. Tags
+// read at the power of the round adjust their power from their on-chip RSSI.
+// A tag is done once its estimate is good or its rounds are used up, so a
+// sweep takes about as long as the slowest tag.
+int KitModel::measureTagsInBatch(QString measurementType)
+{
+	bool temperature = measurementType=="Temperature";
+	QList<SensorTag> &tagList = temperature ? TempTagList : MoistTagList;
+	QList<QDateTime> &measTimeList = temperature ? TempMeasTimeList : MoistMeasTimeList;
+	bool autoPower = temperature ? tempAutoPower : moistAutoPower;
+	int maxPower = temperature ? tempMaxPower : moistMaxPower;
+	int minSamples = temperature ? tempMinSamplesPerMeas : moistMinSamplesPerMeas;
+	int targetMin = temperature ? TempTargetOnChipRssiMin : MoistTargetOnChipRssiMin;
+	int targetMax = temperature ? TempTargetOnChipRssiMax : MoistTargetOnChipRssiMax;
+	for (int t=0; t<tagList.length(); t++)
+		tagList[t].clearSensorReads();
+	if (txPower!=maxPower)
+		setPower(maxPower);
+	findTags(2, measurementType);
+	setSelectsForReading();
+	QVector<BatchTag> batch;
+	for (int t=0; t<tagList.length(); t++)
 	{
-		if (txPower!=moistMaxPower)
-			setPower(moistMaxPower);
-		findTags(2, "Moisture");
-		setSelectsForReading();		
-		if (MoistTagList[t].SelectedForMeasurement)
+		if (!tagList[t].SelectedForMeasurement || (temperature && !tagList[t].getCrcValid()))
+			continue;
+		BatchTag b;
+		b.handle = t;
+		b.rounds = 0;
+		b.power = maxPower;
+		b.done = false;
+		if (autoPower)
 		{
-			if (this->abort)
-				return 0;
-			float moist;	
-			bool goodPower=true;
-			if (moistAutoPower==true)
+			// start at the power the model predicts, else where the last
+			// measurement of the tag ended up
+			b.power = powerModel->predictPower(tagList[t].getEpc(), currentFreqBand, targetMin, targetMax, maxPower);
+			if (b.power < 0)
 			{
-				goodPower = findOptimumPower(t, "Moisture");
+				QList<SensorMeasurement> &history = tagList[t].OnChipRssiMeasurementHistory;
+				b.power = history.isEmpty() ? (19+maxPower)/2 : history.last().getReadPowerCode();
+				b.power = qBound(maxPower, b.power, 19);
 			}
-			for (int r=0; r<=4*moistMinSamplesPerMeas; r++)
+		}
+		batch.append(b);
+	}
+	QVector<int> readCounts(batch.size());
+	while (true)
+	{
+		if (this->abort)
+			return 0;
+		int next = -1;
+		for (int i=0; i<batch.size(); i++)
+		{
+			BatchTag &b = batch[i];
+			if (b.done)
+				continue;
+			int validCount;
+			float value = sensorEstimate(tagList[b.handle], temperature, validCount);
+			bool good = temperature ? value > -100 : value > -1;
+			bool hopeless = b.rounds >= 2*minSamples && validCount <= minSamples/3;
+			if (good || hopeless || b.rounds > 4*minSamples)
 			{
-				if (this->abort)
-					return 0;
-				if (moistAutoPower == true)
-				{						
-					if (moistLinearRegression)
-						moist = MoistTagList[t].linearFitSensorCode(MoistTargetOnChipRssiMin, MoistTargetOnChipRssiMax, moistMinSamplesPerMeas, centerFrequency, validMoistCount);
-					else
-						moist = MoistTagList[t].avgSensorCode(MoistTargetOnChipRssiMin, MoistTargetOnChipRssiMax, moistMinSamplesPerMeas, validMoistCount);			
-					qDebug("Tag %d read iteration %d moist: %f", t, r, moist);
-					if (goodPower==false)
-						break;
-				}
-				else
-				{
-					if (moistLinearRegression)
-						moist = MoistTagList[t].linearFitSensorCode(0, 31, moistMinSamplesPerMeas, centerFrequency, validMoistCount);
-					else
-						moist = MoistTagList[t].avgSensorCode(0, 31, moistMinSamplesPerMeas, validMoistCount);					
-					qDebug("Tag %d read iteration %d moist: %f", t, r, moist);
-				}
-				if (r==2*moistMinSamplesPerMeas && validMoistCount <= moistMinSamplesPerMeas/3)
-					break; // It's hopeless
-				if (moist > -1)
-				{
-					break;
-				}
-				if (moistAutoPower == true)
-				{
-					int ocRssi = MoistTagList[t].getLastOnChipRssiReading();
-					if (ocRssi<MoistTargetOnChipRssiMin && ocRssi>0 && txPower > moistMaxPower)
-						setPower(txPower-1);
-					if (ocRssi>MoistTargetOnChipRssiMax && ocRssi>0 && txPower < 18)
-						setPower(txPower+1);
-					// If on-Chip RSSI target range is wide enough, try to get away from low rssi values for better read reliability
-					if (MoistTargetOnChipRssiMin<12 && MoistTargetOnChipRssiMax > (MoistTargetOnChipRssiMin+6))
-					{
-						int targetMiddle=(MoistTargetOnChipRssiMin+MoistTargetOnChipRssiMax)/2;
-						if (ocRssi>0 && ocRssi<=targetMiddle && txPower > moistMaxPower)
-							setPower(txPower-1);
-					}
-					
-				}
-				readTags(1, "Moisture");
+				b.done = true;
+				continue;
 			}
-			int totalCount=MoistTagList[t].SensorReadHistory.length();
-			float avgOcRssi;
-			if (moistAutoPower)
+			if (next < 0 || b.rounds < batch[next].rounds)
+				next = i;
+		}
+		if (next < 0)
+			break;
+		int power = batch[next].power;
+		if (txPower!=power)
+			setPower(power);
+		for (int i=0; i<batch.size(); i++)
+			readCounts[i] = tagList[batch[i].handle].SensorReadHistory.length();
+		readTags(1, measurementType);
+		for (int i=0; i<batch.size(); i++)
+		{
+			BatchTag &b = batch[i];
+			if (b.done || b.power!=power)
+				continue;
+			b.rounds++;
+			if (!autoPower)
+				continue;
+			SensorTag &tag = tagList[b.handle];
+			if (tag.SensorReadHistory.length()==readCounts[i])
 			{
-				if (moistLinearRegression)
-					moist = MoistTagList[t].linearFitSensorCode(MoistTargetOnChipRssiMin, MoistTargetOnChipRssiMax, moistMinSamplesPerMeas, centerFrequency, validMoistCount);
-				else
-					moist = MoistTagList[t].avgSensorCode(MoistTargetOnChipRssiMin, MoistTargetOnChipRssiMax, moistMinSamplesPerMeas, validMoistCount);
-				avgOcRssi = MoistTagList[t].avgOnChipRssiCode(MoistTargetOnChipRssiMin, MoistTargetOnChipRssiMax, moistMinSamplesPerMeas, validOcRssiCount);
+				// not read at all, more power
+				b.power = qMax(maxPower, b.power-2);
+				continue;
 			}
-			else
+			int ocRssi = tag.getLastOnChipRssiReading();
+			// Check if On-Chip RSSI is outside limits and tweak power if necessary
+			if (ocRssi<targetMin && ocRssi>0 && b.power > maxPower)
+				b.power--;
+			if (ocRssi>targetMax && ocRssi>0 && b.power < 18)
+				b.power++;
+			// If on-Chip RSSI target range is wide enough, try to get away from low rssi values for better read reliability
+			if (targetMin<12 && targetMax > (targetMin+6))
 			{
-				if (moistLinearRegression)
-					moist = MoistTagList[t].linearFitSensorCode(0, 31, moistMinSamplesPerMeas, centerFrequency, validMoistCount);
-				else
-					moist = MoistTagList[t].avgSensorCode(0, 31, moistMinSamplesPerMeas, validMoistCount);
-				avgOcRssi = MoistTagList[t].avgOnChipRssiCode(0, 31, moistMinSamplesPerMeas, validOcRssiCount);
+				int targetMiddle=(targetMin+targetMax)/2;
+				if (ocRssi>0 && ocRssi<=targetMiddle && b.power > maxPower)
+					b.power--;
 			}
-			qDebug("Tag %d final moist: %f", t, moist);
-			SensorMeasurement moistMeas;
-			moistMeas.setValue(moist);
-			moistMeas.setTime();
-			moistMeas.setNumber(MoistMeasTimeList.length());
-			moistMeas.setReadPowerCode(txPower);
-			moistMeas.setValidPowerReadCount(validMoistCount);
-			moistMeas.setInvalidPowerReadCount(totalCount-validMoistCount);
-			SensorMeasurement ocRssiMeas;
-			ocRssiMeas.setValue(avgOcRssi);
-			ocRssiMeas.setTime();
-			ocRssiMeas.setNumber(MoistMeasTimeList.length());
-			ocRssiMeas.setReadPowerCode(txPower);
-			ocRssiMeas.setValidPowerReadCount(validOcRssiCount);
-			ocRssiMeas.setInvalidPowerReadCount(totalCount-validOcRssiCount);
-			MoistTagList[t].addSensorMeasurement(moistMeas);
-			MoistTagList[t].addOnChipRssiMeasurement(ocRssiMeas);
-		}		
+		}
+	}
+	for (int i=0; i<batch.size(); i++)
+	{
+		SensorTag &tag = tagList[batch[i].handle];
+		int validCount;
+		int validOcRssiCount;
+		float value = sensorEstimate(tag, temperature, validCount);
+		float avgOcRssi;
+		if (autoPower)
+			avgOcRssi = tag.avgOnChipRssiCode(targetMin, targetMax, minSamples, validOcRssiCount);
+		else
+			avgOcRssi = tag.avgOnChipRssiCode(0, 31, minSamples, validOcRssiCount);
+		qDebug("Tag %d final %s: %f after %d rounds at power %d", batch[i].handle, qPrintable(measurementType), value, batch[i].rounds, batch[i].power);
+		int totalCount=tag.SensorReadHistory.length();
+		SensorMeasurement valueMeas;
+		valueMeas.setValue(value);
+		valueMeas.setTime();
+		valueMeas.setNumber(measTimeList.length());
+		valueMeas.setReadPowerCode(batch[i].power);
+		valueMeas.setValidPowerReadCount(validCount);
+		valueMeas.setInvalidPowerReadCount(totalCount-validCount);
+		SensorMeasurement ocRssiMeas;
+		ocRssiMeas.setValue(avgOcRssi);
+		ocRssiMeas.setTime();
+		ocRssiMeas.setNumber(measTimeList.length());
+		ocRssiMeas.setReadPowerCode(batch[i].power);
+		ocRssiMeas.setValidPowerReadCount(validOcRssiCount);
+		ocRssiMeas.setInvalidPowerReadCount(totalCount-validOcRssiCount);
+		if (temperature)
+			tag.addTemperatureMeasurement(valueMeas);
+		else
+			tag.addSensorMeasurement(valueMeas);
+		tag.addOnChipRssiMeasurement(ocRssiMeas);
 	}
-	MoistMeasTimeList.append(QDateTime::currentDateTime());
+	measTimeList.append(QDateTime::currentDateTime());
+	publishTagSnapshot(measurementType);
+	if (powerModel->isChanged() && !powerModel->save())
+		qDebug("Could not save the tag power model");
+	saveReaderTrace();
 	return 0;	
 }
 double KitModel::measureTempCodeForCalibration()
@@ -1324,21 +1358,11 @@ int KitModel::numberOfSelectedTempTags()
 }
 bool KitModel::tagInTempTagList(QString epc)
 {
-	for (int t=0;t<TempTagList.length();t++)
-	{
-		if (epc==TempTagList[t].getEpc())
-			return true;
-	}
-	return false;
+	return TempTagRegistry.find(epc) >= 0;
 }
 bool KitModel::tagInMoistTagList(QString epc)
 {
-	for (int t=0;t<MoistTagList.length();t++)
-	{
-		if (epc==MoistTagList[t].getEpc())
-			return true;
-	}
-	return false;
+	return MoistTagRegistry.find(epc) >= 0;
 }
 int KitModel::exportMoistLog(QFile *file)
 {
@@ -1524,45 +1548,13 @@ void KitModel::performInventoriesCheck()
 		qDebug("anntenna sensitivity set failed\n");
 	else
 		qDebug("anntenna sensitivity set ok\n");
-	char reg0x00Value;
-	status = reader->readAS3993Reg(0x00, &reg0x00Value);
-	if(status != 0)
-		qDebug("read reg0x00 failed\n");
-	else
-		qDebug("read reg0x00 ok\n");
-	reg0x00Value &= ~(0x04);
-	reg0x00Value |= 0x04;
-	char operationStatus;
-	status = reader->writeToAS3993Reg(0x00, reg0x00Value, operationStatus);
+	reader->stageAS3993Reg(0x00, 0x04, 0x04);
+	reader->stageAS3993Reg(0x15, 0x1F, 0x10);
+	status = reader->flushAS3993Regs();
 	if(status != 0)
-		qDebug("write reg0x00 failed\n");
+		qDebug("write reg0x00/reg0x15 failed\n");
 	else
-		qDebug("write reg0x00 ok\n");
-	reg0x00Value = 0;
-	status  = reader->readAS3993Reg(0x00, &reg0x00Value);
-	if(status != 0)
-		qDebug("read reg0x00 failed\n");
-	else
-		qDebug("read reg0x00 ok\n");
-	char reg0x15Value;
-	status = reader->readAS3993Reg(0x15, &reg0x15Value);
-	if(status != 0)
-		qDebug("read reg0x15 failed\n");
-	else
-		qDebug("read reg0x15 ok\n");
-	reg0x15Value &= 0xE0;
-	reg0x15Value |= 0x10;
-	status = reader->writeToAS3993Reg(0x15, reg0x15Value, operationStatus);
-	if(status != 0)
-		qDebug("write reg0x15 failed\n");
-	else
-		qDebug("write reg0x15 ok\n");
-	reg0x15Value = 0;
-	status = reader->readAS3993Reg(0x15, &reg0x15Value);
-	if(status != 0)
-		qDebug("read reg0x15 failed\n");
-	else
-		qDebug("read reg0x15 ok\n");
+		qDebug("write reg0x00/reg0x15 ok\n");
 	char storedLinkFreq;
 	status = reader->setLinkFrequency(6, storedLinkFreq);
 	if(status != 0)
@@ -1611,6 +1603,7 @@ void KitModel::performInventoriesCheck()
 		qDebug("target freq set failed\n");
 	else
 		qDebug("target freq set ok\n");
+	char operationStatus;
 	status = reader->setFreqHoppingParams(1, 400, 0, -40, operationStatus);
 	if(status != 0)
 		qDebug("set hopping freq params failed\n");
@@ -1686,26 +1679,13 @@ void KitModel::performInventoriesCheck()
 			}
 		}
 	}
-	char reg0x17Value;
-	status = reader->readAS3993Reg(0x17, &reg0x17Value);
-	if(status != 0)
-		qDebug("read reg0x17 failed\n");
-	else
-		qDebug("read reg0x17 ok\n");
 	char regRefDiv = 0x07 - 3;
-	reg0x17Value &= 0x8F;
-	reg0x17Value |= (regRefDiv << 4);
-	status = reader->writeToAS3993Reg(0x17, reg0x17Value, operationStatus);
+	reader->stageAS3993Reg(0x17, 0x70, regRefDiv << 4);
+	status = reader->flushAS3993Regs();
 	if(status != 0)
 		qDebug("write reg0x17 failed\n");
 	else
 		qDebug("write reg0x17 ok\n");
-	reg0x17Value = 0;
-	status = reader->readAS3993Reg(0x17, &reg0x17Value);
-	if(status != 0)
-		qDebug("read reg0x17 failed\n");
-	else
-		qDebug("read reg0x17 ok\n");
 	qDebug("Performing CAL inventory...\n");
 	vector<TagData> tags;
 	char numberOfTagsFound;	
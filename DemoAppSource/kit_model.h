@@ -25,8 +25,13 @@
 #include "ams_radon_reader.h"
 #include "GPIO.h"
 #include <QFile>
+#include <QMutex>
 
 #define NUMBER_OF_TEMP_INVENTORIES 50
+#define INVENTORY_ROUND_TIMEOUT 300	// ms allowed per streamed inventory round
+#define READER_MAX_BAUD_RATE 1000000
+#define READER_ANTENNA 2
+#define TUNING_CACHE_SPOT_CHECKS 3	// channels measured before a cached tuning table is trusted
 
 class GUIView;
 class QFile;
@@ -39,13 +44,33 @@ class KitModel : public QObject
 	private:
 		GUIView *tempObserver;
 		GUIView *moistureObserver;
+		ReaderPool *pool;		// reader 0 is the one all single reader requests go to
 		AMSRadonReader *reader;
+		AsyncReader *asyncReader;	// runs the long reader operations off the calling thread
+		TuningCache *tuningCache;
+		vector<string> readerIDs;	// firmware information (and UART of the other pool readers), keys the tuning cache
+		TagPowerModel *powerModel;	// power response of every tag read, picks the starting power of a measurement
+		string traceFile;		// receives the firmware event trace, empty if it is not read
+		vector<TagData> tagBuffer;	// reused by findTags() and readTags() so reads do not allocate
 		int FCCBandFreqs[50];
 		int ETSIBandFreqs[4];
 		int PRCBandFreqs[16];
 		int JPNBandFreqs[6];
 		GPIO *gpio7;
 		bool abort;
+		int configureReader(int index);
+		int setUpBand(FreqBandEnum band, const int *freqs, int numFreqs, bool reportProgress);
+		bool restoreTuning(int index, FreqBandEnum band, const int *freqs, int numFreqs);
+		void cacheTuning(int index, FreqBandEnum band, const vector<TuningTableEntry> &tuningTable);
+		void storeReaderSettings(int index);
+		void saveReaderTrace();
+		short runReaderOperation(ReaderOperation *operation);
+		QMutex snapshotLock;
+		TagListSnapshotPointer tempSnapshot;
+		TagListSnapshotPointer moistSnapshot;
+		void publishTagSnapshot(QString measurementType);
+		float sensorEstimate(SensorTag &tag, bool temperature, int &validCount);
+		int measureTagsInBatch(QString measurementType);
 	public:
 		KitModel();
 		FreqBandEnum currentFreqBand;
@@ -68,6 +93,9 @@ class KitModel : public QObject
 		QList<QDateTime> MoistMeasTimeList;
 		QList<SensorTag> TempTagList;
 		QList<SensorTag> MoistTagList;
+		TagRegistry TempTagRegistry;	// EPC to index in TempTagList
+		TagRegistry MoistTagRegistry;
+		TagListSnapshotPointer getTagSnapshot(QString measurementType);
 		void initialize();
 		void turnReaderOn();
 		void turnReaderOff();
@@ -79,10 +107,11 @@ class KitModel : public QObject
 		int setFrequencyBand(FreqBandEnum band);
 		void registerTemperatureObserver(GUIView *gui);
 		void registerMoistureObserver(GUIView *gui);
-		void addTagToList(TagData tag, QString measurementType);
+		void addTagToList(TagData &tag, QString measurementType);
 		float calculateTemperature(QString tagEpc, int minOnChipRssi, int maxOnChipRssi, int minNumberSuccessfulReads);
-		void addSensorReading(TagData tag, QString measurementType);
+		void addSensorReading(TagData &tag, QString measurementType);
 		int findTags(int numInventories, QString measurementType);
+		int inventoryRounds(int numInventories, char tidAndFast, vector<TagData> &tags);
 		int searchForTempTags();
 		int searchForMoistTags();
 		int searchForTempTags(int maxSearchTime);
@@ -109,9 +138,9 @@ class KitModel : public QObject
 		void continuousWave(char timeInSeconds);
 		void setAbort(bool status);
 	signals:
-		void updateTempTagsSignal(QList<SensorTag>);
+		void updateTempTagsSignal(TagListSnapshotPointer);
 		void updateTempTagSelectionsSignal();
-		void updateMoistTagsSignal(QList<SensorTag>);
+		void updateMoistTagsSignal(TagListSnapshotPointer);
 		void updateMoistTagSelectionsSignal();
 		void antennaTuningSignal(int, int);
 		void bandChangedSignal(FreqBandEnum);
@@ -62,23 +62,22 @@ MeasurementDetailsPage::MeasurementDetailsPage(KitModel *model, KitController *c
 	mainLayout->addWidget(settingsFrame);
 	setLayout(mainLayout);
 }
-void MeasurementDetailsPage::loadTempTableSlot(QList<SensorTag> TempTagList)
+void MeasurementDetailsPage::loadTempTableSlot(TagListSnapshotPointer snapshot)
 {
 	selectTable->clearContents();
 	selectTable->setRowCount(0);
-	selectTable->setRowCount(TempTagList.length());
-	for (int t=0; t<TempTagList.length(); t++)
+	selectTable->setRowCount(snapshot->Tags.size());
+	for (int t=0; t<snapshot->Tags.size(); t++)
 	{
-		selectTable->setItem(t,0, new QTableWidgetItem(TempTagList[t].getEpc()));
-		selectTable->setItem(t,1, new QTableWidgetItem(TempTagList[t].Label));
-		selectTable->setItem(t,2, new QTableWidgetItem(TempTagList[t].getModel()));
-		bool cal = TempTagList[t].getCrcValid();
-		if (cal)
+		const TagSnapshot &tag = snapshot->Tags[t];
+		selectTable->setItem(t,0, new QTableWidgetItem(tag.Epc));
+		selectTable->setItem(t,1, new QTableWidgetItem(tag.Label));
+		selectTable->setItem(t,2, new QTableWidgetItem(tag.Model));
+		if (tag.CrcValid)
 			selectTable->setItem(t,3, new QTableWidgetItem("Y"));
 		else
 			selectTable->setItem(t,3, new QTableWidgetItem("N"));
-		int len=TempTagList[t].TemperatureMeasurementHistory.length();
-		if (len==0)
+		if (!tag.Measured)
 		{
 			selectTable->setItem(t,4, new QTableWidgetItem("--"));
 			selectTable->setItem(t,5, new QTableWidgetItem("--"));
@@ -86,10 +85,10 @@ void MeasurementDetailsPage::loadTempTableSlot(QList<SensorTag> TempTagList)
 			selectTable->setItem(t,7, new QTableWidgetItem("--"));
 			continue;
 		}
-		selectTable->setItem(t,4, new QTableWidgetItem(QString::number(TempTagList[t].TemperatureMeasurementHistory[len-1].getValidPowerReadCount())));
-		selectTable->setItem(t,5, new QTableWidgetItem(QString::number(TempTagList[t].TemperatureMeasurementHistory[len-1].getInvalidPowerReadCount())));
-		float temp=TempTagList[t].TemperatureMeasurementHistory[len-1].getValue();
-		float ocRssi=TempTagList[t].OnChipRssiMeasurementHistory[len-1].getValue();
+		selectTable->setItem(t,4, new QTableWidgetItem(QString::number(tag.Value.getValidPowerReadCount())));
+		selectTable->setItem(t,5, new QTableWidgetItem(QString::number(tag.Value.getInvalidPowerReadCount())));
+		float temp=tag.Value.getValue();
+		float ocRssi=tag.OnChipRssi.getValue();
 		if (temp>-100)
 			selectTable->setItem(t,6, new QTableWidgetItem(QString::number(temp,'f',1)));
 		else
@@ -100,23 +99,22 @@ void MeasurementDetailsPage::loadTempTableSlot(QList<SensorTag> TempTagList)
 			selectTable->setItem(t,7, new QTableWidgetItem("----"));			
 	}
 }
-void MeasurementDetailsPage::loadMoistTableSlot(QList<SensorTag> MoistTagList)
+void MeasurementDetailsPage::loadMoistTableSlot(TagListSnapshotPointer snapshot)
 {
 	selectTable->clearContents();
 	selectTable->setRowCount(0);
-	selectTable->setRowCount(MoistTagList.length());
-	for (int t=0; t<MoistTagList.length(); t++)
+	selectTable->setRowCount(snapshot->Tags.size());
+	for (int t=0; t<snapshot->Tags.size(); t++)
 	{
-		selectTable->setItem(t,0, new QTableWidgetItem(MoistTagList[t].getEpc()));
-		selectTable->setItem(t,1, new QTableWidgetItem(MoistTagList[t].Label));
-		selectTable->setItem(t,2, new QTableWidgetItem(MoistTagList[t].getModel()));
-		bool cal = MoistTagList[t].getCrcValid();
-		if (cal)
+		const TagSnapshot &tag = snapshot->Tags[t];
+		selectTable->setItem(t,0, new QTableWidgetItem(tag.Epc));
+		selectTable->setItem(t,1, new QTableWidgetItem(tag.Label));
+		selectTable->setItem(t,2, new QTableWidgetItem(tag.Model));
+		if (tag.CrcValid)
 			selectTable->setItem(t,3, new QTableWidgetItem("Y"));
 		else
 			selectTable->setItem(t,3, new QTableWidgetItem("N"));
-		int len=MoistTagList[t].SensorMeasurementHistory.length();
-		if (len==0)
+		if (!tag.Measured)
 		{
 			selectTable->setItem(t,4, new QTableWidgetItem("--"));
 			selectTable->setItem(t,5, new QTableWidgetItem("--"));
@@ -124,10 +122,10 @@ void MeasurementDetailsPage::loadMoistTableSlot(QList<SensorTag> MoistTagList)
 			selectTable->setItem(t,7, new QTableWidgetItem("--"));
 			continue;
 		}
-		selectTable->setItem(t,4, new QTableWidgetItem(QString::number(MoistTagList[t].SensorMeasurementHistory[len-1].getValidPowerReadCount())));
-		selectTable->setItem(t,5, new QTableWidgetItem(QString::number(MoistTagList[t].SensorMeasurementHistory[len-1].getInvalidPowerReadCount())));
-		float moist=MoistTagList[t].SensorMeasurementHistory[len-1].getValue();
-		float ocRssi=MoistTagList[t].OnChipRssiMeasurementHistory[len-1].getValue();
+		selectTable->setItem(t,4, new QTableWidgetItem(QString::number(tag.Value.getValidPowerReadCount())));
+		selectTable->setItem(t,5, new QTableWidgetItem(QString::number(tag.Value.getInvalidPowerReadCount())));
+		float moist=tag.Value.getValue();
+		float ocRssi=tag.OnChipRssi.getValue();
 		if (moist>-1)
 			selectTable->setItem(t,6, new QTableWidgetItem(QString::number(moist,'f',1)));
 		else
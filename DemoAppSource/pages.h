@@ -58,8 +58,8 @@ class MeasurementDetailsPage : public QWidget
 	public:
 		MeasurementDetailsPage(KitModel *model, KitController *controller, QString demoType);
 	public slots:
-		void loadTempTableSlot(QList<SensorTag>);
-		void loadMoistTableSlot(QList<SensorTag>);
+		void loadTempTableSlot(TagListSnapshotPointer);
+		void loadMoistTableSlot(TagListSnapshotPointer);
 };
 class OnePointTempCalTab : public QWidget
 {
@@ -1,5 +1,10 @@
 #include "sensorTag.h"
 #include "utilityFunctions.h"
+#include <string.h>
+#include <QFile>
+#include <QSaveFile>
+#include <QStringList>
+#include <QTextStream>
 
 SensorRead::SensorRead()
 {
@@ -58,6 +63,189 @@ int SensorRead::getTemperatureCode()
 	return TemperatureCode;
 }
 //==================================
+SensorReadBuffer::SensorReadBuffer(int capacity)
+{
+	First = 0;
+	Count = 0;
+	setCapacity(capacity);
+}
+// The newest reads are kept if the buffer shrinks.
+void SensorReadBuffer::setCapacity(int capacity)
+{
+	if (capacity < 1)
+		capacity = 1;
+	QList<SensorRead> kept;
+	for (int i = Count > capacity ? Count - capacity : 0; i < Count; i++)
+		kept.append((*this)[i]);
+	FrequencyKHz.resize(capacity);
+	ReadPower.resize(capacity);
+	SensorCode.resize(capacity);
+	OnChipRssiCode.resize(capacity);
+	TemperatureCode.resize(capacity);
+	clear();
+	for (int i = 0; i < kept.length(); i++)
+		append(kept[i]);
+}
+int SensorReadBuffer::capacity()
+{
+	return FrequencyKHz.size();
+}
+int SensorReadBuffer::length()
+{
+	return Count;
+}
+int SensorReadBuffer::size()
+{
+	return Count;
+}
+// Once full, the oldest read is dropped for the new one.
+void SensorReadBuffer::append(SensorRead r)
+{
+	int slot;
+	if (Count == capacity())
+	{
+		slot = First;
+		account(slot, -1);
+		First = (First + 1) % capacity();
+	}
+	else
+	{
+		slot = (First + Count) % capacity();
+		Count++;
+	}
+	FrequencyKHz[slot] = r.getFrequencyKHz();
+	ReadPower[slot] = r.getReadPower();
+	SensorCode[slot] = r.getSensorCode();
+	OnChipRssiCode[slot] = r.getOnChipRssiCode();
+	TemperatureCode[slot] = r.getTemperatureCode();
+	account(slot, 1);
+}
+void SensorReadBuffer::clear()
+{
+	First = 0;
+	Count = 0;
+	for (int i = 0; i < ONCHIP_RSSI_CODES; i++)
+	{
+		ReadCount[i] = 0;
+		SensorCount[i] = 0;
+		SensorSum[i] = 0;
+		TempCount[i] = 0;
+		TempSum[i] = 0;
+		TempCodes[i].clear();
+		FitSumX[i] = 0;
+		FitSumXX[i] = 0;
+		FitSumXY[i] = 0;
+		SensorFrequencies[i].clear();
+	}
+}
+// index 0 is the oldest read
+SensorRead SensorReadBuffer::operator[](int index)
+{
+	int slot = (First + index) % capacity();
+	return SensorRead(FrequencyKHz[slot], ReadPower[slot], SensorCode[slot], OnChipRssiCode[slot], TemperatureCode[slot]);
+}
+// Adds (delta 1) or removes (delta -1) the read in slot from the statistics.
+void SensorReadBuffer::account(int slot, int delta)
+{
+	int ocRssi = OnChipRssiCode[slot];
+	if (ocRssi < 0 || ocRssi >= ONCHIP_RSSI_CODES)
+		return;
+	ReadCount[ocRssi] += delta;
+	int sensor = SensorCode[slot];
+	if (sensor >= 0 && sensor <= SENSOR_CODE_MAX)
+	{
+		SensorCount[ocRssi] += delta;
+		SensorSum[ocRssi] += delta * sensor;
+		long long x = FrequencyKHz[slot] - FIT_FREQ_REFERENCE_KHZ;
+		FitSumX[ocRssi] += delta * x;
+		FitSumXX[ocRssi] += delta * x * x;
+		FitSumXY[ocRssi] += delta * x * sensor;
+		int &freqCount = SensorFrequencies[ocRssi][FrequencyKHz[slot]];
+		freqCount += delta;
+		if (freqCount == 0)
+			SensorFrequencies[ocRssi].remove(FrequencyKHz[slot]);
+	}
+	int tempCode = TemperatureCode[slot];
+	if (tempCode >= TEMP_CODE_MIN && tempCode <= TEMP_CODE_MAX)
+	{
+		TempCount[ocRssi] += delta;
+		TempSum[ocRssi] += delta * tempCode;
+		int &codeCount = TempCodes[ocRssi][tempCode];
+		codeCount += delta;
+		if (codeCount == 0)
+			TempCodes[ocRssi].remove(tempCode);
+	}
+}
+// The stats functions return the number of reads with an on-chip RSSI code
+// from minOnChipRssi to maxOnChipRssi and a valid value, and the sum of the
+// values. An on-chip RSSI code of 0 means the tag had too little power and
+// only counts for the temperature code.
+int SensorReadBuffer::onChipRssiStats(int minOnChipRssi, int maxOnChipRssi, int &sum)
+{
+	int count = 0;
+	sum = 0;
+	for (int i = qMax(minOnChipRssi, 1); i <= qMin(maxOnChipRssi, ONCHIP_RSSI_CODES - 1); i++)
+	{
+		count += ReadCount[i];
+		sum += ReadCount[i] * i;
+	}
+	return count;
+}
+int SensorReadBuffer::sensorCodeStats(int minOnChipRssi, int maxOnChipRssi, int &sum)
+{
+	int count = 0;
+	sum = 0;
+	for (int i = qMax(minOnChipRssi, 1); i <= qMin(maxOnChipRssi, ONCHIP_RSSI_CODES - 1); i++)
+	{
+		count += SensorCount[i];
+		sum += SensorSum[i];
+	}
+	return count;
+}
+// The sums are integers, so removing a read takes it out exactly and no
+// rounding error builds up however long the buffer runs. minFreqKHz and
+// maxFreqKHz are only set if count is not 0.
+void SensorReadBuffer::sensorFitSums(int minOnChipRssi, int maxOnChipRssi, SensorFitSums &sums)
+{
+	sums.count = 0;
+	sums.sumX = 0;
+	sums.sumY = 0;
+	sums.sumXX = 0;
+	sums.sumXY = 0;
+	for (int i = qMax(minOnChipRssi, 1); i <= qMin(maxOnChipRssi, ONCHIP_RSSI_CODES - 1); i++)
+	{
+		if (SensorCount[i] == 0)
+			continue;
+		if (sums.count == 0 || SensorFrequencies[i].firstKey() < sums.minFreqKHz)
+			sums.minFreqKHz = SensorFrequencies[i].firstKey();
+		if (sums.count == 0 || SensorFrequencies[i].lastKey() > sums.maxFreqKHz)
+			sums.maxFreqKHz = SensorFrequencies[i].lastKey();
+		sums.count += SensorCount[i];
+		sums.sumX += FitSumX[i];
+		sums.sumY += SensorSum[i];
+		sums.sumXX += FitSumXX[i];
+		sums.sumXY += FitSumXY[i];
+	}
+}
+// minCode and maxCode are only set if there is a valid read.
+int SensorReadBuffer::tempCodeStats(int minOnChipRssi, int maxOnChipRssi, int &sum, int &minCode, int &maxCode)
+{
+	int count = 0;
+	sum = 0;
+	for (int i = qMax(minOnChipRssi, 0); i <= qMin(maxOnChipRssi, ONCHIP_RSSI_CODES - 1); i++)
+	{
+		if (TempCount[i] == 0)
+			continue;
+		if (count == 0 || TempCodes[i].firstKey() < minCode)
+			minCode = TempCodes[i].firstKey();
+		if (count == 0 || TempCodes[i].lastKey() > maxCode)
+			maxCode = TempCodes[i].lastKey();
+		count += TempCount[i];
+		sum += TempSum[i];
+	}
+	return count;
+}
+//==================================
 SensorMeasurement::SensorMeasurement()
 {
 	Value=-1000;
@@ -90,36 +278,37 @@ void SensorMeasurement::setNumber(int n)
 {
 	Number = n;
 }
-float SensorMeasurement::getValue()
+float SensorMeasurement::getValue() const
 {
 	return Value;
 }
-int SensorMeasurement::getValidPowerReadCount()
+int SensorMeasurement::getValidPowerReadCount() const
 {
 	return ValidPowerReadCount;
 }
-int SensorMeasurement::getInvalidPowerReadCount()
+int SensorMeasurement::getInvalidPowerReadCount() const
 {
 	return InvalidPowerReadCount;
 }
-int SensorMeasurement::getReadPowerCode()
+int SensorMeasurement::getReadPowerCode() const
 {
 	return ReadPowerCode;
 }
-int SensorMeasurement::getNumber()
+int SensorMeasurement::getNumber() const
 {
 	return Number;
 }
-QDateTime SensorMeasurement::getFullTimeStamp()
+QDateTime SensorMeasurement::getFullTimeStamp() const
 {
 	return TimeStamp;
 }
-QString SensorMeasurement::getTimeString()
+QString SensorMeasurement::getTimeString() const
 {
 	return TimeStamp.toString("hh.mm.ss");
 }
 //==================================
 SensorTag::SensorTag()
+	: SensorReadHistory(1000)
 {
 	Epc="";
 	Label="";
@@ -134,7 +323,6 @@ SensorTag::SensorTag()
 	TempCalC2=-1;
 	TempCalT2=-1000.0;
 	CrcValid=false;
-	ReadHistoryMaxLength=1000;
 	MeasurementHistoryMaxLength=500;
 }
 void SensorTag::setEpc(QString epc)
@@ -170,14 +358,10 @@ void SensorTag::setTempCalT2(float t2)
 }
 void SensorTag::setReadHistoryMaxLength(int l)
 {
-	ReadHistoryMaxLength=l;
+	SensorReadHistory.setCapacity(l);
 }
 void SensorTag::addSensorRead(SensorRead r)
 {
-	if (SensorReadHistory.count() >= ReadHistoryMaxLength)
-	{
-		SensorReadHistory.removeFirst();
-	}
 	SensorReadHistory.append(r);
 	qDebug("  %s %d p: %d s: %d r: %d t: %d", qPrintable(Label), r.getFrequencyKHz(), r.getReadPower(), r.getSensorCode(), r.getOnChipRssiCode(), r.getTemperatureCode());
 }
@@ -270,26 +454,9 @@ int SensorTag::getLastOnChipRssiReading()
 }
 float SensorTag::linearFitSensorCode(int minOnChipRssi, int maxOnChipRssi, int minNumberValidDataPoints, int freqKHz, int &validCount)
 {
-	QList<int> codes;
-	QList<int> freqs;
-	int minFreq=1000000;
-	int maxFreq=0;
-	for (int i=0; i<SensorReadHistory.length(); i++)
-	{
-		int sensor = SensorReadHistory[i].getSensorCode();
-		int ocRssi = SensorReadHistory[i].getOnChipRssiCode();
-		int freq= SensorReadHistory[i].getFrequencyKHz();
-		if (sensor >= 0 && sensor <= 512 && ocRssi > 0 && ocRssi >= minOnChipRssi && ocRssi <= maxOnChipRssi)
-		{
-			codes.append(sensor);
-			freqs.append(freq);
-			if (freq<minFreq)
-				minFreq=freq;
-			if (freq>maxFreq)
-				maxFreq=freq;
-		}
-	}
-	int size = codes.length();
+	SensorFitSums sums;
+	SensorReadHistory.sensorFitSums(minOnChipRssi, maxOnChipRssi, sums);
+	int size = sums.count;
 	validCount=size;
 	if (size<minNumberValidDataPoints || size==0)
 		return -1000;
@@ -298,68 +465,39 @@ float SensorTag::linearFitSensorCode(int minOnChipRssi, int maxOnChipRssi, int m
 		float avg=avgSensorCode(minOnChipRssi, maxOnChipRssi, minNumberValidDataPoints, validCount);
 		return avg;
 	}
-	if (minFreq>902000 && (maxFreq-minFreq<1000))
+	if (sums.minFreqKHz>902000 && (sums.maxFreqKHz-sums.minFreqKHz<1000))
 		return -1000;
-	double SumX=0;
-	double SumY=0;
-	double SumXX = 0;
-	double SumXY = 0;
-	for (int i=0; i<size; i++)
-	{
-		double f=freqs[i];
-		double c=codes[i];
-		SumX=SumX+f;
-		SumY=SumY+c;
-		SumXX=SumXX+f*f;
-		SumXY=SumXY+f*c;
-	}
-	double slope=(size*SumXY-SumX*SumY)/(size*SumXX-SumX*SumX);
-	double intercept=(SumY-slope*SumX)/size;
-	double value=slope*freqKHz+intercept;
+	// exact up to the division, the frequencies being relative to FIT_FREQ_REFERENCE_KHZ
+	long long slopeNumerator = size*sums.sumXY-sums.sumX*sums.sumY;
+	long long slopeDenominator = size*sums.sumXX-sums.sumX*sums.sumX;
+	double slope=(double)slopeNumerator/slopeDenominator;
+	double intercept=(sums.sumY-slope*sums.sumX)/size;
+	double value=slope*(freqKHz-FIT_FREQ_REFERENCE_KHZ)+intercept;
 	if (value < 0)
 		value=0;
 	return value;
 }
 float SensorTag::avgSensorCode(int minOnChipRssi, int maxOnChipRssi, int minNumberValidDataPoints, int &validCount)
 {
-	float sum=0;
-	int count=0;
-	for (int i=0; i<SensorReadHistory.length(); i++)
-	{
-		int sensor = SensorReadHistory[i].getSensorCode();
-		int ocRssi = SensorReadHistory[i].getOnChipRssiCode();
-		if (sensor >= 0 && sensor <= 512 && ocRssi > 0 && ocRssi >= minOnChipRssi && ocRssi <= maxOnChipRssi)
-		{
-			sum=sum+sensor;
-			count++;
-		}
-	}
+	int sum;
+	int count = SensorReadHistory.sensorCodeStats(minOnChipRssi, maxOnChipRssi, sum);
 	validCount = count;
 	if (count<1 || count < minNumberValidDataPoints)
 	{
 		return -1000.0;
 	}
-	return sum/count;
+	return (float)sum/count;
 }
 float SensorTag::avgOnChipRssiCode(int minOnChipRssi, int maxOnChipRssi, int minNumberValidDataPoints, int &validCount)
 {
-	float sum=0;
-	int count=0;
-	for (int i=0; i<SensorReadHistory.length(); i++)
-	{
-		int ocRssi = SensorReadHistory[i].getOnChipRssiCode();
-		if (ocRssi > 0 && ocRssi <= 31 && ocRssi >= minOnChipRssi && ocRssi <= maxOnChipRssi)
-		{
-			sum=sum+ocRssi;
-			count++;
-		}
-	}
+	int sum;
+	int count = SensorReadHistory.onChipRssiStats(minOnChipRssi, maxOnChipRssi, sum);
 	validCount=count;
 	if (count<1 || count < minNumberValidDataPoints)
 	{
 		return -1000.0;
 	}
-	return sum/count;
+	return (float)sum/count;
 }
 float SensorTag::calculateTemperature(int minOnChipRssi, int maxOnChipRssi, int minNumberValidDataPoints, int &validCount)
 {
@@ -373,32 +511,18 @@ float SensorTag::calculateTemperature(int minOnChipRssi, int maxOnChipRssi, int
 }
 float SensorTag::calculateTempCode(int minOnChipRssi, int maxOnChipRssi, int minNumberValidDataPoints, int &validCount)
 {
-	QList<float> temps;
-	for (int i=0; i<SensorReadHistory.length(); i++)
-	{
-		int tempCode = SensorReadHistory[i].getTemperatureCode();
-		int onChipRssi = SensorReadHistory[i].getOnChipRssiCode();
-		if (onChipRssi < minOnChipRssi || onChipRssi > maxOnChipRssi)
-			continue;
-		if (tempCode < 1600 || tempCode > 2900)
-			continue;
-		temps.append(tempCode);
-	}
-	validCount = temps.length();
-	if (temps.length()<1 || temps.length() < minNumberValidDataPoints)
+	int codeSum, minCode, maxCode;
+	int count = SensorReadHistory.tempCodeStats(minOnChipRssi, maxOnChipRssi, codeSum, minCode, maxCode);
+	validCount = count;
+	if (count<1 || count < minNumberValidDataPoints)
 		return -1000.0;
-	if (temps.length() >= 3)
-	{
-		qSort(temps.begin(), temps.end());
-		temps.removeFirst();
-		temps.removeLast();	
-	}
-	float codeSum=0;
-	for (int i=0; i<temps.length(); i++)
+	if (count >= 3)
 	{
-		codeSum=codeSum+temps[i];
+		// the lowest and the highest code are left out
+		codeSum = codeSum - minCode - maxCode;
+		count = count - 2;
 	}
-	float codeAvg = codeSum/temps.length();
+	float codeAvg = (float)codeSum/count;
 	return codeAvg;	
 }
 float SensorTag::tempCodeToDegC(float tempCode)
@@ -497,3 +621,221 @@ QString SensorTag::calculateTempCal1Point(float c1, float t1)
 	c2 = (t2 - t1)/slope + c1;
 	return calculateTempCal2Point(c1, t1, c2, t2);
 }
+//==================================
+TagRegistry::TagRegistry()
+{
+	clear();
+}
+// FNV-1a
+uint TagRegistry::hashEpc(const unsigned char *epc, int length)
+{
+	uint hash = 2166136261u;
+	for (int i = 0; i < length; i++)
+	{
+		hash ^= epc[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+// Returns the slot holding the EPC or, if it is not there, the free slot
+// where it would go.
+int TagRegistry::findSlot(const unsigned char *epc, int length, uint hash)
+{
+	int mask = Slots.size() - 1;
+	int i = hash & mask;
+	while (Slots[i].handle >= 0)
+	{
+		if (Slots[i].hash == hash && Slots[i].epc.size() == length && memcmp(Slots[i].epc.constData(), epc, length) == 0)
+			break;
+		i = (i + 1) & mask;
+	}
+	return i;
+}
+void TagRegistry::grow()
+{
+	QVector<Slot> old = Slots;
+	Slot freeSlot;
+	freeSlot.handle = -1;
+	freeSlot.hash = 0;
+	Slots.fill(freeSlot, old.size() * 2);
+	for (int i = 0; i < old.size(); i++)
+	{
+		if (old[i].handle < 0)
+			continue;
+		const unsigned char *epc = (const unsigned char *)old[i].epc.constData();
+		Slots[findSlot(epc, old[i].epc.size(), old[i].hash)] = old[i];
+	}
+}
+// Returns the handle of the tag or -1 if it is not registered.
+int TagRegistry::find(const unsigned char *epc, int length)
+{
+	return Slots[findSlot(epc, length, hashEpc(epc, length))].handle;
+}
+int TagRegistry::find(QString epcHex)
+{
+	QByteArray epc = QByteArray::fromHex(epcHex.toLatin1());
+	return find((const unsigned char *)epc.constData(), epc.size());
+}
+// A registered EPC gets the new handle.
+void TagRegistry::insert(const unsigned char *epc, int length, int handle)
+{
+	if (2 * (Count + 1) > Slots.size())
+		grow();
+	uint hash = hashEpc(epc, length);
+	Slot &slot = Slots[findSlot(epc, length, hash)];
+	if (slot.handle < 0)
+	{
+		Count++;
+		slot.hash = hash;
+		slot.epc = QByteArray((const char *)epc, length);
+	}
+	slot.handle = handle;
+}
+// The first tag gets the prefix as its label, the next ones prefix_0,
+// prefix_1 and so on.
+QString TagRegistry::uniqueLabel(QString prefix)
+{
+	int n = LabelCounts.value(prefix, 0);
+	LabelCounts.insert(prefix, n + 1);
+	if (n == 0)
+		return prefix;
+	return prefix + "_" + QString::number(n - 1);
+}
+int TagRegistry::count()
+{
+	return Count;
+}
+void TagRegistry::clear()
+{
+	Slot freeSlot;
+	freeSlot.handle = -1;
+	freeSlot.hash = 0;
+	Slots.fill(freeSlot, 16);
+	Count = 0;
+	LabelCounts.clear();
+}
+#define TAG_POWER_MODEL_MAGIC "HERMES TAG POWER MODEL 1"
+#define TAG_POWER_MODEL_WINDOW 8	// samples before the mean turns into a moving average
+TagPowerModel::PowerResponse::PowerResponse()
+{
+	for (int p=0; p<POWER_CODES; p++)
+	{
+		OnChipRssi[p] = 0;
+		Samples[p] = 0;
+	}
+}
+TagPowerModel::TagPowerModel(QString fileName)
+{
+	FileName = fileName;
+	Changed = false;
+}
+QString TagPowerModel::key(QString epc, int band)
+{
+	return QString::number(band) + " " + epc;
+}
+// Reads without on-chip RSSI (0) or outside the power range tell nothing
+// about the power response and are skipped.
+void TagPowerModel::addRead(QString epc, int band, SensorRead read)
+{
+	int power = read.getReadPower();
+	int ocRssi = read.getOnChipRssiCode();
+	if (power<0 || power>=POWER_CODES || ocRssi<1 || ocRssi>=ONCHIP_RSSI_CODES)
+		return;
+	PowerResponse &response = Responses[key(epc, band)];
+	if (response.Samples[power] < TAG_POWER_MODEL_WINDOW)
+		response.Samples[power]++;
+	// exact mean over the first reads, the tag may have moved since older ones
+	response.OnChipRssi[power] += (ocRssi - response.OnChipRssi[power]) / response.Samples[power];
+	Changed = true;
+}
+// Returns the attenuation code expected to put the on-chip RSSI in the
+// middle of the target window, or -1 if the tag was never seen in this band.
+// The sampled code closest to the window is moved by one code per RSSI step,
+// roughly the slope of the on-chip RSSI over a 1 dB power change.
+int TagPowerModel::predictPower(QString epc, int band, int minOnChipRssi, int maxOnChipRssi, int maxPower)
+{
+	QHash<QString, PowerResponse>::const_iterator it = Responses.constFind(key(epc, band));
+	if (it == Responses.constEnd())
+		return -1;
+	float middle = (minOnChipRssi + maxOnChipRssi) / 2.0;
+	int bestPower = -1;
+	float bestDistance = 0;
+	for (int p=0; p<POWER_CODES; p++)
+	{
+		if (it->Samples[p] == 0)
+			continue;
+		float distance = qAbs(it->OnChipRssi[p] - middle);
+		if (bestPower<0 || distance<bestDistance)
+		{
+			bestPower = p;
+			bestDistance = distance;
+		}
+	}
+	if (bestPower < 0)
+		return -1;
+	// more attenuation lowers the on-chip RSSI
+	int power = bestPower + qRound(it->OnChipRssi[bestPower] - middle);
+	return qBound(maxPower, power, POWER_CODES-1);
+}
+bool TagPowerModel::isChanged()
+{
+	return Changed;
+}
+// Reads the model file. A missing or damaged file leaves the model empty.
+bool TagPowerModel::load()
+{
+	Responses.clear();
+	Changed = false;
+	QFile file(FileName);
+	if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+		return false;
+	QTextStream in(&file);
+	bool valid = (in.readLine() == TAG_POWER_MODEL_MAGIC);
+	while (valid && !in.atEnd())
+	{
+		QStringList fields = in.readLine().split(' ', QString::SkipEmptyParts);
+		if (fields.isEmpty())
+			continue;
+		valid = (fields.length() == 2 + 2*POWER_CODES);
+		if (!valid)
+			break;
+		bool ok;
+		int band = fields[0].toInt(&ok);
+		valid = ok;
+		PowerResponse response;
+		for (int p=0; valid && p<POWER_CODES; p++)
+		{
+			response.Samples[p] = fields[2 + 2*p].toInt(&ok);
+			valid = ok && response.Samples[p]>=0 && response.Samples[p]<=TAG_POWER_MODEL_WINDOW;
+			response.OnChipRssi[p] = fields[3 + 2*p].toFloat(&ok);
+			valid = valid && ok;
+		}
+		if (valid)
+			Responses.insert(key(fields[1], band), response);
+	}
+	if (!valid)
+		Responses.clear();
+	return valid;
+}
+// QSaveFile only replaces the old file once everything is written.
+bool TagPowerModel::save()
+{
+	QSaveFile file(FileName);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+		return false;
+	QTextStream out(&file);
+	out << TAG_POWER_MODEL_MAGIC << "\n";
+	QHash<QString, PowerResponse>::const_iterator it;
+	for (it = Responses.constBegin(); it != Responses.constEnd(); ++it)
+	{
+		out << it.key();
+		for (int p=0; p<POWER_CODES; p++)
+			out << " " << it->Samples[p] << " " << it->OnChipRssi[p];
+		out << "\n";
+	}
+	out.flush();
+	if (out.status() != QTextStream::Ok || !file.commit())
+		return false;
+	Changed = false;
+	return true;
+}
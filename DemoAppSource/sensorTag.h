@@ -10,6 +10,10 @@
 /// SensorRead is a data structure representing a single read from a
 /// single tag.
 ///
+/// SensorReadBuffer holds the latest reads of a tag in a ring of fixed
+/// capacity. It keeps running statistics per on-chip RSSI code, so the
+/// estimators of SensorTag do not have to rescan the reads.
+///
 /// The SensorMeasurement class represents a higher-level concept than a
 /// SensorRead. A SensorMeasurement value will typically be an average of
 /// multiple reads. In the case of temperature measurements, the value will
@@ -17,6 +21,12 @@
 ///
 /// The SensorTag class stores and processes data for a single tag.
 ///
+/// TagListSnapshot is what the views get to see of a tag list: each tag with
+/// its latest measurement, frozen at one moment.
+///
+/// TagRegistry finds the tag of an EPC in a list of SensorTags and hands
+/// out the labels of new tags.
+///
 /// Author: Greg Pitner, RFMicron
 ///-----------------------------------------------------------------------------
 
@@ -25,6 +35,18 @@
 
 #include <QApplication>
 #include <QDateTime>
+#include <QVector>
+#include <QMap>
+#include <QHash>
+#include <QByteArray>
+#include <QSharedPointer>
+#include <QMetaType>
+
+#define ONCHIP_RSSI_CODES 32	// the on-chip RSSI code has 5 bits
+#define SENSOR_CODE_MAX 512
+#define TEMP_CODE_MIN 1600
+#define TEMP_CODE_MAX 2900
+#define FIT_FREQ_REFERENCE_KHZ 900000	// regression frequencies are taken relative to this
  
 class SensorRead
 {
@@ -48,6 +70,56 @@ class SensorRead
 		int getOnChipRssiCode();
 		int getTemperatureCode();
 };
+// Sums for a least squares fit of the sensor code (y) over the frequency
+// (x, in kHz from FIT_FREQ_REFERENCE_KHZ)
+struct SensorFitSums
+{
+	int count;
+	long long sumX;
+	long long sumY;
+	long long sumXX;
+	long long sumXY;
+	int minFreqKHz;
+	int maxFreqKHz;
+};
+class SensorReadBuffer
+{
+	private:
+		QVector<int> FrequencyKHz;
+		QVector<char> ReadPower;
+		QVector<int> SensorCode;
+		QVector<int> OnChipRssiCode;
+		QVector<int> TemperatureCode;
+		int First;	// slot of the oldest read
+		int Count;
+		// Valid sensor and temperature codes of the reads in the buffer, by
+		// on-chip RSSI code. Reads with an on-chip RSSI code outside 0..31
+		// are kept but not counted.
+		int ReadCount[ONCHIP_RSSI_CODES];
+		int SensorCount[ONCHIP_RSSI_CODES];
+		int SensorSum[ONCHIP_RSSI_CODES];
+		int TempCount[ONCHIP_RSSI_CODES];
+		int TempSum[ONCHIP_RSSI_CODES];
+		QMap<int, int> TempCodes[ONCHIP_RSSI_CODES];	// number of reads per temperature code
+		long long FitSumX[ONCHIP_RSSI_CODES];	// of the reads with a valid sensor code
+		long long FitSumXX[ONCHIP_RSSI_CODES];
+		long long FitSumXY[ONCHIP_RSSI_CODES];
+		QMap<int, int> SensorFrequencies[ONCHIP_RSSI_CODES];	// number of reads per frequency
+		void account(int slot, int delta);
+	public:
+		SensorReadBuffer(int capacity);
+		void setCapacity(int capacity);
+		int capacity();
+		int length();
+		int size();
+		void append(SensorRead r);
+		void clear();
+		SensorRead operator[](int index);
+		int onChipRssiStats(int minOnChipRssi, int maxOnChipRssi, int &sum);
+		int sensorCodeStats(int minOnChipRssi, int maxOnChipRssi, int &sum);
+		void sensorFitSums(int minOnChipRssi, int maxOnChipRssi, SensorFitSums &sums);
+		int tempCodeStats(int minOnChipRssi, int maxOnChipRssi, int &sum, int &minCode, int &maxCode);
+};
 class SensorMeasurement
 {
 	private:
@@ -65,13 +137,13 @@ class SensorMeasurement
 		void setReadPowerCode(int p);
 		void setTime();
 		void setNumber(int n);
-		float getValue();
-		int getValidPowerReadCount();
-		int getInvalidPowerReadCount();
-		int getReadPowerCode();
-		int getNumber();
-		QDateTime getFullTimeStamp();
-		QString getTimeString();
+		float getValue() const;
+		int getValidPowerReadCount() const;
+		int getInvalidPowerReadCount() const;
+		int getReadPowerCode() const;
+		int getNumber() const;
+		QDateTime getFullTimeStamp() const;
+		QString getTimeString() const;
 };
 class SensorTag
 {
@@ -84,10 +156,9 @@ class SensorTag
 		int TempCalC2;
 		float TempCalT2;
 		bool CrcValid; 
-		int ReadHistoryMaxLength;
 		int MeasurementHistoryMaxLength;
 	public:
-		QList<SensorRead> SensorReadHistory;
+		SensorReadBuffer SensorReadHistory;
 		QList<SensorMeasurement> SensorMeasurementHistory;
 		QList<SensorMeasurement> TemperatureMeasurementHistory;
 		QList<SensorMeasurement> OnChipRssiMeasurementHistory;
@@ -128,4 +199,80 @@ class SensorTag
 		QString calculateTempCal2Point(float c1, float t1, float c2, float t2);
 		QString calculateTempCal1Point(float c1, float t1);
 };
+// A tag as the views show it
+struct TagSnapshot
+{
+	QString Epc;
+	QString Label;
+	QString Model;
+	bool CrcValid;
+	bool SelectedForMeasurement;
+	bool Measured;			// false until the first measurement
+	SensorMeasurement Value;	// temperature or sensor code
+	SensorMeasurement OnChipRssi;
+};
+// Published by the model and never changed afterwards, so the views may hold
+// on to it and read it on any thread while the next measurement runs.
+struct TagListSnapshot
+{
+	TagListSnapshot() : MeasurementCount(0) {}
+	int MeasurementCount;	// measurements since the last clear, the latest has number MeasurementCount-1
+	QDateTime FirstMeasurementTime;
+	QDateTime LastMeasurementTime;
+	QVector<TagSnapshot> Tags;
+};
+typedef QSharedPointer<const TagListSnapshot> TagListSnapshotPointer;
+Q_DECLARE_METATYPE(TagListSnapshotPointer)
+// Open addressing hash over the binary EPC. The handle of a tag is its
+// index in the tag list, the list must only grow or be cleared together
+// with the registry.
+class TagRegistry
+{
+	private:
+		struct Slot
+		{
+			int handle;	// -1 if the slot is free
+			uint hash;
+			QByteArray epc;
+		};
+		QVector<Slot> Slots;
+		int Count;
+		QHash<QString, int> LabelCounts;	// labels handed out per prefix
+		static uint hashEpc(const unsigned char *epc, int length);
+		int findSlot(const unsigned char *epc, int length, uint hash);
+		void grow();
+	public:
+		TagRegistry();
+		int find(const unsigned char *epc, int length);
+		int find(QString epcHex);
+		void insert(const unsigned char *epc, int length, int handle);
+		QString uniqueLabel(QString prefix);
+		int count();
+		void clear();
+};
+#define POWER_CODES 20
+// On-chip RSSI a tag answered with at each attenuation code, per tag and
+// frequency band. Kept across sessions so a measurement can start at the
+// power that worked last time instead of searching for it.
+class TagPowerModel
+{
+	private:
+		struct PowerResponse
+		{
+			PowerResponse();
+			float OnChipRssi[POWER_CODES];	// running mean, then moving average
+			int Samples[POWER_CODES];
+		};
+		QHash<QString, PowerResponse> Responses;	// key is "band EPC"
+		QString FileName;
+		bool Changed;
+		static QString key(QString epc, int band);
+	public:
+		TagPowerModel(QString fileName);
+		void addRead(QString epc, int band, SensorRead read);
+		int predictPower(QString epc, int band, int minOnChipRssi, int maxOnChipRssi, int maxPower);
+		bool isChanged();
+		bool load();
+		bool save();
+};
 #endif
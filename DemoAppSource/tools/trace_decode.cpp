@@ -0,0 +1,131 @@
+// Prints the event trace of the reader firmware, as collected with
+// AMSRadonReader::readTrace() into the file named by HERMES_TRACE_FILE, as a
+// timeline. Each line shows the time since the first event, the time since
+// the previous one, the event and its arguments.
+//
+// The file is a sequence of trace replies: a header of clock rate, wrap
+// (both little endian u32), lost events (u16) and event count (u8), followed
+// by the events of 8 bytes each: id, arg8, arg16 (u16) and time stamp (u32).
+// Time stamps are unwrapped under the assumption that no two consecutive
+// events are more than one wrap apart.
+//
+// Build: g++ -o trace_decode trace_decode.cpp
+// Usage: trace_decode trace.bin
+#include <stdio.h>
+#include <string.h>
+
+#define TRACE_HEADER_SIZE	11
+#define TRACE_EVENT_SIZE	8
+
+// event ids of the firmware, see trace.h there
+#define TRACE_HOST_COMMAND		0x01
+#define TRACE_HOP				0x02
+#define TRACE_ROUND_START		0x03
+#define TRACE_FRAME_TAGS		0x04
+#define TRACE_FRAME_COLLISIONS	0x05
+#define TRACE_FRAME_END			0x06
+#define TRACE_INVENTORY_END		0x07
+#define TRACE_RESPONSE_TIMEOUT	0x08
+
+static unsigned int u16(const unsigned char *bytes)
+{
+	return bytes[0] | bytes[1] << 8;
+}
+static unsigned int u32(const unsigned char *bytes)
+{
+	return bytes[0] | bytes[1] << 8 | bytes[2] << 16 | (unsigned int)bytes[3] << 24;
+}
+// Writes the name and the arguments of an event to text.
+static void describe(unsigned char id, unsigned char arg8, unsigned short arg16, char *text, int size)
+{
+	switch(id)
+	{
+		case TRACE_HOST_COMMAND:
+			snprintf(text, size, "host command 0x%02x, %u bytes", arg8, arg16);
+			break;
+		case TRACE_HOP:
+			snprintf(text, size, "hop to channel %u, result %d", arg8, (short)arg16);
+			break;
+		case TRACE_ROUND_START:
+			snprintf(text, size, "round start, q %u", arg8);
+			break;
+		case TRACE_FRAME_TAGS:
+			snprintf(text, size, "frame, q %u, %u tags read", arg8, arg16);
+			break;
+		case TRACE_FRAME_COLLISIONS:
+			snprintf(text, size, "frame, q %u, %u collisions", arg8, arg16);
+			break;
+		case TRACE_FRAME_END:
+			snprintf(text, size, "frame end, q %u, %u empty slots", arg8, arg16);
+			break;
+		case TRACE_INVENTORY_END:
+			snprintf(text, size, "inventory end, result %d, %u tags", (signed char)arg8, arg16);
+			break;
+		case TRACE_RESPONSE_TIMEOUT:
+			snprintf(text, size, "response timeout%s, mask 0x%04x", arg8 ? " (timed)" : "", arg16);
+			break;
+		default:
+			snprintf(text, size, "event 0x%02x, 0x%02x, 0x%04x", id, arg8, arg16);
+			break;
+	}
+}
+int main(int argc, char **argv)
+{
+	if(argc != 2)
+	{
+		fprintf(stderr, "Usage: %s trace.bin\n", argv[0]);
+		return 2;
+	}
+	FILE *file = fopen(argv[1], "rb");
+	if(file == NULL)
+	{
+		perror(argv[1]);
+		return 1;
+	}
+	unsigned char header[TRACE_HEADER_SIZE];
+	unsigned long long offset = 0;	// counts added by earlier wraps
+	unsigned long long first = 0;
+	unsigned long long previous = 0;
+	unsigned int lastStamp = 0;
+	bool started = false;
+	while(fread(header, 1, sizeof(header), file) == sizeof(header))
+	{
+		unsigned int clock = u32(header);
+		unsigned int wrap = u32(header + 4);
+		unsigned int lost = u16(header + 8);
+		unsigned int count = header[10];
+		if(clock == 0)
+		{
+			fprintf(stderr, "%s: corrupt trace reply\n", argv[1]);
+			return 1;
+		}
+		if(lost != 0)
+			printf("%14s %12s  -- %u events lost --\n", "", "", lost);
+		for(unsigned int i = 0; i < count; i++)
+		{
+			unsigned char event[TRACE_EVENT_SIZE];
+			if(fread(event, 1, sizeof(event), file) != sizeof(event))
+			{
+				fprintf(stderr, "%s: trace ends within an event\n", argv[1]);
+				return 1;
+			}
+			unsigned int stamp = u32(event + 4);
+			if(started && stamp < lastStamp)
+				offset += wrap;
+			lastStamp = stamp;
+			unsigned long long time = offset + stamp;
+			if(!started)
+			{
+				first = time;
+				previous = time;
+				started = true;
+			}
+			char text[80];
+			describe(event[0], event[1], u16(event + 2), text, sizeof(text));
+			printf("%11.3f ms %+9.3f ms  %s\n", (time - first) * 1000.0 / clock, (time - previous) * 1000.0 / clock, text);
+			previous = time;
+		}
+	}
+	fclose(file);
+	return 0;
+}
@@ -0,0 +1,166 @@
+// Replays a UART session captured with UART::startRecording() through a
+// pseudo terminal, so the unchanged host code can run against it without a
+// reader module. The slave pty name is printed on stdout; point the host at
+// it with HERMES_READER_UART.
+//
+// Every recorded host write is awaited (and compared) before the reader bytes
+// that followed it are sent back, either with their original delays or, with
+// -f, as fast as possible.
+//
+// Build: g++ -I.. -o uart_replay uart_replay.cpp
+// Usage: uart_replay [-f] recording.bin
+#define _XOPEN_SOURCE 600
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#include <poll.h>
+#include <errno.h>
+#include <time.h>
+#include "uart.h"
+
+#define HOST_TIMEOUT_MS	10000
+#define MAX_RECORD_SIZE	0xFFFF
+
+static long long monotonicUs()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000LL + now.tv_nsec / 1000;
+}
+// Reads exactly length bytes written by the host. Returns 0, or -1 if the
+// host stayed silent for HOST_TIMEOUT_MS.
+static int readHost(int master, char *buffer, int length)
+{
+	int count = 0;
+	while(count < length)
+	{
+		struct pollfd pfd;
+		pfd.fd = master;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		int ret = poll(&pfd, 1, HOST_TIMEOUT_MS);
+		if((ret < 0) && (errno == EINTR))
+			continue;
+		if(ret <= 0)
+			return -1;
+		int n = read(master, &buffer[count], length - count);
+		if(n > 0)
+			count += n;
+		else if((n < 0) && (errno != EAGAIN) && (errno != EINTR) && (errno != EIO))
+			return -1;
+	}
+	return 0;
+}
+static int writeHost(int master, const char *buffer, int length)
+{
+	int count = 0;
+	while(count < length)
+	{
+		int n = write(master, &buffer[count], length - count);
+		if(n > 0)
+			count += n;
+		else if((n < 0) && (errno != EAGAIN) && (errno != EINTR))
+			return -1;
+	}
+	return 0;
+}
+int main(int argc, char *argv[])
+{
+	bool fast = false;
+	const char *fileName = NULL;
+	for(int i = 1; i < argc; i++)
+	{
+		if(strcmp(argv[i], "-f") == 0)
+			fast = true;
+		else
+			fileName = argv[i];
+	}
+	if(fileName == NULL)
+	{
+		fprintf(stderr, "usage: %s [-f] recording.bin\n", argv[0]);
+		return 2;
+	}
+	FILE *recording = fopen(fileName, "rb");
+	char magic[UART_RECORD_MAGIC_SIZE];
+	if((recording == NULL) || (fread(magic, 1, UART_RECORD_MAGIC_SIZE, recording) != UART_RECORD_MAGIC_SIZE) ||
+			(memcmp(magic, UART_RECORD_MAGIC, UART_RECORD_MAGIC_SIZE) != 0))
+	{
+		fprintf(stderr, "%s: not a UART recording\n", fileName);
+		return 1;
+	}
+	int master = posix_openpt(O_RDWR | O_NOCTTY);
+	if((master < 0) || (grantpt(master) != 0) || (unlockpt(master) != 0))
+	{
+		perror("posix_openpt");
+		return 1;
+	}
+	// keep the slave open ourselves so the master does not hang up whenever
+	// the host closes and reopens the port
+	int slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+	struct termios options;
+	tcgetattr(slave, &options);
+	cfmakeraw(&options);
+	tcsetattr(slave, TCSANOW, &options);
+	printf("%s\n", ptsname(master));
+	fflush(stdout);
+
+	static char expected[MAX_RECORD_SIZE];
+	static char received[MAX_RECORD_SIZE];
+	unsigned int records = 0, mismatches = 0;
+	unsigned long txBytes = 0, rxBytes = 0;
+	long long recordedUs = 0;
+	long long startUs = -1;
+	int status = 0;
+	unsigned char header[UART_RECORD_HEADER_SIZE];
+	while(fread(header, 1, UART_RECORD_HEADER_SIZE, recording) == UART_RECORD_HEADER_SIZE)
+	{
+		unsigned long delta = header[1] | (header[2] << 8) | (header[3] << 16) | ((unsigned long)header[4] << 24);
+		int length = header[5] | (header[6] << 8);
+		if(fread(expected, 1, length, recording) != (size_t)length)
+			break;
+		// the time before the first host write is idle time, not reader time
+		if(startUs >= 0)
+			recordedUs += delta;
+		records++;
+		if(header[0] == UART_RECORD_TX)
+		{
+			if(readHost(master, received, length) != 0)
+			{
+				fprintf(stderr, "record %u: host did not send the recorded %d bytes\n", records, length);
+				status = 1;
+				break;
+			}
+			if(startUs < 0)
+				startUs = monotonicUs();
+			if(memcmp(received, expected, length) != 0)
+				mismatches++;
+			txBytes += length;
+		}
+		else
+		{
+			if(!fast && (startUs >= 0))
+				usleep(delta);
+			if(writeHost(master, expected, length) != 0)
+			{
+				fprintf(stderr, "record %u: write failed\n", records);
+				status = 1;
+				break;
+			}
+			rxBytes += length;
+		}
+	}
+	long long replayUs = startUs < 0 ? 0 : monotonicUs() - startUs;
+	// let the host drain the last reply before the pty goes away
+	tcdrain(master);
+	usleep(100000);
+	fprintf(stderr, "%u records, %lu bytes from host (%u differing writes), %lu bytes to host\n",
+			records, txBytes, mismatches, rxBytes);
+	fprintf(stderr, "recorded %lld ms, replayed in %lld ms\n", recordedUs / 1000, replayUs / 1000);
+	close(slave);
+	close(master);
+	fclose(recording);
+	return status;
+}
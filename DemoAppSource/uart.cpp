@@ -1,58 +1,271 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <sys/ioctl.h>
-#include <sys/types.h>
-#include <sys/stat.h>
-#include <fcntl.h>
-#include <termios.h>
-#include <unistd.h>
-#include <string>
-#include <cstring>
-#include "uart.h"
-
-using namespace std;
-
-UART::UART(string fileName) {
-	this->fileName = fileName;
-}
-int UART::initialize() {
-	fd = open(fileName.c_str(), O_RDWR | O_NOCTTY | O_NDELAY);
-	if(!(fd < 0))
-	{
-		bzero(&options, sizeof(options));
-		options.c_cflag = B115200 | CS8 | CREAD | CLOCAL;
-		options.c_iflag = 0;
-		options.c_oflag = 0; 
-		options.c_lflag = 0;
-		tcflush(fd, TCIFLUSH);
-		tcsetattr(fd, TCSANOW, &options);
-		return 0;
-	}
-	return -4;
-}
-int UART::sendMessage(char *buffer, int numberOfBytes) {
-	int count = write(fd, buffer, numberOfBytes);
-	if(count != numberOfBytes) 
-	{
-		return -1;
-	}
-	return 0;
-}
-int UART::receiveMessage(char *buffer, int numberOfBytes) {
-	int count = 0;
-	if((count = read(fd, (void *) &buffer[0], numberOfBytes)) < 0) {
-	}
-	else if(count == 0){
-	}
-	else {
-	}
-	return count;
-}
-void UART::flush() {
-	tcflush(fd, TCIFLUSH);
-}
-int UART::release() {
-	int ret = close(fd);
-	fd = 0;
-	return ret;
-}
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/ioctl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#include <poll.h>
+#include <errno.h>
+#include <time.h>
+#include <string>
+#include <cstring>
+#include "uart.h"
+
+using namespace std;
+
+#define RX_RING_MASK (UART_RX_RING_SIZE - 1)
+
+static long monotonicMs()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000L + now.tv_nsec / 1000000L;
+}
+static long long monotonicUs()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000LL + now.tv_nsec / 1000;
+}
+
+UART::UART(string fileName) {
+	this->fileName = fileName;
+	rxHead = 0;
+	rxTail = 0;
+	rxDiscard = 0;
+	baudRate = UART_DEFAULT_BAUD_RATE;
+	recordFile = NULL;
+	lastRecordUs = 0;
+}
+int UART::initialize() {
+	fd = open(fileName.c_str(), O_RDWR | O_NOCTTY | O_NDELAY);
+	if(!(fd < 0))
+	{
+		bzero(&options, sizeof(options));
+		options.c_cflag = B115200 | CS8 | CREAD | CLOCAL;
+		options.c_iflag = 0;
+		options.c_oflag = 0; 
+		options.c_lflag = 0;
+		tcflush(fd, TCIFLUSH);
+		tcsetattr(fd, TCSANOW, &options);
+		baudRate = UART_DEFAULT_BAUD_RATE;
+		rxHead = rxTail = 0;
+		rxDiscard = 0;
+		return 0;
+	}
+	return -4;
+}
+int UART::sendMessage(char *buffer, int numberOfBytes) {
+	int count = write(fd, buffer, numberOfBytes);
+	if(count > 0)
+		record(UART_RECORD_TX, buffer, count);
+	if(count != numberOfBytes) 
+	{
+		return -1;
+	}
+	return 0;
+}
+int UART::receiveMessage(char *buffer, int numberOfBytes) {
+	int count = 0;
+	// bytes already pulled into the ring by receiveFrame() come first
+	while((count < numberOfBytes) && (rxTail != rxHead))
+	{
+		buffer[count++] = rxRing[rxTail & RX_RING_MASK];
+		rxTail++;
+	}
+	if(count > 0)
+		return count;
+	if((count = read(fd, (void *) &buffer[0], numberOfBytes)) < 0) {
+	}
+	else if(count == 0){
+	}
+	else {
+		record(UART_RECORD_RX, buffer, count);
+	}
+	return count;
+}
+// Waits up to timeoutMs for the port to become readable and reads everything
+// available into the ring buffer. Returns the number of bytes added, 0 on
+// timeout and -1 on error.
+int UART::fillRxRing(int timeoutMs) {
+	struct pollfd pfd;
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	int ret = poll(&pfd, 1, timeoutMs);
+	if(ret < 0)
+		return (errno == EINTR) ? 0 : -1;
+	if(ret == 0)
+		return 0;
+	int total = 0;
+	while((rxHead - rxTail) < UART_RX_RING_SIZE)
+	{
+		unsigned int start = rxHead & RX_RING_MASK;
+		unsigned int space = UART_RX_RING_SIZE - (rxHead - rxTail);
+		if(space > UART_RX_RING_SIZE - start)
+			space = UART_RX_RING_SIZE - start;
+		int count = read(fd, &rxRing[start], space);
+		if(count <= 0)
+			break;
+		record(UART_RECORD_RX, &rxRing[start], count);
+		rxHead += count;
+		total += count;
+		if((unsigned int)count < space)
+			break;
+	}
+	return total;
+}
+// Incremental decoder: looks at the bytes buffered so far and, if they hold
+// a complete frame, copies it out and returns its length. Headers announcing
+// a length shorter than a header are skipped one byte at a time so the
+// decoder resynchronizes on the next frame. A frame longer than maxLength is
+// dropped as a whole, also the bytes of it that are still to come, and
+// UART_FRAME_TOO_LONG is returned. Returns 0 if more data is needed.
+int UART::decodeFrame(char *buffer, int maxLength) {
+	if(rxDiscard > 0)
+	{	// rest of a frame too long for the caller
+		unsigned int count = rxHead - rxTail;
+		if(count > rxDiscard)
+			count = rxDiscard;
+		rxTail += count;
+		rxDiscard -= count;
+		if(rxDiscard > 0)
+			return 0;
+	}
+	while((rxHead - rxTail) >= 3)
+	{
+		unsigned int length = ((unsigned char)rxRing[(rxTail + 1) & RX_RING_MASK] << 8) |
+				(unsigned char)rxRing[(rxTail + 2) & RX_RING_MASK];
+		if(length < UART_FRAME_HEADER_SIZE)
+		{
+			rxTail++;
+			continue;
+		}
+		if((int)length > maxLength || length > UART_RX_RING_SIZE)
+		{
+			unsigned int count = rxHead - rxTail;
+			if(count > length)
+				count = length;
+			rxTail += count;
+			rxDiscard = length - count;
+			return UART_FRAME_TOO_LONG;
+		}
+		if((rxHead - rxTail) < length)
+			return 0;
+		for(unsigned int i = 0; i < length; i++)
+			buffer[i] = rxRing[(rxTail + i) & RX_RING_MASK];
+		rxTail += length;
+		return length;
+	}
+	return 0;
+}
+// Blocks until a complete frame has been received or no byte arrived for
+// timeoutMs. The timeout is restarted whenever data arrives, matching the
+// inter-byte timeout semantics of the reader protocol. Returns the frame
+// length, 0 on timeout, UART_PORT_ERROR or UART_FRAME_TOO_LONG.
+int UART::receiveFrame(char *buffer, int maxLength, int timeoutMs) {
+	long deadline = monotonicMs() + timeoutMs;
+	while(true)
+	{
+		int length = decodeFrame(buffer, maxLength);
+		if(length != 0)
+			return length;
+		long remaining = deadline - monotonicMs();
+		if(remaining <= 0)
+			return 0;
+		int count = fillRxRing((int)remaining);
+		if(count < 0)
+			return UART_PORT_ERROR;
+		if(count > 0)
+			deadline = monotonicMs() + timeoutMs;
+	}
+}
+void UART::flush() {
+	tcflush(fd, TCIFLUSH);
+	rxHead = rxTail = 0;
+	rxDiscard = 0;
+}
+// Switches the port to another rate once everything written so far is out.
+// Bytes received at the old rate are discarded. Returns 0, or -1 if the rate
+// is not supported.
+int UART::setBaudRate(int baudRate) {
+	speed_t speed;
+	switch(baudRate)
+	{
+		case 115200:	speed = B115200;	break;
+		case 230400:	speed = B230400;	break;
+		case 460800:	speed = B460800;	break;
+		case 500000:	speed = B500000;	break;
+		case 921600:	speed = B921600;	break;
+		case 1000000:	speed = B1000000;	break;
+		default:
+			return -1;
+	}
+	tcdrain(fd);
+	cfsetispeed(&options, speed);
+	cfsetospeed(&options, speed);
+	if(tcsetattr(fd, TCSANOW, &options) != 0)
+		return -1;
+	this->baudRate = baudRate;
+	flush();
+	return 0;
+}
+int UART::getBaudRate() {
+	return baudRate;
+}
+int UART::release() {
+	stopRecording();
+	int ret = close(fd);
+	fd = 0;
+	return ret;
+}
+// Starts capturing every chunk written to or read from the port, with its
+// direction and the time elapsed since the previous chunk. Recording an
+// already recorded session is a no-op. Returns 0 or -1 if the file can not be
+// created.
+int UART::startRecording(string recordFileName) {
+	if(recordFile != NULL)
+		return 0;
+	recordFile = fopen(recordFileName.c_str(), "wb");
+	if(recordFile == NULL)
+		return -1;
+	fwrite(UART_RECORD_MAGIC, 1, UART_RECORD_MAGIC_SIZE, recordFile);
+	lastRecordUs = monotonicUs();
+	return 0;
+}
+void UART::stopRecording() {
+	if(recordFile == NULL)
+		return;
+	fclose(recordFile);
+	recordFile = NULL;
+}
+void UART::record(unsigned char direction, const char *data, int length) {
+	if(recordFile == NULL)
+		return;
+	long long now = monotonicUs();
+	long long delta = now - lastRecordUs;
+	if(delta > 0xFFFFFFFFLL)
+		delta = 0xFFFFFFFFLL;
+	lastRecordUs = now;
+	// reads are bounded by the ring size, writes are split to fit the
+	// 16 bit length field
+	while(length > 0)
+	{
+		int chunk = length > 0xFFFF ? 0xFFFF : length;
+		unsigned char header[UART_RECORD_HEADER_SIZE];
+		header[0] = direction;
+		header[1] = delta & 0xFF;
+		header[2] = (delta >> 8) & 0xFF;
+		header[3] = (delta >> 16) & 0xFF;
+		header[4] = (delta >> 24) & 0xFF;
+		header[5] = chunk & 0xFF;
+		header[6] = (chunk >> 8) & 0xFF;
+		fwrite(header, 1, UART_RECORD_HEADER_SIZE, recordFile);
+		fwrite(data, 1, chunk, recordFile);
+		data += chunk;
+		length -= chunk;
+		delta = 0;
+	}
+}
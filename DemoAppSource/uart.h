@@ -8,6 +8,15 @@
 /// Black  It allows you to initialize and release the UART resource and send
 /// and receive messages through UART.  
 /// 
+/// Received bytes are read in bulk into a ring buffer and framed using the
+/// type/length/CRC header of the reader protocol, so callers block in poll()
+/// until a complete frame is available instead of spinning on single bytes.
+/// 
+/// A session can be recorded to a binary file for later replay through a pty
+/// (see tools/uart_replay.cpp). The file starts with UART_RECORD_MAGIC followed
+/// by one record per write or read: direction (1 byte), microseconds since the
+/// previous record (4 bytes LE), length (2 bytes LE) and the raw bytes.
+/// 
 /// Author: Frank Miranda, RFMicron
 ///-----------------------------------------------------------------------------
 
@@ -16,6 +25,21 @@
 
 #include <termios.h>
 #include  <string>
+#include <stdio.h>
+
+#define UART_RX_RING_SIZE	4096	// must be a power of two
+#define UART_FRAME_HEADER_SIZE	6
+#define UART_DEFAULT_BAUD_RATE	115200
+
+// errors of receiveFrame()
+#define UART_PORT_ERROR		-1
+#define UART_FRAME_TOO_LONG	-2
+
+#define UART_RECORD_MAGIC	"HRMSREC1"
+#define UART_RECORD_MAGIC_SIZE	8
+#define UART_RECORD_HEADER_SIZE	7
+#define UART_RECORD_TX	0	// host to reader
+#define UART_RECORD_RX	1	// reader to host
 
 using namespace std;
 
@@ -24,12 +48,27 @@ class UART {
 		int fd;
 		struct termios options;
 		string fileName;
+		int baudRate;
+		char rxRing[UART_RX_RING_SIZE];
+		unsigned int rxHead;
+		unsigned int rxTail;
+		unsigned int rxDiscard;		// bytes of a frame too long for the caller still to be dropped
+		int fillRxRing(int timeoutMs);
+		int decodeFrame(char *buffer, int maxLength);
+		FILE *recordFile;
+		long long lastRecordUs;
+		void record(unsigned char direction, const char *data, int length);
 	public:
 		UART(string fileName);
 		int initialize();
 		int sendMessage(char *buffer, int numberOfBytes);
 		int receiveMessage(char *buffer, int numberOfBytes);
+		int receiveFrame(char *buffer, int maxLength, int timeoutMs);
 		void flush();
+		int setBaudRate(int baudRate);
+		int getBaudRate();
+		int startRecording(string recordFileName);
+		void stopRecording();
 		int release();
 };
 #endif
@@ -61,6 +61,10 @@
 #include <limits.h>
 #include "as3993.h"
 #include "tuner.h"
+#include "config_store.h"
+#include "stream_dispatcher.h"
+#include "run_loop.h"
+#include "trace.h"
 
 /*
  ******************************************************************************
@@ -208,6 +212,15 @@ static u8 fastInventory;
  */
 static u8 read_TID_CAL_inInventoryRound;
 static u8 read_MMS_VFC_TEMP_inInventoryRound;
+/** If set to 1 cyclic inventory rounds push every tag to the host as soon as it
+ * is singulated instead of after the round, see streamTag(). The value is set in
+ * callStartStop(). */
+static u8 streamTags;
+/** Tag which streamTag() hands to sendCyclicTagData(), NULL if there is none. */
+static Tag *streamedTag;
+/** Set by streamTag() when the UART TX ring is full, ends the round via
+ * continueCheckTimeout(). Cleared in inventoryGen2(). */
+static u8 streamTagsStalled;
 
 /** Value for register AS3993_REG_STATUSPAGE. This defines what RSSI value is sent
  * to the host along with the tag data. The value is set in callStartStop() and callInventoryGen2(). */
@@ -237,6 +250,36 @@ static TunerParameters tunerParams = {15, 15, 15};
 #if RADON
 static TunerParameters tunerAnt1Params = {15, 15, 15};
 #endif
+/** Number of hop frequencies the running band tuning covers, 0 if no band tuning
+ * is running. See callTunerTable() subcmd #TUNER_TABLE_TUNE_BAND. */
+static u8 bandTuningCount;
+/** Index of the next hop frequency doBandTuning() tunes. */
+static u8 bandTuningIdx;
+/** Autotune algorithm of the running band tuning, see autoTuner(). */
+static u8 bandTuningAlgorithm;
+/** Will be set to 1 when doBandTuning() tuned a channel whose result was not yet
+ * pushed to the host by sendBandTuningData(). */
+static u8 bandTuningDataAvailable;
+
+/** Layout version of #settingsStoreItems, increment it when the list or one of
+ * the stored structures changes. */
+#define SETTINGS_STORE_VERSION  1
+/** Settings which are kept in flash by callTunerTable() subcmd #TUNER_TABLE_COMMIT
+ * and restored by loadSettings() after a reset. */
+static const ConfigStoreItem settingsStoreItems[] =
+{
+    { &tuningTable, sizeof(tuningTable) },
+    { &Frequencies, sizeof(Frequencies) },
+    { &gen2Configuration, sizeof(gen2Configuration) },
+    { &gen2qbegin, sizeof(gen2qbegin) },
+    { &guiActiveProfile, sizeof(guiActiveProfile) },
+    { &guiNumFreqs, sizeof(guiNumFreqs) },
+    { &guiMinFreq, sizeof(guiMinFreq) },
+    { &guiMaxFreq, sizeof(guiMaxFreq) },
+#ifdef ANTENNA_SWITCH
+    { &usedAntenna, sizeof(usedAntenna) },
+#endif
+};
 #endif
 
 /** Structure which contains the command data which has been received and shall be sent.
@@ -254,7 +297,7 @@ void antennaTuner(void);
 void autoTuner(void);
 void tunerTable(void);
 u8 inventoryGen2(void);
-void gen2FollowRead(Tag *tag, s8 *readErr);
+BOOL gen2FollowRead(Tag *tag, s8 *readErr);
 void wrongCommand(void);
 void initCommands(void);
 
@@ -275,10 +318,16 @@ static void applyTunerSettingForFreq(u32 freq);
  * This function can be used as callback parameter for gen2SearchForTags().
  * It will return 1 as long as allocation timeout has not been exceeded yet.
  * If allocation timeout has occured it will return 0.
+ * During cyclic inventory it also returns 0 as soon as data from the host
+ * arrives, so that the host waits at most one slot until its command is
+ * processed instead of a whole inventory round. A round which streams tags
+ * also ends once the UART can not take further tags, see streamTag().
  * @return 1 if allocation timeout has not been exceeded yet.
  */
 static BOOL continueCheckTimeout( ) 
 {
+    if (cyclicInventory && runLoopEventPending(RUN_LOOP_EVENT_HOST_RX)) return 0;
+    if (streamTagsStalled) return 0;
     if (maxSendingLimit == 0) return 1;
     if ( slowTimerValue() >= maxSendingLimit )
     {
@@ -684,6 +733,23 @@ void autoTuner(void)
 #endif
 }
 
+/**
+ * Measures the reflected power at the current frequency with the noise level
+ * removed. Returns the I channel in the low byte and the Q channel in the high byte.
+ */
+static u16 measureReflectedPower(void)
+{
+    u16 reflectedValues;
+    u16 noiseLevel;
+
+    noiseLevel = as3993GetReflectedPowerNoiseLevel();
+    as3993AntennaPower(1);
+    reflectedValues = as3993GetReflectedPower();
+    as3993AntennaPower(0);
+    return (u8)((reflectedValues & 0xff) - (noiseLevel & 0xff))
+            | ((u16)(u8)(((reflectedValues >> 8) & 0xff) - ((noiseLevel >> 8) & 0xff)) << 8);
+}
+
 #ifdef TUNER
 /**
  * adds data in current USB buffer to tuning table, should be only called from callAntennaTuner().
@@ -741,6 +807,131 @@ static u8 addToTuningTable(void)
     else
         return tuningTable.tableSize;
 }
+
+/**
+ * Starts the band tuning requested with subcmd #TUNER_TABLE_TUNE_BAND: replaces the
+ * frequency list used for hopping and clears the tuning table, which doBandTuning()
+ * then fills channel by channel.
+ */
+static u8 startBandTuning(void)
+{
+    u8 i, count;
+    u32 baseFreq, freq;
+
+    count = (cmdBuffer.rxSize - CMD_TUNER_TABLE_BAND_RX_SIZE) / 2;
+    if (cmdBuffer.rxSize < CMD_TUNER_TABLE_BAND_RX_SIZE + 2)
+        return ERR_PARAM;
+    if (count > MAXTUNE || count > MAXFREQ)
+        return ERR_NOMEM;
+    baseFreq = 0;
+    baseFreq += (u32)cmdBuffer.rxData[3];
+    baseFreq += ((u32)cmdBuffer.rxData[4]) << 8;
+    baseFreq += ((u32)cmdBuffer.rxData[5]) << 16;
+
+    guiActiveProfile = cmdBuffer.rxData[2];
+    guiNumFreqs = count;
+    guiMinFreq = 0xFFFFFF;
+    guiMaxFreq = 0;
+    for (i = 0; i < count; i++)
+    {
+        freq = baseFreq + cmdBuffer.rxData[CMD_TUNER_TABLE_BAND_RX_SIZE + 2 * i]
+                + ((u32)cmdBuffer.rxData[CMD_TUNER_TABLE_BAND_RX_SIZE + 2 * i + 1] << 8);
+        Frequencies.freq[i] = freq;
+        Frequencies.countFreqHop[i] = 0;
+        if (guiMaxFreq < freq) guiMaxFreq = freq;
+        if (guiMinFreq > freq) guiMinFreq = freq;
+    }
+    Frequencies.numFreqs = count;
+    currentFreqIdx = 0;
+
+    tuningTable.currentEntry = 0;
+    tuningTable.tableSize = 0;
+    bandTuningAlgorithm = cmdBuffer.rxData[1];
+    bandTuningIdx = 0;
+    bandTuningDataAvailable = 0;
+    /* auto_tune 0 only replaces the frequency list */
+    bandTuningCount = bandTuningAlgorithm ? count : 0;
+    APPLOG("tune band: %hhx freqs from %x%x, algorithm %hhx\n", count, guiMinFreq, bandTuningAlgorithm);
+    return ERR_NONE;
+}
+
+/**
+ * Tunes the antenna for freq the way the host did it channel by channel: a hill climb
+ * from the current setting, followed by a hill climb from more points if the reflected
+ * power is still not close to zero. The result is added to the tuning table for the
+ * antenna in use.
+ */
+static void tuneBandChannel(u32 freq)
+{
+    u8 idx;
+    s8 i, q;
+    u16 reflected;
+
+    as3993SetBaseFrequency(AS3993_REG_PLLMAIN1, freq);
+    as3993AntennaPower(1);
+    if (bandTuningAlgorithm == 2)
+        tunerMultiHillClimb(&mainTuner, &tunerParams);
+    else
+        tunerOneHillClimb(&mainTuner, &tunerParams, 100);
+    as3993AntennaPower(0);
+    reflected = measureReflectedPower();
+    i = (s8)(reflected & 0xff);
+    q = (s8)(reflected >> 8);
+    if (bandTuningAlgorithm == 1 && (i > 1 || i < -1 || q > 1 || q < -1))
+    {
+        as3993AntennaPower(1);
+        tunerMultiHillClimb(&mainTuner, &tunerParams);
+        as3993AntennaPower(0);
+        reflected = measureReflectedPower();
+        i = (s8)(reflected & 0xff);
+        q = (s8)(reflected >> 8);
+    }
+    tunerSetTuning(&mainTuner, tunerParams.cin, tunerParams.clen, tunerParams.cout);
+
+    idx = tuningTable.tableSize;
+    tuningTable.freq[idx] = freq;
+    tuningTable.tuneEnable[idx] = usedAntenna;
+    tuningTable.cin[usedAntenna - 1][idx] = tunerParams.cin;
+    tuningTable.clen[usedAntenna - 1][idx] = tunerParams.clen;
+    tuningTable.cout[usedAntenna - 1][idx] = tunerParams.cout;
+    tuningTable.tunedIQ[usedAntenna - 1][idx] = i * i + q * q;
+    tuningTable.tableSize++;
+    APPLOG("tuned f=%x%x cin=%hhx clen=%hhx cout=%hhx iq=%hx\n", freq, tunerParams.cin,
+            tunerParams.clen, tunerParams.cout, tuningTable.tunedIQ[usedAntenna - 1][idx]);
+}
+
+/**
+ * Copies entry idx of the tuning table for the antenna in use to txData in the
+ * format of subcmd #TUNER_TABLE_DUMP.
+ */
+static void putTuningTableEntry(u8 idx, u8 * txData)
+{
+    txData[0] = tuningTable.freq[idx] & 0xff;
+    txData[1] = (tuningTable.freq[idx] >> 8) & 0xff;
+    txData[2] = (tuningTable.freq[idx] >> 16) & 0xff;
+    txData[3] = tuningTable.cin[usedAntenna - 1][idx];
+    txData[4] = tuningTable.clen[usedAntenna - 1][idx];
+    txData[5] = tuningTable.cout[usedAntenna - 1][idx];
+    txData[6] = tuningTable.tunedIQ[usedAntenna - 1][idx] & 0xff;
+    txData[7] = tuningTable.tunedIQ[usedAntenna - 1][idx] >> 8;
+}
+
+/**
+ * Fills txData with the reply to subcmd #TUNER_TABLE_DUMP and returns its size.
+ */
+static u16 dumpTuningTable(u8 * txData)
+{
+    u8 i;
+
+    txData[0] = TUNER_TABLE_DUMP;
+    txData[1] = MAXTUNE;
+    txData[2] = tuningTable.tableSize;
+    for (i = 0; i < tuningTable.tableSize; i++)
+    {
+        putTuningTableEntry(i, &txData[CMD_TUNER_TABLE_REPLY_SIZE + i * CMD_TUNER_TABLE_ENTRY_SIZE]);
+    }
+    return CMD_TUNER_TABLE_REPLY_SIZE + tuningTable.tableSize * CMD_TUNER_TABLE_ENTRY_SIZE;
+}
 #endif
 
 /** This function allows to update the tuner table. For in detail information
@@ -859,6 +1050,153 @@ static u8 addToTuningTable(void)
  * to tuningTable was successful status will be set to ERR_NONE.
  * </li>
  * 
+ * <li>Set up a band: replace the frequency list used for hopping and tune every channel of it:
+ * <table>
+ *  <tr>
+ *      <th>Byte</th>
+ *      <th>0</th>
+ *      <th>1</th>
+ *      <th>2</th>
+ *      <th>3..5</th>
+ *      <th>6..7</th>
+ *      <th>8+2n..9+2n</th>
+ *  </tr>
+ *  <tr>
+ *      <th>Content</th>
+ *      <td>0x03 (SubCmd ID)</td>
+ *      <td>auto_tune</td>
+ *      <td>profile_id</td>
+ *      <td>base frequency</td>
+ *      <td>reserved (0)</td>
+ *      <td>frequency n - base frequency (kHz)</td>
+ *  </tr>
+ * </table>
+ * The frequencies are added to the cleared frequency list in the given order, profile_id
+ * is used as in callChangeFreq() SubCmd 4. The tuning table is cleared and the device
+ * responds right away:
+ * <table>
+ *  <tr>
+ *      <th>Byte</th>
+ *      <th>0</th>
+ *      <th>1</th>
+ *      <th>2</th>
+ *  </tr>
+ *  <tr>
+ *      <th>Content</th>
+ *      <td>0x03 (SubCmd ID)</td>
+ *      <td>maximum tuning table size this device supports</td>
+ *      <td>number of frequencies to tune</td>
+ *  </tr>
+ * </table>
+ * Then doBandTuning() tunes one channel after the other with the auto_tune algorithm
+ * (see autoTuner(), 1 continues with algorithm 2 if the reflected power stays high) and
+ * every result but the last is pushed to the host without request:
+ * <table>
+ *  <tr>
+ *      <th>Byte</th>
+ *      <th>0</th>
+ *      <th>1</th>
+ *      <th>2</th>
+ *      <th>3..10</th>
+ *  </tr>
+ *  <tr>
+ *      <th>Content</th>
+ *      <td>0x04 (SubCmd ID)</td>
+ *      <td>number of tuned channels</td>
+ *      <td>number of frequencies to tune</td>
+ *      <td>tuning table entry as in SubCmd 5</td>
+ *  </tr>
+ * </table>
+ * When all channels are tuned the whole tuning table is pushed as reply to SubCmd 5.
+ * With auto_tune 0 nothing is tuned and nothing is pushed, the number of frequencies to
+ * tune is 0. This restores a tuning table the host saved, followed by SubCmd 2 for
+ * every entry.
+ * Status will be set to ERR_NOMEM if there are more than #MAXTUNE frequencies. Any
+ * command received stops the band tuning, the channels tuned so far stay in the table.
+ * </li>
+ *
+ * <li>Get the tuning table:
+ * <table>
+ *  <tr>
+ *      <th>Byte</th>
+ *      <th>0</th>
+ *  </tr>
+ *  <tr>
+ *      <th>Content</th>
+ *      <td>0x05 (SubCmd ID)</td>
+ *  </tr>
+ * </table>
+ * The device sends back the entries for the antenna in use:
+ * <table>
+ *  <tr>
+ *      <th>Byte</th>
+ *      <th>0</th>
+ *      <th>1</th>
+ *      <th>2</th>
+ *      <th>3+8n..5+8n</th>
+ *      <th>6+8n</th>
+ *      <th>7+8n</th>
+ *      <th>8+8n</th>
+ *      <th>9+8n..10+8n</th>
+ *  </tr>
+ *  <tr>
+ *      <th>Content</th>
+ *      <td>0x05 (SubCmd ID)</td>
+ *      <td>maximum tuning table size this device supports</td>
+ *      <td>current tuning table size</td>
+ *      <td>frequency</td>
+ *      <td>cin</td>
+ *      <td>clen</td>
+ *      <td>cout</td>
+ *      <td>I*I+Q*Q after tuning</td>
+ *  </tr>
+ * </table>
+ * </li>
+ *
+ * <li>Keep the settings in flash:
+ * <table>
+ *  <tr>
+ *      <th>Byte</th>
+ *      <th>0</th>
+ *  </tr>
+ *  <tr>
+ *      <th>Content</th>
+ *      <td>0x06 (SubCmd ID)</td>
+ *  </tr>
+ * </table>
+ * The tuning table, the hop frequencies, the Gen2 configuration and the antenna in
+ * use are written to flash, after a reset loadSettings() restores them. The device
+ * sends back:
+ * <table>
+ *  <tr>
+ *      <th>Byte</th>
+ *      <th>0</th>
+ *      <th>1</th>
+ *      <th>2</th>
+ *  </tr>
+ *  <tr>
+ *      <th>Content</th>
+ *      <td>0x06 (SubCmd ID)</td>
+ *      <td>maximum tuning table size this device supports</td>
+ *      <td>stored tuning table size</td>
+ *  </tr>
+ * </table>
+ * </li>
+ *
+ * <li>Forget the settings in flash, after the next reset the defaults are used:
+ * <table>
+ *  <tr>
+ *      <th>Byte</th>
+ *      <th>0</th>
+ *  </tr>
+ *  <tr>
+ *      <th>Content</th>
+ *      <td>0x07 (SubCmd ID)</td>
+ *  </tr>
+ * </table>
+ * The device sends back 0x07 and the maximum tuning table size this device supports.
+ * </li>
+ *
  * <li> If the device does not support antenna tuning or if a unsupported SubCmd ID
  * was received the device sends back:
  *  <table>
@@ -917,6 +1255,28 @@ void tunerTable(void)
         cmdBuffer.txData[0] = 0x02;    //subcmd
         cmdBuffer.txData[1] = MAXTUNE - tuningTable.tableSize;
         break;
+    case TUNER_TABLE_TUNE_BAND:
+        cmdBuffer.result = startBandTuning();
+        cmdBuffer.txData[0] = TUNER_TABLE_TUNE_BAND;    //subcmd
+        cmdBuffer.txData[1] = MAXTUNE;
+        cmdBuffer.txData[2] = bandTuningCount;
+        break;
+    case TUNER_TABLE_DUMP:
+        cmdBuffer.txSize = dumpTuningTable(cmdBuffer.txData);
+        APPLOGDUMP(cmdBuffer.txData, cmdBuffer.txSize);
+        return;
+    case TUNER_TABLE_COMMIT:
+        cmdBuffer.result = configStoreCommit(settingsStoreItems,
+                sizeof(settingsStoreItems) / sizeof(settingsStoreItems[0]), SETTINGS_STORE_VERSION);
+        cmdBuffer.txData[0] = TUNER_TABLE_COMMIT;    //subcmd
+        cmdBuffer.txData[1] = MAXTUNE;
+        cmdBuffer.txData[2] = tuningTable.tableSize;
+        break;
+    case TUNER_TABLE_INVALIDATE:
+        cmdBuffer.result = configStoreInvalidate();
+        cmdBuffer.txData[0] = TUNER_TABLE_INVALIDATE;    //subcmd
+        cmdBuffer.txData[1] = MAXTUNE;
+        break;
     default:
         cmdBuffer.txData[0] = 0xFF; //subcmd
         cmdBuffer.txData[1] = MAXTUNE;
@@ -1118,6 +1478,49 @@ u8 writeRegister(u8 addr, u8 value, u16 * txSize, u8 * txData)
     return ERR_NONE;
 }
 
+/**
+ * writes a batch of AS3993 registers and prepares tx answer to host.\n
+ * see cmdWriteRegs() for request and reply structure.
+ * @param rxSize size of the (address, mask, value) triples in rxData
+ * @param rxData the triples
+ * @param txSize expected tx size
+ * @param txData buffer for reply
+ * @return error code
+ */
+u8 writeRegisters(u16 rxSize, const u8 * rxData, u16 * txSize, u8 * txData)
+{
+    u16 i;
+    u8 addr;
+    u8 mask;
+    u8 value;
+
+    APPLOG("WRITE registers\n");
+    *txSize = 0;
+    if (rxSize < WRITE_REGS_ENTRY_SIZE)
+        return ERR_PARAM;
+    powerUpReader();
+    for (i = 0; i + WRITE_REGS_ENTRY_SIZE <= rxSize; i += WRITE_REGS_ENTRY_SIZE)
+    {
+        addr = rxData[i];
+        mask = rxData[i + 1];
+        value = rxData[i + 2];
+        if (addr >= 0x80)
+        {
+            as3993SingleCommand(addr);
+            txData[(*txSize)++] = 0;
+            continue;
+        }
+        if (mask != 0xFF)
+        {   /* bits outside mask keep what the firmware has set */
+            value = (as3993SingleRead(addr) & ~mask) | (value & mask);
+        }
+        as3993SingleWrite(addr, value);
+        txData[(*txSize)++] = as3993SingleRead(addr);
+    }
+    /* do not power down reader, see writeRegister() */
+    return ERR_NONE;
+}
+
 /**
  * reads one AS3993 register at address and puts the value into the reply to the host.\n
  * see cmdReadReg() for reply structure.
@@ -1679,6 +2082,49 @@ void callInventoryGen2(void)
     cmdBuffer.result = ERR_NONE;
 }
 
+/**
+ * Writes the record of one tag of a CMD_GET_TAG_DATA reply, see callInventoryGen2().
+ * @param tag The tag
+ * @param txData Buffer for the record
+ * @return Number of bytes written.
+ */
+static u16 putTagData( const Tag *tag, u8 *txData )
+{
+    u16 size = 0;
+
+    txData[size++] = tag->agc;
+    txData[size++] = tag->rssi;
+    txData[size++] = Frequencies.freq[currentFreqIdx] & 0xff;
+    txData[size++] = (Frequencies.freq[currentFreqIdx] >>  8) & 0xff;
+    txData[size++] = (Frequencies.freq[currentFreqIdx] >> 16) & 0xff;
+    txData[size++] = tag->epclen + 2;
+    txData[size++] = tag->pc[0];
+    txData[size++] = tag->pc[1];
+    memcpy(&txData[size], tag->epc, tag->epclen);
+
+    size += tag->epclen;
+
+    if(read_TID_CAL_inInventoryRound)
+    {
+        txData[size++] = tag->tidlength;
+        memcpy(&txData[size], tag->tid, tag->tidlength);
+        size += tag->tidlength;
+        memcpy(&txData[size], tag->cal, 8);
+        size += 8;
+    }
+
+    if(read_MMS_VFC_TEMP_inInventoryRound)
+    {
+        txData[size++] = tag->mms[0];
+        txData[size++] = tag->mms[1];
+        txData[size++] = tag->vfc[0];
+        txData[size++] = tag->vfc[1];
+        txData[size++] = tag->temp[0];
+        txData[size++] = tag->temp[1];
+    }
+    return size;
+}
+
 u8 getTagData( u16 *txSize, u8 *txData )
 {
     unsigned char element = 0;
@@ -1710,42 +2156,7 @@ u8 getTagData( u16 *txSize, u8 *txData )
     
     while(num_of_tags > 0)
     {
-        txData[(*txSize)++] = tags_[element].agc;
-        txData[(*txSize)++] = tags_[element].rssi;
-        txData[(*txSize)++] = Frequencies.freq[currentFreqIdx] & 0xff;
-        txData[(*txSize)++] = (Frequencies.freq[currentFreqIdx] >>  8) & 0xff;
-        txData[(*txSize)++] = (Frequencies.freq[currentFreqIdx] >> 16) & 0xff;
-        txData[(*txSize)++] = tags_[element].epclen + 2;
-        txData[(*txSize)++] = tags_[element].pc[0];
-        txData[(*txSize)++] = tags_[element].pc[1];
-        memcpy(&txData[*txSize], tags_[element].epc, tags_[element].epclen);
-
-        *txSize += tags_[element].epclen;
-
-        if(read_TID_CAL_inInventoryRound)
-        {
-            txData[(*txSize)++] = tags_[element].tidlength;
-            memcpy(&txData[*txSize], tags_[element].tid, tags_[element].tidlength);
-            *txSize += tags_[element].tidlength;
-            txData[(*txSize)++] = tags_[element].cal[0];
-            txData[(*txSize)++] = tags_[element].cal[1];
-            txData[(*txSize)++] = tags_[element].cal[2];
-            txData[(*txSize)++] = tags_[element].cal[3];
-            txData[(*txSize)++] = tags_[element].cal[4];
-            txData[(*txSize)++] = tags_[element].cal[5];
-            txData[(*txSize)++] = tags_[element].cal[6];
-            txData[(*txSize)++] = tags_[element].cal[7];
-        }
-
-        if(read_MMS_VFC_TEMP_inInventoryRound)
-        {
-            txData[(*txSize)++] = tags_[element].mms[0];
-            txData[(*txSize)++] = tags_[element].mms[1];
-            txData[(*txSize)++] = tags_[element].vfc[0];
-            txData[(*txSize)++] = tags_[element].vfc[1];
-            txData[(*txSize)++] = tags_[element].temp[0];
-            txData[(*txSize)++] = tags_[element].temp[1];
-        }
+        *txSize += putTagData(&tags_[element], &txData[*txSize]);
         num_of_tags--;
         element++;
     }
@@ -1755,6 +2166,72 @@ u8 getTagData( u16 *txSize, u8 *txData )
     return ERR_NONE;
 }
 
+/**
+ * Used as followTagCommand of gen2SearchForTags() in cyclic inventory rounds
+ * with #INVENTORY_STREAM_TAGS. Reads TID and sensor data if requested and queues
+ * the tag for the host right away, see sendCyclicTagData(). The entry of the tag
+ * is free again afterwards, so a round is not limited to #MAXTAG tags and the
+ * host sees the first tag one slot after the round started.
+ * The UART sends the frame from its TX interrupt, so the slot loop does not wait
+ * for it. If the TX ring is full the tag is kept for the reply at the end of the
+ * round and the round ends, the host link can not keep up with more tags.
+ * @param tag The tag which has just been singulated, it is in the Open state.
+ * @param readErr See gen2FollowRead().
+ * @return 1 if the tag has been passed on, 0 if it has been kept.
+ */
+static BOOL streamTag(Tag *tag, s8 *readErr)
+{
+    s8 result;
+
+    if (read_TID_CAL_inInventoryRound || read_MMS_VFC_TEMP_inInventoryRound)
+        gen2FollowRead(tag, readErr);
+    streamedTag = tag;
+    result = StreamDispatcherProcessCyclic();
+    streamedTag = NULL;
+    if (result != ERR_NONE)
+    {
+        streamTagsStalled = 1;
+        return 0;
+    }
+    return 1;
+}
+
+/**This function pushes the tag data of the last cyclic inventory round to the host.
+ * It is called via applProcessCyclic() whenever the stream dispatcher is idle. The
+ * packet is a #CMD_GET_TAG_DATA reply with the same payload as callGetTagData(), so
+ * the host decodes pushed rounds the same way as polled ones. Outside of cyclic
+ * inventory nothing is sent, the host fetches single rounds with #CMD_GET_TAG_DATA.
+ * @param protocol Protocol byte for the stream packet
+ * @param txSize Number of bytes which have been copied into the buffer.
+ * @param txData Buffer to use for tx data
+ * @param remainingSize Number of available bytes in the tx buffer.
+ * @return Status of the command.
+ */
+u8 sendCyclicTagData( u8 * protocol, u16 * txSize, u8 * txData, u16 remainingSize )
+{
+    *txSize = 0;
+    if (!cyclicInventory)
+    {
+        return ERR_NONE;
+    }
+    if (streamedTag != NULL)
+    {   // a single tag while the round is running, the round ends with a reply without TAG_DATA_ROUND_CONTINUES
+        *protocol = CMD_GET_TAG_DATA;
+        txData[0] = inventoryResult;
+        txData[1] = read_MMS_VFC_TEMP_inInventoryRound << 2 | read_TID_CAL_inInventoryRound << 1 | TAG_DATA_ROUND_CONTINUES;
+        txData[2] = 1;
+        *txSize = 3 + putTagData(streamedTag, &txData[3]);
+        streamedTag = NULL;
+        return ERR_NONE;
+    }
+    if (!tagDataAvailable)
+    {
+        return ERR_NONE;
+    }
+    *protocol = CMD_GET_TAG_DATA;
+    return getTagData( txSize, txData );
+}
+
 void callGetTagData()
 {
     cmdBuffer.result = getTagData( &cmdBuffer.txSize, cmdBuffer.txData );
@@ -1763,10 +2240,13 @@ void callGetTagData()
 u8 inventoryGen2(void)
 {
     s8 result;
-    void (*followTagCommand)(Tag *tag, s8 *readErr) = NULL;
+    BOOL (*followTagCommand)(Tag *tag, s8 *readErr) = NULL;
     num_of_tags = 0;
+    streamTagsStalled = 0;
     APPLOG("INVENTORY Gen2 , autoAck: %hhx, fast: %hhx, rssi: %hhx\n", autoAckMode, fastInventory, rssiMode);
     result = hopFrequencies();
+    TRACE_EVENT(TRACE_HOP, currentFreqIdx, result);
+    inventoryResult = result;
     if( !result )
     {
         checkAndSetSession(SESSION_GEN2);
@@ -1781,6 +2261,10 @@ u8 inventoryGen2(void)
             {
                 followTagCommand = gen2FollowRead;
             }
+            if (cyclicInventory && streamTags)
+            {
+                followTagCommand = streamTag;
+            }
 
             if( !autoAckMode )
                 num_of_tags = gen2SearchForTags(tags_, MAXTAG, gen2qbegin, continueCheckTimeout, fastInventory?0:1, 1, followTagCommand);
@@ -1795,7 +2279,6 @@ u8 inventoryGen2(void)
             special_select_performed = 0;  
        }
     }
-    inventoryResult = result;
     hopChannelRelease();
 #if RADON
     //delay_ms(100);
@@ -1803,6 +2286,7 @@ u8 inventoryGen2(void)
 #endif
 
     APPLOG("end inventory, found tags: %hhx\n", num_of_tags);
+    TRACE_EVENT(TRACE_INVENTORY_END, result, num_of_tags);
     return num_of_tags;
 }
 
@@ -2271,7 +2755,6 @@ static void pseudoRandomContinuousModulation()
 void callChangeFreq(void)
 {
     u16 reflectedValues;
-    u16 noiseLevel;
     u32 freq;
     freq = 0;
     freq += (u32)cmdBuffer.rxData[1];
@@ -2299,13 +2782,10 @@ void callChangeFreq(void)
                     applyTunerSettingForFreq(freq);
                 }
                 #endif
-                noiseLevel = as3993GetReflectedPowerNoiseLevel();
-                as3993AntennaPower(1);
-                reflectedValues = as3993GetReflectedPower();
-                as3993AntennaPower(0);
+                reflectedValues = measureReflectedPower();
                 cmdBuffer.txSize = 2;
-                cmdBuffer.txData[0] = (reflectedValues & 0xff) - (noiseLevel & 0xff);
-                cmdBuffer.txData[1] = ((reflectedValues >> 8)&0xff) - ((noiseLevel >> 8)&0xff);
+                cmdBuffer.txData[0] = reflectedValues & 0xff;
+                cmdBuffer.txData[1] = reflectedValues >> 8;
                 cmdBuffer.result = ERR_NONE;
                 powerDownReader();
                 break;
@@ -2690,8 +3170,13 @@ exit:
     <tr><th>   Byte</th><th>                  0</th></tr>
     <tr><th>Content</th><td>current start value</td></tr>
   </table>
-    Subsequently callInventoryGen2() result packets are returned in a
-    dense continuous loop.
+    Subsequently the inventory rounds are performed in a dense continuous
+    loop and the result of each round is pushed to the host without request,
+    see sendCyclicTagData(). Any command received stops the cyclic inventory.
+    If #INVENTORY_STREAM_TAGS is set in the inventory type byte, every tag is
+    pushed on its own as soon as it is singulated, in a reply with
+    #TAG_DATA_ROUND_CONTINUES set. The reply at the end of the round then has
+    no tags. See streamTag().
  */
 void callStartStop(void)
 {
@@ -2705,6 +3190,7 @@ void callStartStop(void)
             fastInventory = cmdBuffer.rxData[3] & 0x01;
             read_TID_CAL_inInventoryRound = (cmdBuffer.rxData[3] & 0x02) >> 1 ;
             read_MMS_VFC_TEMP_inInventoryRound = (cmdBuffer.rxData[3] & 0x04) >> 2;
+            streamTags = (cmdBuffer.rxData[3] & INVENTORY_STREAM_TAGS) ? 1 : 0;
             rssiMode = cmdBuffer.rxData[4];
         }
     }
@@ -2865,6 +3351,7 @@ void initCommands(void)
     fastInventory = 0;
     read_TID_CAL_inInventoryRound = 0;
     read_MMS_VFC_TEMP_inInventoryRound = 0;
+    streamTags = 0;
     autoAckMode = 1;
     rssiMode = 0x06;    //rssi at 2nd byte
     rssiThreshold = -40;
@@ -2879,6 +3366,23 @@ void initCommands(void)
     powerDownReader();
 }
 
+/**
+ * Restores the settings kept in flash with callTunerTable() subcmd #TUNER_TABLE_COMMIT.
+ * Called once at startup before the reader is initialized, so that after any reset
+ * the reader hops and tunes as before without the host sending the band again.
+ * If nothing valid is stored the defaults stay.
+ */
+void loadSettings(void)
+{
+#ifdef TUNER
+    if (configStoreLoad(settingsStoreItems, sizeof(settingsStoreItems) / sizeof(settingsStoreItems[0]),
+                SETTINGS_STORE_VERSION) != ERR_NONE)
+        return;
+    memset(Frequencies.countFreqHop, 0, sizeof(Frequencies.countFreqHop));
+    APPLOG("settings restored, %hhx freqs, tuning table size %hhx\n", Frequencies.numFreqs, tuningTable.tableSize);
+#endif
+}
+
 #ifdef TUNER
 static void applyTunerSettingForFreq(u32 freq)
 {
@@ -3056,6 +3560,62 @@ int doCyclicInventory(void)
     return 0;
 }
 
+/**
+ * This function is called periodically from main() loop. If a band tuning has been
+ * started with callTunerTable() subcmd #TUNER_TABLE_TUNE_BAND and the result of the
+ * last channel has been pushed to the host, the next channel is tuned.
+ */
+int doBandTuning(void)
+{
+#ifdef TUNER
+    if (bandTuningIdx >= bandTuningCount || bandTuningDataAvailable)
+        return 0;
+    powerUpReader();
+    tuneBandChannel(Frequencies.freq[bandTuningIdx]);
+    powerDownReader();
+    bandTuningIdx++;
+    bandTuningDataAvailable = 1;
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+/**This function pushes the result of the channel doBandTuning() tuned last to the host,
+ * or the whole tuning table once all channels are tuned, see callTunerTable() subcmd
+ * #TUNER_TABLE_TUNE_BAND. It is called via applProcessCyclic().
+ * @param protocol Protocol byte for the stream packet
+ * @param txSize Number of bytes which have been copied into the buffer.
+ * @param txData Buffer to use for tx data
+ * @param remainingSize Number of available bytes in the tx buffer.
+ * @return Status of the command.
+ */
+u8 sendBandTuningData( u8 * protocol, u16 * txSize, u8 * txData, u16 remainingSize )
+{
+    *txSize = 0;
+#ifdef TUNER
+    if (!bandTuningDataAvailable)
+    {
+        return ERR_NONE;
+    }
+    bandTuningDataAvailable = 0;
+    *protocol = CMD_TUNER_TABLE;
+    if (bandTuningIdx >= bandTuningCount)
+    {
+        bandTuningCount = 0;
+        bandTuningIdx = 0;
+        *txSize = dumpTuningTable(txData);
+        return ERR_NONE;
+    }
+    txData[0] = TUNER_TABLE_PROGRESS;
+    txData[1] = bandTuningIdx;
+    txData[2] = bandTuningCount;
+    putTuningTableEntry(bandTuningIdx - 1, &txData[3]);
+    *txSize = 3 + CMD_TUNER_TABLE_ENTRY_SIZE;
+#endif
+    return ERR_NONE;
+}
+
 /** Handles the configured power down mode of the reader. The power down mode
  * is define in readerPowerDownMode variable and can be changed via callReaderConfig().
  * Available modes are: #POWER_DOWN, #POWER_NORMAL, #POWER_NORMAL_RF and #POWER_STANDBY
@@ -3239,6 +3799,15 @@ static void powerUpReader(void)
  *   <li> FLOW CONTROL: NONE
  * </ul>
  *
+ * <b>Pipelined requests:</b>
+ * The host may tag a request with a sequence number (1..255) in the status byte
+ * of the request header and send further requests before the reply has arrived.
+ * Requests are executed in the order they were received. The reply to a tagged
+ * request has #UART_SEQUENCE_FLAG set in its message type and carries the
+ * sequence number as last byte behind the data (see ams_stream.h).
+ * As unprocessed requests wait in the UART receive buffer, the host must not
+ * have more than #UART_RX_BUFFER_SIZE request bytes in flight.
+ *
  * \subsubsection streamexampleConfigTXRX Example for the config TX RX command, handled by callConfigTxRx():
  * Request from host (Reader Suite):
  * <table>
@@ -3335,8 +3904,21 @@ static void powerUpReader(void)
 u8 commands( u8 protocol, u16 rxSize, const u8 * rxData, u16 * txSize, u8 * txData )
 {
     APPLOG("%hhxI\n", protocol);
+    TRACE_EVENT(TRACE_HOST_COMMAND, protocol, rxSize);
     //if (rxSize == 0) return ERR_REQUEST;
-    cyclicInventory = 0;    //stop cyclic inventory when new command has been received.
+    if (cyclicInventory)
+    {   //stop cyclic inventory when new command has been received.
+        cyclicInventory = 0;
+        tagDataAvailable = 0;   //the host does not expect the round which was not pushed yet
+    }
+#ifdef TUNER
+    if (bandTuningCount)
+    {   //stop band tuning as well, the channels tuned so far stay in the tuning table
+        bandTuningCount = 0;
+        bandTuningIdx = 0;
+        bandTuningDataAvailable = 0;
+    }
+#endif
     
     if (protocol >= CALL_FKT_SIZE)
     {
@@ -3527,12 +4109,13 @@ void callConfigPA(void)
   *            state
   *
   * @param *tag Pointer to the Tag structure.
-  * @return The function returns an errorcode.
+  * @param *readErr The error codes of the reads are stored here.
                   0x00 means no error occoured.
                   0xFF unknown error occoured.
                   Any other value is the backscattered error code from the tag.
+  * @return 0, the tag stays in the tag list of the round, see gen2SearchForTags().
  */
-void gen2FollowRead(Tag *tag, s8 *readErr)
+BOOL gen2FollowRead(Tag *tag, s8 *readErr)
 {
     u8 wordCount = 4;
     u32 wordPtr = 0;
@@ -3709,7 +4292,7 @@ void gen2FollowRead(Tag *tag, s8 *readErr)
            }
        } 
     }
-    return;
+    return 0;
 }
 
 
@@ -57,11 +57,16 @@ extern u8 commands( u8 protocol, u16 rxSize, const u8 * rxData, u16 * txSize, u8
 extern void initCommands(void);
 extern u8 uartCommands(void);
 extern u8 sendTagData( u8 * protocol, u16 * txSize, u8 * txData, u16 remainingSize );
+extern u8 sendCyclicTagData( u8 * protocol, u16 * txSize, u8 * txData, u16 remainingSize );
 extern int doCyclicInventory(void);
+extern u8 sendBandTuningData( u8 * protocol, u16 * txSize, u8 * txData, u16 remainingSize );
+extern int doBandTuning(void);
+extern void loadSettings(void);
 
 extern u8 readRegister(u8 addr, u16 * txSize, u8 * txData);
 extern u8 readRegisters(u16 * txSize, u8 * txData);
 extern u8 writeRegister(u8 addr, u8 value, u16 * txSize, u8 * txData);
+extern u8 writeRegisters(u16 rxSize, const u8 * rxData, u16 * txSize, u8 * txData);
 
 
 /* command functions table */
@@ -166,6 +171,9 @@ extern struct callFunction call_fkt_[CALL_FKT_SIZE];
 #define COM_CTRL_CMD_ENTER_BOOTLOADER_RESP 46
 #define COM_WRITE_REG_RESP           47
 #define COM_READ_REG_RESP            48
+#define COM_SET_BAUDRATE_RESP        49
+#define COM_WRITE_REGS_RESP          50
+#define COM_READ_TRACE_RESP          51
 
 /*Size */
 #define CMD_READER_CONFIG_MIN_REPLY_SIZE    9
@@ -175,6 +183,23 @@ extern struct callFunction call_fkt_[CALL_FKT_SIZE];
 
 #define CMD_TUNER_TABLE_REPLY_SIZE          3
 #define CMD_TUNER_TABLE_RX_SIZE             1
+#define CMD_TUNER_TABLE_BAND_RX_SIZE        8   /* tune band request without any frequency */
+#define CMD_TUNER_TABLE_ENTRY_SIZE          8   /* freq, cin, clen, cout, I+Q of one dumped entry */
+
+/* CMD_TUNER_TABLE subcommands of the band setup */
+#define TUNER_TABLE_TUNE_BAND               0x03
+#define TUNER_TABLE_PROGRESS                0x04
+#define TUNER_TABLE_DUMP                    0x05
+/* CMD_TUNER_TABLE subcommands of the settings store in flash */
+#define TUNER_TABLE_COMMIT                  0x06
+#define TUNER_TABLE_INVALIDATE              0x07
+
+/* Inventory type byte of callInventoryGen2() and callStartStop() requests */
+/** Cyclic inventory pushes every tag as soon as it is singulated. */
+#define INVENTORY_STREAM_TAGS               0x08
+/* Inventory type byte of CMD_GET_TAG_DATA replies */
+/** More tags of the same inventory round follow in further replies. */
+#define TAG_DATA_ROUND_CONTINUES            0x08
 
 #define CMD_AUTO_TUNER_REPLY_SIZE           0
 #define CMD_AUTO_TUNER_RX_SIZE              1
@@ -253,6 +278,8 @@ extern struct callFunction call_fkt_[CALL_FKT_SIZE];
 #define WRITE_REG_REPLY_SIZE            1
 #define WRITE_REG_RX_SIZE               2
 
+#define WRITE_REGS_ENTRY_SIZE           3
+
 #define READ_REG_REPLY_SIZE             1
 #define READ_REG_RX_SIZE                2
 
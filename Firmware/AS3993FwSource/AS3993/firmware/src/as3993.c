@@ -42,6 +42,8 @@
 #include "stdlib.h"
 #include "string.h"
 #include "Compiler.h"
+#include "run_loop.h"
+#include "trace.h"
 #if VERBOSE_INIT
 #include <math.h>
 #endif
@@ -432,6 +434,7 @@ void INTERRUPT as3993Isr(void)
 #endif
     as3993Response |= (regs[0] | (regs[1] << 8));
     }while(AS3993_PORT_INT);
+    runLoopPostEvent(RUN_LOOP_EVENT_READER_IRQ);
 
     //LOG("isr: %hx\n", as3993Response);
 }
@@ -534,15 +537,30 @@ void as3993CommandContinuousAddress(u8 *command, u8 com_len,
     ENEXTIRQ();
 }
 
-void as3993WaitForResponseTimed(u16 waitMask, u16 counter)
+/** Idles until as3993Isr() has set one of the bits of waitMask in
+  * #as3993Response or at least ms milliseconds have passed.
+  * @return 1 if a bit of waitMask is set, 0 on timeout.
+  */
+static BOOL waitForResponse(u16 waitMask, u16 ms)
 {
-    while (((as3993Response & waitMask) == 0) && (counter))
+    u16 start = runLoopTicks();
+    /* +1 as the first tick may elapse right after start */
+    u16 ticks = (ms + RUN_LOOP_TICK_MS - 1) / RUN_LOOP_TICK_MS + 1;
+
+    while ((as3993Response & waitMask) == 0)
     {
-        delay_ms(1);
-        counter--;
+        if ((u16)(runLoopTicks() - start) >= ticks)
+            return 0;
+        runLoopWait(RUN_LOOP_EVENT_READER_IRQ | RUN_LOOP_EVENT_TICK);
     }
-    if (counter==0)
+    return 1;
+}
+
+void as3993WaitForResponseTimed(u16 waitMask, u16 counter)
+{
+    if (!waitForResponse(waitMask, counter))
     {
+        TRACE_EVENT(TRACE_RESPONSE_TIMEOUT, 1, waitMask);
 #if !USE_UART_STREAM_DRIVER
         LOG("TI O T %x %x\n", as3993Response, waitMask);
 #endif
@@ -554,15 +572,9 @@ void as3993WaitForResponseTimed(u16 waitMask, u16 counter)
 
 void as3993WaitForResponse(u16 waitMask)
 {
-    u16 counter;
-    counter=0;
-    while (((as3993Response & waitMask) == 0) && (counter < WAITFORRESPONSECOUNT))
-    {
-        counter++;
-        delay_us(WAITFORRESPONSEDELAY);
-    }
-    if (counter >= WAITFORRESPONSECOUNT)
+    if (!waitForResponse(waitMask, WAITFORRESPONSETIMEOUT / 1000))
     {
+        TRACE_EVENT(TRACE_RESPONSE_TIMEOUT, 0, waitMask);
 #if !USE_UART_STREAM_DRIVER
         LOG("TI O response: %x, mask: %x\n", as3993Response, waitMask);
 #endif
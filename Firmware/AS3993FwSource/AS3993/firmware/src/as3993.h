@@ -194,12 +194,8 @@
 
 /* at 40kHz BLF one gen2 slot takes ~40ms, we are going to wait
  * 50ms (in as3993WaitForResponse()) to be on the safe side. */
-/** delay in us which will be used as3993WaitForResponse() loop */
-#define WAITFORRESPONSEDELAY    10
 /** max delay in us which we will wait for an response from AS3993 */
 #define WAITFORRESPONSETIMEOUT  50000
-/** number of loop iterations in as3993WaitForResponse() */
-#define WAITFORRESPONSECOUNT    WAITFORRESPONSETIMEOUT/WAITFORRESPONSEDELAY
 
 
 extern volatile u16 as3993Response;
@@ -263,7 +259,8 @@ void as3993CommandContinuousAddress(u8 *command, u8 com_len,
                              u8 address, u8 *buf, u8 buf_len);
 
 /*------------------------------------------------------------------------- */
-/** This function waits for the specified response(IRQ).
+/** This function waits for the specified response(IRQ). The CPU idles
+  * until as3993Isr() or the run loop tick wakes it up.
   */
 void as3993WaitForResponse(u16 waitMask);
 
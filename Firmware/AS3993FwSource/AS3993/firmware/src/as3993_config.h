@@ -78,6 +78,11 @@
 /** If set to 1 reader intialization will be more verbose. */
 #define VERBOSE_INIT 0
 
+/** Set this to 1 to store binary trace events in RAM which the host reads
+ with the stream command AMS_COM_READ_TRACE, see trace.h. Unlike the logger
+ it is cheap enough to stay enabled in release builds. */
+#define TRACE 1
+
 /** Set this to 1 to enable iso6b support. */
 #if RUN_ON_AS3993
 #define ISO6B 1
@@ -0,0 +1,268 @@
+/*
+ *****************************************************************************
+ * Copyright by ams AG                                                       *
+ * All rights are reserved.                                                  *
+ *                                                                           *
+ * IMPORTANT - PLEASE READ CAREFULLY BEFORE COPYING, INSTALLING OR USING     *
+ * THE SOFTWARE.                                                             *
+ *                                                                           *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS       *
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT         *
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS         *
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT  *
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,     *
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT          *
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,     *
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY     *
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT       *
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE     *
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.      *
+ *****************************************************************************
+/** @file
+  * @brief Implementation of the settings store in flash.
+  *
+  * A record is a byte stream which is packed into flash instructions, 3 bytes
+  * each (the phantom byte is not used):
+  \code
+  magic | version | sequence (2) | length (2) | data (length bytes) | crc (2)
+  \endcode
+  * Each record starts at the beginning of a flash page. The sequence number
+  * of a new record is one higher than the one of the newest record found, the
+  * record is written to the page after it. An empty record (length 0)
+  * invalidates the store.
+  */
+
+#include "as3993_config.h"
+#include "global.h"
+#include "config_store.h"
+#include "flash_access.h"
+#include "crc16.h"
+#include "errno.h"
+#include "logger.h"
+
+/*------------------------------------------------------------------------- */
+#define CONFIG_STORE_MAGIC          0xA5
+#define CONFIG_STORE_HEADER_SIZE    6
+#define CONFIG_STORE_CRC_SIZE       2
+/** Bytes of a flash page which can be used, 3 of every 4 bytes are real flash. */
+#define CONFIG_STORE_PAGE_CAPACITY  (FLASH_PAGE_SIZE_IN_BYTES / 4 * 3)
+
+/** Flash pages of the store, see the description in flash_access.h. */
+static const u8 configStoreFlash[CONFIG_STORE_PAGES * FLASH_PAGE_SIZE_IN_WORDS]
+        __attribute__((space(prog), aligned(FLASH_PAGE_SIZE_IN_WORDS)));
+
+/** Byte stream position within a record in flash. */
+typedef struct
+{
+    u32 address;
+    u8 bytes[3];
+    u8 pos;
+    u16 crc;
+} ConfigStoreCursor;
+
+/** Header of a record in flash. */
+typedef struct
+{
+    u8 magic;
+    u8 version;
+    u16 sequence;
+    u16 length;
+} ConfigStoreHeader;
+
+static u32 pageAddress(u8 page)
+{
+    return __builtin_tbladdress(configStoreFlash) + (u32)page * FLASH_PAGE_SIZE_IN_WORDS;
+}
+
+static void cursorStart(ConfigStoreCursor *cursor, u8 page)
+{
+    cursor->address = pageAddress(page);
+    cursor->pos = 3;
+    cursor->crc = CRC16_PRELOAD;
+}
+
+static u8 readByte(ConfigStoreCursor *cursor)
+{
+    if (cursor->pos == 3)
+    {
+        flashRead3Bytes(&cursor->address, cursor->bytes);
+        cursor->pos = 0;
+    }
+    cursor->crc = updateCrc16(cursor->crc, &cursor->bytes[cursor->pos], 1);
+    return cursor->bytes[cursor->pos++];
+}
+
+static void writeByte(ConfigStoreCursor *cursor, u8 value)
+{
+    if (cursor->pos == 3)
+        cursor->pos = 0;
+    cursor->crc = updateCrc16(cursor->crc, &value, 1);
+    cursor->bytes[cursor->pos++] = value;
+    if (cursor->pos == 3)
+        flashProgram3Bytes(&cursor->address, cursor->bytes);
+}
+
+/** Writes the last, partly filled instruction of a record. */
+static void writeFlush(ConfigStoreCursor *cursor)
+{
+    while (cursor->pos < 3)
+        cursor->bytes[cursor->pos++] = 0xFF;
+    flashProgram3Bytes(&cursor->address, cursor->bytes);
+}
+
+/**
+ * Reads the header of the record in page and checks the CRC of the whole record.
+ * @return 1 if the page holds a complete record.
+ */
+static u8 readHeader(u8 page, ConfigStoreHeader *header)
+{
+    ConfigStoreCursor cursor;
+    u16 i, crc;
+
+    cursorStart(&cursor, page);
+    header->magic = readByte(&cursor);
+    header->version = readByte(&cursor);
+    header->sequence = readByte(&cursor);
+    header->sequence |= (u16)readByte(&cursor) << 8;
+    header->length = readByte(&cursor);
+    header->length |= (u16)readByte(&cursor) << 8;
+    if (header->magic != CONFIG_STORE_MAGIC
+            || header->length > CONFIG_STORE_PAGE_CAPACITY - CONFIG_STORE_HEADER_SIZE - CONFIG_STORE_CRC_SIZE)
+        return 0;
+    for (i = 0; i < header->length; i++)
+        readByte(&cursor);
+    crc = cursor.crc;
+    i = readByte(&cursor);
+    i |= (u16)readByte(&cursor) << 8;
+    return i == crc;
+}
+
+/**
+ * Finds the page with the newest complete record.
+ * @return the page, or CONFIG_STORE_PAGES if no page holds a record.
+ */
+static u8 findNewest(ConfigStoreHeader *newest)
+{
+    ConfigStoreHeader header;
+    u8 page, found = CONFIG_STORE_PAGES;
+
+    for (page = 0; page < CONFIG_STORE_PAGES; page++)
+    {
+        if (!readHeader(page, &header))
+            continue;
+        /* sequence numbers wrap, compare their distance */
+        if (found == CONFIG_STORE_PAGES || (s16)(header.sequence - newest->sequence) > 0)
+        {
+            *newest = header;
+            found = page;
+        }
+    }
+    return found;
+}
+
+/**
+ * Compares the data of the record in page with the RAM blocks in items.
+ * @return 1 if they are equal.
+ */
+static u8 recordEquals(u8 page, const ConfigStoreItem *items, u8 numItems)
+{
+    ConfigStoreCursor cursor;
+    u8 i;
+    u16 j;
+
+    cursorStart(&cursor, page);
+    for (j = 0; j < CONFIG_STORE_HEADER_SIZE; j++)
+        readByte(&cursor);
+    for (i = 0; i < numItems; i++)
+        for (j = 0; j < items[i].size; j++)
+            if (readByte(&cursor) != ((const u8 *)items[i].data)[j])
+                return 0;
+    return 1;
+}
+
+static s8 writeRecord(const ConfigStoreItem *items, u8 numItems, u8 version, u16 length)
+{
+    ConfigStoreHeader newest;
+    ConfigStoreCursor cursor;
+    u8 page, i;
+    u16 j, crc, sequence = 0;
+
+    page = findNewest(&newest);
+    if (page < CONFIG_STORE_PAGES)
+    {
+        sequence = newest.sequence + 1;
+        page = (page + 1) % CONFIG_STORE_PAGES;
+    }
+    else
+        page = 0;
+
+    flashErasePage(pageAddress(page));
+    cursorStart(&cursor, page);
+    writeByte(&cursor, CONFIG_STORE_MAGIC);
+    writeByte(&cursor, version);
+    writeByte(&cursor, sequence & 0xFF);
+    writeByte(&cursor, sequence >> 8);
+    writeByte(&cursor, length & 0xFF);
+    writeByte(&cursor, length >> 8);
+    for (i = 0; i < numItems; i++)
+        for (j = 0; j < items[i].size; j++)
+            writeByte(&cursor, ((const u8 *)items[i].data)[j]);
+    crc = cursor.crc;
+    writeByte(&cursor, crc & 0xFF);
+    writeByte(&cursor, crc >> 8);
+    if (cursor.pos < 3)
+        writeFlush(&cursor);
+    LOG("config store: record %hx of %hx bytes in page %hhx\n", sequence, length, page);
+    return ERR_NONE;
+}
+
+s8 configStoreLoad(const ConfigStoreItem *items, u8 numItems, u8 version)
+{
+    ConfigStoreHeader newest;
+    ConfigStoreCursor cursor;
+    u8 page, i;
+    u16 j, length = 0;
+
+    for (i = 0; i < numItems; i++)
+        length += items[i].size;
+    page = findNewest(&newest);
+    if (page == CONFIG_STORE_PAGES || newest.length == 0
+            || newest.version != version || newest.length != length)
+        return ERR_NOMSG;
+
+    cursorStart(&cursor, page);
+    for (j = 0; j < CONFIG_STORE_HEADER_SIZE; j++)
+        readByte(&cursor);
+    for (i = 0; i < numItems; i++)
+        for (j = 0; j < items[i].size; j++)
+            ((u8 *)items[i].data)[j] = readByte(&cursor);
+    return ERR_NONE;
+}
+
+s8 configStoreCommit(const ConfigStoreItem *items, u8 numItems, u8 version)
+{
+    ConfigStoreHeader newest;
+    u8 page, i;
+    u16 length = 0;
+
+    for (i = 0; i < numItems; i++)
+        length += items[i].size;
+    if (length == 0 || length > CONFIG_STORE_PAGE_CAPACITY - CONFIG_STORE_HEADER_SIZE - CONFIG_STORE_CRC_SIZE)
+        return ERR_NOMEM;
+    /* do not wear the flash if the newest record holds the same data */
+    page = findNewest(&newest);
+    if (page < CONFIG_STORE_PAGES && newest.version == version && newest.length == length
+            && recordEquals(page, items, numItems))
+        return ERR_NONE;
+    return writeRecord(items, numItems, version, length);
+}
+
+s8 configStoreInvalidate(void)
+{
+    ConfigStoreHeader newest;
+
+    /* nothing to write if there is no record or it is invalidated already */
+    if (findNewest(&newest) == CONFIG_STORE_PAGES || newest.length == 0)
+        return ERR_NONE;
+    return writeRecord(0, 0, 0, 0);
+}
@@ -0,0 +1,80 @@
+/*
+ *****************************************************************************
+ * Copyright by ams AG                                                       *
+ * All rights are reserved.                                                  *
+ *                                                                           *
+ * IMPORTANT - PLEASE READ CAREFULLY BEFORE COPYING, INSTALLING OR USING     *
+ * THE SOFTWARE.                                                             *
+ *                                                                           *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS       *
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT         *
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS         *
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT  *
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,     *
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT          *
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,     *
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY     *
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT       *
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE     *
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.      *
+ *****************************************************************************
+/** @file
+  * @brief This file provides declarations for the settings store in flash.
+  *
+  * The settings store keeps one record of reader settings in program flash so
+  * they survive resets and power cycles. A record is the content of several
+  * RAM blocks (::ConfigStoreItem) followed by a CRC. Every commit writes a new
+  * record to the next of #CONFIG_STORE_PAGES flash pages, so the pages wear
+  * evenly and the previous record stays valid until the new one is complete.
+  */
+
+#ifndef __CONFIG_STORE_H__
+#define __CONFIG_STORE_H__
+
+#include "global.h"
+
+/*------------------------------------------------------------------------- */
+#ifndef CONFIG_STORE_PAGES
+/** Number of flash pages the records rotate through. */
+#define CONFIG_STORE_PAGES      4
+#endif
+
+/** A block of RAM which is saved to or restored from the settings store. */
+typedef struct
+{
+    /** Start of the block. */
+    void *data;
+    /** Size of the block in bytes. */
+    u16 size;
+} ConfigStoreItem;
+
+/**
+ * Restores the newest record from flash into the RAM blocks in items.
+ * The record is only used if its CRC is valid and version and size match,
+ * otherwise items are left untouched.
+ * @param items RAM blocks to be filled, in the same order as they were committed.
+ * @param numItems Number of entries in items.
+ * @param version Layout version of the blocks.
+ * @return ERR_NONE if the blocks were restored, ERR_NOMSG if no matching record is stored.
+ */
+extern s8 configStoreLoad(const ConfigStoreItem *items, u8 numItems, u8 version);
+
+/**
+ * Writes the RAM blocks in items as new record to flash. This erases one flash
+ * page and takes some ten milliseconds. Nothing is written if the newest
+ * record already holds the same data.
+ * @param items RAM blocks to be saved.
+ * @param numItems Number of entries in items.
+ * @param version Layout version of the blocks.
+ * @return ERR_NONE on success, ERR_NOMEM if the blocks do not fit into a page.
+ */
+extern s8 configStoreCommit(const ConfigStoreItem *items, u8 numItems, u8 version);
+
+/**
+ * Writes an empty record, so that configStoreLoad() finds nothing until the
+ * next configStoreCommit().
+ * @return ERR_NONE
+ */
+extern s8 configStoreInvalidate(void);
+
+#endif
@@ -76,9 +76,13 @@
 };
 
 u16 calcCrc16(const void *buf, s16 len)
+{
+    return updateCrc16(CRC16_PRELOAD, buf, len);
+}
+
+u16 updateCrc16(u16 crc, const void *buf, s16 len)
 {
     s16 counter;
-    u16 crc = CRC16_PRELOAD;
     s8 *sbuf =(s8 *)buf;
     for ( counter = 0; counter < len; counter++)
         crc = (crc<<8) ^ crc16OffsetTable[((crc>>8) ^ *sbuf++) & 0x00FF];
@@ -46,5 +46,8 @@
 #define CRC16_PRELOAD 0xffff  /*!< specifies the initial value for the crc register */
 
 u16 calcCrc16(const void *buf, s16 len);
+/** Continues a CRC over further data, e.g. data which is not in one buffer.
+  * calcCrc16(buf, len) equals updateCrc16(CRC16_PRELOAD, buf, len). */
+u16 updateCrc16(u16 crc, const void *buf, s16 len);
 
 #endif /* CRC_H */
@@ -33,6 +33,8 @@
 #include "logger.h"
 #include "timer.h"
 #include "gen2.h"
+#include "gen2_q.h"
+#include "trace.h"
 #include "string.h"
 
 /** Definition for debug output: epc.c */
@@ -47,6 +49,10 @@
 #define EPCLOGDUMP(...) /*!< macro used for dumping buffers if USE_LOGGER is set */
 #endif
 
+/** Maximal number of frames of gen2SearchForTags(), ends the inventory round if
+ * collisions do not go away, e.g. because of interference. */
+#define GEN2_MAX_FRAMES   8
+
 /*EPC Commands */
 /** Definition for queryrep EPC command */
 #define EPC_QUERYREP      0
@@ -681,14 +687,15 @@ unsigned gen2SearchForTags(Tag *tags_
                       , BOOL (*cbContinueScanning)(void)
                       , BOOL singulate
                       , BOOL toggleSession
-                      , void (*followTagCommand)(Tag *tag, s8 *readErr)
+                      , BOOL (*followTagCommand)(Tag *tag, s8 *readErr)
                       )
 {
     u16 num_of_tags = 0;
-    u16 collisions = 0;
+    Gen2Frame frame;
     u16 slot_count;
     u8 i = 0;
-    u8 addRounds = 1; /* the maximal number of rounds performed */
+    u8 frames = GEN2_MAX_FRAMES;
+    u8 nextQ;
     u8 cmd = AS3993_CMD_QUERY;
     u8 followCmd = 0;
     s8 readErr[5];
@@ -709,6 +716,7 @@ unsigned gen2SearchForTags(Tag *tags_
 
     EPCLOG("Searching for Tags, maxtags=%hhd, q=%hhd\n",maxtags,q);
     EPCLOG("-------------------------------\n");
+    TRACE_EVENT(TRACE_ROUND_START, q, 0);
 
     for (i=0; i < maxtags; i++)   /*Reseting the TAGLIST */
     {
@@ -719,7 +727,10 @@ unsigned gen2SearchForTags(Tag *tags_
     do
     {
         BOOL goOn;
-        collisions = 0;
+        frame.q = q;
+        frame.empty = 0;
+        frame.success = 0;
+        frame.collision = 0;
         slot_count = 1UL<<q;   /*get the maximum slot_count */
         do
         {
@@ -734,7 +745,7 @@ unsigned gen2SearchForTags(Tag *tags_
             {
                 case -1:
                     //EPCLOG("collision\n");
-                    collisions++;
+                    frame.collision++;
                     cmd = AS3993_CMD_QUERYREP;
                     break;
                 case 1:
@@ -742,15 +753,18 @@ unsigned gen2SearchForTags(Tag *tags_
                         cmd = 0;    // query_rep has already been sent as followCmd
                     else
                         cmd = AS3993_CMD_QUERYREP;
+                    frame.success++;
                     if (followTagCommand != NULL)
                     {
-                        followTagCommand(tags_+num_of_tags, readErr);
                         cmd = AS3993_CMD_QUERYREP;
+                        if (followTagCommand(tags_+num_of_tags, readErr))
+                            break;  // passed on, reuse the entry
                     }
                     num_of_tags++;
                     break;
                 case 0:
                     //EPCLOG("NO EPC response -> empty Slot\n");
+                    frame.empty++;
                     cmd = AS3993_CMD_QUERYREP;
                     break;
                 default:
@@ -758,32 +772,29 @@ unsigned gen2SearchForTags(Tag *tags_
             }
             goOn = cbContinueScanning();
         } while (slot_count && goOn );
-        addRounds--;
-        EPCLOG("q=%hhx, collisions=%x, num_of_tags=%x",q,collisions,num_of_tags);
-        if( collisions )
-            if( collisions >= (1UL<<q) /4)
-            {
-                q++;
-                EPCLOG("->++\n");
-                cmd = AS3993_CMD_QUERYADJUSTUP;
-            }
-            else if( collisions < (1UL<<q) /8)
-            {
-                q--;
-                EPCLOG("->--\n");
-                cmd = AS3993_CMD_QUERYADJUSTDOWN;
-            }
-            else
-            {
-                EPCLOG("->==\n");
-                cmd = AS3993_CMD_QUERYADJUSTNIC;
-            }
-        else
-        {
+        frames--;
+        TRACE_EVENT(TRACE_FRAME_TAGS, q, frame.success);
+        TRACE_EVENT(TRACE_FRAME_COLLISIONS, q, frame.collision);
+        TRACE_EVENT(TRACE_FRAME_END, q, frame.empty);
+        EPCLOG("q=%hhx, empty=%x, success=%x, collisions=%x, num_of_tags=%x",q,frame.empty,frame.success,frame.collision,num_of_tags);
+        if (!frame.collision)
+        {   /* every tag of the frame has been read */
             EPCLOG("->!!\n");
-            addRounds = 0;
+            break;
         }
-    }while(num_of_tags < maxtags && addRounds && cbContinueScanning() );
+        /* Q for the tags which are left, QueryAdjust if it is one step away */
+        nextQ = gen2QNext(&frame);
+        EPCLOG("->%hhx\n", nextQ);
+        if (nextQ == q + 1)
+            cmd = AS3993_CMD_QUERYADJUSTUP;
+        else if (nextQ + 1 == q)
+            cmd = AS3993_CMD_QUERYADJUSTDOWN;
+        else if (nextQ == q)
+            cmd = AS3993_CMD_QUERYADJUSTNIC;
+        else
+            cmd = AS3993_CMD_QUERY;
+        q = nextQ;
+    }while(num_of_tags < maxtags && frames && cbContinueScanning() );
 
     // If a tag is found in the last slot of an inventory round, follow Command QueryRep will be executed.
     // Add some time to send this command to the tag over the field.
@@ -816,7 +827,7 @@ unsigned gen2SearchForTagsAutoAck(Tag *tags_
                       , BOOL (*cbContinueScanning)(void)
                       , BOOL singulate
                       , BOOL toggleSession
-                      , void (*followTagCommand)(Tag *tag, s8 *readErr)
+                      , BOOL (*followTagCommand)(Tag *tag, s8 *readErr)
                       )
 {
     u16 num_of_tags = 0;
@@ -884,8 +895,9 @@ unsigned gen2SearchForTagsAutoAck(Tag *tags_
                     cmd = AS3993_CMD_QUERYREP;
                 if (followTagCommand != NULL)
                 {
-                    followTagCommand(tags_+num_of_tags, readErr);
                     cmd = AS3993_CMD_QUERYREP;
+                    if (followTagCommand(tags_+num_of_tags, readErr))
+                        break;  // passed on, reuse the entry
                 }
                 num_of_tags++;               
                 break;
@@ -211,8 +211,9 @@ struct gen2SelectParams{
   *
   * @param *tags an array for the found tags to be stored to
   * @param maxtags the size of the tags array
-  * @param q 2^q slots will be done first, additional 2 round with increased 
-  * or decreased q may be performed
+  * @param q 2^q slots will be done first. As long as there are collisions further
+  * frames follow, each with the Q gen2QNext() picks from the slots of the frame
+  * before, at most #GEN2_MAX_FRAMES frames.
   * @param cbContinueScanning callback is called after each slot to inquire if we should
   * continue scanning (e.g. for allowing a timeout)
   * @param singulate If set to true Req_RN command will be sent to get tag into Open state
@@ -220,8 +221,11 @@ struct gen2SelectParams{
   * @param toggleSession If set to true, QueryRep commands will be sent immediately
   *                  after receiving tag reply to toggle session flag on tag.
   * @param followTagCommand callback function is called after a tag is inventoried.
-  *        If function will be called, no fast mode is possible.
-  * @return the number of tags found
+  *        If function will be called, no fast mode is possible. If it returns 1
+  *        the tag has been passed on, e.g. sent to the host, and its entry in
+  *        tags is used again for the next tag. Such tags count neither for
+  *        maxtags nor for the return value.
+  * @return the number of tags stored in tags
   */
 unsigned gen2SearchForTags(Tag *tags
                           , u8 maxtags
@@ -229,7 +233,7 @@ unsigned gen2SearchForTags(Tag *tags
                           , BOOL (*cbContinueScanning)(void)
                           , BOOL singulate
                           , BOOL toggleSession
-                          , void (*followTagCommand)(Tag *tag, s8 *readErr)
+                          , BOOL (*followTagCommand)(Tag *tag, s8 *readErr)
                           );
 
 
@@ -242,7 +246,7 @@ unsigned gen2SearchForTagsAutoAck(Tag *tags_
                       , BOOL (*cbContinueScanning)(void)
                       , BOOL singulate
                       , BOOL toggleSession
-                      , void (*followTagCommand)(Tag *tag, s8 *readErr)
+                      , BOOL (*followTagCommand)(Tag *tag, s8 *readErr)
                       );
 /*------------------------------------------------------------------------- */
 /** EPC ACCESS command send to the Tag.
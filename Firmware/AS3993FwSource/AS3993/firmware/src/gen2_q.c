@@ -0,0 +1,125 @@
+/*
+ *****************************************************************************
+ * Copyright by ams AG                                                       *
+ * All rights are reserved.                                                  *
+ *                                                                           *
+ * IMPORTANT - PLEASE READ CAREFULLY BEFORE COPYING, INSTALLING OR USING     *
+ * THE SOFTWARE.                                                             *
+ *                                                                           *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS       *
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT         *
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS         *
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT  *
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,     *
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT          *
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,     *
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY     *
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT       *
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE     *
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.      *
+ *****************************************************************************
+ */
+/** @file
+  * @brief This file implements the Q selection of inventory rounds.
+  *
+  * The estimator searches the tag count n with the smallest squared distance
+  * between the slot counts of the frame and their expected values
+  *   empty     = m * (1-1/L)^n
+  *   success   = m * n/L * (1-1/L)^(n-1)
+  *   collision = m - empty - success
+  * for a frame of L slots of which m were run. The distance falls down to the
+  * estimate and grows behind it, so the estimate is found by bisection on the
+  * sign of its slope between the lower bound success + 2 * collision and an
+  * upper bound. Everything is done in integers, the probabilities in 32 bit
+  * fixed point.
+  */
+
+#include "gen2_q.h"
+
+/*------------------------------------------------------------------------- */
+/** A frame without empty slots gives no upper limit, the search stops at this
+ * many tags per slot above the lower bound. */
+#define GEN2_Q_SEARCH_TAGS_PER_SLOT     4
+/** Limit of the tag estimate, keeps the fixed point products in 64 bit. */
+#define GEN2_Q_MAX_TAGS                 0xFFFF
+
+/*------------------------------------------------------------------------- */
+/** (1-1/L)^n in 32 bit fixed point by square and multiply, L > 1. Every
+ * factor is below 1, so the products fit in 64 bit. */
+static u64 gen2QEmptyProbability(u32 slots, u32 n)
+{
+    u64 base = ((u64)(slots - 1) << 32) / slots;
+    u64 p = 1ULL << 32;
+
+    while (n)
+    {
+        if (n & 1)
+            p = (p * base) >> 32;
+        base = (base * base) >> 32;
+        n >>= 1;
+    }
+    return p;
+}
+
+/** Squared distance between the slot counts of the frame and the ones
+ * expected for n tags. */
+static u64 gen2QDistance(const Gen2Frame *frame, u32 slots, u32 run, u32 n)
+{
+    /* expected counts in 16 bit fixed point */
+    s64 emptyRun = (s64)((run * gen2QEmptyProbability(slots, n)) >> 16);
+    s64 successRun = emptyRun * n / (slots - 1);
+    s64 collisionRun = ((s64)run << 16) - emptyRun - successRun;
+    s64 d0, d1, d2;
+
+    if (collisionRun < 0)
+        collisionRun = 0;
+    /* compare in 8 bit fixed point, the squares fit in 64 bit */
+    d0 = (emptyRun - ((s64)frame->empty << 16)) >> 8;
+    d1 = (successRun - ((s64)frame->success << 16)) >> 8;
+    d2 = (collisionRun - ((s64)frame->collision << 16)) >> 8;
+    return (u64)(d0 * d0) + (u64)(d1 * d1) + (u64)(d2 * d2);
+}
+
+u16 gen2QEstimateTags(const Gen2Frame *frame)
+{
+    u32 slots = 1UL << frame->q;
+    u32 run = (u32)frame->empty + frame->success + frame->collision;
+    u32 n = frame->success + 2UL * frame->collision;
+    u32 maxN;
+
+    if (frame->collision == 0 || slots == 1 || run == 0)
+        return n > GEN2_Q_MAX_TAGS ? GEN2_Q_MAX_TAGS : n;
+    if (n > GEN2_Q_MAX_TAGS)
+        n = GEN2_Q_MAX_TAGS;
+    maxN = n + GEN2_Q_SEARCH_TAGS_PER_SLOT * run;
+    if (maxN > GEN2_Q_MAX_TAGS)
+        maxN = GEN2_Q_MAX_TAGS;
+    /* at most 16 steps for the 16 bit range */
+    while (n < maxN)
+    {
+        u32 mid = (n + maxN) / 2;
+
+        if (gen2QDistance(frame, slots, run, mid + 1) < gen2QDistance(frame, slots, run, mid))
+            n = mid + 1;
+        else
+            maxN = mid;
+    }
+    return n;
+}
+
+u8 gen2QForTags(u16 tags)
+{
+    u8 q = 0;
+
+    /* 2*ln(2) = 1.386 */
+    while (q < GEN2_Q_MAX && (u32)tags * 1000 > (1386UL << q))
+        q++;
+    return q;
+}
+
+u8 gen2QNext(const Gen2Frame *frame)
+{
+    u16 tags = gen2QEstimateTags(frame);
+
+    return gen2QForTags(tags > frame->success ? tags - frame->success : 0);
+}
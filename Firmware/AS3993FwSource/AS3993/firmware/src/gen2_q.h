@@ -0,0 +1,95 @@
+/*
+ *****************************************************************************
+ * Copyright by ams AG                                                       *
+ * All rights are reserved.                                                  *
+ *                                                                           *
+ * IMPORTANT - PLEASE READ CAREFULLY BEFORE COPYING, INSTALLING OR USING     *
+ * THE SOFTWARE.                                                             *
+ *                                                                           *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS       *
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT         *
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS         *
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT  *
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,     *
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT          *
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,     *
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY     *
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT       *
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE     *
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.      *
+ *****************************************************************************
+ */
+/** @file
+  * @brief This file provides declarations for the Q selection of inventory rounds.
+  *
+  * After every frame of an inventory round the number of tags which took part
+  * is estimated from the counts of empty, successful and collided slots, using
+  * the minimum distance estimator by Vogt. The next frame gets the Q whose
+  * frame size gives the most successful slots per slot for the tags which are
+  * left. The functions do not talk to the reader, so they can be tested on the
+  * host against a simulation of the slots.
+  */
+
+#ifndef __GEN2_Q_H__
+#define __GEN2_Q_H__
+
+#include "global.h"
+
+/** Largest Q allowed by the Gen2 standard. */
+#define GEN2_Q_MAX              15
+
+/** Slot counts of one inventory frame. */
+typedef struct
+{
+    /** Q the frame was started with, the frame has 2^q slots. */
+    u8 q;
+    /** Slots without reply. */
+    u16 empty;
+    /** Slots in which a tag was read. */
+    u16 success;
+    /** Slots with a collision or a damaged reply. */
+    u16 collision;
+} Gen2Frame;
+
+/*!
+ *****************************************************************************
+ *  \brief  Estimate the number of tags which took part in a frame.
+ *
+ *  Returns the tag count whose expected slot counts are closest to the counts
+ *  of the frame. A frame which was stopped early is fine, the expected counts
+ *  are scaled to the slots which were run.
+ *
+ *  \param frame : slot counts of the frame
+ *  \return the estimated number of tags, at least success + 2 * collision
+ *****************************************************************************
+ */
+u16 gen2QEstimateTags(const Gen2Frame *frame);
+
+/*!
+ *****************************************************************************
+ *  \brief  Q for the most tags per slot.
+ *
+ *  With n tags a frame of L slots reads n/L*(1-1/L)^(n-1) tags per slot, which
+ *  is largest for L = n. Between two powers of two L and 2L the larger one is
+ *  better once n > 2*ln(2)*L.
+ *
+ *  \param tags : number of tags to read
+ *  \return the Q, at most #GEN2_Q_MAX
+ *****************************************************************************
+ */
+u8 gen2QForTags(u16 tags);
+
+/*!
+ *****************************************************************************
+ *  \brief  Q for the frame after the given one.
+ *
+ *  Tags which were read in the frame do not take part in the next one, so
+ *  the Q is chosen for the estimated tags minus the successful slots.
+ *
+ *  \param frame : slot counts of the frame
+ *  \return the Q for the next frame
+ *****************************************************************************
+ */
+u8 gen2QNext(const Gen2Frame *frame);
+
+#endif /* __GEN2_Q_H__ */
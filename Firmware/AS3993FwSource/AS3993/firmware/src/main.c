@@ -34,6 +34,7 @@
 #include "as3993_config.h"
 #include "platform.h"
 #include "stream_dispatcher.h"
+#include "run_loop.h"
 #include "usb_hid_stream_driver.h"
 #include "logger.h"
 #include "uart_driver.h"
@@ -43,6 +44,7 @@
 #include "gen2.h"
 #include "global.h"
 #include "timer.h"
+#include "trace.h"
 #include "appl_commands.h"
 #include "tuner.h"
 #if ISO6B
@@ -52,6 +54,9 @@
 extern Freq Frequencies;
 extern Tag tags_[MAXTAG];
 
+/** number of run loop ticks between two toggles of the status LED */
+#define BLINK_TICKS     (500 / RUN_LOOP_TICK_MS)
+
 #if (SYSCLK == SYSCLK_16MHZ)
 #if (FEMTO2 || FEMTO2_1)
 _CONFIG1(WDTPS_PS1 & FWPSA_PR32 & WINDIS_OFF & FWDTEN_OFF & ICS_PGx1 & GWRP_OFF & GCP_OFF & JTAGEN_OFF)
@@ -270,12 +275,16 @@ TunerConfiguration ant1Tuner =
 
 /** main function
  * Initializes board, cpu, reader, host communication, ...\n
- * After intialization a loop which waits for commands from host
- * and performs cyclic inventory rounds is entered.
+ * After intialization the run loop is entered. It serves commands from the
+ * host first and then performs one step of cyclic inventory or band tuning.
+ * A cyclic inventory round ends after the slot in which data from the host
+ * arrived, see continueCheckTimeout(). If there is nothing to do the CPU
+ * idles until the host sends data or the next tick, see runLoopWait().
  */
 int main(void)
 {
-    u32 counter = 0;
+    u16 blinkTick;
+    BOOL busy;
     BOOL ledBlinkState = 0;
     u32 baudrate, realrate;
 
@@ -339,6 +348,9 @@ int main(void)
     Frequencies.freq[0]= 902700;
 #endif
 
+    /* hop list, tuning table and Gen2 settings the host kept in flash */
+    loadSettings();
+
     delay_ms(1);
     readerInitStatus = as3993Initialize(Frequencies.freq[0]);
 
@@ -369,15 +381,12 @@ int main(void)
     USBDeviceAttach();
 #endif
 
+    blinkTick = runLoopTicks();
     while (1)
     {
-        if (counter)
-        {
-            counter--;
-        }
-        else
+        if ((u16)(runLoopTicks() - blinkTick) >= (BLINK_TICKS<<(readerInitStatus?3:0)))
         {
-            counter = (10000ULL<<(readerInitStatus?3:0));
+            blinkTick = runLoopTicks();
             ledBlinkState = (~ledBlinkState) & 0x01;
             showError(readerInitStatus, ledBlinkState);
             if (readerInitStatus) 
@@ -385,13 +394,18 @@ int main(void)
                 readerInitStatus = as3993Initialize(Frequencies.freq[0]);
             }
         }
+        runLoopTakeEvents(RUN_LOOP_EVENT_HOST_RX);
         ProcessIO(); /* main trigger for operation commands. */
 
-        //if (doCyclicInventory()) /* do cyclic inventory if necessary.*/
-        //{ /* if it was performed, then update blink state */
-          //  ledBlinkState = (~ledBlinkState) & 0x01;
-          //  showError(readerInitStatus, ledBlinkState);
-        //}
+        busy = 0;
+        if (doCyclicInventory()) /* do cyclic inventory if necessary.*/
+        { /* if it was performed, then update blink state */
+            ledBlinkState = (~ledBlinkState) & 0x01;
+            showError(readerInitStatus, ledBlinkState);
+            busy = 1;
+        }
+        if (doBandTuning()) /* tune the next channel of a band setup if necessary. */
+            busy = 1;
 #if !USE_UART_STREAM_DRIVER
 #ifdef BUTTON
         if (! BUTTON)
@@ -403,6 +417,8 @@ int main(void)
         }
 #endif
 #endif
+        if (!busy)
+            runLoopWait(RUN_LOOP_EVENT_HOST_RX | RUN_LOOP_EVENT_TICK);
     }
 }
 
@@ -432,7 +448,14 @@ u8 applProcessCmd( u8 protocol, u16 rxSize, const u8 * rxData, u16 * txSize, u8
 
 u8 applProcessCyclic( u8 * protocol, u16 * txSize, u8 * txData, u16 remainingSize )
 {
-    return sendTagData( protocol, txSize, txData, remainingSize );
+    u8 status;
+
+    status = sendBandTuningData( protocol, txSize, txData, remainingSize );
+    if ( *txSize > 0 )
+    {
+        return status;
+    }
+    return sendCyclicTagData( protocol, txSize, txData, remainingSize );
 }
 
 const char * applFirmwareInformation()
@@ -541,6 +564,67 @@ u8 applWriteReg( u16 rxSize, const u8 * rxData, u16 * txSize, u8 * txData )
     return cmdWriteReg(rxSize, rxData, txSize, txData);
 }
 
+/*!This function writes several registers on the AS3993 in one request. See also
+  applWriteRegs(). \n
+  The format of the report from the host is a list of triples:
+  <table>
+    <tr><th>   Byte</th><th>       0</th><th>   1</th><th>    2</th><th>..</th></tr>
+    <tr><th>Content</th><td>reg_addr</td><td>mask</td><td>value</td><td>..</td></tr>
+  </table>
+  Only the bits set in mask are changed, the others keep the value the register
+  has on the chip. If reg_addr >= 0x80, then an immediate command is executed.\n
+  The device sends back one byte per triple:
+  <table>
+    <tr><th>   Byte</th><th>        0</th><th>..</th></tr>
+    <tr><th>Content</th><td>reg value</td><td>..</td></tr>
+  </table>
+  where reg value is read back after the write (0 for immediate commands).
+
+  returns ERR_NONE if operation was successful, ERR_PARAM if no triple was sent.
+ */
+u8 cmdWriteRegs (u16 rxSize, const u8 * rxData, u16 * txSize, u8 * txData)
+{
+    return writeRegisters(rxSize, rxData, txSize, txData);
+}
+
+u8 applWriteRegs( u16 rxSize, const u8 * rxData, u16 * txSize, u8 * txData )
+{
+    return cmdWriteRegs(rxSize, rxData, txSize, txData);
+}
+
+#if TRACE
+/*!This function moves the events of the trace buffer to the reply, see trace.h
+  and applReadTrace(). \n
+  The report from the host has no payload. The device sends back:
+  <table>
+    <tr><th>   Byte</th><th>    0..3</th><th>4..7</th><th>8..9</th><th>   10</th><th>11..</th></tr>
+    <tr><th>Content</th><td>clock Hz</td><td>wrap</td><td>lost</td><td>count</td><td>events</td></tr>
+  </table>
+  where clock Hz is the rate of the time stamps, wrap the number of counts after
+  which they start at 0 again, lost the number of events which have been
+  overwritten since the last read and count the number of events which follow,
+  oldest first. Each event has 8 bytes:
+  <table>
+    <tr><th>   Byte</th><th>0</th><th>   1</th><th> 2..3</th><th>      4..7</th></tr>
+    <tr><th>Content</th><td>id</td><td>arg8</td><td>arg16</td><td>time stamp</td></tr>
+  </table>
+  All values are little endian. The events are removed from the buffer, the
+  host repeats the request until count is 0.
+
+  returns ERR_NONE.
+ */
+u8 cmdReadTrace (u16 rxSize, const u8 * rxData, u16 * txSize, u8 * txData)
+{
+    *txSize = traceRead(txData, PAYLOAD_MAX_SIZE);
+    return ERR_NONE;
+}
+
+u8 applReadTrace( u16 rxSize, const u8 * rxData, u16 * txSize, u8 * txData )
+{
+    return cmdReadTrace(rxSize, rxData, txSize, txData);
+}
+#endif
+
 #if RUN_ON_AS3994 || __PIC24FJ256GB110__    // check for CPU: fix nightly build
 /* TODO: AS3994 does not support bootloader yet. */
 void enableBootloader()
@@ -559,9 +559,7 @@ void writeReadAS3993( const u8* wbuf, u8 wlen, u8* rbuf, u8 rlen, u8 stopMode, u
 #endif
     if (doStart) NCS_SELECT();
 
-    spiTxRx(wbuf, 0, wlen);
-    if (rlen)
-        spiTxRx(0, rbuf, rlen);
+    spiWriteRead(wbuf, wlen, rbuf, rlen);
 
     if (stopMode != STOP_NONE) NCS_DESELECT();
 }
@@ -576,8 +574,7 @@ void writeReadAS3993Isr( const u8* wbuf, u8 wlen, u8* rbuf, u8 rlen )
 
     NCS_SELECT();
 
-    spiTxRx(wbuf, 0, wlen);
-    spiTxRx(0, rbuf, rlen);
+    spiWriteRead(wbuf, wlen, rbuf, rlen);
 
     NCS_DESELECT();
 }
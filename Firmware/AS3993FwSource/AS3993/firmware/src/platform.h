@@ -59,6 +59,9 @@
 /** map as3993Isr to _INT1Interrupt */
 #define as3993Isr _INT1Interrupt
 
+/*! map timer2Isr to _T2Interrupt */
+#define timer2Isr _T2Interrupt
+
 /*! map timer2Isr to _T3Interrupt */
 #define timer3Isr _T3Interrupt
 
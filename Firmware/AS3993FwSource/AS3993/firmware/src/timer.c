@@ -32,6 +32,7 @@
 #include "global.h"
 #include "platform.h"
 #include "timer.h"
+#include "run_loop.h"
 
 static volatile u16 slowTimerMsValue;
 
@@ -66,6 +67,43 @@ void timerInit()
     _T3IP = 2; // Timer3 interrupt priority 2 (low)
     PR3 = (SYSCLK / 64) / 100;
     // do not enable T3 interrupt here, they will be enabled in slowTimerStart()
+
+    // Timer2 is the tick of the run loop, prescaler 1:64, period RUN_LOOP_TICK_MS
+    T2CON = 0x00;
+    T2CONbits.TCKPS = 2;        // prescaler 1:64
+    _T2IP = 2; // Timer2 interrupt priority 2 (low)
+    PR2 = (SYSCLK / 64) / (1000 / RUN_LOOP_TICK_MS);
+    TMR2 = 0;
+    _T2IF = 0;
+    _T2IE = 1;
+    T2CONbits.TON = 1;
+}
+
+u32 timerTimestamp()
+{
+    u16 cpuIpl;
+    u16 tick;
+    u16 count;
+
+    SET_AND_SAVE_CPU_IPL(cpuIpl, 7);
+    tick = runLoopTicks();
+    count = TMR2;
+    /* timer2 overflowed but its interrupt is not yet handled */
+    if (_T2IF && count < PR2 / 2)
+        tick++;
+    RESTORE_CPU_IPL(cpuIpl);
+    return (u32)tick * (PR2 + 1) + count;
+}
+
+u32 timerTimestampWrap()
+{
+    return 65536UL * (PR2 + 1);
+}
+
+void INTERRUPT timer2Isr(void)	// interrupt handler for Timer2
+{
+    _T2IF = 0;
+    runLoopTick();
 }
 
 void INTERRUPT timer3Isr(void)	// interrupt handler for Timer3
@@ -53,10 +53,25 @@ u16 slowTimerValue( );
  */
 void slowTimerStop( );
 
+/** Clock of timerTimestamp() in Hz. */
+#define TIMER_TIMESTAMP_HZ  (SYSCLK / 64)
+
+/*!
+ * Time stamp for tracing, counts with TIMER_TIMESTAMP_HZ since timerInit().
+ * It is derived from the run loop tick and wraps after timerTimestampWrap()
+ * counts.
+ */
+u32 timerTimestamp();
+
+/*!
+ * Number of counts after which timerTimestamp() wraps to 0.
+ */
+u32 timerTimestampWrap();
+
 /*!
  * Set up timers. The timers are used for:
  * T1: 
- * T2:
+ * T2: tick of the run loop, see runLoopTick()
  * T3: slow timer for measuring bigger intervals, resolution is ~10ms
  * T4:
  * T5:
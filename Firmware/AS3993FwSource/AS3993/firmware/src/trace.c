@@ -0,0 +1,112 @@
+/*
+ *****************************************************************************
+ * Copyright by ams AG                                                       *
+ * All rights are reserved.                                                  *
+ *                                                                           *
+ * IMPORTANT - PLEASE READ CAREFULLY BEFORE COPYING, INSTALLING OR USING     *
+ * THE SOFTWARE.                                                             *
+ *                                                                           *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS       *
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT         *
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS         *
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT  *
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,     *
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT          *
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,     *
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY     *
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT       *
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE     *
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.      *
+ *****************************************************************************
+ */
+/** @file
+  * @brief This file implements the binary event trace.
+  *
+  * Only the main loop writes and reads the buffer, so it needs no locking.
+  */
+
+#include "trace.h"
+#include "timer.h"
+
+#if TRACE
+
+/*------------------------------------------------------------------------- */
+/** One event in the trace buffer. */
+typedef struct
+{
+    u8 id;
+    u8 arg8;
+    u16 arg16;
+    u32 time;
+} TraceEvent;
+
+/** The ring buffer. */
+static TraceEvent traceBuffer[TRACE_SIZE];
+/** Index of the next event to write. */
+static u16 traceHead;
+/** Number of events in the buffer. */
+static u16 traceCount;
+/** Number of events overwritten since the last traceRead(). */
+static u16 traceLost;
+
+/*------------------------------------------------------------------------- */
+void traceEvent(u8 id, u8 arg8, u16 arg16)
+{
+    TraceEvent *event = &traceBuffer[traceHead];
+
+    event->id = id;
+    event->arg8 = arg8;
+    event->arg16 = arg16;
+    event->time = timerTimestamp();
+    traceHead = (traceHead + 1) & (TRACE_SIZE - 1);
+    if (traceCount < TRACE_SIZE)
+        traceCount++;
+    else if (traceLost < 0xFFFF)
+        traceLost++;
+}
+
+/*------------------------------------------------------------------------- */
+static u16 putU32(u8 *txData, u32 value)
+{
+    txData[0] = value & 0xff;
+    txData[1] = (value >>  8) & 0xff;
+    txData[2] = (value >> 16) & 0xff;
+    txData[3] = (value >> 24) & 0xff;
+    return 4;
+}
+
+/*------------------------------------------------------------------------- */
+u16 traceRead(u8 *txData, u16 size)
+{
+    u16 txSize = 0;
+    u16 count = traceCount;
+    u16 index;
+
+    if (size < TRACE_HEADER_SIZE)
+        return 0;
+    if (count > (size - TRACE_HEADER_SIZE) / TRACE_EVENT_SIZE)
+        count = (size - TRACE_HEADER_SIZE) / TRACE_EVENT_SIZE;
+    index = (traceHead - traceCount) & (TRACE_SIZE - 1);
+
+    txSize += putU32(&txData[txSize], TIMER_TIMESTAMP_HZ);
+    txSize += putU32(&txData[txSize], timerTimestampWrap());
+    txData[txSize++] = traceLost & 0xff;
+    txData[txSize++] = traceLost >> 8;
+    txData[txSize++] = count;
+    traceLost = 0;
+    traceCount -= count;
+    while (count--)
+    {
+        TraceEvent *event = &traceBuffer[index];
+
+        txData[txSize++] = event->id;
+        txData[txSize++] = event->arg8;
+        txData[txSize++] = event->arg16 & 0xff;
+        txData[txSize++] = event->arg16 >> 8;
+        txSize += putU32(&txData[txSize], event->time);
+        index = (index + 1) & (TRACE_SIZE - 1);
+    }
+    return txSize;
+}
+
+#endif
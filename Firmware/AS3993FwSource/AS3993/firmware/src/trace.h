@@ -0,0 +1,107 @@
+/*
+ *****************************************************************************
+ * Copyright by ams AG                                                       *
+ * All rights are reserved.                                                  *
+ *                                                                           *
+ * IMPORTANT - PLEASE READ CAREFULLY BEFORE COPYING, INSTALLING OR USING     *
+ * THE SOFTWARE.                                                             *
+ *                                                                           *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS       *
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT         *
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS         *
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT  *
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,     *
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT          *
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,     *
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY     *
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT       *
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE     *
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.      *
+ *****************************************************************************
+ */
+/** @file
+  * @brief This file provides declarations for the binary event trace.
+  *
+  * Instead of formatting text like the logger, the firmware stores compact
+  * events in a ring buffer in RAM: an id, two arguments and a time stamp of
+  * timerTimestamp(). Storing an event takes a few microseconds, so the trace
+  * stays on in the inventory loop and in production builds. The host reads
+  * and clears the buffer with the stream command #AMS_COM_READ_TRACE, see
+  * cmdReadTrace(). If the host does not read it in time the oldest events are
+  * overwritten and counted as lost.
+  */
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include "as3993_config.h"
+#include "global.h"
+
+/** Number of events kept, must be a power of two. An inventory round takes
+ * at most 3 + 3 * GEN2_MAX_FRAMES events, so a whole round fits. */
+#ifndef TRACE_SIZE
+#define TRACE_SIZE              64
+#endif
+
+/** Size of the header of a trace reply, see cmdReadTrace(). */
+#define TRACE_HEADER_SIZE       11
+/** Size of one event in a trace reply, see cmdReadTrace(). */
+#define TRACE_EVENT_SIZE        8
+
+/* Event ids. arg8 and arg16 are the two arguments of traceEvent(). */
+/** A command from the host is executed. arg8: command id, arg16: size of the
+ * request */
+#define TRACE_HOST_COMMAND      0x01
+/** The channel of an inventory round has been chosen. arg8: channel index,
+ * arg16: result of the channel allocation */
+#define TRACE_HOP               0x02
+/** gen2SearchForTags() starts. arg8: Q of the first frame */
+#define TRACE_ROUND_START       0x03
+/** Tags read in a frame of gen2SearchForTags(). arg8: Q, arg16: tags */
+#define TRACE_FRAME_TAGS        0x04
+/** Slots of a frame with a collision or a damaged reply. arg8: Q,
+ * arg16: slots */
+#define TRACE_FRAME_COLLISIONS  0x05
+/** A frame of gen2SearchForTags() ended, follows TRACE_FRAME_TAGS and
+ * TRACE_FRAME_COLLISIONS. arg8: Q, arg16: empty slots */
+#define TRACE_FRAME_END         0x06
+/** An inventory round ended. arg8: result of the channel allocation,
+ * arg16: tags stored for the host */
+#define TRACE_INVENTORY_END     0x07
+/** The AS3993 did not signal the expected interrupt in time.
+ * arg8: 1 for as3993WaitForResponseTimed(), arg16: interrupt mask which was
+ * waited for */
+#define TRACE_RESPONSE_TIMEOUT  0x08
+
+#if TRACE
+
+/*!
+ *****************************************************************************
+ *  \brief  Store an event in the trace buffer.
+ *
+ *  Must not be called from interrupt handlers.
+ *
+ *  \param id : one of the TRACE_* event ids
+ *  \param arg8 : first argument
+ *  \param arg16 : second argument
+ *****************************************************************************
+ */
+void traceEvent(u8 id, u8 arg8, u16 arg16);
+
+/*!
+ *****************************************************************************
+ *  \brief  Move the events of the trace buffer to a trace reply.
+ *
+ *  \param txData : buffer for the reply, see cmdReadTrace()
+ *  \param size : size of txData
+ *  \return the size of the reply
+ *****************************************************************************
+ */
+u16 traceRead(u8 *txData, u16 size);
+
+#define TRACE_EVENT(id, arg8, arg16)    traceEvent(id, arg8, arg16)
+#else
+#define TRACE_EVENT(id, arg8, arg16)
+#endif
+
+#endif /* __TRACE_H__ */
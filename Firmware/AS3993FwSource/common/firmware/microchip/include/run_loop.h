@@ -0,0 +1,144 @@
+/*
+ *****************************************************************************
+ * Copyright by ams AG                                                       *
+ * All rights are reserved.                                                  *
+ *                                                                           *
+ * IMPORTANT - PLEASE READ CAREFULLY BEFORE COPYING, INSTALLING OR USING     *
+ * THE SOFTWARE.                                                             *
+ *                                                                           *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS       *
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT         *
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS         *
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT  *
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,     *
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT          *
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,     *
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY     *
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT       *
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE     *
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.      *
+ *****************************************************************************
+ */
+/*
+ *      $Revision: $
+ *      LANGUAGE:  ANSI C
+ */
+
+/*! \file
+ *
+ *  \brief cooperative run loop
+ *
+ */
+/*!
+ *
+ * Interrupt handlers post events to the run loop, the main loop and the
+ * functions which wait for hardware take them. Whoever waits for an event and
+ * has nothing else to do puts the CPU into Idle mode until an interrupt
+ * posts it, instead of spinning.
+ *
+ * API:
+ * - Post an event from an interrupt handler: #runLoopPostEvent
+ * - Take posted events: #runLoopTakeEvents
+ * - Check for a posted event without taking it: #runLoopEventPending
+ * - Idle until an event is posted: #runLoopWait
+ * - Time base: #runLoopTick, #runLoopTicks
+ */
+
+#ifndef RUN_LOOP_H
+#define RUN_LOOP_H
+
+/*
+******************************************************************************
+* INCLUDES
+******************************************************************************
+*/
+#include "ams_types.h"
+#include "GenericTypeDefs.h"
+
+/*
+******************************************************************************
+* DEFINES
+******************************************************************************
+*/
+#define RUN_LOOP_EVENT_HOST_RX      0x01    /*!< data from the host has been received */
+#define RUN_LOOP_EVENT_READER_IRQ   0x02    /*!< the reader IC signalled an interrupt */
+#define RUN_LOOP_EVENT_TICK         0x04    /*!< the tick timer elapsed, see #runLoopTick */
+
+#define RUN_LOOP_TICK_MS            10      /*!< period of the tick timer in ms */
+
+/*
+******************************************************************************
+* GLOBAL FUNCTION PROTOTYPES
+******************************************************************************
+*/
+
+/*!
+ *****************************************************************************
+ *  \brief  Post events
+ *
+ *  May be called from interrupt handlers. A posted event stays pending until
+ *  it is taken with runLoopTakeEvents() or runLoopWait().
+ *
+ *  \param[in] events: RUN_LOOP_EVENT_* flags to post.
+ *****************************************************************************
+ */
+extern void runLoopPostEvent(u8 events);
+
+/*!
+ *****************************************************************************
+ *  \brief  Take posted events
+ *
+ *  \param[in] events: RUN_LOOP_EVENT_* flags to take.
+ *
+ *  \return The flags of \a events which were pending, they are cleared.
+ *****************************************************************************
+ */
+extern u8 runLoopTakeEvents(u8 events);
+
+/*!
+ *****************************************************************************
+ *  \brief  Check for posted events without taking them
+ *
+ *  \param[in] events: RUN_LOOP_EVENT_* flags to check.
+ *
+ *  \return TRUE if one of \a events is pending.
+ *****************************************************************************
+ */
+extern BOOL runLoopEventPending(u8 events);
+
+/*!
+ *****************************************************************************
+ *  \brief  Idle until one of \a events is posted
+ *
+ *  Puts the CPU into Idle mode until an interrupt handler posts one of
+ *  \a events. Returns at once if one of them is pending already. The caller
+ *  must make sure that one of \a events will be posted, e.g. by including
+ *  #RUN_LOOP_EVENT_TICK.
+ *
+ *  \param[in] events: RUN_LOOP_EVENT_* flags to wait for.
+ *
+ *  \return The flags of \a events which were posted, they are cleared.
+ *****************************************************************************
+ */
+extern u8 runLoopWait(u8 events);
+
+/*!
+ *****************************************************************************
+ *  \brief  Count a tick of the tick timer
+ *
+ *  Has to be called every #RUN_LOOP_TICK_MS ms from the interrupt handler
+ *  of the tick timer. Posts #RUN_LOOP_EVENT_TICK.
+ *****************************************************************************
+ */
+extern void runLoopTick(void);
+
+/*!
+ *****************************************************************************
+ *  \brief  Number of ticks since start up
+ *
+ *  \return The tick counter, it wraps around after 65536 ticks.
+ *****************************************************************************
+ */
+extern u16 runLoopTicks(void);
+
+#endif /* RUN_LOOP_H */
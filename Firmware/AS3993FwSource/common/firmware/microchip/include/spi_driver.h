@@ -211,6 +211,27 @@ extern s8 spiDeinitialize();
  */
 extern s8 spiTxRx(const u8* txData, u8* rxData, u16 length);
 
+/*!
+ *****************************************************************************
+ *  \brief  Write a buffer and read the answer in one transfer
+ *
+ *  This function shifts out the \a txLength bytes of \a txData, followed
+ *  by \a rxLength zero bytes during which the data latched in is written
+ *  to \a rxData. Unlike two calls of spiTxRx() the SPI FIFO is not drained
+ *  between the two phases, so there is no gap on the bus.
+ *
+ *  \param[in] txData: Buffer of size \a txLength to be transmitted.
+ *  \param[in] txLength: Number of bytes to be transmitted.
+ *  \param[out] rxData: Buffer of size \a rxLength where received data is
+ *              written to OR NULL in order to perform a write-only operation.
+ *  \param[in] rxLength: Number of bytes to be received.
+ *
+ *  \return ERR_NONE : No error, all bytes transmitted/received.
+ *
+ *****************************************************************************
+ */
+extern s8 spiWriteRead(const u8* txData, u16 txLength, u8* rxData, u16 rxLength);
+
 /*!
  *****************************************************************************
  *  \brief  Disables SPI interfaces
@@ -158,6 +158,37 @@ extern u8 applReadReg( u16 rxSize, const u8 * rxData, u16 * txSize, u8 * txData
  */
 extern u8 applWriteReg( u16 rxSize, const u8 * rxData, u16 * txSize, u8 * txData );
 
+/*!
+ *****************************************************************************
+ *  \brief  Generic function to write a batch of registers
+ *
+ *  Function which can be implemented by the application to write several
+ *  registers with one request. The request payload is a list of
+ *  (address, mask, value) triples, the reply holds one byte per triple.
+ *  \param[in] rxData : pointer to payload for appl commands (in stream protocol buffer).
+ *  \param[in] rxSize : size of rxData
+ *  \param[out] txData : pointer to buffer to store returned data (payload only)
+ *  \param[out] txSize : size of returned data
+ *  \return the status byte to be interpreted by the stream layer on the host
+ *****************************************************************************
+ */
+extern u8 applWriteRegs( u16 rxSize, const u8 * rxData, u16 * txSize, u8 * txData );
+
+/*!
+ *****************************************************************************
+ *  \brief  Generic function to read the trace buffer
+ *
+ *  Function which can be implemented by the application to move the events
+ *  it has traced to the reply. The request has no payload.
+ *  \param[in] rxData : pointer to payload for appl commands (in stream protocol buffer).
+ *  \param[in] rxSize : size of rxData
+ *  \param[out] txData : pointer to buffer to store returned data (payload only)
+ *  \param[out] txSize : size of returned data
+ *  \return the status byte to be interpreted by the stream layer on the host
+ *****************************************************************************
+ */
+extern u8 applReadTrace( u16 rxSize, const u8 * rxData, u16 * txSize, u8 * txData );
+
 
 /* ------------ functions ---------------------------------------- */
 
@@ -195,4 +226,17 @@ void StreamDispatcherInit( u32 sysClk );
  *  *******************************************************************/
 void ProcessIO( );
 
+/********************************************************************
+ *  \brief  Queues what applProcessCyclic() has to send right now.
+ *
+ *  For applications which produce data while they are busy and can not
+ *  wait for the next call of ProcessIO(), e.g. tags found in the middle
+ *  of an inventory round. The frame is handed to uartTxQueueNBytes(), so
+ *  the call does not wait for the UART.
+ *
+ *  \return ERR_NONE : The frame is queued or there was nothing to send.
+ *  \return ERR_NOMEM : The TX ring is full, the frame has been dropped.
+ *  *******************************************************************/
+s8 StreamDispatcherProcessCyclic( );
+
 #endif /* STREAM_DISPATCHER */
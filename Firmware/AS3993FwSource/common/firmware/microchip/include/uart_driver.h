@@ -45,6 +45,7 @@
  * - Initialize UART driver: #uartTxInitialize()/uartRxInitialize()/uartInitialize()
  * - Deinitialize UART driver: #uartTxDeinitialize
  * - Transmit data: #uartTxNBytes
+ * - Transmit data without waiting: #uartTxQueueNBytes
  * - size of received data: #uartRxNumBytesAvailable
  * - get received data: #uartRxNBytes
  */
@@ -82,6 +83,15 @@
  */
 #define UART_READ_REG(REG) U1##REG
 
+/* Baudrates above this use the high speed (BRGH, 4x) baudrate generator */
+#define UART_BRGH_THRESHOLD 115200UL
+#define UART_MODE_BRGH      0x0008
+/* A baudrate is only accepted if the generator gets within 1/25 (4%) of it */
+#define UART_MAX_BAUD_DEVIATION 25
+
+#define UART_TX_BUFFER_SIZE 256         /* Holds three frames of a streamed tag with TID and
+sensor data. At a baudrate of 115200 it takes ~22ms to send it. */
+
 #ifdef UART_RECEIVE_ENABLED
 #define UART_RX_BUFFER_SIZE 128         /* At a baudrate of 115200 it takes ~11ms to fill it.
 The driver has to be polled in this time frame. */
@@ -188,6 +198,24 @@ extern s8 uartRxInitialize();
  */
 extern s8 uartInitialize(u32 sysclk, u32 baudrate, u32* actbaudrate);
 
+/*!
+ *****************************************************************************
+ *  \brief  Check whether a baudrate can be generated
+ *
+ *  Calculates the baudrate the generator would actually produce for
+ *  \a baudrate without touching the UART. Use it before switching a running
+ *  link with uartInitialize().
+ *
+ *  \param[in] sysclk: clk frequency the system is configured to
+ *  \param[in] baudrate: Baudrate to check, e.g. 460800
+ *  \param[out] actbaudrate: Baudrate the generator would produce.
+ *  \return ERR_NONE : The baudrate is within UART_MAX_BAUD_DEVIATION.
+ *  \return ERR_PARAM : The baudrate can not be generated accurately enough.
+ *
+ *****************************************************************************
+ */
+extern s8 uartCheckBaudrate(u32 sysclk, u32 baudrate, u32* actbaudrate);
+
 /*!
  *****************************************************************************
  *  \brief  Deinitialize UART TX interface
@@ -233,7 +261,7 @@ extern s8 uartTxString(const char * text);
  *
  *  This function is used to transmit \a length bytes via the UART interface.
  *  \note blocking implementation, i.e. Function doesn't return before all
- *  data has been sent.
+ *  data has been sent. Bytes queued with uartTxQueueNBytes() are sent first.
  *
  *  \param[in] buffer: Buffer of size \a length to be transmitted.
  *  \param[in] length: Number of bytes to be transmitted.
@@ -244,6 +272,24 @@ extern s8 uartTxString(const char * text);
  */
 extern s8 uartTxNBytes(const u8* buffer, u16 length);
 
+/*!
+ *****************************************************************************
+ *  \brief  Queue a given number of bytes for transmission
+ *
+ *  Copies \a length bytes into the TX ring and returns right away, the UART
+ *  TX interrupt sends them. The bytes are queued all or none, so a frame is
+ *  never cut in two.
+ *
+ *  \param[in] buffer: Buffer of size \a length to be transmitted.
+ *  \param[in] length: Number of bytes to be transmitted.
+ *
+ *  \return ERR_NONE : All data queued.
+ *  \return ERR_NOMEM : Not enough room in the ring, nothing queued.
+ *
+ *****************************************************************************
+ */
+extern s8 uartTxQueueNBytes(const u8* buffer, u16 length);
+
 
 /*!
  *****************************************************************************
@@ -0,0 +1,111 @@
+/*
+ *****************************************************************************
+ * Copyright by ams AG                                                       *
+ * All rights are reserved.                                                  *
+ *                                                                           *
+ * IMPORTANT - PLEASE READ CAREFULLY BEFORE COPYING, INSTALLING OR USING     *
+ * THE SOFTWARE.                                                             *
+ *                                                                           *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS       *
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT         *
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS         *
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT  *
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,     *
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT          *
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,     *
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY     *
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT       *
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE     *
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.      *
+ *****************************************************************************
+ */
+/*
+ *      $Revision: $
+ *      LANGUAGE:  ANSI C
+ */
+
+/*! \file
+ *
+ *  \brief cooperative run loop
+ *
+ */
+
+/*
+******************************************************************************
+* INCLUDES
+******************************************************************************
+*/
+#include <p24Fxxxx.h>
+#include "run_loop.h"
+
+/*
+******************************************************************************
+* LOCAL VARIABLES
+******************************************************************************
+*/
+static volatile u8 pendingEvents;
+static volatile u16 ticks;
+
+/*
+******************************************************************************
+* GLOBAL FUNCTIONS
+******************************************************************************
+*/
+
+void runLoopPostEvent(u8 events)
+{
+    u16 cpuIpl;
+
+    SET_AND_SAVE_CPU_IPL(cpuIpl, 7);
+    pendingEvents |= events;
+    RESTORE_CPU_IPL(cpuIpl);
+}
+
+u8 runLoopTakeEvents(u8 events)
+{
+    u16 cpuIpl;
+    u8 posted;
+
+    SET_AND_SAVE_CPU_IPL(cpuIpl, 7);
+    posted = pendingEvents & events;
+    pendingEvents &= ~events;
+    RESTORE_CPU_IPL(cpuIpl);
+    return posted;
+}
+
+BOOL runLoopEventPending(u8 events)
+{
+    return (pendingEvents & events) != 0;
+}
+
+u8 runLoopWait(u8 events)
+{
+    u16 cpuIpl;
+    u8 posted;
+
+    /* With interrupts masked an event can not be posted between the check
+       and Idle(). An enabled interrupt still ends Idle mode, its handler
+       runs as soon as the priority is restored. */
+    SET_AND_SAVE_CPU_IPL(cpuIpl, 7);
+    while (!(pendingEvents & events))
+    {
+        Idle();
+        RESTORE_CPU_IPL(cpuIpl);
+        SET_AND_SAVE_CPU_IPL(cpuIpl, 7);
+    }
+    posted = pendingEvents & events;
+    pendingEvents &= ~events;
+    RESTORE_CPU_IPL(cpuIpl);
+    return posted;
+}
+
+void runLoopTick(void)
+{
+    ticks++;
+    runLoopPostEvent(RUN_LOOP_EVENT_TICK);
+}
+
+u16 runLoopTicks(void)
+{
+    return ticks;
+}
@@ -69,6 +69,12 @@
 #define spiWriteCon2(A) *hw->con2 = (A)
 #define spiWriteBuf(A)  *hw->buf  = (A)
 
+#ifdef __PIC24FJ128GB202__
+#define spiRxEmpty()    (SPI1STATLbits.SPIRBE)
+#else
+#define spiRxEmpty()    (spiReadStat() & 0x20)  /* SRXMPT, enhanced buffer mode */
+#endif
+
 /*
 ******************************************************************************
 * LOCAL DATATYPES
@@ -146,6 +152,63 @@ static unsigned char spienbits[2];
 * LOCAL FUNCTIONS
 ******************************************************************************
 */
+/*!
+ * Shifts \a length bytes. Byte k sent is txData[k] for k < \a txLength and 0
+ * after it, byte k received is stored to rxData[k - rxSkip] for k >= \a rxSkip.
+ * Up to SPI_FIFO_DEPTH bytes are kept in flight, so the SPI clock runs without
+ * gaps between the bytes. Every byte written also latches one byte into the
+ * receive FIFO, which has the same depth and therefore cannot overflow.
+ */
+static void spiShift(const u8* txData, u16 txLength, u8* rxData, u16 rxSkip, u16 length)
+{
+    const struct spiHw *hw = spiController + myCfgData.instance;
+    u16 txed = 0;
+    u16 rxed = 0;
+#if USE_LOGGER
+    u16 i;
+#endif
+
+    while (rxed < length)
+    {
+        while (txed < length && txed - rxed < SPI_FIFO_DEPTH)
+        {
+            spiWriteBuf(txed < txLength ? txData[txed] : 0);
+            txed++;
+        }
+        while (!spiRxEmpty())
+        {
+            if (rxData != NULL && rxed >= rxSkip)
+            {
+                rxData[rxed - rxSkip] = spiReadBuf();
+            }
+            else
+            {
+                spiReadBuf();
+            }
+            rxed++;
+        }
+    }
+
+#if USE_LOGGER
+    SPI_LOG("SPI Write:");
+    for (i = 0; i < length; i++)
+    {
+        SPI_LOG(" %hhx", i < txLength ? txData[i] : 0);
+    }
+    if (rxData)
+    {
+        SPI_LOG(" ->");
+
+        for (i = rxSkip; i < length; i++)
+        {
+            SPI_LOG(" %hhx",rxData[i - rxSkip]);
+        }
+    }
+
+    SPI_LOG("\n");
+#endif
+}
+
 /*
 ******************************************************************************
 * GLOBAL FUNCTIONS
@@ -395,104 +458,17 @@ s8 spiDeinitialize()
 
 s8 spiTxRx(const u8* txData, u8* rxData, u16 length)
 {
-    const struct spiHw *hw = spiController + myCfgData.instance;
-    u16 i = 0;
-
     if (length == 0) return 0;
 
-#ifdef __PIC24FJ128GB202__
-    // Wait if buffer is full
-    //while(SPI1STATLbits.SPITBF);
-#endif
-    SPI_LOG("SPI Write:");
-
-    /* Write one data before proceeding, this is possible because we have a FIFO */
-    /* This could also be changed to a more efficient scheme always looking
-       at water levels. But this only makes sense at very high SPI speeds,
-       improvement for future */
-    if (txData != NULL)
-    {
-        SPI_LOG(" %hhx", txData[i]);
-        spiWriteBuf(txData[i]);
-    }
-    else
-    {
-        SPI_LOG(" %hhx", 0);
-        spiWriteBuf(0);
-    }
-    i++;
-
-    /* Write the next byte, then receive the previous byte */
-    while (i < length)
-    {
-#ifdef __PIC24FJ128GB202__
-        // Wait if buffer is full
-        //while(SPI1STATLbits.SPITBF);
-#endif
-        if (txData != NULL)
-        {
-            SPI_LOG(" %hhx", txData[i]);
-            spiWriteBuf(txData[i]);
-        }
-        else
-        {
-            SPI_LOG(" %hhx", 0);
-            spiWriteBuf(0);
-        }
-        i++;
-
-#ifdef __PIC24FJ128GB202__
-        // Wait if receive buffer is empty
-        while(SPI1STATLbits.SPIRBE);
-#else
-        while (spiReadStat() & 0x20);
-#endif
-
-        if ((rxData != NULL))
-        {
-            rxData[i - 2] = spiReadBuf();
-        }
-        else
-        {
-            spiReadBuf();
-        }
-    }
-
-#ifdef __PIC24FJ128GB202__
-    // Wait if receive buffer is empty
-    while(SPI1STATLbits.SPIRBE);
-#else
-    while (spiReadStat() & 0x20);
-#endif
-
-    /* Receive the last byte, FIFO should be empty for both directions */
-    if ((rxData != NULL))
-    {
-        rxData[i - 1] = spiReadBuf();
-    }
-    else
-    {
-        spiReadBuf();
-    }
-
-#if USE_LOGGER
-    if (rxData)
-    {
-        SPI_LOG(" ->");
+    spiShift(txData, (txData != NULL) ? length : 0, rxData, 0, length);
+    return ERR_NONE;
+}
 
-        for (i = 0; i < length; i++)
-        {
-            SPI_LOG(" %hhx",rxData[i]);
-        }
-    }
+s8 spiWriteRead(const u8* txData, u16 txLength, u8* rxData, u16 rxLength)
+{
+    if (txLength + rxLength == 0) return 0;
 
-    SPI_LOG("\n");
-#endif
-//    if (spiReadCon2() & 0x01)
-//    {
-//        // Enhanced Buffer Mode -> wait for pending transfers
-//        while(SPI1STATbits.SPIBEC);
-//    }
+    spiShift(txData, txLength, rxData, txLength, txLength + rxLength);
     return ERR_NONE;
 }
 
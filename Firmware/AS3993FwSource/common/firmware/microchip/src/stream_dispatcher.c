@@ -45,6 +45,7 @@
 #include "uart_stream_driver.h"
 #include "bootloadable.h"
 #include "ams_types.h"
+#include "errno.h"
 #include "i2c_driver.h"
 #include "spi_driver.h"
 #include "logger.h"
@@ -68,10 +69,14 @@
 
 /* ------------- local variables -------------------------------------------- */
 static u8 rxBuffer[ COM_BUFFER_MAX_SIZE ] NOLOAD; /*! buffer to store protocol packets received from the Host */
-static u8 txBuffer[ COM_BUFFER_MAX_SIZE ] NOLOAD; /*! buffer to store protocol packets which are transmitted to the Host */
+/* handlers may fill PAYLOAD_MAX_SIZE bytes, sendResponse() appends the sequence number of a tagged request behind them */
+static u8 txBuffer[ COM_BUFFER_MAX_SIZE + UART_SEQUENCE_SIZE ] NOLOAD; /*! buffer to store protocol packets which are transmitted to the Host */
 
 static u32 systemClock;
 static u8 lastError; /* flag inicating different types of errors that cannot be reported in the protocol status field */
+static u8 rxSequence; /* sequence number of the request currently processed, 0 if the request is untagged */
+static u32 linkBaudrate; /* baudrate the host link currently runs at */
+static u32 requestedBaudrate; /* baudrate to switch to once the reply to AMS_COM_SET_BAUDRATE is out */
 
 
 /* ------------- local functions --------------------------------------------- */
@@ -223,7 +228,52 @@ static u8 handleEnterBootloader ( )
     return AMS_STREAM_NO_ERROR;
 }
 
-static s8 sendResponse ( u8 msgType, u8 status, u8 *txBuf, u16 toTx )
+/*!
+ * Validates a baudrate requested by the host and replies the rate the UART
+ * will actually run at. The switch itself happens in setLinkBaudrate() after
+ * the reply has been sent at the old rate.
+ */
+static u8 handleSetBaudrate ( u16 rxed, u8 * rxData, u16 * toTx, u8 * txData )
+{
+    u32 actualBaudrate;
+
+    *toTx = 0;
+    if ( rxed < 4 )
+    {
+        return SIZE_ERROR;
+    }
+    requestedBaudrate = (u32)rxData[0] | ((u32)rxData[1] << 8) | ((u32)rxData[2] << 16) | ((u32)rxData[3] << 24);
+    if ( uartCheckBaudrate( systemClock, requestedBaudrate, &actualBaudrate ) != ERR_NONE )
+    {
+        INFO_LOG( "SetBaudrate %lu rejected\n", requestedBaudrate );
+        return AMS_STREAM_PROTOCOL_FAILED;
+    }
+    INFO_LOG( "SetBaudrate %lu (actual %lu)\n", requestedBaudrate, actualBaudrate );
+    txData[0] = actualBaudrate & 0xFF;
+    txData[1] = (actualBaudrate >> 8) & 0xFF;
+    txData[2] = (actualBaudrate >> 16) & 0xFF;
+    txData[3] = (actualBaudrate >> 24) & 0xFF;
+    *toTx = 4;
+    return AMS_STREAM_NO_ERROR;
+}
+
+/*!
+ * Reprograms the UART. uartTxNBytes() only returns once the last stop bit is
+ * out, so a reply sent before is not cut off. A partially received request
+ * is dropped.
+ */
+static void setLinkBaudrate ( u32 baudrate )
+{
+    uartInitialize( systemClock, baudrate, 0 );
+    StreamInitialize( rxBuffer, txBuffer );
+    linkBaudrate = baudrate;
+}
+
+/*!
+ * Completes the header of the reply in txBuf and returns the length of the
+ * frame.
+ */
+static u16 buildResponse ( u8 msgType, u8 status, u8 *txBuf, u16 toTx )
 {
     u16 messageLength;
     u16 crc;
@@ -308,19 +358,40 @@ static s8 sendResponse ( u8 msgType, u8 status, u8 *txBuf, u16 toTx )
         case AMS_COM_READ_REG:
                 UART_SET_MESSAGE_TYPE( txBuf, COM_READ_REG_RESP ); 
             break;
+        case AMS_COM_SET_BAUDRATE:
+                UART_SET_MESSAGE_TYPE( txBuf, COM_SET_BAUDRATE_RESP ); 
+            break;
+        case AMS_COM_WRITE_REGS:
+                UART_SET_MESSAGE_TYPE( txBuf, COM_WRITE_REGS_RESP ); 
+            break;
+        case AMS_COM_READ_TRACE:
+                UART_SET_MESSAGE_TYPE( txBuf, COM_READ_TRACE_RESP ); 
+            break;
         case CMD_GET_TAG_DATA:
                 UART_SET_MESSAGE_TYPE( txBuf, CMD_GET_TAG_DATA_RESP ); 
         default:
             break;
     }
     
+    if ( rxSequence != 0 )
+    { /* tagged request: echo the sequence number behind the payload */
+        txBuf[ UART_HEADER_SIZE + toTx ] = rxSequence;
+        toTx += UART_SEQUENCE_SIZE;
+        UART_SET_MESSAGE_TYPE( txBuf, UART_GET_MESSAGE_TYPE( txBuf ) | UART_SEQUENCE_FLAG );
+    }
+
     messageLength = toTx + UART_HEADER_SIZE;
     UART_SET_MESSAGE_LENGTH( txBuf, messageLength );    
     UART_SET_MESSAGE_CRC( txBuf, 0 );  
     UART_SET_MESSAGE_STATUS( txBuf, status );
     crc = calcCrc16(txBuf, messageLength);
     UART_SET_MESSAGE_CRC( txBuf, crc ); 
-    return uartTxNBytes( txBuf, messageLength );
+    return messageLength;
+}
+
+static s8 sendResponse ( u8 msgType, u8 status, u8 *txBuf, u16 toTx )
+{
+    return uartTxNBytes( txBuf, buildResponse( msgType, status, txBuf, toTx ) );
 }
 
 
@@ -337,6 +408,7 @@ static void processReceivedPackets ( )
     //{
     /* read out protocol header data */
     u8  msgType    = UART_GET_MESSAGE_TYPE( rxBuffer );
+    u8  msgSequence = UART_GET_MESSAGE_SEQUENCE( rxBuffer );
     u16 msgLength  = UART_GET_MESSAGE_LENGTH( rxBuffer );
     u16 msgCRC  = UART_GET_MESSAGE_CRC( rxBuffer );
     u16 rxed       = msgLength - UART_HEADER_SIZE;
@@ -359,9 +431,15 @@ static void processReceivedPackets ( )
    UART_SET_MESSAGE_CRC( rxBuffer, 0);
     if( checkMsgCRC(msgLength, msgCRC, rxBuffer) != 0 )
     {
+        rxSequence = 0; /* the sequence number can not be trusted either */
         sendResponse( msgType, CRC_ERROR, txBuf, 0 );
+        if ( linkBaudrate != BAUDRATE )
+        { /* the negotiated rate is not reliable, the host falls back as well */
+            setLinkBaudrate( BAUDRATE );
+        }
         return;
     }
+    rxSequence = msgSequence;
     
     if( rxed > PAYLOAD_MAX_SIZE )
     { 
@@ -419,6 +497,22 @@ static void processReceivedPackets ( )
                 status = applReadReg( rxed, rxData, &toTx, &txBuf[6] );
                 sendResponse( msgType, status, txBuf, toTx );
             break;
+        case AMS_COM_WRITE_REGS:
+                status = applWriteRegs( rxed, rxData, &toTx, &txBuf[6] );
+                sendResponse( msgType, status, txBuf, toTx );
+            break;
+        case AMS_COM_READ_TRACE:
+                status = applReadTrace( rxed, rxData, &toTx, &txBuf[6] );
+                sendResponse( msgType, status, txBuf, toTx );
+            break;
+        case AMS_COM_SET_BAUDRATE:
+                status = handleSetBaudrate( rxed, rxData, &toTx, &txBuf[6] );
+                sendResponse( msgType, status, txBuf, toTx );
+                if ( status == AMS_STREAM_NO_ERROR )
+                {
+                    setLinkBaudrate( requestedBaudrate );
+                }
+            break;
         default:
                 if ( msgType > CMD_RSSI_MEAS_CMD_ID )
                 { /* reserved protocol value and not handled so far */
@@ -448,49 +542,29 @@ static void processReceivedPackets ( )
     return;
 }
 
-//static u16 processCyclic ( )
-//{
-//    /* every time we enter this function, the last txBuffer was already sent.
-//       So we fill a new transfer buffer */
-//    u8 * txEnd = txBuffer; /* the txEnd always points to the next position to be filled with data */
-//    u16 txSize = 0;
-//    u16 toTx;
-//    u8 protocol;
-//    u8 status = AMS_STREAM_NO_ERROR;
-//
-//    do
-//    {
-//        /* set up tx pointer for any data to be transmitted back to the host */
-//        u8 * txData = UART_GET_MESSAGE_PAYLOAD( txEnd );
-//        toTx = 0;
-//        status = applProcessCyclic( &protocol, &toTx, txData, AMS_STREAM_MAX_DATA_SIZE - txSize );
-//
-//        /* fill out transmit packet header if any data was produced */
-//        if ( toTx > 0 )
-//        {
-//            INFO_LOG( "ProcessCyclic\n" );
-//
-//            AMS_STREAM_DT_SET_PROTOCOL( txEnd, protocol );
-//            AMS_STREAM_DT_SET_STATUS( txEnd, status );
-//            AMS_STREAM_DT_SET_TX_LENGTH( txEnd, toTx );
-//
-//            INFO_LOG( "TX-Packet: protocol=%hhx status=%hhx toTx=%u\n", protocol, status, toTx );
-//#if STREAM_DEBUG
-//	    LOGDUMP( txEnd, toTx + AMS_STREAM_HEADER_SIZE );
-//#endif
-//            /* adjust pointer to the enter next data, and total size */
-//            txEnd += ( toTx + AMS_STREAM_HEADER_SIZE );
-//            txSize += (toTx + AMS_STREAM_HEADER_SIZE );
-//        }
-//        else if ( status != AMS_STREAM_NO_ERROR ) /* protocol failed, we indicate an error if command itself does not send back */
-//        {
-//            lastError = status;
-//        }
-//    }
-//    while ( toTx > 0 );
-//
-//    return txSize;
-//}
+/*!
+ * Sends the data the application produces without a request from the host,
+ * i.e. the tag data of cyclic inventory rounds. Such frames answer no request
+ * and therefore never carry a sequence number.
+ */
+static void processCyclic ( )
+{
+    u16 toTx = 0;
+    u8 protocol;
+    u8 status;
+
+    status = applProcessCyclic( &protocol, &toTx, &txBuffer[UART_HEADER_SIZE], PAYLOAD_MAX_SIZE );
+    if ( toTx > 0 )
+    {
+        INFO_LOG( "ProcessCyclic: protocol=%hhx status=%hhx toTx=%u\n", protocol, status, toTx );
+        rxSequence = 0;
+        sendResponse( protocol, status, txBuffer, toTx );
+    }
+    else if ( status != AMS_STREAM_NO_ERROR )
+    {
+        lastError = status;
+    }
+}
 
 
 /* --------- global functions ------------------------------------------------------------- */
@@ -505,6 +579,7 @@ void StreamDispatcherInit ( u32 sysClk )
 {
     StreamDispatcherGetLastError();
     systemClock = sysClk;
+    linkBaudrate = BAUDRATE;
     StreamInitialize( rxBuffer, txBuffer );
 }
 
@@ -521,6 +596,12 @@ void ProcessIO(void)
 
     if ( UARTReady() )
     {
+        if ( linkBaudrate != BAUDRATE && uartGetError( ) != ERR_NONE )
+        { /* framing errors or overruns at a negotiated rate: the host gave up
+             on it or the line can not carry it, so go back to the default */
+            setLinkBaudrate( BAUDRATE );
+        }
+
         /* read out data from stream driver, and move it to module-local buffer */
         if ( packetReceive() > 0 )
         {
@@ -534,12 +615,24 @@ void ProcessIO(void)
         }
         
         /* we need to call the processCyclic function for all applications that
-           have any data to send (without receiving a hid packet). The data to
-           be sent is written into the module-local buffer */
-        //txSize = processCyclic( );
-        
-        /* transmit any data waiting in the module-local buffer */
-        //StreamTransmit( txSize );
+           have any data to send (without receiving a packet). The data is sent
+           right away. */
+        processCyclic( );
+    }
+}
+
+s8 StreamDispatcherProcessCyclic( )
+{
+    u16 toTx = 0;
+    u8 protocol;
+    u8 status;
+
+    status = applProcessCyclic( &protocol, &toTx, &txBuffer[UART_HEADER_SIZE], PAYLOAD_MAX_SIZE );
+    if ( toTx == 0 )
+    {
+        return ERR_NONE;
     }
+    rxSequence = 0;
+    return uartTxQueueNBytes( txBuffer, buildResponse( protocol, status, txBuffer, toTx ) );
 }
 
@@ -58,9 +58,10 @@
 #else
 #include "uart.h"
 #endif
-#ifdef UART_RECEIVE_ENABLED
 #include "Compiler.h"
+#ifdef UART_RECEIVE_ENABLED
 #include "string.h"
+#include "run_loop.h"
 #endif
 /*
 ******************************************************************************
@@ -70,6 +71,7 @@
 #ifdef UART_RECEIVE_ENABLED
 #define uart1RxIsr _U1RXInterrupt
 #endif
+#define uart1TxIsr _U1TXInterrupt
 
 /*
 ******************************************************************************
@@ -81,6 +83,11 @@ static u8 rxBuffer[UART_RX_BUFFER_SIZE] NOLOAD;
 static u16 rxCount;
 static u8 rxError;
 #endif
+/* bytes queued by uartTxQueueNBytes(), sent by uart1TxIsr() */
+static u8 txRing[UART_TX_BUFFER_SIZE] NOLOAD;
+static u16 txHead;
+static volatile u16 txTail;
+static volatile u16 txCount;
 
 
 /*
@@ -104,41 +111,70 @@ unsigned int ReadUART1(void)
 }
 #endif
 
-s8 uartTxInitialize (u32 sysclk, u32 baudrate, u32* actbaudrate)
+/* Calculates the baudrate generator value for baudrate and the baudrate it
+   actually produces */
+static u16 uartCalcBrg (u32 sysclk, u32 baudrate, u32* actbaudrate)
 {
     u32 br1, br2;
     u16 breg;
+    u32 divider = ( baudrate > UART_BRGH_THRESHOLD ) ? 4 : 16;
 
-    /* Disable UART for configuration */
-    UART_WRITE_REG(MODE, 0x0);
-    UART_WRITE_REG(STA, 0x0);
-
-    /* Setup UART registers */
     /* equation according to the datasheet:
-       (sysclk / (16 * baudrate)) - 1
+       (sysclk / (divider * baudrate)) - 1
      */
-    breg = (sysclk / (16 * baudrate)) - 1;
+    breg = (sysclk / (divider * baudrate)) - 1;
 
     /* round up/down w/o using floating point maths */
-    br1 = sysclk / (16 * (breg + 1));
-    br2 = sysclk / (16 * (breg + 2));
+    br1 = sysclk / (divider * (breg + 1));
+    br2 = sysclk / (divider * (breg + 2));
 
     /* check which of the two values produce fewer error rate */
     if ((br1 - baudrate) > (baudrate - br2))
     {
-        UART_WRITE_REG(BRG, breg + 1);
-        if ( actbaudrate )
-        {
-            *actbaudrate = br2;
-        }
+        *actbaudrate = br2;
+        return breg + 1;
     }
-    else
+    *actbaudrate = br1;
+    return breg;
+}
+
+/* Moves queued bytes into the hardware TX buffer until it is full. Called
+   with the TX interrupt disabled or from the TX interrupt itself. */
+static void uartTxFill (void)
+{
+    while ( txCount && !U1STAbits.UTXBF )
     {
-        UART_WRITE_REG(BRG, breg);
-        if ( actbaudrate )
-        {
-            *actbaudrate = br1;
-        }
+        UART_WRITE_REG(TXREG, txRing[txTail]);
+        txTail = (txTail + 1) % UART_TX_BUFFER_SIZE;
+        txCount--;
+    }
+}
+
+s8 uartTxInitialize (u32 sysclk, u32 baudrate, u32* actbaudrate)
+{
+    u32 actbaud;
+    u16 breg = uartCalcBrg(sysclk, baudrate, &actbaud);
+
+    /* Drop what is still queued, the UART is reset anyway */
+    IEC0bits.U1TXIE = 0;
+    IFS0bits.U1TXIF = 0;
+    txHead = 0;
+    txTail = 0;
+    txCount = 0;
+
+    /* Disable UART for configuration */
+    UART_WRITE_REG(MODE, 0x0);
+    UART_WRITE_REG(STA, 0x0);
+
+    /* Setup UART registers */
+    if ( baudrate > UART_BRGH_THRESHOLD )
+    {
+        UART_WRITE_REG(MODE, UART_MODE_BRGH);
+    }
+    UART_WRITE_REG(BRG, breg);
+    if ( actbaudrate )
+    {
+        *actbaudrate = actbaud;
     }
     /* Enable UART */
     UART_WRITE_REG(MODE, UART_READ_REG(MODE) | 0x8000);
@@ -147,6 +183,23 @@ s8 uartTxInitialize (u32 sysclk, u32 baudrate, u32* actbaudrate)
     return ERR_NONE;
 }
 
+s8 uartCheckBaudrate (u32 sysclk, u32 baudrate, u32* actbaudrate)
+{
+    u32 deviation;
+
+    if ( baudrate == 0 || baudrate > sysclk / 4 )
+    {
+        return ERR_PARAM;
+    }
+    uartCalcBrg(sysclk, baudrate, actbaudrate);
+    deviation = ( *actbaudrate > baudrate ) ? *actbaudrate - baudrate : baudrate - *actbaudrate;
+    if ( deviation > baudrate / UART_MAX_BAUD_DEVIATION )
+    {
+        return ERR_PARAM;
+    }
+    return ERR_NONE;
+}
+
 #ifdef UART_RECEIVE_ENABLED
 s8 uartRxInitialize ()
 {
@@ -221,6 +274,8 @@ s8 uartTxString ( const char * text )
 
 s8 uartTxNBytes ( const u8 * buffer, u16 length )
 {
+    /* queued bytes go first */
+    while ( txCount ) ;
     while ( length-- )
     {
         uartTx( *buffer );
@@ -230,6 +285,42 @@ s8 uartTxNBytes ( const u8 * buffer, u16 length )
     return ERR_NONE;
 }
 
+s8 uartTxQueueNBytes ( const u8 * buffer, u16 length )
+{
+    s8 result = ERR_NONE;
+
+    IEC0bits.U1TXIE = 0;
+    if ( length > UART_TX_BUFFER_SIZE - txCount )
+    {
+        result = ERR_NOMEM;
+    }
+    else
+    {
+        txCount += length;
+        while ( length-- )
+        {
+            txRing[txHead] = *buffer++;
+            txHead = (txHead + 1) % UART_TX_BUFFER_SIZE;
+        }
+        uartTxFill();
+    }
+    if ( txCount )
+    {
+        IEC0bits.U1TXIE = 1;
+    }
+    return result;
+}
+
+void INTERRUPT uart1TxIsr (void)
+{
+    IFS0bits.U1TXIF = 0;
+    uartTxFill();
+    if ( !txCount )
+    {
+        IEC0bits.U1TXIE = 0;
+    }
+}
+
 
 #ifdef UART_RECEIVE_ENABLED
 u16 uartRxNumBytesAvailable ()
@@ -272,9 +363,14 @@ void INTERRUPT uart1RxIsr (void)
             U1STAbits.OERR = 0;
             break;
         }
+        if ( U1STAbits.FERR )
+        { /* wrong stop bit, usually the host talks at another baudrate */
+            rxError = ERR_IO;
+        }
         rxBuffer[rxCount] = ReadUART1();
         rxCount++;
     }
+    runLoopPostEvent(RUN_LOOP_EVENT_HOST_RX);
 }
 
 u8 uartGetError ( void )
@@ -49,6 +49,7 @@
 #include "usb_function_hid.h"
 #include "ams_types.h"
 #include "logger.h"
+#include "run_loop.h"
 #include <stdio.h>
 
 #ifdef NO_INITIAL_LOAD
@@ -663,7 +664,10 @@ BOOL USER_USB_CALLBACK_EVENT_HANDLER(USB_EVENT event, void *pdata, WORD size)
         break;
     case EVENT_TRANSFER:
         //USB_LOG("EVENT_TRANSFER\n");
-        Nop();
+        /* pdata is the USTAT copy, its DIR bit (as in USTAT_EP0_IN) is set when
+           a report has been sent, only received reports are host input */
+        if ((*(BYTE*)pdata & USTAT_EP0_IN) == 0)
+            runLoopPostEvent(RUN_LOOP_EVENT_HOST_RX);
         break;
     default:
         //USB_LOG("EVENT_UNKNOWN\n");
@@ -128,6 +128,18 @@ u8 WEAK applWriteReg ( u16 rxSize, const u8 * rxData, u16 * txSize, u8 * txData
     return AMS_STREAM_UNHANDLED_PROTOCOL;
 }    
 
+u8 WEAK applWriteRegs ( u16 rxSize, const u8 * rxData, u16 * txSize, u8 * txData )
+{
+    INFO_LOG( "applWriteRegs N/A\n" );
+    return AMS_STREAM_UNHANDLED_PROTOCOL;
+}    
+
+u8 WEAK applReadTrace ( u16 rxSize, const u8 * rxData, u16 * txSize, u8 * txData )
+{
+    INFO_LOG( "applReadTrace N/A\n" );
+    return AMS_STREAM_UNHANDLED_PROTOCOL;
+}    
+
 void WEAK 	applSpiActivateSEN( u8 spiDeviceId )
 {
     INFO_LOG( "applSpiActivateSEN N/A\n" );
@@ -0,0 +1,24 @@
+/* ams_types.h for host builds of the tests. The firmware types assume the
+ * 16 bit int of the PIC24, here they get their widths from stdint.h.
+ * Put this directory in front of ../../include on the include path.
+ */
+#ifndef AMS_TYPES_H
+#define AMS_TYPES_H
+
+#include <stdint.h>
+#include "GenericTypeDefs.h"
+
+typedef uint8_t u8;
+typedef int8_t s8;
+typedef uint16_t u16;
+typedef int16_t s16;
+typedef uint32_t u32;
+typedef int32_t s32;
+typedef uint64_t u64;
+typedef int64_t s64;
+typedef u16 umword;
+typedef s16 smword;
+typedef unsigned int uint;
+typedef signed int sint;
+
+#endif /* AMS_TYPES_H */
@@ -0,0 +1 @@
+/* Empty libpic30.h for host builds of the tests, see p24Fxxxx.h. */
@@ -0,0 +1,3 @@
+/* Empty p24Fxxxx.h for host builds of the tests. Firmware headers include it
+ * for the register definitions, which host tests do not touch.
+ */
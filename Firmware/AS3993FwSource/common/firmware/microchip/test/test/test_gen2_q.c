@@ -0,0 +1,173 @@
+/* Tests of the Q selection of inventory rounds against a simulation of the
+ * slots of gen2SearchForTags(). Runs on the host:
+ *   gcc -DUNITY_TEST -Ihost -I../../include -o test_gen2_q test_gen2_q.c test_gen2_q_Runner.c unity.c ../../../../../AS3993/firmware/src/gen2_q.c
+ */
+#include "unity.h"
+#include "../../../../../AS3993/firmware/src/gen2_q.h"
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+//------------------------------------------------------------------------------------------
+// Simulation
+// Every tag which is not inventoried yet picks one of the 2^q slots of a frame.
+// A slot with one tag reads it, a slot with more tags is a collision.
+#define SIM_MAX_Q 10
+static u16 simSlotTags[1 << SIM_MAX_Q];
+static u32 simSeed;
+
+static u16 simRandom()
+{
+    simSeed = simSeed * 1103515245UL + 12345;
+    return (u16)(simSeed >> 16);
+}
+
+static void simFrame(u8 q, u16 tags, Gen2Frame *frame)
+{
+    u16 slots = 1 << q;
+    u16 i;
+
+    for (i = 0; i < slots; i++)
+        simSlotTags[i] = 0;
+    for (i = 0; i < tags; i++)
+        simSlotTags[simRandom() & (slots - 1)]++;
+    frame->q = q;
+    frame->empty = 0;
+    frame->success = 0;
+    frame->collision = 0;
+    for (i = 0; i < slots; i++)
+    {
+        if (simSlotTags[i] == 0)
+            frame->empty++;
+        else if (simSlotTags[i] == 1)
+            frame->success++;
+        else
+            frame->collision++;
+    }
+}
+
+/* Q rule gen2SearchForTags() used before the estimator. */
+static u8 simOldQ(const Gen2Frame *frame)
+{
+    u16 slots = 1 << frame->q;
+
+    if (frame->collision >= slots / 4)
+        return frame->q + 1;
+    if (frame->collision < slots / 8 && frame->q > 0)
+        return frame->q - 1;
+    return frame->q;
+}
+
+/* Slots until all tags are read, frames start at q like an inventory does. */
+static u32 simInventory(u16 tags, u8 q, BOOL estimator)
+{
+    u32 slots = 0;
+    Gen2Frame frame;
+
+    while (tags)
+    {
+        simFrame(q, tags, &frame);
+        slots += 1UL << q;
+        tags -= frame.success;
+        q = estimator ? gen2QNext(&frame) : simOldQ(&frame);
+        if (q > SIM_MAX_Q)
+            q = SIM_MAX_Q;
+    }
+    return slots;
+}
+
+//------------------------------------------------------------------------------------------
+// Q selection
+void test_gen2_q_for_tags()
+{
+    TEST_ASSERT_EQUAL_UINT8(0, gen2QForTags(0));
+    TEST_ASSERT_EQUAL_UINT8(0, gen2QForTags(1));
+    TEST_ASSERT_EQUAL_UINT8(1, gen2QForTags(2));
+    TEST_ASSERT_EQUAL_UINT8(4, gen2QForTags(16));
+    TEST_ASSERT_EQUAL_UINT8(4, gen2QForTags(22));
+    TEST_ASSERT_EQUAL_UINT8(5, gen2QForTags(23));
+    TEST_ASSERT_EQUAL_UINT8(8, gen2QForTags(300));
+    TEST_ASSERT_EQUAL_UINT8(GEN2_Q_MAX, gen2QForTags(0xFFFF));
+}
+
+void test_gen2_q_estimate_without_collisions()
+{
+    Gen2Frame frame = { 4, 9, 7, 0 };
+
+    TEST_ASSERT_EQUAL_UINT16(7, gen2QEstimateTags(&frame));
+    TEST_ASSERT_EQUAL_UINT8(0, gen2QNext(&frame));
+}
+
+void test_gen2_q_estimate_single_slot()
+{
+    Gen2Frame frame = { 0, 0, 0, 1 };
+
+    TEST_ASSERT_EQUAL_UINT16(2, gen2QEstimateTags(&frame));
+    TEST_ASSERT_EQUAL_UINT8(1, gen2QNext(&frame));
+}
+
+// The mean estimate over many frames is close to the real tag count, from
+// frames half as large to frames twice as large as the population.
+void test_gen2_q_estimate_accuracy()
+{
+    static const u16 populations[] = { 10, 30, 60, 120, 250 };
+    u8 i, j;
+    s8 offset;
+
+    simSeed = 1;
+    for (i = 0; i < sizeof(populations) / sizeof(populations[0]); i++)
+    {
+        for (offset = -1; offset <= 1; offset++)
+        {
+            u8 q = gen2QForTags(populations[i]) + offset;
+            u32 sum = 0;
+            Gen2Frame frame;
+
+            for (j = 0; j < 200; j++)
+            {
+                simFrame(q, populations[i], &frame);
+                sum += gen2QEstimateTags(&frame);
+            }
+            TEST_ASSERT_UINT_WITHIN(populations[i] / 10 + 1, populations[i], sum / 200);
+        }
+    }
+}
+
+// A frame with collisions only must grow the frame more than QueryAdjust would.
+void test_gen2_q_saturated_frame()
+{
+    Gen2Frame frame;
+
+    simSeed = 2;
+    simFrame(4, 300, &frame);
+    TEST_ASSERT_EQUAL_UINT16(0, frame.empty);
+    TEST_ASSERT_TRUE(gen2QNext(&frame) >= 6);
+}
+
+// Reading a whole population takes about 3 slots per tag, close to the e slots
+// per tag of frame slotted ALOHA with ideal frames, and fewer than the old rule.
+void test_gen2_q_inventory_slots()
+{
+    static const u16 populations[] = { 20, 100, 300, 600 };
+    u8 i, j;
+
+    simSeed = 3;
+    for (i = 0; i < sizeof(populations) / sizeof(populations[0]); i++)
+    {
+        u32 estimatorSlots = 0;
+        u32 oldSlots = 0;
+
+        for (j = 0; j < 50; j++)
+        {
+            estimatorSlots += simInventory(populations[i], 4, 1);
+            oldSlots += simInventory(populations[i], 4, 0);
+        }
+        TEST_ASSERT_TRUE(estimatorSlots * 2 / populations[i] <= 310);
+        TEST_ASSERT_TRUE(estimatorSlots < oldSlots);
+    }
+}
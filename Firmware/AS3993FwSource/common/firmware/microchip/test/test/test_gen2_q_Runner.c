@@ -0,0 +1,61 @@
+/* AUTOGENERATED FILE. DO NOT EDIT. */
+
+//=======Test Runner Used To Run Each Test Below=====
+#define RUN_TEST(TestFunc, TestLineNum) \
+{ \
+  Unity.CurrentTestName = #TestFunc; \
+  Unity.CurrentTestLineNumber = TestLineNum; \
+  Unity.NumberOfTests++; \
+  if (TEST_PROTECT()) \
+  { \
+      setUp(); \
+      TestFunc(); \
+  } \
+  if (TEST_PROTECT() && !TEST_IS_IGNORED) \
+  { \
+    tearDown(); \
+  } \
+  UnityConcludeTest(); \
+}
+
+//=======Automagically Detected Files To Include=====
+#include "unity.h"
+#include <setjmp.h>
+#include <stdio.h>
+#include "../../../../../AS3993/firmware/src/gen2_q.h"
+
+//=======External Functions This Runner Calls=====
+extern void setUp(void);
+extern void tearDown(void);
+extern void test_gen2_q_for_tags();
+extern void test_gen2_q_estimate_without_collisions();
+extern void test_gen2_q_estimate_single_slot();
+extern void test_gen2_q_estimate_accuracy();
+extern void test_gen2_q_saturated_frame();
+extern void test_gen2_q_inventory_slots();
+
+
+//=======Test Reset Option=====
+void resetTest(void);
+void resetTest(void)
+{
+  tearDown();
+  setUp();
+}
+
+
+//=======MAIN=====
+#ifdef UNITY_TEST
+int main(void)
+{
+  UnityBegin("test_gen2_q.c");
+  RUN_TEST(test_gen2_q_for_tags, 86);
+  RUN_TEST(test_gen2_q_estimate_without_collisions, 98);
+  RUN_TEST(test_gen2_q_estimate_single_slot, 106);
+  RUN_TEST(test_gen2_q_estimate_accuracy, 116);
+  RUN_TEST(test_gen2_q_saturated_frame, 142);
+  RUN_TEST(test_gen2_q_inventory_slots, 154);
+
+  return (UnityEnd());
+}
+#endif
@@ -0,0 +1,118 @@
+/* Tests of the ring buffer of the binary event trace. Runs on the host:
+ *   gcc -DUNITY_TEST -Ihost -I../../include -I../../../../../AS3993/firmware/src -o test_trace test_trace.c test_trace_Runner.c unity.c ../../../../../AS3993/firmware/src/trace.c
+ */
+#include "unity.h"
+#include "trace.h"
+#include "timer.h"
+
+#define TEST_CLOCK      250000UL
+#define TEST_WRAP       (65536UL * 2500)
+
+static u8 reply[TRACE_HEADER_SIZE + (TRACE_SIZE + 1) * TRACE_EVENT_SIZE];
+static u32 now;
+
+/* Time stamps of the test are under its control. */
+u32 timerTimestamp()
+{
+    return now;
+}
+
+u32 timerTimestampWrap()
+{
+    return TEST_WRAP;
+}
+
+static u32 replyU32(u16 index)
+{
+    return reply[index] | (u32)reply[index + 1] << 8 | (u32)reply[index + 2] << 16 | (u32)reply[index + 3] << 24;
+}
+
+static u8 replyCount()
+{
+    return reply[10];
+}
+
+static u16 replyLost()
+{
+    return reply[8] | reply[9] << 8;
+}
+
+/* arg16 of the n-th event of the reply */
+static u16 replyArg16(u8 n)
+{
+    u16 index = TRACE_HEADER_SIZE + n * TRACE_EVENT_SIZE;
+
+    return reply[index + 2] | reply[index + 3] << 8;
+}
+
+void setUp()
+{
+    now = 0;
+    traceRead(reply, sizeof(reply));
+}
+
+void tearDown()
+{
+}
+
+//------------------------------------------------------------------------------------------
+void test_trace_empty()
+{
+    TEST_ASSERT_EQUAL_UINT16(TRACE_HEADER_SIZE, traceRead(reply, sizeof(reply)));
+    TEST_ASSERT_EQUAL_UINT32(TIMER_TIMESTAMP_HZ, replyU32(0));
+    TEST_ASSERT_EQUAL_UINT32(TEST_WRAP, replyU32(4));
+    TEST_ASSERT_EQUAL_UINT16(0, replyLost());
+    TEST_ASSERT_EQUAL_UINT8(0, replyCount());
+}
+
+void test_trace_event_layout()
+{
+    now = 0x12345678;
+    traceEvent(TRACE_FRAME_TAGS, 0x9A, 0xBEEF);
+    TEST_ASSERT_EQUAL_UINT16(TRACE_HEADER_SIZE + TRACE_EVENT_SIZE, traceRead(reply, sizeof(reply)));
+    TEST_ASSERT_EQUAL_UINT8(1, replyCount());
+    TEST_ASSERT_EQUAL_UINT8(TRACE_FRAME_TAGS, reply[TRACE_HEADER_SIZE]);
+    TEST_ASSERT_EQUAL_UINT8(0x9A, reply[TRACE_HEADER_SIZE + 1]);
+    TEST_ASSERT_EQUAL_UINT16(0xBEEF, replyArg16(0));
+    TEST_ASSERT_EQUAL_UINT32(0x12345678, replyU32(TRACE_HEADER_SIZE + 4));
+    /* read events are gone */
+    traceRead(reply, sizeof(reply));
+    TEST_ASSERT_EQUAL_UINT8(0, replyCount());
+}
+
+// A full buffer keeps the newest events and counts the ones it dropped.
+void test_trace_overflow()
+{
+    u16 i;
+
+    for (i = 0; i < TRACE_SIZE + 3; i++)
+        traceEvent(TRACE_FRAME_COLLISIONS, 0, i);
+    traceRead(reply, sizeof(reply));
+    TEST_ASSERT_EQUAL_UINT16(3, replyLost());
+    TEST_ASSERT_EQUAL_UINT8(TRACE_SIZE, replyCount());
+    for (i = 0; i < TRACE_SIZE; i++)
+        TEST_ASSERT_EQUAL_UINT16(i + 3, replyArg16(i));
+    traceRead(reply, sizeof(reply));
+    TEST_ASSERT_EQUAL_UINT16(0, replyLost());
+    TEST_ASSERT_EQUAL_UINT8(0, replyCount());
+}
+
+// A reply buffer which is too small for all events leaves the rest for the
+// next read, in order.
+void test_trace_partial_read()
+{
+    u16 i;
+
+    for (i = 0; i < 5; i++)
+        traceEvent(TRACE_FRAME_END, 0, i);
+    TEST_ASSERT_EQUAL_UINT16(TRACE_HEADER_SIZE + 2 * TRACE_EVENT_SIZE,
+            traceRead(reply, TRACE_HEADER_SIZE + 2 * TRACE_EVENT_SIZE + 1));
+    TEST_ASSERT_EQUAL_UINT8(2, replyCount());
+    TEST_ASSERT_EQUAL_UINT16(1, replyArg16(1));
+    traceEvent(TRACE_FRAME_END, 0, 5);
+    traceRead(reply, sizeof(reply));
+    TEST_ASSERT_EQUAL_UINT8(4, replyCount());
+    for (i = 0; i < 4; i++)
+        TEST_ASSERT_EQUAL_UINT16(i + 2, replyArg16(i));
+    TEST_ASSERT_EQUAL_UINT16(0, traceRead(reply, TRACE_HEADER_SIZE - 1));
+}
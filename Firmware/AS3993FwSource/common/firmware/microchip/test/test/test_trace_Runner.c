@@ -0,0 +1,58 @@
+/* AUTOGENERATED FILE. DO NOT EDIT. */
+
+//=======Test Runner Used To Run Each Test Below=====
+#define RUN_TEST(TestFunc, TestLineNum) \
+{ \
+  Unity.CurrentTestName = #TestFunc; \
+  Unity.CurrentTestLineNumber = TestLineNum; \
+  Unity.NumberOfTests++; \
+  if (TEST_PROTECT()) \
+  { \
+      setUp(); \
+      TestFunc(); \
+  } \
+  if (TEST_PROTECT() && !TEST_IS_IGNORED) \
+  { \
+    tearDown(); \
+  } \
+  UnityConcludeTest(); \
+}
+
+//=======Automagically Detected Files To Include=====
+#include "unity.h"
+#include <setjmp.h>
+#include <stdio.h>
+#include "trace.h"
+#include "timer.h"
+
+//=======External Functions This Runner Calls=====
+extern void setUp(void);
+extern void tearDown(void);
+extern void test_trace_empty();
+extern void test_trace_event_layout();
+extern void test_trace_overflow();
+extern void test_trace_partial_read();
+
+
+//=======Test Reset Option=====
+void resetTest(void);
+void resetTest(void)
+{
+  tearDown();
+  setUp();
+}
+
+
+//=======MAIN=====
+#ifdef UNITY_TEST
+int main(void)
+{
+  UnityBegin("test_trace.c");
+  RUN_TEST(test_trace_empty, 59);
+  RUN_TEST(test_trace_event_layout, 68);
+  RUN_TEST(test_trace_overflow, 84);
+  RUN_TEST(test_trace_partial_read, 102);
+
+  return (UnityEnd());
+}
+#endif
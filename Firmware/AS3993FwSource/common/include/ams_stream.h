@@ -341,16 +341,21 @@
 #define AMS_COM_CTRL_CMD_FW_NUMBER          0x67 /* returns the 3-byte FW number */
 #define AMS_COM_WRITE_REG                   0x68
 #define AMS_COM_READ_REG                    0x69
+#define AMS_COM_SET_BAUDRATE                0x6A /* 4-byte LE baudrate, replies the actual rate and switches after the reply */
 
 /* 0x6B = reserved protocol id 
    This will become 0xEB at sending because it is: 
    AMS_COM_WRITE_READ_NOT | AMS_COM_CTRL_CMD_ENTER_BOOTLOADER == 0x80 | 0x6B = 0xEB */
 #define AMS_COM_CTRL_CMD_ENTER_BOOTLOADER   0x6B 
 
+#define AMS_COM_WRITE_REGS                  0x6C /* (address, mask, value) triples, replies the value read back for each */
+
+#define AMS_COM_READ_TRACE                  0x6D /* moves the events of the firmware trace buffer to the reply */
+
 /* 0x7F = reserved protocol id */
 #define AMS_COM_FLUSH                       0x7F
 
-/* currently available reserved numbers are: 0x6A and 0x6C - 0x7E */
+/* currently available reserved numbers are: 0x6E - 0x7E */
 
 /* all unused numbers between 0x00 and 0x5F are forwarded in the firmware (by the stream_dispatcher.c) 
    to the function
@@ -481,4 +486,13 @@
 #define UART_SET_MESSAGE_CRC( buf, value )       do { buf[3] = (value >> 8) & 0xFF; buf[4] = value & 0xFF; } while ( 0 )
 #define UART_SET_MESSAGE_STATUS( buf, value )    buf[5] = value
 
+/* Pipelined requests: the status byte of a request (always 0 in a plain request)
+   may carry a sequence number 1..255. The reply to such a request has
+   UART_SEQUENCE_FLAG set in its message type and the sequence number appended
+   as last byte after the payload, so the host can keep several requests in
+   flight and match the replies. Sequence number 0 gives an untagged reply. */
+#define UART_SEQUENCE_FLAG                       0x80
+#define UART_SEQUENCE_SIZE                       1
+#define UART_GET_MESSAGE_SEQUENCE( buf )         buf[5]
+
 #endif /* AMS_STREAM_H */